@@ -1,5 +1,15 @@
 #include "../common/vulkan-tutorial.h"
 
+#ifdef EMBED_SPIRV
+// NOTE: EMBED=1でビルドすると、glslcが書き出した配列の初期化子を取り込み、起動時にファイルを読まない。
+static const uint32_t shader_vert_spv[] =
+#    include "shader.vert.inc"
+;
+static const uint32_t shader_frag_spv[] =
+#    include "shader.frag.inc"
+;
+#endif
+
 // A struct for vertex input data.
 // NOTE: 頂点情報の構造。
 // NOTE: のちのち変更されるため、vulkan-tutorial.hではなくここで定義しておく。
@@ -321,33 +331,31 @@ int main() {
     {
         // vertex shader
         // NOTE: ヴァーテックスシェーダモジュールを作成する。
-        int bin_vert_size;
-        char *bin_vert = read_bin("./shader.vert.spv", &bin_vert_size);
-        CHECK(bin_vert != NULL, "failed to read shader.vert.spv.");
+        SpirvCode bin_vert;
+        CHECK(LOAD_SPIRV(shader_vert_spv, "./shader.vert.spv", &bin_vert), "failed to read shader.vert.spv.");
         const VkShaderModuleCreateInfo vert_ci = {
             VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
             NULL,
             0,
-            bin_vert_size,
-            (const uint32_t*)bin_vert,
+            bin_vert.size,
+            bin_vert.code,
         };
         CHECK_VK(vkCreateShaderModule(device, &vert_ci, NULL, &vert_shader), "failed to create a vertex shader module.");
         // fragment shader
         // NOTE: フラグメントシェーダモジュールを作成する。
-        int bin_frag_size;
-        char *bin_frag = read_bin("./shader.frag.spv", &bin_frag_size);
-        CHECK(bin_frag != NULL, "failed to read shader.frag.spv.");
+        SpirvCode bin_frag;
+        CHECK(LOAD_SPIRV(shader_frag_spv, "./shader.frag.spv", &bin_frag), "failed to read shader.frag.spv.");
         const VkShaderModuleCreateInfo frag_ci = {
             VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
             NULL,
             0,
-            bin_frag_size,
-            (const uint32_t*)bin_frag,
+            bin_frag.size,
+            bin_frag.code,
         };
         CHECK_VK(vkCreateShaderModule(device, &frag_ci, NULL, &frag_shader), "failed to create a fragment shader module.");
         // NOTE: バイナリ配列は不要なので解放する。
-        free(bin_vert);
-        free(bin_frag);
+        free_spirv(&bin_vert);
+        free_spirv(&bin_frag);
     }
 
     // pipeline
@@ -624,7 +632,7 @@ int main() {
         // NOTE: 残念ながらコマンドバッファごとに関連付けるので、一つしかモデルがなくとも、毎フレーム行う。
         const VkDeviceSize offset = 0;
         vkCmdBindVertexBuffers(command_buffer, 0, 1, &model.vertex.buffer, &offset);
-        vkCmdBindIndexBuffer(command_buffer, model.index.buffer, offset, VK_INDEX_TYPE_UINT32);
+        vkCmdBindIndexBuffer(command_buffer, model.index.buffer, offset, model.index_type);
         // NOTE: ドローコール。
         vkCmdDrawIndexed(command_buffer, model.index_cnt, 1, 0, 0, 0);
 
@@ -1,5 +1,15 @@
 #include "../common/vulkan-tutorial.h"
 
+#ifdef EMBED_SPIRV
+// NOTE: EMBED=1でビルドすると、glslcが書き出した配列の初期化子を取り込み、起動時にファイルを読まない。
+static const uint32_t shader_vert_spv[] =
+#    include "shader.vert.inc"
+;
+static const uint32_t shader_frag_spv[] =
+#    include "shader.frag.inc"
+;
+#endif
+
 // A struct for vertex input data.
 typedef struct Vertex_t {
     float pos[3];
@@ -327,31 +337,29 @@ int main() {
     VkShaderModule frag_shader;
     {
         // vertex shader
-        int bin_vert_size;
-        char *bin_vert = read_bin("./shader.vert.spv", &bin_vert_size);
-        CHECK(bin_vert != NULL, "failed to read shader.vert.spv.");
+        SpirvCode bin_vert;
+        CHECK(LOAD_SPIRV(shader_vert_spv, "./shader.vert.spv", &bin_vert), "failed to read shader.vert.spv.");
         const VkShaderModuleCreateInfo vert_ci = {
             VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
             NULL,
             0,
-            bin_vert_size,
-            (const uint32_t*)bin_vert,
+            bin_vert.size,
+            bin_vert.code,
         };
         CHECK_VK(vkCreateShaderModule(device, &vert_ci, NULL, &vert_shader), "failed to create a vertex shader module.");
         // fragment shader
-        int bin_frag_size;
-        char *bin_frag = read_bin("./shader.frag.spv", &bin_frag_size);
-        CHECK(bin_frag != NULL, "failed to read shader.frag.spv.");
+        SpirvCode bin_frag;
+        CHECK(LOAD_SPIRV(shader_frag_spv, "./shader.frag.spv", &bin_frag), "failed to read shader.frag.spv.");
         const VkShaderModuleCreateInfo frag_ci = {
             VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
             NULL,
             0,
-            bin_frag_size,
-            (const uint32_t*)bin_frag,
+            bin_frag.size,
+            bin_frag.code,
         };
         CHECK_VK(vkCreateShaderModule(device, &frag_ci, NULL, &frag_shader), "failed to create a fragment shader module.");
-        free(bin_vert);
-        free(bin_frag);
+        free_spirv(&bin_vert);
+        free_spirv(&bin_frag);
     }
 
     // pipeline
@@ -638,7 +646,7 @@ int main() {
         for (int i = 0; i < 2; ++i) {
             const VkDeviceSize offset = 0;
             vkCmdBindVertexBuffers(command_buffer, 0, 1, &models[i].vertex.buffer, &offset);
-            vkCmdBindIndexBuffer(command_buffer, models[i].index.buffer, offset, VK_INDEX_TYPE_UINT32);
+            vkCmdBindIndexBuffer(command_buffer, models[i].index.buffer, offset, models[i].index_type);
             vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstant), (const void *)&push_constants[i]);
             vkCmdDrawIndexed(command_buffer, models[i].index_cnt, 1, 0, 0, 0);
         }
@@ -2,6 +2,16 @@
 
 #include <math.h>
 
+#ifdef EMBED_SPIRV
+// NOTE: EMBED=1でビルドすると、glslcが書き出した配列の初期化子を取り込み、起動時にファイルを読まない。
+static const uint32_t shader_vert_spv[] =
+#    include "shader.vert.inc"
+;
+static const uint32_t shader_frag_spv[] =
+#    include "shader.frag.inc"
+;
+#endif
+
 // A struct for vertex input data.
 typedef struct Vertex_t {
     float pos[3];
@@ -327,31 +337,29 @@ int main() {
     VkShaderModule frag_shader;
     {
         // vertex shader
-        int bin_vert_size;
-        char *bin_vert = read_bin("./shader.vert.spv", &bin_vert_size);
-        CHECK(bin_vert != NULL, "failed to read shader.vert.spv.");
+        SpirvCode bin_vert;
+        CHECK(LOAD_SPIRV(shader_vert_spv, "./shader.vert.spv", &bin_vert), "failed to read shader.vert.spv.");
         const VkShaderModuleCreateInfo vert_ci = {
             VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
             NULL,
             0,
-            bin_vert_size,
-            (const uint32_t*)bin_vert,
+            bin_vert.size,
+            bin_vert.code,
         };
         CHECK_VK(vkCreateShaderModule(device, &vert_ci, NULL, &vert_shader), "failed to create a vertex shader module.");
         // fragment shader
-        int bin_frag_size;
-        char *bin_frag = read_bin("./shader.frag.spv", &bin_frag_size);
-        CHECK(bin_frag != NULL, "failed to read shader.frag.spv.");
+        SpirvCode bin_frag;
+        CHECK(LOAD_SPIRV(shader_frag_spv, "./shader.frag.spv", &bin_frag), "failed to read shader.frag.spv.");
         const VkShaderModuleCreateInfo frag_ci = {
             VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
             NULL,
             0,
-            bin_frag_size,
-            (const uint32_t*)bin_frag,
+            bin_frag.size,
+            bin_frag.code,
         };
         CHECK_VK(vkCreateShaderModule(device, &frag_ci, NULL, &frag_shader), "failed to create a fragment shader module.");
-        free(bin_vert);
-        free(bin_frag);
+        free_spirv(&bin_vert);
+        free_spirv(&bin_frag);
     }
 
     // descriptor sets
@@ -775,7 +783,7 @@ int main() {
         // NOTE: 今回モデルは一種類しか使わない。
         const VkDeviceSize offset = 0;
         vkCmdBindVertexBuffers(command_buffer, 0, 1, &model.vertex.buffer, &offset);
-        vkCmdBindIndexBuffer(command_buffer, model.index.buffer, offset, VK_INDEX_TYPE_UINT32);
+        vkCmdBindIndexBuffer(command_buffer, model.index.buffer, offset, model.index_type);
         for (int i = 0; i < 2; ++i) {
             // NOTE: ディスクリプタセットを適応する。
             // NOTE: 一度適応してからずっと同じものが使われるため、なるべく同じものを連続して使えるような順番で描画したほうが良い。
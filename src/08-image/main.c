@@ -2,6 +2,16 @@
 
 #include <math.h>
 
+#ifdef EMBED_SPIRV
+// NOTE: EMBED=1でビルドすると、glslcが書き出した配列の初期化子を取り込み、起動時にファイルを読まない。
+static const uint32_t shader_vert_spv[] =
+#    include "shader.vert.inc"
+;
+static const uint32_t shader_frag_spv[] =
+#    include "shader.frag.inc"
+;
+#endif
+
 // A struct for vertex input data.
 typedef struct Vertex_t {
     float pos[3];
@@ -104,9 +114,13 @@ int main() {
             },
         };
         const char *ext_names[] = DEVICE_EXT_NAMES;
+        // NOTE: タイムラインセマフォを有効にする。
+        VkPhysicalDeviceVulkan12Features features12 = { 0 };
+        features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        features12.timelineSemaphore = VK_TRUE;
         const VkDeviceCreateInfo ci = {
             VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-            NULL,
+            &features12,
             0,
             1,
             queue_cis,
@@ -148,6 +162,23 @@ int main() {
         CHECK_VK(vkAllocateCommandBuffers(device, &ai, &command_buffer), "failed to allocate a command buffer.");
     }
 
+    // timeline
+    // NOTE: 画像の転送を待つために使う。
+    Timeline timeline;
+    CHECK_VK(create_timeline(device, &timeline), "failed to create a timeline.");
+
+    // deletion queue
+    // NOTE: 画像の転送に使った一時リソースを、転送が終わってから解放するために使う。
+    DeletionQueue deletion_queue = { 0 };
+
+    // upload context
+    // NOTE: セットアップ時の転送をまとめて一度に提出するために使う。
+    UploadContext upload;
+    CHECK_VK(
+        create_upload_context(device, &phys_device_memory_prop, queue, command_pool, &timeline, &deletion_queue, UPLOAD_THRESHOLD, &upload),
+        "failed to create an upload context."
+    );
+
     // fence
     VkFence fence;
     {
@@ -329,31 +360,29 @@ int main() {
     VkShaderModule frag_shader;
     {
         // vertex shader
-        int bin_vert_size;
-        char *bin_vert = read_bin("./shader.vert.spv", &bin_vert_size);
-        CHECK(bin_vert != NULL, "failed to read shader.vert.spv.");
+        SpirvCode bin_vert;
+        CHECK(LOAD_SPIRV(shader_vert_spv, "./shader.vert.spv", &bin_vert), "failed to read shader.vert.spv.");
         const VkShaderModuleCreateInfo vert_ci = {
             VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
             NULL,
             0,
-            bin_vert_size,
-            (const uint32_t*)bin_vert,
+            bin_vert.size,
+            bin_vert.code,
         };
         CHECK_VK(vkCreateShaderModule(device, &vert_ci, NULL, &vert_shader), "failed to create a vertex shader module.");
         // fragment shader
-        int bin_frag_size;
-        char *bin_frag = read_bin("./shader.frag.spv", &bin_frag_size);
-        CHECK(bin_frag != NULL, "failed to read shader.frag.spv.");
+        SpirvCode bin_frag;
+        CHECK(LOAD_SPIRV(shader_frag_spv, "./shader.frag.spv", &bin_frag), "failed to read shader.frag.spv.");
         const VkShaderModuleCreateInfo frag_ci = {
             VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
             NULL,
             0,
-            bin_frag_size,
-            (const uint32_t*)bin_frag,
+            bin_frag.size,
+            bin_frag.code,
         };
         CHECK_VK(vkCreateShaderModule(device, &frag_ci, NULL, &frag_shader), "failed to create a fragment shader module.");
-        free(bin_vert);
-        free(bin_frag);
+        free_spirv(&bin_vert);
+        free_spirv(&bin_frag);
     }
 
     // sampler
@@ -668,7 +697,7 @@ int main() {
         // NOTE: イメージテクスチャを作る。
         // NOTE: 汎用性があるロジックであるため、関数に切り分けた。common/image.cで定義されている。
         CHECK_VK(
-            create_image_texture_from_file(device, &phys_device_memory_prop, command_pool, queue, "../img/shape.png", &img_tex),
+            create_image_texture_from_file(device, &phys_device_memory_prop, &upload, "../img/shape.png", &img_tex),
             "failed to create a image texture."
         );
         // update
@@ -744,6 +773,9 @@ int main() {
         { 0.0f, 0.0f, 0.0f, 0.0f },
     };
 
+    // NOTE: 溜まっている転送を提出する。完了はタイムラインで待たずに、描画と同じキューの順序に任せる。
+    CHECK_VK(destroy_upload_context(&upload), "failed to submit uploads.");
+
     // mainloop
     while (1) {
         if (glfwWindowShouldClose(window))
@@ -783,7 +815,7 @@ int main() {
         // draw
         const VkDeviceSize offset = 0;
         vkCmdBindVertexBuffers(command_buffer, 0, 1, &model.vertex.buffer, &offset);
-        vkCmdBindIndexBuffer(command_buffer, model.index.buffer, offset, VK_INDEX_TYPE_UINT32);
+        vkCmdBindIndexBuffer(command_buffer, model.index.buffer, offset, model.index_type);
         vkCmdBindDescriptorSets(
             command_buffer,
             VK_PIPELINE_BIND_POINT_GRAPHICS,
@@ -830,6 +862,7 @@ int main() {
 
     // termination
     vkDeviceWaitIdle(device);
+    flush_deletion_queue(device, &deletion_queue);
     vkFreeMemory(device, model.vertex.memory, NULL);
     vkFreeMemory(device, model.index.memory, NULL);
     vkDestroyBuffer(device, model.vertex.buffer, NULL);
@@ -856,6 +889,7 @@ int main() {
     vkDestroySemaphore(device, signal_semaphore, NULL);
     vkDestroySemaphore(device, wait_semaphore, NULL);
     vkDestroyFence(device, fence, NULL);
+    vkDestroySemaphore(device, timeline.semaphore, NULL);
     vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
     vkDestroyCommandPool(device, command_pool, NULL);
     vkDestroyDevice(device, NULL);
@@ -1,6 +1,23 @@
 #include "../common/vulkan-tutorial.h"
 
 #include <math.h>
+#include <string.h>
+
+#ifdef EMBED_SPIRV
+// NOTE: EMBED=1でビルドすると、glslcが書き出した配列の初期化子を取り込み、起動時にファイルを読まない。
+static const uint32_t shader_vert_spv[] =
+#    include "shader.vert.inc"
+;
+static const uint32_t shader_frag_spv[] =
+#    include "shader.frag.inc"
+;
+static const uint32_t cull_comp_spv[] =
+#    include "cull.comp.inc"
+;
+static const uint32_t hiz_comp_spv[] =
+#    include "hiz.comp.inc"
+;
+#endif
 
 // A struct for vertex input data.
 typedef struct Vertex_t {
@@ -8,12 +25,89 @@ typedef struct Vertex_t {
     float uv[2];
 } Vertex;
 
-// A struct for organizing the layout of push constant data.
-typedef struct PushConstant_t {
-    float scl[4];
-    float rot[4];
-    float trs[4];
-} PushConstant;
+// A struct for organizing the layout of per-draw instance data.
+// NOTE: シーングラフのワールド行列(列優先)と、bindlessのテーブルでのテクスチャの番号。ストレージバッファ(std430)に並べるので、16bytesの倍数にする。
+typedef struct Instance_t {
+    float world[16];
+    uint32_t texture;
+    uint32_t reserved[3];
+} Instance;
+
+#define BINDLESS_CAPACITY 64 // NOTE: bindlessのテーブルに登録できるテクスチャの数。
+#define MSAA_SAMPLE_CNT VK_SAMPLE_COUNT_4_BIT // NOTE: MSAAのサンプル数の希望。デバイスが対応していなければ下げる。VK_SAMPLE_COUNT_1_BITならMSAAを使わない。
+
+// コンパイルし直されたシェーダを読み直す関数。読み直せたらVK_TRUEを返し、モジュールを書き換える。
+// NOTE: パイプラインレイアウトは作り直さないので、ディスクリプタや頂点入力が変わったシェーダは受け付けない。
+static VkBool32 reload_shader(
+    const VkDevice device,
+    ShaderWatcher *watcher,
+    ShaderReflectionCache *reflection_cache,
+    const ShaderReflection *shader_layout,
+    uint32_t index,
+    const char *path,
+    VkShaderModule *p_module
+) {
+    if (!take_shader_reload(watcher, index))
+        return VK_FALSE;
+    int size;
+    char *bin = read_bin(path, &size);
+    if (bin == NULL)
+        return VK_FALSE;
+    ShaderReflection refl;
+    if (get_shader_reflection(reflection_cache, (const uint32_t *)bin, size, &refl) != VK_SUCCESS || !check_shader_reflection(&refl, shader_layout)) {
+        printf("[ Warning ] %s does not match the pipeline layout.\n", path);
+        free(bin);
+        return VK_FALSE;
+    }
+    const VkShaderModuleCreateInfo ci = {
+        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        NULL,
+        0,
+        size,
+        (const uint32_t *)bin,
+    };
+    VkShaderModule module;
+    const VkResult res = vkCreateShaderModule(device, &ci, NULL, &module);
+    free(bin);
+    if (res != VK_SUCCESS)
+        return VK_FALSE;
+    *p_module = module;
+    return VK_TRUE;
+}
+
+// 差し替えで使われなくなったシェーダモジュールを、それを使うパイプラインとともに捨てる関数。
+static void drop_shaders(
+    const VkDevice device,
+    PipelineCache *pipeline_cache,
+    DeletionQueue *deletion_queue,
+    uint64_t value,
+    const PipelineDesc *keep,
+    const PipelineDesc *drop
+) {
+    if (drop->vert_shader != keep->vert_shader) {
+        WARN_VK(release_pipelines_with_shader(pipeline_cache, drop->vert_shader, deletion_queue, value), "failed to release pipelines.");
+        vkDestroyShaderModule(device, drop->vert_shader, NULL);
+    }
+    if (drop->frag_shader != keep->frag_shader) {
+        WARN_VK(release_pipelines_with_shader(pipeline_cache, drop->frag_shader, deletion_queue, value), "failed to release pipelines.");
+        vkDestroyShaderModule(device, drop->frag_shader, NULL);
+    }
+}
+
+#ifdef CPU_CULL
+// モデル空間の境界球を、ワールド行列(列優先)でワールド空間へ移す関数。半径は3軸のうち最も大きい拡大率で広げる。
+static void transform_sphere(const float *world, const float *sphere, float *out) {
+    float scale = 0.0f;
+    for (uint32_t i = 0; i < 3; ++i) {
+        out[i] = world[i] * sphere[0] + world[4 + i] * sphere[1] + world[8 + i] * sphere[2] + world[12 + i];
+        const float *axis = world + 4 * i;
+        const float len = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        if (len > scale)
+            scale = len;
+    }
+    out[3] = sphere[3] * scale;
+}
+#endif
 
 int main() {
     // window
@@ -61,6 +155,11 @@ int main() {
     // physical device
     VkPhysicalDevice phys_device;
     VkPhysicalDeviceMemoryProperties phys_device_memory_prop;
+    IndirectFeatures indirect_features;
+    VkBool32 anisotropy_supported;
+    DynamicStateFeatures dynamic_features;
+    VkSampleCountFlagBits samples;
+    VkResolveModeFlagBits depth_resolve_mode;
     {
         uint32_t cnt = 0;
         CHECK_VK(vkEnumeratePhysicalDevices(instance, &cnt, NULL), "failed to get the number of physical devices.");
@@ -68,6 +167,25 @@ int main() {
         CHECK_VK(vkEnumeratePhysicalDevices(instance, &cnt, phys_devices), "failed to enumerate physical devices.");
         phys_device = phys_devices[0];
         vkGetPhysicalDeviceMemoryProperties(phys_device, &phys_device_memory_prop);
+        get_indirect_features(phys_device, &indirect_features);
+        CHECK(indirect_features.draw_indirect_first_instance, "drawIndirectFirstInstance is not supported.");
+        CHECK(is_bindless_supported(phys_device, BINDLESS_CAPACITY), "descriptor indexing is not supported.");
+        VkPhysicalDeviceFeatures features;
+        vkGetPhysicalDeviceFeatures(phys_device, &features);
+        anisotropy_supported = features.samplerAnisotropy;
+        get_dynamic_state_features(phys_device, &dynamic_features);
+        // NOTE: MSAAのデプスは解決してからHi-Zの作成に使う。Hi-Zは最も遠い深度を取るので、できればサンプルの最大値で解決する。
+        // NOTE: サンプル0での解決はどのデバイスでも使えるが、物体の縁では遠い側のサンプルを落とすことがある。
+        samples = get_max_sample_count(phys_device, MSAA_SAMPLE_CNT);
+        VkPhysicalDeviceDepthStencilResolveProperties resolve_prop = { 0 };
+        resolve_prop.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DEPTH_STENCIL_RESOLVE_PROPERTIES;
+        VkPhysicalDeviceProperties2 prop2 = { 0 };
+        prop2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        prop2.pNext = &resolve_prop;
+        vkGetPhysicalDeviceProperties2(phys_device, &prop2);
+        depth_resolve_mode = (resolve_prop.supportedDepthResolveModes & VK_RESOLVE_MODE_MAX_BIT) ? VK_RESOLVE_MODE_MAX_BIT : VK_RESOLVE_MODE_SAMPLE_ZERO_BIT;
+        if (samples != MSAA_SAMPLE_CNT)
+            printf("[ Warning ] MSAA falls back to %u samples.\n", (uint32_t)samples);
         free(phys_devices);
     }
 
@@ -102,18 +220,50 @@ int main() {
                 queue_priorities,
             },
         };
-        const char *ext_names[] = DEVICE_EXT_NAMES;
+        // NOTE: 拡張された動的ステートとダイナミックレンダリングは、対応していれば有効にする。
+        const char *ext_names[DEVICE_EXT_NAMES_CNT + 2] = DEVICE_EXT_NAMES;
+        uint32_t ext_names_cnt = DEVICE_EXT_NAMES_CNT;
+        VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extended_dynamic_state_features = { 0 };
+        extended_dynamic_state_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+        extended_dynamic_state_features.extendedDynamicState = VK_TRUE;
+        VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamic_rendering_features = { 0 };
+        dynamic_rendering_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+        dynamic_rendering_features.dynamicRendering = VK_TRUE;
+        void *next = NULL;
+        if (dynamic_features.extended_dynamic_state) {
+            ext_names[ext_names_cnt] = EXTENDED_DYNAMIC_STATE_EXT_NAME;
+            ext_names_cnt += 1;
+            extended_dynamic_state_features.pNext = next;
+            next = &extended_dynamic_state_features;
+        }
+        if (dynamic_features.dynamic_rendering) {
+            ext_names[ext_names_cnt] = DYNAMIC_RENDERING_EXT_NAME;
+            ext_names_cnt += 1;
+            dynamic_rendering_features.pNext = next;
+            next = &dynamic_rendering_features;
+        }
+        // NOTE: タイムラインセマフォと、対応している間接描画の機能、bindlessのテーブルに使うディスクリプタインデックスを有効にする。
+        VkPhysicalDeviceVulkan12Features features12 = { 0 };
+        features12.pNext = next;
+        features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        features12.timelineSemaphore = VK_TRUE;
+        features12.drawIndirectCount = indirect_features.draw_indirect_count;
+        enable_bindless_features(&features12);
+        VkPhysicalDeviceFeatures features = { 0 };
+        features.multiDrawIndirect = indirect_features.multi_draw_indirect;
+        features.drawIndirectFirstInstance = indirect_features.draw_indirect_first_instance;
+        features.samplerAnisotropy = anisotropy_supported; // NOTE: 対応していれば異方性フィルタリングを使う。
         const VkDeviceCreateInfo ci = {
             VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-            NULL,
+            &features12,
             0,
             1,
             queue_cis,
             0,
             NULL,
-            DEVICE_EXT_NAMES_CNT,
+            ext_names_cnt,
             ext_names,
-            NULL,
+            &features,
         };
         CHECK_VK(vkCreateDevice(phys_device, &ci, NULL, &device), "failed to create a device.");
     }
@@ -147,16 +297,22 @@ int main() {
         CHECK_VK(vkAllocateCommandBuffers(device, &ai, &command_buffer), "failed to allocate a command buffer.");
     }
 
-    // fence
-    VkFence fence;
-    {
-        const VkFenceCreateInfo ci = {
-            VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-            NULL,
-            VK_FENCE_CREATE_SIGNALED_BIT,
-        };
-        CHECK_VK(vkCreateFence(device, &ci, NULL, &fence), "failed to create a fence.");
-    }
+    // timeline
+    // NOTE: フェンスの代わりに、キューへの提出ごとに値が増えるタイムラインセマフォで同期する。
+    Timeline timeline;
+    CHECK_VK(create_timeline(device, &timeline), "failed to create a timeline.");
+
+    // deletion queue
+    // NOTE: GPUが使い終わるまで解放できないリソースを溜めておく。
+    DeletionQueue deletion_queue = { 0 };
+
+    // upload context
+    // NOTE: セットアップ時の転送をまとめて一度に提出するために使う。
+    UploadContext upload;
+    CHECK_VK(
+        create_upload_context(device, &phys_device_memory_prop, queue, command_pool, &timeline, &deletion_queue, UPLOAD_THRESHOLD, &upload),
+        "failed to create an upload context."
+    );
 
     // semaphores
     VkSemaphore wait_semaphore, signal_semaphore;
@@ -221,12 +377,14 @@ int main() {
     }
 
     // image views
+    // NOTE: ダイナミックレンダリングではレイアウトを自分で遷移させるので、スワップチェインのイメージも残しておく。
     uint32_t image_views_cnt;
+    VkImage *images;
     VkImageView *image_views;
     {
         uint32_t images_cnt = 0;
         CHECK_VK(vkGetSwapchainImagesKHR(device, swapchain, &images_cnt, NULL), "failed to get the number of swapchain images.");
-        VkImage *images = (VkImage *)malloc(sizeof(VkImage) * images_cnt);
+        images = (VkImage *)malloc(sizeof(VkImage) * images_cnt);
         CHECK_VK(vkGetSwapchainImagesKHR(device, swapchain, &images_cnt, images), "failed to get swapchain images.");
         image_views_cnt = images_cnt;
         image_views = (VkImageView *)malloc(sizeof(VkImageView) * image_views_cnt);
@@ -249,68 +407,139 @@ int main() {
             ci.image = images[i];
             CHECK_VK(vkCreateImageView(device, &ci, NULL, &image_views[i]), "failed to create an image view.");
         }
-        free(images);
     }
 
     // render pass
-    VkRenderPass render_pass;
-    const uint32_t render_pass_attachments_count = 2; // NOTE: アタッチメントを増やすので。
+    // NOTE: ダイナミックレンダリングが使えれば、レンダーパスとフレームバッファは作らず、描画を始めるときにアタッチメントを渡す。
+    // NOTE: MSAAでは、マルチサンプルのカラーとデプスに描き、サブパスの終わりでスワップチェインのイメージとデプスバッファへ解決する。
+    // NOTE: マルチサンプルの中身は解決した後は要らないので保存しない。タイルベースのGPUではタイルメモリから書き出さずに済む。
+    // NOTE: デプスの解決にはVulkan 1.2のvkCreateRenderPass2が要るので、MSAAを使わないときも同じ作り方にそろえる。
+    // NOTE: レイアウトの遷移はレンダーグラフが行うので、レンダーパスの前後でレイアウトは変えない。
+    VkRenderPass render_pass = VK_NULL_HANDLE;
+    const uint32_t render_pass_attachments_count = samples == VK_SAMPLE_COUNT_1_BIT ? 2 : 4; // NOTE: MSAAでは解決先の二つが増える。
     const VkFormat depth_format = VK_FORMAT_D32_SFLOAT; // NOTE: デプスバッファ作成時で使うので。
-    {
-        const VkAttachmentDescription attachment_descs[] = {
+    if (!dynamic_features.dynamic_rendering) {
+        const VkBool32 msaa = samples != VK_SAMPLE_COUNT_1_BIT;
+        const VkAttachmentDescription2 attachment_descs[] = {
             {
+                VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2,
+                NULL,
                 0,
                 surface_format.format,
-                VK_SAMPLE_COUNT_1_BIT,
+                samples,
                 VK_ATTACHMENT_LOAD_OP_CLEAR,
-                VK_ATTACHMENT_STORE_OP_STORE,
+                msaa ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE,
                 VK_ATTACHMENT_LOAD_OP_DONT_CARE,
                 VK_ATTACHMENT_STORE_OP_DONT_CARE,
-                VK_IMAGE_LAYOUT_UNDEFINED,
-                VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
             },
             // NOTE: デプスバッファを設定する。
             {
+                VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2,
+                NULL,
                 0,
                 depth_format,
-                VK_SAMPLE_COUNT_1_BIT,
+                samples,
                 VK_ATTACHMENT_LOAD_OP_CLEAR,
+                msaa ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE,
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            },
+            // NOTE: MSAAのときだけ使う、カラーの解決先(スワップチェインのイメージ)。すべて書き換えるので、読み込まない。
+            {
+                VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2,
+                NULL,
+                0,
+                surface_format.format,
+                VK_SAMPLE_COUNT_1_BIT,
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,
                 VK_ATTACHMENT_STORE_OP_STORE,
                 VK_ATTACHMENT_LOAD_OP_DONT_CARE,
                 VK_ATTACHMENT_STORE_OP_DONT_CARE,
-                VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            },
+            // NOTE: MSAAのときだけ使う、デプスの解決先。Hi-Zの作成で読むので残す。
+            {
+                VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2,
+                NULL,
+                0,
+                depth_format,
+                VK_SAMPLE_COUNT_1_BIT,
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                VK_ATTACHMENT_STORE_OP_STORE,
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
                 VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
             },
         };
-        const VkAttachmentReference color_refs[] = {
+        const VkAttachmentReference2 color_refs[] = {
             {
+                VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2,
+                NULL,
                 0,
                 VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                VK_IMAGE_ASPECT_COLOR_BIT,
             },
         };
         // NOTE: デプスバッファの参照を設定する。
         // NOTE: 各サブパスに一つ設定するため、一つ。
-        const VkAttachmentReference depth_ref = {
+        const VkAttachmentReference2 depth_ref = {
+            VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2,
+            NULL,
             1,
             VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_ASPECT_DEPTH_BIT,
         };
-        const VkSubpassDescription subpass_descs[] = {
+        const VkAttachmentReference2 resolve_refs[] = {
             {
+                VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2,
+                NULL,
+                2,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                VK_IMAGE_ASPECT_COLOR_BIT,
+            },
+        };
+        const VkAttachmentReference2 depth_resolve_ref = {
+            VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2,
+            NULL,
+            3,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_ASPECT_DEPTH_BIT,
+        };
+        const VkSubpassDescriptionDepthStencilResolve depth_resolve = {
+            VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_DEPTH_STENCIL_RESOLVE,
+            NULL,
+            depth_resolve_mode,
+            VK_RESOLVE_MODE_NONE,
+            &depth_resolve_ref,
+        };
+        const VkSubpassDescription2 subpass_descs[] = {
+            {
+                VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_2,
+                msaa ? &depth_resolve : NULL,
                 0,
                 VK_PIPELINE_BIND_POINT_GRAPHICS,
                 0,
+                0,
                 NULL,
                 1,
                 color_refs,
-                NULL,
+                msaa ? resolve_refs : NULL,
                 &depth_ref, // NOTE: ここも忘れずに。
                 0,
                 NULL,
             },
         };
         // NOTE: 
-        const VkSubpassDependency dependencies[] = {
+        const VkSubpassDependency2 dependencies[] = {
             {
+                VK_STRUCTURE_TYPE_SUBPASS_DEPENDENCY_2,
+                NULL,
                 0,
                 0,
                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
@@ -318,10 +547,11 @@ int main() {
                 0,
                 VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
                 VK_DEPENDENCY_BY_REGION_BIT,
+                0,
             },
         };
-        const VkRenderPassCreateInfo ci = {
-            VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        const VkRenderPassCreateInfo2 ci = {
+            VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO_2,
             NULL,
             0,
             render_pass_attachments_count,
@@ -330,12 +560,25 @@ int main() {
             subpass_descs,
             1,
             dependencies,
+            0,
+            NULL,
         };
-        CHECK_VK(vkCreateRenderPass(device, &ci, NULL, &render_pass), "failed to create a render pass.");
+        CHECK_VK(vkCreateRenderPass2(device, &ci, NULL, &render_pass), "failed to create a render pass.");
+    }
+
+    // dynamic rendering
+    // NOTE: 拡張の関数なので、デバイスから取り出しておく。
+    PFN_vkCmdBeginRenderingKHR cmd_begin_rendering = NULL;
+    PFN_vkCmdEndRenderingKHR cmd_end_rendering = NULL;
+    if (render_pass == VK_NULL_HANDLE) {
+        cmd_begin_rendering = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR");
+        cmd_end_rendering = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR");
+        CHECK(cmd_begin_rendering != NULL && cmd_end_rendering != NULL, "failed to get dynamic rendering functions.");
     }
 
     // depth buffer
     // NOTE: 深度値を溜めるためのバッファ。イメージの数だけ作る。
+    // NOTE: 描き終えた深度からHi-Zピラミッドを作るので、サンプルもできるようにしておく。
     Texture *depth_buffers = (Texture *)malloc(sizeof(Texture) * image_views_cnt);
     for (int i = 0; i < image_views_cnt; ++i) {
         CHECK_VK(
@@ -345,17 +588,134 @@ int main() {
                 depth_format,
                 surface_capabilities.currentExtent.width,
                 surface_capabilities.currentExtent.height,
-                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                1,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
                 VK_IMAGE_ASPECT_DEPTH_BIT,
+                NULL,
                 &depth_buffers[i]
             ),
             "failed to create a depth buffer."
         );
     }
 
-    // framebuffers
-    VkFramebuffer *framebuffers;
+    // render graph
+    // NOTE: フレームのパス(カリング・描画・Hi-Zの作成)が使う資源を宣言し、パスの間のバリアとレイアウトの遷移はグラフに求めさせる。
+    // NOTE: MSAAでは、描画はマルチサンプルのカラーとデプスに対して行い、上のデプスバッファとスワップチェインのイメージは解決先になる。
+    // NOTE: マルチサンプルの二つは描画の間しか要らないので、グラフが一時的なイメージとして作る。同じパスで使うので、メモリは共有しない。
+    const VkBool32 msaa = samples != VK_SAMPLE_COUNT_1_BIT;
+    RenderGraph graph;
+    init_render_graph(&graph);
+    uint32_t rg_swapchain, rg_depth, rg_hiz, rg_commands, rg_count, rg_instances, rg_stats;
+    uint32_t rg_msaa_color = RENDER_GRAPH_NONE;
+    uint32_t rg_msaa_depth = RENDER_GRAPH_NONE;
+    uint32_t cull_node, draw_node, hiz_node;
     {
+        CHECK_VK(add_render_graph_image(&graph, VK_IMAGE_ASPECT_COLOR_BIT, 1, &rg_swapchain), "failed to add a swapchain image to a render graph.");
+        CHECK_VK(add_render_graph_image(&graph, VK_IMAGE_ASPECT_DEPTH_BIT, 1, &rg_depth), "failed to add a depth buffer to a render graph.");
+        CHECK_VK(add_render_graph_image(&graph, VK_IMAGE_ASPECT_COLOR_BIT, VK_REMAINING_MIP_LEVELS, &rg_hiz), "failed to add a Hi-Z pyramid to a render graph.");
+        CHECK_VK(add_render_graph_buffer(&graph, &rg_commands), "failed to add a buffer to a render graph.");
+        CHECK_VK(add_render_graph_buffer(&graph, &rg_count), "failed to add a buffer to a render graph.");
+        CHECK_VK(add_render_graph_buffer(&graph, &rg_instances), "failed to add a buffer to a render graph.");
+        CHECK_VK(add_render_graph_buffer(&graph, &rg_stats), "failed to add a buffer to a render graph.");
+        if (msaa) {
+            CHECK_VK(
+                add_render_graph_transient(
+                    &graph,
+                    surface_format.format,
+                    surface_capabilities.currentExtent.width,
+                    surface_capabilities.currentExtent.height,
+                    samples,
+                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                    VK_IMAGE_ASPECT_COLOR_BIT,
+                    &rg_msaa_color
+                ),
+                "failed to add a multisample color target to a render graph."
+            );
+            CHECK_VK(
+                add_render_graph_transient(
+                    &graph,
+                    depth_format,
+                    surface_capabilities.currentExtent.width,
+                    surface_capabilities.currentExtent.height,
+                    samples,
+                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                    VK_IMAGE_ASPECT_DEPTH_BIT,
+                    &rg_msaa_depth
+                ),
+                "failed to add a multisample depth target to a render graph."
+            );
+        }
+
+#ifndef CPU_CULL
+        // NOTE: カリングは前のフレームのHi-Zピラミッドを読み、描画リストと統計に書き込む。数と統計は転送で0にしてから数える。
+        const RenderGraphAccess cull_accesses[] = {
+            { rg_hiz, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL },
+            { rg_commands, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED },
+            {
+                rg_count,
+                VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                VK_IMAGE_LAYOUT_UNDEFINED,
+            },
+            { rg_instances, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED },
+            {
+                rg_stats,
+                VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                VK_IMAGE_LAYOUT_UNDEFINED,
+            },
+        };
+        CHECK_VK(add_render_graph_pass(&graph, 5, cull_accesses, &cull_node), "failed to add a cull pass to a render graph.");
+#else
+        // NOTE: CPUでカリングするときは、描画リストをCPUが書き込むので、カリングのパスを置かない。提出で書き込みが見えるので、描画の前のバリアも要らない。
+        cull_node = RENDER_GRAPH_NONE;
+#endif
+
+        // NOTE: 描画は描画リストを読み、アタッチメントに書き込む。MSAAではデプスバッファは解決先なので、カラーアタッチメント出力のステージで書かれる。
+        const RenderGraphAccess draw_accesses[] = {
+            { rg_commands, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED },
+            { rg_count, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED },
+            { rg_instances, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED },
+            { rg_swapchain, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+            {
+                rg_depth,
+                msaa ? VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT : VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                msaa ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            },
+            { rg_msaa_color, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+            {
+                rg_msaa_depth,
+                VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            },
+        };
+        CHECK_VK(add_render_graph_pass(&graph, msaa ? 7 : 5, draw_accesses, &draw_node), "failed to add a draw pass to a render graph.");
+
+        // NOTE: Hi-Zの作成はデプスバッファを読み、ピラミッドのミップを順に読み書きする。
+        const RenderGraphAccess hiz_accesses[] = {
+            { rg_depth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL },
+            { rg_hiz, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL },
+        };
+        CHECK_VK(add_render_graph_pass(&graph, 2, hiz_accesses, &hiz_node), "failed to add a Hi-Z pass to a render graph.");
+
+        // NOTE: スワップチェインのイメージは表示できるレイアウトに、統計はCPUから読めるようにして終える。Hi-Zピラミッドは次のフレームで読む。
+        const RenderGraphAccess present = { 0, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
+        CHECK_VK(set_render_graph_output(&graph, rg_swapchain, &present), "failed to set a render graph output.");
+#ifndef CPU_CULL
+        const RenderGraphAccess host_read = { 0, VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+        CHECK_VK(set_render_graph_output(&graph, rg_stats, &host_read), "failed to set a render graph output.");
+        CHECK_VK(set_render_graph_output(&graph, rg_hiz, NULL), "failed to set a render graph output.");
+#else
+        // NOTE: 統計とHi-Zピラミッドを結果にしなければ、グラフはHi-Zの作成のパスを除く。
+#endif
+        CHECK_VK(compile_render_graph(device, &phys_device_memory_prop, &graph), "failed to compile a render graph.");
+    }
+
+    // framebuffers
+    VkFramebuffer *framebuffers = NULL;
+    if (render_pass != VK_NULL_HANDLE) {
         VkFramebufferCreateInfo ci = {
             VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
             NULL,
@@ -369,8 +729,15 @@ int main() {
         };
         framebuffers = (VkFramebuffer *)malloc(sizeof(VkFramebuffer) * image_views_cnt);
         for (int32_t i = 0; i < image_views_cnt; ++i) {
-            VkImageView attachments[] = { image_views[i], depth_buffers[i].view };
-            ci.pAttachments = attachments;
+            // NOTE: MSAAでは、マルチサンプルの二つに続けて解決先の二つを並べる。
+            const VkImageView attachments[] = { image_views[i], depth_buffers[i].view };
+            const VkImageView msaa_attachments[] = {
+                msaa ? graph.resources[rg_msaa_color].view : VK_NULL_HANDLE,
+                msaa ? graph.resources[rg_msaa_depth].view : VK_NULL_HANDLE,
+                image_views[i],
+                depth_buffers[i].view,
+            };
+            ci.pAttachments = msaa ? msaa_attachments : attachments;
             CHECK_VK(vkCreateFramebuffer(device, &ci, NULL, &framebuffers[i]), "failed to create a framebuffer.");
         }
     }
@@ -378,36 +745,74 @@ int main() {
     // shaders
     VkShaderModule vert_shader;
     VkShaderModule frag_shader;
+    VkShaderModule cull_shader;
+    VkShaderModule hiz_shader;
+    // NOTE: 頂点シェーダとフラグメントシェーダのSPIR-Vを読み取り、ディスクリプタセットレイアウト・プッシュ定数・頂点入力をそこから作る。
+    ShaderReflectionCache reflection_cache;
+    CHECK_VK(create_shader_reflection_cache(&reflection_cache), "failed to create a shader reflection cache.");
+    ShaderReflection vert_reflection;
+    ShaderReflection shader_layout; // NOTE: 二つのステージをまとめた、パイプラインレイアウト全体。
     {
         // vertex shader
-        int bin_vert_size;
-        char *bin_vert = read_bin("./shader.vert.spv", &bin_vert_size);
-        CHECK(bin_vert != NULL, "failed to read shader.vert.spv.");
+        SpirvCode bin_vert;
+        CHECK(LOAD_SPIRV(shader_vert_spv, "./shader.vert.spv", &bin_vert), "failed to read shader.vert.spv.");
         const VkShaderModuleCreateInfo vert_ci = {
             VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
             NULL,
             0,
-            bin_vert_size,
-            (const uint32_t*)bin_vert,
+            bin_vert.size,
+            bin_vert.code,
         };
         CHECK_VK(vkCreateShaderModule(device, &vert_ci, NULL, &vert_shader), "failed to create a vertex shader module.");
         // fragment shader
-        int bin_frag_size;
-        char *bin_frag = read_bin("./shader.frag.spv", &bin_frag_size);
-        CHECK(bin_frag != NULL, "failed to read shader.frag.spv.");
+        SpirvCode bin_frag;
+        CHECK(LOAD_SPIRV(shader_frag_spv, "./shader.frag.spv", &bin_frag), "failed to read shader.frag.spv.");
         const VkShaderModuleCreateInfo frag_ci = {
             VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
             NULL,
             0,
-            bin_frag_size,
-            (const uint32_t*)bin_frag,
+            bin_frag.size,
+            bin_frag.code,
         };
         CHECK_VK(vkCreateShaderModule(device, &frag_ci, NULL, &frag_shader), "failed to create a fragment shader module.");
-        free(bin_vert);
-        free(bin_frag);
+        // culling compute shader
+        SpirvCode bin_cull;
+        CHECK(LOAD_SPIRV(cull_comp_spv, "./cull.comp.spv", &bin_cull), "failed to read cull.comp.spv.");
+        const VkShaderModuleCreateInfo cull_ci = {
+            VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+            NULL,
+            0,
+            bin_cull.size,
+            bin_cull.code,
+        };
+        CHECK_VK(vkCreateShaderModule(device, &cull_ci, NULL, &cull_shader), "failed to create a culling shader module.");
+        // Hi-Z downsampling compute shader
+        SpirvCode bin_hiz;
+        CHECK(LOAD_SPIRV(hiz_comp_spv, "./hiz.comp.spv", &bin_hiz), "failed to read hiz.comp.spv.");
+        const VkShaderModuleCreateInfo hiz_ci = {
+            VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+            NULL,
+            0,
+            bin_hiz.size,
+            bin_hiz.code,
+        };
+        CHECK_VK(vkCreateShaderModule(device, &hiz_ci, NULL, &hiz_shader), "failed to create a Hi-Z shader module.");
+        // reflection
+        ShaderReflection refls[2];
+        CHECK_VK(get_shader_reflection(&reflection_cache, bin_vert.code, bin_vert.size, &refls[0]), "failed to reflect shader.vert.spv.");
+        CHECK_VK(get_shader_reflection(&reflection_cache, bin_frag.code, bin_frag.size, &refls[1]), "failed to reflect shader.frag.spv.");
+        CHECK_VK(merge_shader_reflections(2, refls, &shader_layout), "failed to merge shader reflections.");
+        vert_reflection = refls[0];
+        free_spirv(&bin_vert);
+        free_spirv(&bin_frag);
+        free_spirv(&bin_cull);
+        free_spirv(&bin_hiz);
     }
 
     // sampler
+    // NOTE: サンプラはキャッシュから得る。同じ設定を何度求めても、作るのは一度だけ。
+    SamplerCache sampler_cache;
+    CHECK_VK(create_sampler_cache(phys_device, anisotropy_supported, &sampler_cache), "failed to create a sampler cache.");
     VkSampler sampler;
     {
         const VkSamplerCreateInfo ci = {
@@ -416,280 +821,124 @@ int main() {
             0,
             VK_FILTER_LINEAR,
             VK_FILTER_LINEAR,
-            VK_SAMPLER_MIPMAP_MODE_NEAREST,
+            VK_SAMPLER_MIPMAP_MODE_LINEAR,
             VK_SAMPLER_ADDRESS_MODE_REPEAT,
             VK_SAMPLER_ADDRESS_MODE_REPEAT,
             VK_SAMPLER_ADDRESS_MODE_REPEAT,
             0.0,
-            0,
-            1.0,
+            VK_TRUE,
+            16.0, // NOTE: デバイスの上限に収められる。使えなければ異方性フィルタリングは無効になる。
             0,
             VK_COMPARE_OP_NEVER,
             0.0,
-            0.0,
+            VK_LOD_CLAMP_NONE, // NOTE: 圧縮テクスチャの全ミップレベルを使えるように。
             VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE,
             0,
         };
-        CHECK_VK(vkCreateSampler(device, &ci, NULL, &sampler), "failed to create a sampler.");
+        CHECK_VK(get_sampler(device, &sampler_cache, &ci, &sampler), "failed to create a sampler.");
     }
 
     // descriptor sets
+    // NOTE: レイアウトはキャッシュから得る。同じ内容のレイアウトを何度求めても、作るのは一度だけ。
+    // NOTE: セットはフレームごとのアロケータから毎フレーム割り当て、フレームの完了後にプールごとリセットする。
+    DescriptorLayoutCache layout_cache;
+    CHECK_VK(create_descriptor_layout_cache(&layout_cache), "failed to create a descriptor layout cache.");
     VkDescriptorSetLayout descriptor_set_layout;
-    VkDescriptorPool descriptor_pool;
-    VkDescriptorSet descriptor_set;
+    DescriptorAllocator frame_descriptors;
     {
         // descriptor layout
-        const VkDescriptorSetLayoutBinding desc_set_layout_binds[] = {
-            {
-                0,
-                VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                1,
-                VK_SHADER_STAGE_VERTEX_BIT,
-                NULL,
-            },
-            {
-                1,
-                VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                1,
-                VK_SHADER_STAGE_FRAGMENT_BIT,
-                NULL,
-            },
-        };
-        const VkDescriptorSetLayoutCreateInfo desc_set_layout_ci = {
-            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-            NULL,
-            0,
-            2,
-            desc_set_layout_binds,
-        };
-        CHECK_VK(vkCreateDescriptorSetLayout(device, &desc_set_layout_ci, NULL, &descriptor_set_layout), "failed to create a descriptor set layout.");
-        // descriptor pool
-        const VkDescriptorPoolSize desc_pool_sizes[] = {
-            {
-                VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                1,
-            },
-            {
-                VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                1,
-            },
-        };
-        const VkDescriptorPoolCreateInfo desc_pool_ci = {
-            VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-            NULL,
-            0,
-            2,
-            2,
-            desc_pool_sizes,
-        };
-        CHECK_VK(vkCreateDescriptorPool(device, &desc_pool_ci, NULL, &descriptor_pool), "failed to create a descriptor pool.");
-        const VkDescriptorSetAllocateInfo ai = {
-            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-            NULL,
-            descriptor_pool,
-            1,
-            &descriptor_set_layout,
+        // NOTE: セット0(カメラのバインディング0と、インスタンスデータのバインディング2)は、シェーダから読み取ったとおりに作る。
+        // NOTE: セット1はbindlessのテーブルのレイアウトを使う。バインディングのフラグが要るので、読み取った結果からは作らない。
+        CHECK_VK(
+            get_reflected_set_layout(device, &layout_cache, &shader_layout, 0, &descriptor_set_layout),
+            "failed to create a descriptor set layout."
+        );
+        // descriptor allocator
+        // NOTE: セット一つにユニフォームバッファとストレージバッファが一つずつ。
+        const DescriptorPoolRatio ratios[] = {
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f },
         };
-        CHECK_VK(vkAllocateDescriptorSets(device, &ai, &descriptor_set), "failed to allocate a descriptor set.");
+        CHECK_VK(create_descriptor_allocator(4, 2, ratios, &frame_descriptors), "failed to create a descriptor allocator.");
     }
 
+    // bindless table
+    // NOTE: すべてのテクスチャを一つのセットに登録し、インスタンスデータの番号で引く。テクスチャごとにセットを作らなくてよい。
+    BindlessTable bindless;
+    CHECK_VK(create_bindless_table(device, BINDLESS_CAPACITY, sampler, &bindless), "failed to create a bindless table.");
+
     // pipeline
+    // NOTE: パイプラインの作成はキャッシュのコンパイルスレッドで行う。
+    PipelineCache pipeline_cache;
+    CHECK_VK(create_pipeline_cache(device, &dynamic_features, 0, &pipeline_cache), "failed to create a pipeline cache.");
     VkPipelineLayout pipeline_layout;
+    PipelineDesc desc; // NOTE: 動的ステートを記録するときにも使うので。
     VkPipeline pipeline;
     {
-        const VkPushConstantRange push_constant_ranges[] = {
-            {
-                VK_SHADER_STAGE_VERTEX_BIT,
-                0,
-                sizeof(PushConstant),
-            },
+        // NOTE: プッシュ定数の範囲も読み取った結果から作る。描画ごとの変換とテクスチャはインスタンスデータで渡すので、今は使われない。
+        const VkDescriptorSetLayout set_layouts[] = {
+            descriptor_set_layout,
+            bindless.descriptor_set_layout,
         };
         const VkPipelineLayoutCreateInfo pipeline_layout_ci = {
             VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
             NULL,
             0,
-            1,
-            &descriptor_set_layout,
-            1,
-            push_constant_ranges,
-        };
-        CHECK_VK(vkCreatePipelineLayout(device, &pipeline_layout_ci, NULL, &pipeline_layout), "failed to create a pipeline layout.");
-
-        // shaders
-        const VkPipelineShaderStageCreateInfo shader_cis[2] = {
-            {
-                VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-                NULL,
-                0,
-                VK_SHADER_STAGE_VERTEX_BIT,
-                vert_shader,
-                "main",
-                NULL,
-            },
-            {
-                VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-                NULL,
-                0,
-                VK_SHADER_STAGE_FRAGMENT_BIT,
-                frag_shader,
-                "main",
-                NULL,
-            },
-        };
-
-        // vertex input
-        const VkVertexInputBindingDescription vert_inp_binding_dcs[] = {
-            { 0, sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX },
-        };
-        const VkVertexInputAttributeDescription vert_inp_attr_dcs[] = {
-            { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 },
-            { 1, 0, VK_FORMAT_R32G32_SFLOAT, sizeof(float) * 3 },
-        };
-        const VkPipelineVertexInputStateCreateInfo vert_inp_ci = {
-            VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-            NULL,
-            0,
-            1,
-            vert_inp_binding_dcs,
             2,
-            vert_inp_attr_dcs,
-        };
-
-        // input assembly
-        const VkPipelineInputAssemblyStateCreateInfo inp_as_ci = {
-            VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-            NULL,
-            0,
-            VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-            VK_FALSE,
-        };
-
-        // viewport
-        const VkViewport viewports[] = {
-            {
-                0.0f,
-                0.0f,
-                surface_capabilities.currentExtent.width,
-                surface_capabilities.currentExtent.height,
-                0.0f,
-                1.0f,
-            },
-        };
-        const VkRect2D scissors[] = {
-            { {0, 0}, surface_capabilities.currentExtent },
-        };
-        const VkPipelineViewportStateCreateInfo viewport_ci = {
-            VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-            NULL,
-            0,
-            1,
-            viewports,
-            1,
-            scissors,
-        };
-
-        // rasterization
-        const VkPipelineRasterizationStateCreateInfo raster_ci = {
-            VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-            NULL,
-            0,
-            VK_FALSE,
-            VK_FALSE,
-            VK_POLYGON_MODE_FILL,
-            VK_CULL_MODE_BACK_BIT,
-            VK_FRONT_FACE_COUNTER_CLOCKWISE,
-            VK_FALSE,
-            0.0f,
-            0.0f,
-            0.0f,
-            1.0f,
-        };
-
-        // multisample
-        const VkPipelineMultisampleStateCreateInfo multisample_ci = {
-            VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-            NULL,
-            0,
-            VK_SAMPLE_COUNT_1_BIT,
-            VK_FALSE,
-            0.0f,
-            NULL,
-            VK_FALSE,
-            VK_FALSE,
-        };
-
-        // depth stencil
-        // TODO: 
-        // NOTE: デプス/ステンシルテストの設定をする。
-        const VkPipelineDepthStencilStateCreateInfo depth_stencil_ci = {
-            VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
-            NULL,
-            0,
-            VK_TRUE,
-            VK_TRUE,
-            VK_COMPARE_OP_LESS_OR_EQUAL,
-            VK_FALSE,
-            VK_FALSE,
-            { 0 },
-            { 0 },
-            0.0f,
-            0.0f,
+            set_layouts,
+            shader_layout.push_constant.size > 0 ? 1 : 0,
+            &shader_layout.push_constant,
         };
+        CHECK_VK(vkCreatePipelineLayout(device, &pipeline_layout_ci, NULL, &pipeline_layout), "failed to create a pipeline layout.");
 
-        // color blend
-        const VkPipelineColorBlendAttachmentState color_blend_states[] = {
-            {
-                VK_TRUE,
-                VK_BLEND_FACTOR_SRC_ALPHA,
-                VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
-                VK_BLEND_OP_ADD,
-                VK_BLEND_FACTOR_SRC_ALPHA,
-                VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
-                VK_BLEND_OP_ADD,
-                VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
-            }
-        };
-        const VkPipelineColorBlendStateCreateInfo color_blend_ci = {
-            VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-            NULL,
-            0,
-            VK_FALSE,
-            (VkLogicOp)0,
-            1,
-            color_blend_states,
-            {0.0f, 0.0f, 0.0f, 0.0f},
-        };
+        // NOTE: パイプラインは記述から作り、キャッシュに置く。同じ記述なら作ってあるものを返す。
+        // NOTE: 描き始める前に一つしかないので、できるまで待つ。フレームの途中で新しい記述を求めるなら、待たずに次のフレームで取り直す。
+        init_pipeline_desc(&desc);
+        desc.vert_shader = vert_shader;
+        desc.frag_shader = frag_shader;
+        desc.layout = pipeline_layout;
+        desc.render_pass = render_pass;
+        desc.color_format = surface_format.format;
+        desc.depth_format = depth_format;
+        desc.samples = samples;
+        // NOTE: 頂点属性は頂点シェーダの入力から作る。頂点の構造体と食い違っていれば、ここで分かる。
+        CHECK_VK(fill_reflected_vertex_input(&vert_reflection, &desc), "failed to build vertex input from shader.vert.spv.");
+        CHECK(desc.vertex_stride == sizeof(Vertex), "shader.vert.spv does not match the vertex layout.");
+        desc.blend = VK_TRUE;
+        CHECK_VK(get_pipeline(&pipeline_cache, &desc, VK_TRUE, &pipeline), "failed to create a pipeline.");
+    }
 
-        // pipeline
-        const VkGraphicsPipelineCreateInfo cis[] = {
-            {
-                VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-                NULL,
-                0,
-                2,
-                shader_cis,
-                &vert_inp_ci,
-                &inp_as_ci,
-                NULL,
-                &viewport_ci,
-                &raster_ci,
-                &multisample_ci,
-                &depth_stencil_ci, // NOTE: ここも忘れずに。
-                &color_blend_ci,
-                NULL,
-                pipeline_layout,
-                render_pass,
-                0,
-                NULL,
-                0,
-            },
-        };
-        CHECK_VK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, cis, NULL, &pipeline), "failed to create a pipeline.");
+    // shader hot reload
+    // NOTE: 開発中は頂点シェーダとフラグメントシェーダのソースを監視し、保存されたら再起動せずにパイプラインを差し替える。
+    // NOTE: ./buildで実行することを前提とする。監視できなければ、ホットリロードなしで続ける。
+    ShaderWatcher shader_watcher = { 0, NULL };
+#ifndef RELEASE
+    {
+        const char *srcs[] = { "../src/09-cube/shader.vert", "../src/09-cube/shader.frag" };
+        const char *outs[] = { "./shader.vert.spv", "./shader.frag.spv" };
+        WARN_VK(create_shader_watcher(2, srcs, outs, &shader_watcher), "failed to watch shaders.");
     }
+#endif
+    PipelineDesc next_desc; // NOTE: 差し替え中の記述。
+    VkBool32 reloading = VK_FALSE;
+
+    // draw list
+    // NOTE: カリングパスが描画コマンドとインスタンスデータを毎フレーム書き込み、間接描画でまとめて描く。
+    // NOTE: 前のフレームの完了を待ってから記録するので、一つで足りる。
+    DrawList draw_list;
+    CHECK_VK(
+        create_draw_list(device, &phys_device_memory_prop, &indirect_features, 16, sizeof(Instance), &draw_list),
+        "failed to create a draw list."
+    );
 
     // descriptor sets for cameras
+#ifdef CPU_CULL
+    Frustum frustum;
+#endif
     Buffer uniform_buffer;
     Texture img_tex;
+    Texture checker_tex;
+    uint32_t img_slot, checker_slot;
     {
         // camera
         const float div_tanpov = 1.0f / tan(3.1415f / 4.0f);
@@ -708,6 +957,9 @@ int main() {
                       0.0f,                     0.0f, -100.0f * 1000.0f * div_depth, 0.0f,
             },
         };
+#ifdef CPU_CULL
+        extract_frustum(&camera, &frustum);
+#endif
         CHECK_VK(
             create_buffer(
                 device,
@@ -729,52 +981,119 @@ int main() {
             "failed to map a camera data to a uniform buffer."
         );
         // image
-        CHECK_VK(
-            create_image_texture_from_file(device, &phys_device_memory_prop, command_pool, queue, "../img/cube-texture.png", &img_tex),
-            "failed to create a image texture."
-        );
-        // update
-        const VkDescriptorBufferInfo bi = {
-            uniform_buffer.buffer,
-            0,
-            VK_WHOLE_SIZE,
-        };
-        const VkDescriptorImageInfo ii = {
-            sampler,
-            img_tex.view,
-            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-        };
-        const VkWriteDescriptorSet write_desc_sets[] = {
-            {
-                VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                NULL,
-                descriptor_set,
+        // NOTE: 圧縮済みのテクスチャがあり、デバイスが対応していればそれを使う。なければPNGを読み込む。
+        if (create_compressed_texture_from_file(device, phys_device, &phys_device_memory_prop, &upload, "../img/cube-texture.ktx2", &img_tex) != VK_SUCCESS) {
+            CHECK_VK(
+                create_image_texture_from_file(device, &phys_device_memory_prop, &upload, "../img/cube-texture.png", &img_tex),
+                "failed to create a image texture."
+            );
+        }
+        // NOTE: 二つ目のテクスチャとして、8x8の市松模様をその場で作る。
+        {
+            const uint32_t size = 8;
+            void *p;
+            VkDeviceSize offset;
+            CHECK_VK(reserve_upload(&upload, size * size * 4, 16, &p, &offset), "failed to reserve an upload.");
+            uint8_t *texels = (uint8_t *)p;
+            for (uint32_t y = 0; y < size; ++y) {
+                for (uint32_t x = 0; x < size; ++x) {
+                    const uint8_t c = ((x + y) & 1) == 0 ? 0xFF : 0x40;
+                    uint8_t *texel = &texels[(y * size + x) * 4];
+                    texel[0] = c;
+                    texel[1] = c;
+                    texel[2] = c;
+                    texel[3] = 0xFF;
+                }
+            }
+            CHECK_VK(
+                create_texture(
+                    device,
+                    &phys_device_memory_prop,
+                    VK_FORMAT_R8G8B8A8_UNORM,
+                    size,
+                    size,
+                    1,
+                    VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VK_IMAGE_ASPECT_COLOR_BIT,
+                    NULL,
+                    &checker_tex
+                ),
+                "failed to create a checker texture."
+            );
+            const VkBufferImageCopy copy_region = {
                 0,
                 0,
-                1,
-                VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                NULL,
-                &bi,
-                NULL,
-            },
-            {
-                VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                NULL,
-                descriptor_set,
-                1,
                 0,
-                1,
-                VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                &ii,
-                NULL,
-                NULL,
-            },
-        };
-        vkUpdateDescriptorSets(device, 2, write_desc_sets, 0, NULL);
+                { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+                { 0, 0, 0 },
+                { size, size, 1 },
+            };
+            CHECK_VK(
+                upload_image(&upload, offset, checker_tex.image, 1, 1, &copy_region, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT),
+                "failed to upload a checker texture."
+            );
+        }
+        // NOTE: テクスチャをテーブルに登録する。転送の完了前に登録してもよい。
+        CHECK_VK(register_bindless_texture(device, &bindless, img_tex.view, &img_slot), "failed to register a texture.");
+        CHECK_VK(register_bindless_texture(device, &bindless, checker_tex.view, &checker_slot), "failed to register a texture.");
     }
 
+    // Hi-Z pyramid
+    // NOTE: フレームの終わりに、描き終えたデプスバッファから作る。次のフレームのカリングで使う。
+    HiZ hiz;
+    {
+        VkImageView *depth_views = (VkImageView *)malloc(sizeof(VkImageView) * image_views_cnt);
+        CHECK(depth_views != NULL, "failed to allocate depth views.");
+        for (uint32_t i = 0; i < image_views_cnt; ++i) {
+            depth_views[i] = depth_buffers[i].view;
+        }
+        CHECK_VK(
+            create_hiz(
+                device,
+                &phys_device_memory_prop,
+                hiz_shader,
+                surface_capabilities.currentExtent.width,
+                surface_capabilities.currentExtent.height,
+                image_views_cnt,
+                depth_views,
+                &hiz
+            ),
+            "failed to create a Hi-Z pyramid."
+        );
+        free(depth_views);
+    }
+
+    // cull pass
+    // NOTE: オブジェクトの境界球をカメラの視錐台と前のフレームの深度と比べ、見えるものだけを描画リストに詰める。
+    CullPass cull_pass;
+    CHECK_VK(
+        create_cull_pass(device, &phys_device_memory_prop, cull_shader, &uniform_buffer, &hiz, &draw_list, &cull_pass),
+        "failed to create a cull pass."
+    );
+    // NOTE: 作り終えた資源をレンダーグラフに渡す。Hi-Zピラミッドはまだ作っていないので、中身は要らない。
+    set_render_graph_image(&graph, rg_hiz, hiz.texture.image, 0, VK_IMAGE_LAYOUT_UNDEFINED);
+    set_render_graph_buffer(&graph, rg_commands, draw_list.commands.buffer);
+    set_render_graph_buffer(&graph, rg_count, draw_list.count.buffer);
+    set_render_graph_buffer(&graph, rg_instances, draw_list.instances.buffer);
+    set_render_graph_buffer(&graph, rg_stats, cull_pass.stats.buffer);
+
     // models
+    // NOTE: すべてのモデルを一つのジオメトリプールに置き、バッファのバインドをフレームに一度で済ませる。
+    GeometryPool geometry_pool;
+    CHECK_VK(
+        create_geometry_pool(
+            device,
+            &phys_device_memory_prop,
+            VERTEX_FORMAT_FLOAT32,
+            VK_INDEX_TYPE_UINT16,
+            1024,
+            4096,
+            &geometry_pool
+        ),
+        "failed to create a geometry pool."
+    );
     Model cube;
+    float cube_sphere[4];
     {
         const float k = 1.0f / 3.0f;
         const Vertex vtxs[24] = {
@@ -817,20 +1136,11 @@ int main() {
             16, 17, 18, 16, 18, 19,
             20, 21, 22, 20, 22, 23,
         };
-        CHECK_VK(
-            create_model(
-                device,
-                &phys_device_memory_prop,
-                36,
-                sizeof(Vertex) * 24,
-                (const float *)vtxs,
-                (const uint32_t *)idxs,
-                &cube
-            ),
-            "failed to create a model."
-        );
+        CHECK_VK(upload_geometry(&upload, &geometry_pool, 24, (const void *)vtxs, 36, idxs, &cube), "failed to create a model.");
+        compute_bounding_sphere((const MeshVertex *)vtxs, 24, cube_sphere);
     }
     Model square;
+    float square_sphere[4];
     {
         const Vertex vtxs[] = {
             { { -0.5f,  0.5f, -0.5f }, { 0.0f, 1.0f } },
@@ -841,48 +1151,195 @@ int main() {
         const uint32_t idxs[] = {
             0, 1, 2, 0, 2, 3,
         };
-        CHECK_VK(
-            create_model(
-                device,
-                &phys_device_memory_prop,
-                6,
-                sizeof(Vertex) * 4,
-                (const float *)vtxs,
-                (const uint32_t *)idxs,
-                &square
-            ),
-            "failed to create a model."
-        );
+        CHECK_VK(upload_geometry(&upload, &geometry_pool, 4, (const void *)vtxs, 6, idxs, &square), "failed to create a model.");
+        compute_bounding_sphere((const MeshVertex *)vtxs, 4, square_sphere);
     }
 
-    PushConstant pc_cube = {
-        { 160.0f, 160.0f, 160.0f, 0.0f },
-        { 0.0f, 0.0f, 0.0f, 0.0f },
-        { 0.0f, 0.0f, 0.0f, 0.0f },
-    };
-    PushConstant pc_square = {
-        { 320.0f, 320.0f, 1.0f, 0.0f },
-        { 3.1415f / 6.0f, 0.0f, 0.0f, 0.0f },
-        { 0.0f, 0.0f, 0.0f, 0.0f },
-    };
+    // NOTE: 溜まっている転送を提出する。完了はタイムラインで待たずに、描画と同じキューの順序に任せる。
+    CHECK_VK(destroy_upload_context(&upload), "failed to submit uploads.");
+
+    // job system
+    // NOTE: シーングラフの更新を、同じ深さのノードごとにワーカースレッドへ分ける。
+    JobSystem jobs;
+    CHECK_VK(create_job_system(0, &jobs), "failed to create a job system.");
+
+    // scene graph
+    // NOTE: オブジェクトの変換はシーングラフで持ち、変わったノードとその子孫だけワールド行列を計算し直す。
+    SceneGraph scene;
+    CHECK_VK(create_scene_graph(16, &scene), "failed to create a scene graph.");
+    const float zero[3] = { 0.0f, 0.0f, 0.0f };
+    const float cube_scl[3] = { 160.0f, 160.0f, 160.0f };
+    float cube_rot[3] = { 0.0f, 0.0f, 0.0f };
+    uint32_t node_cube, node_satellite, node_square, node_hidden, node_outside;
+    {
+        CHECK_VK(add_scene_node(&scene, SCENE_NO_PARENT, cube_scl, zero, zero, &node_cube), "failed to add a cube node.");
+        // NOTE: 立方体の子。親の変換を受け継ぐので、親と一緒に回る。
+        const float satellite_scl[3] = { 0.25f, 0.25f, 0.25f };
+        const float satellite_trs[3] = { 1.0f, 0.0f, 0.0f };
+        CHECK_VK(add_scene_node(&scene, node_cube, satellite_scl, zero, satellite_trs, &node_satellite), "failed to add a satellite node.");
+        const float square_scl[3] = { 320.0f, 320.0f, 1.0f };
+        const float square_rot[3] = { 3.1415f / 6.0f, 0.0f, 0.0f };
+        CHECK_VK(add_scene_node(&scene, SCENE_NO_PARENT, square_scl, square_rot, zero, &node_square), "failed to add a square node.");
+        // NOTE: カリングを確かめるため、四角形の奥に隠れる立方体と、画面の外にある立方体も置く。
+        const float small_scl[3] = { 40.0f, 40.0f, 40.0f };
+        const float hidden_trs[3] = { 0.0f, 0.0f, 400.0f };
+        CHECK_VK(add_scene_node(&scene, SCENE_NO_PARENT, small_scl, zero, hidden_trs, &node_hidden), "failed to add a hidden node.");
+        const float outside_trs[3] = { 2000.0f, 0.0f, 0.0f };
+        CHECK_VK(add_scene_node(&scene, SCENE_NO_PARENT, small_scl, zero, outside_trs, &node_outside), "failed to add an outside node.");
+    }
+    CullStats last_stats = { 0, 0, 0, 0 };
+#ifdef CPU_CULL
+    // NOTE: CPUでカリングするときは、ワールド空間の境界球を毎フレーム詰め直す。
+    CullBounds cull_objects;
+    CHECK_VK(create_cull_bounds(16, &cull_objects), "failed to create cull bounds.");
+#endif
 
     // mainloop
+    uint64_t frame_value = 0; // NOTE: 直前のフレームの描画が完了したときにタイムラインが到達する値。
     while (1) {
         if (glfwWindowShouldClose(window))
             break;
         glfwPollEvents();
 
-        pc_cube.rot[0] += 0.01;
-        pc_cube.rot[1] += 0.01;
-        pc_cube.rot[2] += 0.01;
+        // NOTE: 回すのは立方体だけなので、計算し直すのは立方体とその子だけになる。
+        cube_rot[0] += 0.01;
+        cube_rot[1] += 0.01;
+        cube_rot[2] += 0.01;
+        set_scene_node(&scene, node_cube, cube_scl, cube_rot, zero);
+        update_scene_graph(&jobs, &scene);
 
         // prepare
         int img_idx;
         WARN_VK(vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, wait_semaphore, VK_NULL_HANDLE, &img_idx), "failed to acquire a next image index.");
-        WARN_VK(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX), "failed to wait for a fence.");
-        WARN_VK(vkResetFences(device, 1, &fence), "failed to reset a fence.");
+        WARN_VK(wait_timeline(device, &timeline, frame_value, UINT64_MAX), "failed to wait for a timeline.");
+        uint64_t completed_value = 0;
+        WARN_VK(get_timeline_value(device, &timeline, &completed_value), "failed to get a timeline value.");
+        collect_deletion_queue(device, &deletion_queue, completed_value);
+
+        // shader hot reload
+        // NOTE: フレームの区切りで、コンパイルし直されたシェーダを読み直す。パイプラインはコンパイルスレッドで作り、できるまでは前のもので描く。
+        if (!reloading) {
+            next_desc = desc;
+            if (reload_shader(device, &shader_watcher, &reflection_cache, &shader_layout, 0, "./shader.vert.spv", &next_desc.vert_shader))
+                reloading = VK_TRUE;
+            if (reload_shader(device, &shader_watcher, &reflection_cache, &shader_layout, 1, "./shader.frag.spv", &next_desc.frag_shader))
+                reloading = VK_TRUE;
+        }
+        if (reloading) {
+            VkPipeline next_pipeline;
+            const VkResult result = get_pipeline(&pipeline_cache, &next_desc, VK_FALSE, &next_pipeline);
+            // NOTE: できれば古いシェーダを、失敗すれば新しいシェーダを捨てる。失敗したときは前のパイプラインで描き続ける。
+            if (result == VK_SUCCESS) {
+                drop_shaders(device, &pipeline_cache, &deletion_queue, timeline.value, &next_desc, &desc);
+                desc = next_desc;
+                pipeline = next_pipeline;
+                reloading = VK_FALSE;
+                printf("[ Info    ] shader: swapped the pipeline\n");
+            } else if (result != VK_NOT_READY) {
+                drop_shaders(device, &pipeline_cache, &deletion_queue, timeline.value, &desc, &next_desc);
+                reloading = VK_FALSE;
+                printf("[ Warning ] failed to create a reloaded pipeline.\n");
+            }
+        }
+
+#ifndef CPU_CULL
+        // NOTE: 前のフレームが完了したので、そのカリングの統計が読める。変わったときだけ表示する。
+        if (frame_value > 0) {
+            CullStats stats;
+            get_cull_stats(&cull_pass, &stats);
+            if (memcmp(&stats, &last_stats, sizeof(CullStats)) != 0) {
+                printf("[ Info    ] cull: drawn %u, frustum culled %u, occlusion culled %u\n", stats.drawn, stats.frustum_culled, stats.occlusion_culled);
+                last_stats = stats;
+            }
+        }
+#endif
         WARN_VK(vkResetCommandBuffer(command_buffer, VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT), "failed to reset a command buffer.");
 
+        // NOTE: 前のフレームのセットはGPUが使い終えたので、プールごとまとめて解放し、このフレームのセットを割り当て直す。
+        // NOTE: ここでは毎フレーム同じ内容だが、マテリアルのように描画ごとに変わるセットも同じように作れる。
+        VkDescriptorSet descriptor_set;
+        WARN_VK(reset_descriptor_allocator(device, &frame_descriptors), "failed to reset a descriptor allocator.");
+        WARN_VK(allocate_descriptor_set(device, &frame_descriptors, descriptor_set_layout, &descriptor_set), "failed to allocate a descriptor set.");
+        {
+            const VkDescriptorBufferInfo bi = {
+                uniform_buffer.buffer,
+                0,
+                VK_WHOLE_SIZE,
+            };
+            const VkDescriptorBufferInfo instances_bi = {
+                draw_list.instances.buffer,
+                0,
+                VK_WHOLE_SIZE,
+            };
+            const VkWriteDescriptorSet write_desc_sets[] = {
+                {
+                    VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    NULL,
+                    descriptor_set,
+                    0,
+                    0,
+                    1,
+                    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                    NULL,
+                    &bi,
+                    NULL,
+                },
+                {
+                    VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    NULL,
+                    descriptor_set,
+                    2,
+                    0,
+                    1,
+                    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    NULL,
+                    &instances_bi,
+                    NULL,
+                },
+            };
+            vkUpdateDescriptorSets(device, 2, write_desc_sets, 0, NULL);
+        }
+
+        // NOTE: GPUが前のフレームのオブジェクトを読み終えたので、書き換えてよい。
+        // NOTE: インスタンスデータは、ワールド行列とテクスチャの番号。
+        {
+            const Model *models[5] = { &cube, &cube, &square, &cube, &cube };
+            const float *spheres[5] = { cube_sphere, cube_sphere, square_sphere, cube_sphere, cube_sphere };
+            const uint32_t nodes[5] = { node_cube, node_satellite, node_square, node_hidden, node_outside };
+            const uint32_t slots[5] = { img_slot, img_slot, checker_slot, checker_slot, img_slot };
+#ifdef CPU_CULL
+            // NOTE: 境界球をワールド空間で視錐台と比べ、見えるものだけを描画リストに積む。遮蔽による選別は行わない。
+            cull_objects.cnt = 0;
+            for (uint32_t i = 0; i < 5; ++i) {
+                float sphere[4];
+                transform_sphere(scene.worlds[nodes[i]], spheres[i], sphere);
+                WARN_VK(push_cull_bounds(&cull_objects, sphere), "failed to push cull bounds.");
+            }
+            uint32_t visible[16];
+            uint32_t visible_cnt = 0;
+            WARN_VK(cull_bounds(&jobs, &cull_objects, &frustum, NULL, VK_TRUE, visible, &visible_cnt), "failed to cull objects.");
+            reset_draw_list(&draw_list);
+            for (uint32_t k = 0; k < visible_cnt; ++k) {
+                const uint32_t i = visible[k];
+                Instance inst = { { 0 }, slots[i], { 0, 0, 0 } };
+                memcpy(inst.world, scene.worlds[nodes[i]], sizeof(float) * 16);
+                WARN_VK(push_draw(&draw_list, models[i], (const void *)&inst), "failed to push a draw.");
+            }
+            const CullStats stats = { visible_cnt, cull_objects.cnt - visible_cnt, 0, 0 };
+            if (memcmp(&stats, &last_stats, sizeof(CullStats)) != 0) {
+                printf("[ Info    ] cull: drawn %u, frustum culled %u, occlusion culled %u\n", stats.drawn, stats.frustum_culled, stats.occlusion_culled);
+                last_stats = stats;
+            }
+#else
+            reset_cull_pass(&cull_pass);
+            for (uint32_t i = 0; i < 5; ++i) {
+                Instance inst = { { 0 }, slots[i], { 0, 0, 0 } };
+                memcpy(inst.world, scene.worlds[nodes[i]], sizeof(float) * 16);
+                WARN_VK(push_cull_object(&cull_pass, models[i], spheres[i], (const void *)&inst), "failed to push an object to a cull pass.");
+            }
+#endif
+        }
+
         // begin
         const VkCommandBufferBeginInfo cmd_bi = {
             VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
@@ -891,72 +1348,128 @@ int main() {
             NULL,
         };
         WARN_VK(vkBeginCommandBuffer(command_buffer, &cmd_bi), "failed to begin to record commands to render.");
-        const VkClearValue clear_values[] = {
-            { SCREEN_CLEAR_RGBA },
-            { 1.0f, 0.0f }, // NOTE: デプスバッファのクリア値。
-        };
-        const VkRenderPassBeginInfo rp_bi = {
-            VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-            NULL,
-            render_pass,
-            framebuffers[img_idx],
-            { {0, 0}, surface_capabilities.currentExtent },
-            2, // NOTE: 忘れずに。
-            clear_values,
-        };
-        vkCmdBeginRenderPass(command_buffer, &rp_bi, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-
-        // draw a cube
-        const VkDeviceSize offset1 = 0;
-        vkCmdBindVertexBuffers(command_buffer, 0, 1, &cube.vertex.buffer, &offset1);
-        vkCmdBindIndexBuffer(command_buffer, cube.index.buffer, offset1, VK_INDEX_TYPE_UINT32);
-        vkCmdBindDescriptorSets(
-            command_buffer,
-            VK_PIPELINE_BIND_POINT_GRAPHICS,
-            pipeline_layout,
-            0,
-            1,
-            &descriptor_set,
-            0,
-            NULL
-        );
-        vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstant), (const void *)&pc_cube);
-        vkCmdDrawIndexed(command_buffer, cube.index_cnt, 1, 0, 0, 0);
-
-        // draw a square
-        const VkDeviceSize offset2 = 0;
-        vkCmdBindVertexBuffers(command_buffer, 0, 1, &square.vertex.buffer, &offset2);
-        vkCmdBindIndexBuffer(command_buffer, square.index.buffer, offset2, VK_INDEX_TYPE_UINT32);
-        vkCmdBindDescriptorSets(
-            command_buffer,
-            VK_PIPELINE_BIND_POINT_GRAPHICS,
-            pipeline_layout,
-            0,
-            1,
-            &descriptor_set,
-            0,
-            NULL
-        );
-        vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstant), (const void *)&pc_square);
-        vkCmdDrawIndexed(command_buffer, square.index_cnt, 1, 0, 0, 0);
+
+        // NOTE: スワップチェインのイメージとデプスバッファはフレームごとに違うので、グラフに渡し直す。どちらも中身はクリアするので、前のレイアウトは問わない。
+        // NOTE: スワップチェインのイメージは取得のセマフォをカラーアタッチメント出力のステージで待つので、遷移もそのステージから始める。
+        begin_render_graph(&graph);
+        set_render_graph_image(&graph, rg_swapchain, images[img_idx], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+        set_render_graph_image(&graph, rg_depth, depth_buffers[img_idx].image, 0, VK_IMAGE_LAYOUT_UNDEFINED);
+
+        // cull
+        // NOTE: レンダーパスの中ではディスパッチできないので、先に済ませる。
+        if (cmd_begin_render_graph_pass(command_buffer, &graph, cull_node))
+            cmd_cull(command_buffer, &cull_pass, &hiz, &draw_list);
+
+        // draw
+        if (cmd_begin_render_graph_pass(command_buffer, &graph, draw_node)) {
+            const VkClearValue clear_values[] = {
+                { SCREEN_CLEAR_RGBA },
+                { .depthStencil = { 1.0f, 0 } }, // NOTE: デプスバッファのクリア値。
+            };
+            if (render_pass == VK_NULL_HANDLE) {
+                // NOTE: MSAAでは、マルチサンプルの中身は解決した後は要らないので保存しない。
+                const VkRenderingAttachmentInfoKHR color_attachment = {
+                    VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+                    NULL,
+                    msaa ? graph.resources[rg_msaa_color].view : image_views[img_idx],
+                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                    msaa ? VK_RESOLVE_MODE_AVERAGE_BIT : VK_RESOLVE_MODE_NONE,
+                    msaa ? image_views[img_idx] : VK_NULL_HANDLE,
+                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                    VK_ATTACHMENT_LOAD_OP_CLEAR,
+                    msaa ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE,
+                    clear_values[0],
+                };
+                const VkRenderingAttachmentInfoKHR depth_attachment = {
+                    VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+                    NULL,
+                    msaa ? graph.resources[rg_msaa_depth].view : depth_buffers[img_idx].view,
+                    VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                    msaa ? depth_resolve_mode : VK_RESOLVE_MODE_NONE,
+                    msaa ? depth_buffers[img_idx].view : VK_NULL_HANDLE,
+                    VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                    VK_ATTACHMENT_LOAD_OP_CLEAR,
+                    msaa ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE, // NOTE: Hi-Zの作成で読むので、解決しないなら残す。
+                    clear_values[1],
+                };
+                const VkRenderingInfoKHR ri = {
+                    VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+                    NULL,
+                    0,
+                    { {0, 0}, surface_capabilities.currentExtent },
+                    1,
+                    0,
+                    1,
+                    &color_attachment,
+                    &depth_attachment,
+                    NULL,
+                };
+                cmd_begin_rendering(command_buffer, &ri);
+            } else {
+                const VkRenderPassBeginInfo rp_bi = {
+                    VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+                    NULL,
+                    render_pass,
+                    framebuffers[img_idx],
+                    { {0, 0}, surface_capabilities.currentExtent },
+                    2, // NOTE: 忘れずに。解決先は読み込まないので、クリア値は要らない。
+                    clear_values,
+                };
+                vkCmdBeginRenderPass(command_buffer, &rp_bi, VK_SUBPASS_CONTENTS_INLINE);
+            }
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            // NOTE: ビューポートとシザーは常に動的ステートなので、バインドのたびに設定する。拡張された動的ステートが使えれば、カリングやデプスもここで設定する。
+            cmd_set_pipeline_state(command_buffer, &pipeline_cache, &desc, surface_capabilities.currentExtent);
+
+            // NOTE: モデルはすべてジオメトリプールにあるので、バッファのバインドは一度でよい。
+            const VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(command_buffer, 0, 1, &geometry_pool.vertex.buffer, &offset);
+            vkCmdBindIndexBuffer(command_buffer, geometry_pool.index.buffer, offset, geometry_pool.index_type);
+
+            // draw all
+            // NOTE: 描画ごとの違いはインスタンスデータにあるので、ディスクリプタセットのバインドも一度でよい。
+            // NOTE: テクスチャもbindlessのテーブルから番号で引くので、テクスチャが変わってもバインドし直さない。
+            const VkDescriptorSet sets[] = { descriptor_set, bindless.descriptor_set };
+            vkCmdBindDescriptorSets(
+                command_buffer,
+                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                pipeline_layout,
+                0,
+                2,
+                sets,
+                0,
+                NULL
+            );
+            cmd_draw_list(command_buffer, &draw_list);
+
+            if (render_pass == VK_NULL_HANDLE) {
+                cmd_end_rendering(command_buffer);
+            } else {
+                vkCmdEndRenderPass(command_buffer);
+            }
+        }
+
+        // build Hi-Z
+        // NOTE: レンダーパスの外でなければディスパッチできないので、描き終えてから作る。
+        if (cmd_begin_render_graph_pass(command_buffer, &graph, hiz_node))
+            cmd_build_hiz(command_buffer, &hiz, (uint32_t)img_idx);
+        cmd_end_render_graph(command_buffer, &graph);
 
         // end
-        vkCmdEndRenderPass(command_buffer);
         vkEndCommandBuffer(command_buffer);
-        const VkPipelineStageFlags wait_stage_mask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        const VkSubmitInfo submit_info = {
-            VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            NULL,
-            1,
-            &wait_semaphore,
-            &wait_stage_mask,
-            1,
-            &command_buffer,
-            1,
-            &signal_semaphore,
-        };
-        WARN_VK(vkQueueSubmit(queue, 1, &submit_info, fence), "failed to submit commands to queue.");
+        WARN_VK(
+            submit_timeline(
+                queue,
+                &timeline,
+                1,
+                &command_buffer,
+                wait_semaphore,
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                signal_semaphore,
+                &frame_value
+            ),
+            "failed to submit commands to queue."
+        );
         VkResult res;
         const VkPresentInfoKHR pi = {
             VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -973,40 +1486,58 @@ int main() {
     }
 
     // termination
-    vkDeviceWaitIdle(device);
-    vkFreeMemory(device, square.vertex.memory, NULL);
-    vkFreeMemory(device, square.index.memory, NULL);
-    vkDestroyBuffer(device, square.vertex.buffer, NULL);
-    vkDestroyBuffer(device, square.index.buffer, NULL);
-    vkFreeMemory(device, cube.vertex.memory, NULL);
-    vkFreeMemory(device, cube.index.memory, NULL);
-    vkDestroyBuffer(device, cube.vertex.buffer, NULL);
-    vkDestroyBuffer(device, cube.index.buffer, NULL);
-    vkFreeMemory(device, uniform_buffer.memory, NULL);
-    vkDestroyBuffer(device, uniform_buffer.buffer, NULL);
-    vkFreeMemory(device, img_tex.memory, NULL);
-    vkDestroyImageView(device, img_tex.view, NULL);
-    vkDestroyImage(device, img_tex.image, NULL);
-    vkDestroyPipeline(device, pipeline, NULL);
+    // NOTE: 最後に提出した処理の完了を待つ。
+    // NOTE: プレゼンテーションはタイムラインを進めないため、signal_semaphoreを破棄する前にキューを空にしておく。
+    WARN_VK(wait_timeline(device, &timeline, timeline.value, UINT64_MAX), "failed to wait for a timeline.");
+    vkQueueWaitIdle(queue);
+    flush_deletion_queue(device, &deletion_queue);
+#ifdef CPU_CULL
+    destroy_cull_bounds(&cull_objects);
+#endif
+    destroy_scene_graph(&scene);
+    destroy_job_system(&jobs);
+    destroy_geometry_pool(device, &geometry_pool);
+    destroy_cull_pass(device, &cull_pass);
+    destroy_hiz(device, &hiz);
+    destroy_draw_list(device, &draw_list);
+    destroy_buffer(device, &uniform_buffer);
+    destroy_bindless_table(device, &bindless);
+    destroy_texture(device, &img_tex);
+    destroy_texture(device, &checker_tex);
+    destroy_shader_watcher(&shader_watcher);
+    destroy_pipeline_cache(&pipeline_cache);
+    if (reloading) {
+        // NOTE: 差し替え中の新しいシェーダは、パイプラインとともにキャッシュが破棄済みなので、モジュールだけを破棄する。
+        if (next_desc.vert_shader != desc.vert_shader)
+            vkDestroyShaderModule(device, next_desc.vert_shader, NULL);
+        if (next_desc.frag_shader != desc.frag_shader)
+            vkDestroyShaderModule(device, next_desc.frag_shader, NULL);
+    }
     vkDestroyPipelineLayout(device, pipeline_layout, NULL);
-    vkDestroyDescriptorPool(device, descriptor_pool, NULL);
-    vkDestroyDescriptorSetLayout(device, descriptor_set_layout, NULL);
-    vkDestroySampler(device, sampler, NULL);
-    vkDestroyShaderModule(device, frag_shader, NULL);
-    vkDestroyShaderModule(device, vert_shader, NULL);
+    destroy_descriptor_allocator(device, &frame_descriptors);
+    destroy_descriptor_layout_cache(device, &layout_cache);
+    destroy_sampler_cache(device, &sampler_cache);
+    destroy_shader_reflection_cache(&reflection_cache);
+    vkDestroyShaderModule(device, desc.frag_shader, NULL); // NOTE: ホットリロードで差し替わっているかもしれないので。
+    vkDestroyShaderModule(device, desc.vert_shader, NULL);
+    vkDestroyShaderModule(device, cull_shader, NULL);
+    vkDestroyShaderModule(device, hiz_shader, NULL);
     for (uint32_t i = 0; i < image_views_cnt; ++i) {
-        vkDestroyFramebuffer(device, framebuffers[i], NULL);
+        if (framebuffers != NULL)
+            vkDestroyFramebuffer(device, framebuffers[i], NULL);
         vkDestroyImageView(device, image_views[i], NULL);
         vkFreeMemory(device, depth_buffers[i].memory, NULL);
         vkDestroyImageView(device, depth_buffers[i].view, NULL);
         vkDestroyImage(device, depth_buffers[i].image, NULL);
     }
-    vkDestroyRenderPass(device, render_pass, NULL);
+    destroy_render_graph(device, &graph);
+    if (render_pass != VK_NULL_HANDLE)
+        vkDestroyRenderPass(device, render_pass, NULL);
     vkDestroySwapchainKHR(device, swapchain, NULL);
     vkDestroySurfaceKHR(instance, surface, NULL);
     vkDestroySemaphore(device, signal_semaphore, NULL);
     vkDestroySemaphore(device, wait_semaphore, NULL);
-    vkDestroyFence(device, fence, NULL);
+    vkDestroySemaphore(device, timeline.semaphore, NULL);
     vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
     vkDestroyCommandPool(device, command_pool, NULL);
     vkDestroyDevice(device, NULL);
@@ -1,11 +1,16 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
-layout(binding=1) uniform sampler2D diffuse_map;
+// NOTE: テクスチャはbindlessのテーブルから、インスタンスごとの番号で引く。
+layout(set=1, binding=0) uniform texture2D textures[];
+layout(set=1, binding=1) uniform sampler tex_sampler;
 
 layout(location=0) in vec2 in_uv;
+layout(location=1) flat in uint in_texture;
 
 layout(location=0) out vec4 out_color;
 
 void main() {
-    out_color = texture(diffuse_map, in_uv);
+    // NOTE: 番号は描画ごとに異なりうるので、nonuniformEXTを付ける。
+    out_color = texture(sampler2D(textures[nonuniformEXT(in_texture)], tex_sampler), in_uv);
 }
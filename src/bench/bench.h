@@ -0,0 +1,34 @@
+#pragma once
+
+#include "../common/vulkan-tutorial.h"
+
+#include <time.h>
+
+// ベンチマーク用の、ウィンドウを持たないVulkanの環境。
+typedef struct Headless_t {
+    VkInstance instance;
+    VkPhysicalDevice phys_device;
+    VkPhysicalDeviceMemoryProperties mem_prop;
+    IndirectFeatures indirect_features; // NOTE: 対応しているものはすべて有効にしてある。
+    uint32_t queue_family_index;
+    VkDevice device;
+    VkQueue queue;
+    VkCommandPool command_pool;
+    Timeline timeline;
+    DeletionQueue deletion_queue;
+} Headless;
+
+// ウィンドウもスワップチェーンも作らずに、デバイスとキューまでを用意する関数。
+//   - out: 結果を格納するポインタ
+VkResult create_headless(Headless *out);
+
+// キューの処理の完了を待ってから、create_headlessで作ったものをすべて破棄する関数。
+//   - headless: 破棄する環境
+void destroy_headless(Headless *headless);
+
+// 現在時刻を秒で返す関数。
+static inline double now_sec() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
@@ -0,0 +1,143 @@
+// CPUでの視錐台カリングを、スカラー・SIMD・SIMDとジョブシステムとで比較するベンチマーク。
+//
+//   $ ./a.out [オブジェクト数]
+//
+// 09-cubeと同じカメラの前後に、ランダムな境界球をオブジェクト数だけ置く。
+//   - scalar: 一つずつ6平面と比べる
+//   - simd: AVXで8個ずつ比べる(使えなければscalarと同じ)
+//   - simd + jobs: simdをジョブシステムで並列に実行する
+//   - occlusion: simd + jobsに加えて、手前に置いた壁で遮蔽されたものを除く
+// いずれもITER_CNT回の平均。デバイスは使わない。
+
+#include "bench.h"
+
+#include <math.h>
+#include <string.h>
+
+#define ITER_CNT 32
+#define OCCLUSION_WIDTH 128
+#define OCCLUSION_HEIGHT 96
+
+// 再現性のための、単純な線形合同法の乱数。[0, 1)を返す。
+static float next_random(uint32_t *state) {
+    *state = *state * 1664525u + 1013904223u;
+    return (float)(*state >> 8) / 16777216.0f;
+}
+
+static int compare_index(const void *a, const void *b) {
+    const uint32_t x = *(const uint32_t *)a;
+    const uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+// カリングをITER_CNT回行い、一回あたりの時間を返す関数。
+static VkResult run(
+    JobSystem *jobs,
+    const CullBounds *bounds,
+    const Frustum *frustum,
+    const OcclusionBuffer *occlusion,
+    VkBool32 simd,
+    uint32_t *visible,
+    uint32_t *p_visible_cnt,
+    double *p_sec
+) {
+    const double start = now_sec();
+    for (uint32_t i = 0; i < ITER_CNT; ++i) {
+        CHECK_RETURN_VK(cull_bounds(jobs, bounds, frustum, occlusion, simd, visible, p_visible_cnt));
+    }
+    *p_sec = (now_sec() - start) / (double)ITER_CNT;
+    return VK_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+    const uint32_t cnt = argc > 1 ? (uint32_t)atoi(argv[1]) : 1000000;
+    CHECK(cnt > 0, "invalid object count.");
+
+    // NOTE: 09-cubeと同じカメラ。
+    const float div_tanpov = 1.0f / tanf(3.1415f / 4.0f);
+    const float div_depth = 1.0f / (1000.0f - 100.0f);
+    const CameraData camera = {
+        {
+            1.0f, 0.0f, 0.0f, 0.0f,
+            0.0f, 1.0f, 0.0f, 0.0f,
+            0.0f, 0.0f, 1.0f, 0.0f,
+            0.0f, 0.0f, 320.0f, 1.0f,
+        },
+        {
+            div_tanpov,                     0.0f,                          0.0f, 0.0f,
+                  0.0f, div_tanpov * 4.0f / 3.0f,                          0.0f, 0.0f,
+                  0.0f,                     0.0f,           1000.0f * div_depth, 1.0f,
+                  0.0f,                     0.0f, -100.0f * 1000.0f * div_depth, 0.0f,
+        },
+    };
+    Frustum frustum;
+    extract_frustum(&camera, &frustum);
+
+    // NOTE: 視錐台より一回り広い範囲にばらまき、おおよそ半分ほどが見えるようにする。
+    CullBounds bounds;
+    CHECK_VK(create_cull_bounds(cnt, &bounds), "failed to create bounds.");
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < cnt; ++i) {
+        const float sphere[4] = {
+            (next_random(&seed) * 2.0f - 1.0f) * 1200.0f,
+            (next_random(&seed) * 2.0f - 1.0f) * 900.0f,
+            next_random(&seed) * 1100.0f - 320.0f,
+            1.0f + next_random(&seed) * 15.0f,
+        };
+        CHECK_VK(push_cull_bounds(&bounds, sphere), "failed to push bounds.");
+    }
+
+    // NOTE: カメラのすぐ前、視野の左半分を塞ぐ壁を遮蔽物とする。
+    OcclusionBuffer occlusion;
+    CHECK_VK(create_occlusion_buffer(OCCLUSION_WIDTH, OCCLUSION_HEIGHT, &occlusion), "failed to create an occlusion buffer.");
+    clear_occlusion_buffer(&occlusion, &camera);
+    {
+        const float positions[12] = {
+            -2000.0f, -2000.0f, -100.0f,
+                0.0f, -2000.0f, -100.0f,
+                0.0f,  2000.0f, -100.0f,
+            -2000.0f,  2000.0f, -100.0f,
+        };
+        const uint32_t idxs[6] = { 0, 1, 2, 0, 2, 3 };
+        rasterize_occluders(&occlusion, positions, idxs, 6);
+    }
+
+    // NOTE: スカラーの結果を別に取っておき、他の方法と見えるものが一致するかを確かめる。
+    uint32_t *expected = (uint32_t *)malloc(sizeof(uint32_t) * cnt);
+    uint32_t *visible = (uint32_t *)malloc(sizeof(uint32_t) * cnt);
+    CHECK(expected != NULL && visible != NULL, "failed to allocate visible indices.");
+    JobSystem jobs;
+    CHECK_VK(create_job_system(0, &jobs), "failed to create a job system.");
+
+    printf("objects      : %u\n", cnt);
+    printf("simd         : %s\n", is_cull_simd_supported() ? "avx" : "not supported");
+    printf("threads      : %u + 1\n", jobs.thread_cnt);
+    printf("                   time    visible\n");
+    double sec;
+    uint32_t scalar_cnt, visible_cnt;
+    CHECK_VK(run(NULL, &bounds, &frustum, NULL, VK_FALSE, expected, &scalar_cnt, &sec), "failed to run the scalar benchmark.");
+    printf("scalar       : %7.3f ms %10u\n", sec * 1000.0, scalar_cnt);
+    CHECK_VK(run(NULL, &bounds, &frustum, NULL, VK_TRUE, visible, &visible_cnt, &sec), "failed to run the simd benchmark.");
+    printf("simd         : %7.3f ms %10u\n", sec * 1000.0, visible_cnt);
+    CHECK(
+        visible_cnt == scalar_cnt && memcmp(visible, expected, sizeof(uint32_t) * scalar_cnt) == 0,
+        "simd result differs from scalar one."
+    );
+    CHECK_VK(run(&jobs, &bounds, &frustum, NULL, VK_TRUE, visible, &visible_cnt, &sec), "failed to run the job benchmark.");
+    printf("simd + jobs  : %7.3f ms %10u\n", sec * 1000.0, visible_cnt);
+    // NOTE: チャンクは順に詰めるので今は昇順だが、並びには依存せず中身だけを比べる。
+    qsort(visible, visible_cnt, sizeof(uint32_t), compare_index);
+    CHECK(
+        visible_cnt == scalar_cnt && memcmp(visible, expected, sizeof(uint32_t) * scalar_cnt) == 0,
+        "job result differs from scalar one."
+    );
+    CHECK_VK(run(&jobs, &bounds, &frustum, &occlusion, VK_TRUE, visible, &visible_cnt, &sec), "failed to run the occlusion benchmark.");
+    printf("occlusion    : %7.3f ms %10u\n", sec * 1000.0, visible_cnt);
+
+    destroy_job_system(&jobs);
+    free(visible);
+    free(expected);
+    destroy_occlusion_buffer(&occlusion);
+    destroy_cull_bounds(&bounds);
+    return 0;
+}
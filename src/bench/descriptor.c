@@ -0,0 +1,140 @@
+// ディスクリプタセットの割り当てを、一つずつ割り当てて解放する場合とフレームごとのアロケータでまとめてリセットする場合とで比較するベンチマーク。
+//
+//   $ ./a.out [1フレームあたりのセット数]
+//
+// マテリアルのように毎フレーム作り直すセットを想定し、ITER_CNTフレーム分の平均を表示する。
+// あわせて、レイアウトを毎回作って破棄する場合とキャッシュから引く場合の時間も表示する。GPUへの提出は行わない。
+
+#include "bench.h"
+
+#define ITER_CNT 32
+
+// 1フレーム分のセットを割り当てて解放する時間を返す。
+//   - allocator: NULLなら、VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT付きのプールから一つずつ割り当て、一つずつ解放する
+static VkResult run_sets(
+    Headless *hl,
+    uint32_t cnt,
+    const VkDescriptorSetLayout layout,
+    const VkDescriptorPool pool,
+    DescriptorAllocator *allocator,
+    VkDescriptorSet *sets,
+    double *p_sec
+) {
+    double sec = 0.0;
+    for (uint32_t i = 0; i < ITER_CNT; ++i) {
+        const double start = now_sec();
+        if (allocator == NULL) {
+            const VkDescriptorSetAllocateInfo ai = {
+                VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+                NULL,
+                pool,
+                1,
+                &layout,
+            };
+            for (uint32_t k = 0; k < cnt; ++k) {
+                CHECK_RETURN_VK(vkAllocateDescriptorSets(hl->device, &ai, &sets[k]));
+            }
+            for (uint32_t k = 0; k < cnt; ++k) {
+                CHECK_RETURN_VK(vkFreeDescriptorSets(hl->device, pool, 1, &sets[k]));
+            }
+        } else {
+            for (uint32_t k = 0; k < cnt; ++k) {
+                CHECK_RETURN_VK(allocate_descriptor_set(hl->device, allocator, layout, &sets[k]));
+            }
+            CHECK_RETURN_VK(reset_descriptor_allocator(hl->device, allocator));
+        }
+        sec += now_sec() - start;
+    }
+    *p_sec = sec / (double)ITER_CNT;
+    return VK_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+    const uint32_t cnt = argc > 1 ? (uint32_t)atoi(argv[1]) : 10000;
+    CHECK(cnt > 0, "invalid set count.");
+
+    Headless hl;
+    CHECK_VK(create_headless(&hl), "failed to create a headless environment.");
+
+    // NOTE: マテリアルを想定し、ユニフォームバッファ一つとテクスチャ二つを持つレイアウトとする。
+    const VkDescriptorSetLayoutBinding binds[] = {
+        { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, NULL },
+        { 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, VK_SHADER_STAGE_FRAGMENT_BIT, NULL },
+    };
+    const VkDescriptorSetLayoutCreateInfo layout_ci = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        NULL,
+        0,
+        2,
+        binds,
+    };
+    DescriptorLayoutCache cache;
+    CHECK_VK(create_descriptor_layout_cache(&cache), "failed to create a layout cache.");
+    VkDescriptorSetLayout layout;
+    CHECK_VK(get_descriptor_set_layout(hl.device, &cache, &layout_ci, &layout), "failed to create a layout.");
+
+    // NOTE: 一つずつ解放するプールは、1フレーム分がちょうど入る大きさで作る。
+    VkDescriptorPool pool;
+    {
+        const VkDescriptorPoolSize sizes[] = {
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, cnt },
+            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, cnt * 2 },
+        };
+        const VkDescriptorPoolCreateInfo ci = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            NULL,
+            VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
+            cnt,
+            2,
+            sizes,
+        };
+        CHECK_VK(vkCreateDescriptorPool(hl.device, &ci, NULL, &pool), "failed to create a descriptor pool.");
+    }
+    // NOTE: アロケータは小さなプールから始め、足りなければ継ぎ足す。一度広がれば、リセット後はプールを使い回す。
+    DescriptorAllocator allocator;
+    const DescriptorPoolRatio ratios[] = {
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f },
+    };
+    CHECK_VK(create_descriptor_allocator(64, 2, ratios, &allocator), "failed to create a descriptor allocator.");
+    VkDescriptorSet *sets = (VkDescriptorSet *)malloc(sizeof(VkDescriptorSet) * cnt);
+    CHECK(sets != NULL, "failed to allocate sets.");
+
+    double individual, pooled;
+    CHECK_VK(run_sets(&hl, cnt, layout, pool, NULL, sets, &individual), "failed to run the individual benchmark.");
+    CHECK_VK(run_sets(&hl, cnt, layout, pool, &allocator, sets, &pooled), "failed to run the pooled benchmark.");
+    const uint32_t pool_cnt = allocator.free_cnt;
+
+    // NOTE: レイアウトは、毎回作って破棄する場合とキャッシュから引く場合とで比べる。
+    double create_sec, cache_sec;
+    {
+        double start = now_sec();
+        for (uint32_t i = 0; i < cnt; ++i) {
+            VkDescriptorSetLayout tmp;
+            CHECK_VK(vkCreateDescriptorSetLayout(hl.device, &layout_ci, NULL, &tmp), "failed to create a layout.");
+            vkDestroyDescriptorSetLayout(hl.device, tmp, NULL);
+        }
+        create_sec = now_sec() - start;
+        start = now_sec();
+        for (uint32_t i = 0; i < cnt; ++i) {
+            VkDescriptorSetLayout tmp;
+            CHECK_VK(get_descriptor_set_layout(hl.device, &cache, &layout_ci, &tmp), "failed to get a layout.");
+            CHECK(tmp == layout, "cache returned a different layout.");
+        }
+        cache_sec = now_sec() - start;
+    }
+
+    printf("sets per frame      : %u\n", cnt);
+    printf("allocate and free   : %10.3f ms / frame\n", individual * 1000.0);
+    printf("allocator and reset : %10.3f ms / frame (%u pools)\n", pooled * 1000.0, pool_cnt);
+    printf("speedup             : %10.2fx\n", individual / pooled);
+    printf("layout create       : %10.3f ms / %u\n", create_sec * 1000.0, cnt);
+    printf("layout cache        : %10.3f ms / %u\n", cache_sec * 1000.0, cnt);
+
+    free(sets);
+    destroy_descriptor_allocator(hl.device, &allocator);
+    vkDestroyDescriptorPool(hl.device, pool, NULL);
+    destroy_descriptor_layout_cache(hl.device, &cache);
+    destroy_headless(&hl);
+    return 0;
+}
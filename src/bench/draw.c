@@ -0,0 +1,595 @@
+// 描画コマンドを、オブジェクトごとに記録する場合と描画リストで間接描画する場合とで比較するベンチマーク。
+//
+//   $ ./a.out [オブジェクト数]
+//
+// 同じ立方体をオブジェクト数だけ、256x256のオフスクリーンの画像に描く。
+//   - direct: オブジェクトごとにvkCmdDrawIndexedを記録する(以前の09-cubeと同じ)
+//   - indirect: 描画リストをvkCmdDrawIndexedIndirectで描く(multiDrawIndirectがなければ描画ごとに一回)
+//   - indirect count: 描画リストをvkCmdDrawIndexedIndirectCountで描く(drawIndirectCountがあるときだけ)
+// recordはインスタンスデータの書き込みを含むCPUの記録時間、gpuはタイムスタンプクエリで計った実行時間。
+// いずれもFRAME_CNTフレームの平均。
+
+#include "bench.h"
+
+#include <string.h>
+
+#define TARGET_SIZE 256
+#define FRAME_CNT 32
+
+// 描画ごとのインスタンスデータ。
+typedef struct Instance_t {
+    float trs[4]; // NOTE: xyが位置、wが大きさ。
+} Instance;
+
+typedef enum Mode_t {
+    MODE_DIRECT,
+    MODE_INDIRECT,
+    MODE_INDIRECT_COUNT,
+} Mode;
+
+// 描画に使うオブジェクトをまとめた構造体。
+typedef struct Scene_t {
+    Texture target;
+    VkRenderPass render_pass;
+    VkFramebuffer framebuffer;
+    VkShaderModule vert_shader;
+    VkShaderModule frag_shader;
+    VkDescriptorSetLayout descriptor_set_layout;
+    VkDescriptorPool descriptor_pool;
+    VkDescriptorSet descriptor_set;
+    VkPipelineLayout pipeline_layout;
+    VkPipeline pipeline;
+    VkQueryPool query_pool;
+    VkCommandBuffer command;
+} Scene;
+
+static VkResult create_shader_module(const VkDevice device, const char *path, VkShaderModule *out) {
+    int size;
+    char *bin = read_bin(path, &size);
+    CHECK_RETURN(bin != NULL);
+    const VkShaderModuleCreateInfo ci = {
+        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        NULL,
+        0,
+        size,
+        (const uint32_t *)bin,
+    };
+    const VkResult res = vkCreateShaderModule(device, &ci, NULL, out);
+    free(bin);
+    return res;
+}
+
+static VkResult create_scene(Headless *hl, const DrawList *draw_list, Scene *out) {
+    // render target
+    CHECK_RETURN_VK(
+        create_texture(
+            hl->device,
+            &hl->mem_prop,
+            VK_FORMAT_R8G8B8A8_UNORM,
+            TARGET_SIZE,
+            TARGET_SIZE,
+            1,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+            VK_IMAGE_ASPECT_COLOR_BIT,
+            NULL,
+            &out->target
+        )
+    );
+
+    // render pass
+    {
+        const VkAttachmentDescription attachment_descs[] = {
+            {
+                0,
+                VK_FORMAT_R8G8B8A8_UNORM,
+                VK_SAMPLE_COUNT_1_BIT,
+                VK_ATTACHMENT_LOAD_OP_CLEAR,
+                VK_ATTACHMENT_STORE_OP_STORE,
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            },
+        };
+        const VkAttachmentReference color_refs[] = {
+            {
+                0,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            },
+        };
+        const VkSubpassDescription subpass_descs[] = {
+            {
+                0,
+                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                0,
+                NULL,
+                1,
+                color_refs,
+                NULL,
+                NULL,
+                0,
+                NULL,
+            },
+        };
+        const VkRenderPassCreateInfo ci = {
+            VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+            NULL,
+            0,
+            1,
+            attachment_descs,
+            1,
+            subpass_descs,
+            0,
+            NULL,
+        };
+        CHECK_RETURN_VK(vkCreateRenderPass(hl->device, &ci, NULL, &out->render_pass));
+    }
+
+    // framebuffer
+    {
+        const VkFramebufferCreateInfo ci = {
+            VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+            NULL,
+            0,
+            out->render_pass,
+            1,
+            &out->target.view,
+            TARGET_SIZE,
+            TARGET_SIZE,
+            1,
+        };
+        CHECK_RETURN_VK(vkCreateFramebuffer(hl->device, &ci, NULL, &out->framebuffer));
+    }
+
+    // shaders
+    CHECK_RETURN_VK(create_shader_module(hl->device, "./draw.vert.spv", &out->vert_shader));
+    CHECK_RETURN_VK(create_shader_module(hl->device, "./draw.frag.spv", &out->frag_shader));
+
+    // descriptor set
+    {
+        const VkDescriptorSetLayoutBinding binds[] = {
+            {
+                0,
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                1,
+                VK_SHADER_STAGE_VERTEX_BIT,
+                NULL,
+            },
+        };
+        const VkDescriptorSetLayoutCreateInfo layout_ci = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            NULL,
+            0,
+            1,
+            binds,
+        };
+        CHECK_RETURN_VK(vkCreateDescriptorSetLayout(hl->device, &layout_ci, NULL, &out->descriptor_set_layout));
+        const VkDescriptorPoolSize pool_sizes[] = {
+            {
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                1,
+            },
+        };
+        const VkDescriptorPoolCreateInfo pool_ci = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            NULL,
+            0,
+            1,
+            1,
+            pool_sizes,
+        };
+        CHECK_RETURN_VK(vkCreateDescriptorPool(hl->device, &pool_ci, NULL, &out->descriptor_pool));
+        const VkDescriptorSetAllocateInfo ai = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            NULL,
+            out->descriptor_pool,
+            1,
+            &out->descriptor_set_layout,
+        };
+        CHECK_RETURN_VK(vkAllocateDescriptorSets(hl->device, &ai, &out->descriptor_set));
+        const VkDescriptorBufferInfo bi = {
+            draw_list->instances.buffer,
+            0,
+            VK_WHOLE_SIZE,
+        };
+        const VkWriteDescriptorSet write = {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            NULL,
+            out->descriptor_set,
+            0,
+            0,
+            1,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            NULL,
+            &bi,
+            NULL,
+        };
+        vkUpdateDescriptorSets(hl->device, 1, &write, 0, NULL);
+    }
+
+    // pipeline
+    {
+        const VkPipelineLayoutCreateInfo layout_ci = {
+            VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            NULL,
+            0,
+            1,
+            &out->descriptor_set_layout,
+            0,
+            NULL,
+        };
+        CHECK_RETURN_VK(vkCreatePipelineLayout(hl->device, &layout_ci, NULL, &out->pipeline_layout));
+        const VkPipelineShaderStageCreateInfo shader_cis[] = {
+            {
+                VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                NULL,
+                0,
+                VK_SHADER_STAGE_VERTEX_BIT,
+                out->vert_shader,
+                "main",
+                NULL,
+            },
+            {
+                VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                NULL,
+                0,
+                VK_SHADER_STAGE_FRAGMENT_BIT,
+                out->frag_shader,
+                "main",
+                NULL,
+            },
+        };
+        const VkVertexInputBindingDescription vert_inp_binding_dcs[] = {
+            { 0, sizeof(MeshVertex), VK_VERTEX_INPUT_RATE_VERTEX },
+        };
+        const VkVertexInputAttributeDescription vert_inp_attr_dcs[] = {
+            { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 },
+            { 1, 0, VK_FORMAT_R32G32_SFLOAT, sizeof(float) * 3 },
+        };
+        const VkPipelineVertexInputStateCreateInfo vert_inp_ci = {
+            VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+            NULL,
+            0,
+            1,
+            vert_inp_binding_dcs,
+            2,
+            vert_inp_attr_dcs,
+        };
+        const VkPipelineInputAssemblyStateCreateInfo inp_as_ci = {
+            VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+            NULL,
+            0,
+            VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+            VK_FALSE,
+        };
+        const VkViewport viewport = { 0.0f, 0.0f, TARGET_SIZE, TARGET_SIZE, 0.0f, 1.0f };
+        const VkRect2D scissor = { { 0, 0 }, { TARGET_SIZE, TARGET_SIZE } };
+        const VkPipelineViewportStateCreateInfo viewport_ci = {
+            VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+            NULL,
+            0,
+            1,
+            &viewport,
+            1,
+            &scissor,
+        };
+        const VkPipelineRasterizationStateCreateInfo raster_ci = {
+            VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+            NULL,
+            0,
+            VK_FALSE,
+            VK_FALSE,
+            VK_POLYGON_MODE_FILL,
+            VK_CULL_MODE_NONE,
+            VK_FRONT_FACE_COUNTER_CLOCKWISE,
+            VK_FALSE,
+            0.0f,
+            0.0f,
+            0.0f,
+            1.0f,
+        };
+        const VkPipelineMultisampleStateCreateInfo multisample_ci = {
+            VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+            NULL,
+            0,
+            VK_SAMPLE_COUNT_1_BIT,
+            VK_FALSE,
+            0.0f,
+            NULL,
+            VK_FALSE,
+            VK_FALSE,
+        };
+        const VkPipelineColorBlendAttachmentState color_blend_states[] = {
+            {
+                VK_FALSE,
+                VK_BLEND_FACTOR_ONE,
+                VK_BLEND_FACTOR_ZERO,
+                VK_BLEND_OP_ADD,
+                VK_BLEND_FACTOR_ONE,
+                VK_BLEND_FACTOR_ZERO,
+                VK_BLEND_OP_ADD,
+                VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+            },
+        };
+        const VkPipelineColorBlendStateCreateInfo color_blend_ci = {
+            VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+            NULL,
+            0,
+            VK_FALSE,
+            (VkLogicOp)0,
+            1,
+            color_blend_states,
+            { 0.0f, 0.0f, 0.0f, 0.0f },
+        };
+        const VkGraphicsPipelineCreateInfo ci = {
+            VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+            NULL,
+            0,
+            2,
+            shader_cis,
+            &vert_inp_ci,
+            &inp_as_ci,
+            NULL,
+            &viewport_ci,
+            &raster_ci,
+            &multisample_ci,
+            NULL,
+            &color_blend_ci,
+            NULL,
+            out->pipeline_layout,
+            out->render_pass,
+            0,
+            VK_NULL_HANDLE,
+            0,
+        };
+        CHECK_RETURN_VK(vkCreateGraphicsPipelines(hl->device, VK_NULL_HANDLE, 1, &ci, NULL, &out->pipeline));
+    }
+
+    // query pool
+    // NOTE: 描画の前後のタイムスタンプを一つずつ。
+    {
+        const VkQueryPoolCreateInfo ci = {
+            VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            NULL,
+            0,
+            VK_QUERY_TYPE_TIMESTAMP,
+            2,
+            0,
+        };
+        CHECK_RETURN_VK(vkCreateQueryPool(hl->device, &ci, NULL, &out->query_pool));
+    }
+
+    // command buffer
+    {
+        const VkCommandBufferAllocateInfo ai = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            NULL,
+            hl->command_pool,
+            VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            1,
+        };
+        CHECK_RETURN_VK(vkAllocateCommandBuffers(hl->device, &ai, &out->command));
+    }
+    return VK_SUCCESS;
+}
+
+static void destroy_scene(Headless *hl, Scene *scene) {
+    vkFreeCommandBuffers(hl->device, hl->command_pool, 1, &scene->command);
+    vkDestroyQueryPool(hl->device, scene->query_pool, NULL);
+    vkDestroyPipeline(hl->device, scene->pipeline, NULL);
+    vkDestroyPipelineLayout(hl->device, scene->pipeline_layout, NULL);
+    vkDestroyDescriptorPool(hl->device, scene->descriptor_pool, NULL);
+    vkDestroyDescriptorSetLayout(hl->device, scene->descriptor_set_layout, NULL);
+    vkDestroyShaderModule(hl->device, scene->frag_shader, NULL);
+    vkDestroyShaderModule(hl->device, scene->vert_shader, NULL);
+    vkDestroyFramebuffer(hl->device, scene->framebuffer, NULL);
+    vkDestroyRenderPass(hl->device, scene->render_pass, NULL);
+    destroy_texture(hl->device, &scene->target);
+}
+
+// FRAME_CNTフレームを描き、フレームあたりの記録時間と実行時間の平均を返す。
+static VkResult run(
+    Headless *hl,
+    const Scene *scene,
+    const GeometryPool *pool,
+    const Model *model,
+    const DrawList *draw_list,
+    Mode mode,
+    uint32_t cnt,
+    const Instance *instances,
+    double *p_record_sec,
+    double *p_gpu_sec
+) {
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(hl->phys_device, &props);
+
+    // NOTE: 同じバッファを指すコピーで、間接描画の方法だけを切り替える。
+    DrawList list = *draw_list;
+    list.features.draw_indirect_count = mode == MODE_INDIRECT_COUNT;
+
+    double record_sec = 0.0;
+    double gpu_sec = 0.0;
+    for (uint32_t frame = 0; frame < FRAME_CNT; ++frame) {
+        const double start = now_sec();
+
+        // NOTE: どの方法でもインスタンスデータは書き込むので、その時間も含めて比べる。
+        reset_draw_list(&list);
+        for (uint32_t i = 0; i < cnt; ++i) {
+            CHECK_RETURN_VK(push_draw(&list, model, (const void *)&instances[i]));
+        }
+
+        const VkCommandBufferBeginInfo bi = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            NULL,
+            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+            NULL,
+        };
+        CHECK_RETURN_VK(vkBeginCommandBuffer(scene->command, &bi));
+        vkCmdResetQueryPool(scene->command, scene->query_pool, 0, 2);
+        vkCmdWriteTimestamp(scene->command, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, scene->query_pool, 0);
+        const VkClearValue clear_values[] = {
+            { SCREEN_CLEAR_RGBA },
+        };
+        const VkRenderPassBeginInfo rp_bi = {
+            VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+            NULL,
+            scene->render_pass,
+            scene->framebuffer,
+            { { 0, 0 }, { TARGET_SIZE, TARGET_SIZE } },
+            1,
+            clear_values,
+        };
+        vkCmdBeginRenderPass(scene->command, &rp_bi, VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdBindPipeline(scene->command, VK_PIPELINE_BIND_POINT_GRAPHICS, scene->pipeline);
+        const VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(scene->command, 0, 1, &pool->vertex.buffer, &offset);
+        vkCmdBindIndexBuffer(scene->command, pool->index.buffer, offset, pool->index_type);
+        vkCmdBindDescriptorSets(
+            scene->command,
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            scene->pipeline_layout,
+            0,
+            1,
+            &scene->descriptor_set,
+            0,
+            NULL
+        );
+        if (mode == MODE_DIRECT) {
+            for (uint32_t i = 0; i < cnt; ++i) {
+                vkCmdDrawIndexed(scene->command, model->index_cnt, 1, model->first_index, (int32_t)model->first_vertex, i);
+            }
+        } else {
+            cmd_draw_list(scene->command, &list);
+        }
+        vkCmdEndRenderPass(scene->command);
+        vkCmdWriteTimestamp(scene->command, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, scene->query_pool, 1);
+        CHECK_RETURN_VK(vkEndCommandBuffer(scene->command));
+        record_sec += now_sec() - start;
+
+        uint64_t value;
+        CHECK_RETURN_VK(submit_timeline(hl->queue, &hl->timeline, 1, &scene->command, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, &value));
+        CHECK_RETURN_VK(wait_timeline(hl->device, &hl->timeline, value, UINT64_MAX));
+        uint64_t timestamps[2];
+        CHECK_RETURN_VK(
+            vkGetQueryPoolResults(
+                hl->device,
+                scene->query_pool,
+                0,
+                2,
+                sizeof(timestamps),
+                (void *)timestamps,
+                sizeof(uint64_t),
+                VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT
+            )
+        );
+        gpu_sec += (double)(timestamps[1] - timestamps[0]) * (double)props.limits.timestampPeriod * 1e-9;
+    }
+    *p_record_sec = record_sec / FRAME_CNT;
+    *p_gpu_sec = gpu_sec / FRAME_CNT;
+    return VK_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+    const uint32_t cnt = argc > 1 ? (uint32_t)atoi(argv[1]) : 10000;
+    CHECK(cnt > 0, "invalid object count.");
+
+    Headless hl;
+    CHECK_VK(create_headless(&hl), "failed to create a headless environment.");
+    CHECK(hl.indirect_features.draw_indirect_first_instance, "drawIndirectFirstInstance is not supported.");
+
+    // model
+    GeometryPool pool;
+    CHECK_VK(
+        create_geometry_pool(hl.device, &hl.mem_prop, VERTEX_FORMAT_FLOAT32, VK_INDEX_TYPE_UINT16, 8, 36, &pool),
+        "failed to create a geometry pool."
+    );
+    UploadContext upload;
+    CHECK_VK(
+        create_upload_context(
+            hl.device,
+            &hl.mem_prop,
+            hl.queue,
+            hl.command_pool,
+            &hl.timeline,
+            &hl.deletion_queue,
+            UPLOAD_THRESHOLD,
+            &upload
+        ),
+        "failed to create an upload context."
+    );
+    Model cube;
+    {
+        const MeshVertex vtxs[8] = {
+            { { -0.5f, -0.5f, -0.5f }, { 0.0f, 0.0f } },
+            { {  0.5f, -0.5f, -0.5f }, { 1.0f, 0.0f } },
+            { {  0.5f,  0.5f, -0.5f }, { 1.0f, 1.0f } },
+            { { -0.5f,  0.5f, -0.5f }, { 0.0f, 1.0f } },
+            { { -0.5f, -0.5f,  0.5f }, { 1.0f, 1.0f } },
+            { {  0.5f, -0.5f,  0.5f }, { 0.0f, 1.0f } },
+            { {  0.5f,  0.5f,  0.5f }, { 0.0f, 0.0f } },
+            { { -0.5f,  0.5f,  0.5f }, { 1.0f, 0.0f } },
+        };
+        const uint32_t idxs[36] = {
+            0, 1, 2, 0, 2, 3,
+            5, 4, 7, 5, 7, 6,
+            4, 0, 3, 4, 3, 7,
+            1, 5, 6, 1, 6, 2,
+            3, 2, 6, 3, 6, 7,
+            4, 5, 1, 4, 1, 0,
+        };
+        CHECK_VK(upload_geometry(&upload, &pool, 8, (const void *)vtxs, 36, idxs, &cube), "failed to create a model.");
+    }
+    CHECK_VK(destroy_upload_context(&upload), "failed to submit uploads.");
+
+    // NOTE: オブジェクトを格子状に並べる。
+    Instance *instances = (Instance *)malloc(sizeof(Instance) * cnt);
+    CHECK(instances != NULL, "failed to allocate instances.");
+    uint32_t side = 1;
+    while (side * side < cnt)
+        side += 1;
+    for (uint32_t i = 0; i < cnt; ++i) {
+        const float step = 2.0f / (float)side;
+        const Instance instance = {
+            {
+                -1.0f + step * ((float)(i % side) + 0.5f),
+                -1.0f + step * ((float)(i / side) + 0.5f),
+                0.0f,
+                step * 0.8f,
+            },
+        };
+        instances[i] = instance;
+    }
+
+    DrawList draw_list;
+    CHECK_VK(
+        create_draw_list(hl.device, &hl.mem_prop, &hl.indirect_features, cnt, sizeof(Instance), &draw_list),
+        "failed to create a draw list."
+    );
+    Scene scene;
+    CHECK_VK(create_scene(&hl, &draw_list, &scene), "failed to create a scene.");
+
+    const VkBool32 multi = hl.indirect_features.multi_draw_indirect;
+    printf("objects       : %u\n", cnt);
+    printf("                    record        gpu   draw calls\n");
+    double record_sec, gpu_sec;
+    CHECK_VK(run(&hl, &scene, &pool, &cube, &draw_list, MODE_DIRECT, cnt, instances, &record_sec, &gpu_sec), "failed to run the direct benchmark.");
+    printf("direct        : %7.3f ms %7.3f ms %10u\n", record_sec * 1000.0, gpu_sec * 1000.0, cnt);
+    CHECK_VK(run(&hl, &scene, &pool, &cube, &draw_list, MODE_INDIRECT, cnt, instances, &record_sec, &gpu_sec), "failed to run the indirect benchmark.");
+    printf("indirect      : %7.3f ms %7.3f ms %10u\n", record_sec * 1000.0, gpu_sec * 1000.0, multi ? 1 : cnt);
+    if (hl.indirect_features.draw_indirect_count) {
+        CHECK_VK(
+            run(&hl, &scene, &pool, &cube, &draw_list, MODE_INDIRECT_COUNT, cnt, instances, &record_sec, &gpu_sec),
+            "failed to run the indirect count benchmark."
+        );
+        printf("indirect count: %7.3f ms %7.3f ms %10u\n", record_sec * 1000.0, gpu_sec * 1000.0, 1);
+    } else {
+        printf("indirect count: not supported\n");
+    }
+
+    destroy_scene(&hl, &scene);
+    destroy_draw_list(hl.device, &draw_list);
+    destroy_geometry_pool(hl.device, &pool);
+    free(instances);
+    destroy_headless(&hl);
+    return 0;
+}
@@ -0,0 +1,9 @@
+#version 450
+
+layout(location=0) in vec2 in_uv;
+
+layout(location=0) out vec4 out_color;
+
+void main() {
+    out_color = vec4(in_uv, 0.5, 1.0);
+}
@@ -0,0 +1,20 @@
+#version 450
+
+struct Instance {
+    vec4 trs; // NOTE: xyが位置、wが大きさ。
+};
+
+layout(std430, binding = 0) readonly buffer Instances {
+    Instance instances[];
+};
+
+layout(location=0) in vec3 in_pos;
+layout(location=1) in vec2 in_uv;
+
+layout(location=0) out vec2 out_uv;
+
+void main() {
+    vec4 trs = instances[gl_InstanceIndex].trs;
+    gl_Position = vec4(in_pos.xy * trs.w + trs.xy, 0.5, 1.0);
+    out_uv = in_uv;
+}
@@ -0,0 +1,123 @@
+#include "bench.h"
+
+VkResult create_headless(Headless *out) {
+    // instance
+    {
+        const VkApplicationInfo ai = {
+            VK_STRUCTURE_TYPE_APPLICATION_INFO,
+            NULL,
+            "VulkanBenchmark\0",
+            0,
+            "VulkanBenchmark\0",
+            VK_MAKE_VERSION(1, 0, 0),
+            VK_API_VERSION_1_2,
+        };
+        const char *layer_names[] = INST_LAYER_NAMES;
+        const VkInstanceCreateInfo ci = {
+            VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+            NULL,
+            0,
+            &ai,
+            INST_LAYER_NAMES_CNT,
+            layer_names,
+            0,
+            NULL,
+        };
+        CHECK_RETURN_VK(vkCreateInstance(&ci, NULL, &out->instance));
+    }
+
+    // physical device
+    {
+        uint32_t cnt = 0;
+        CHECK_RETURN_VK(vkEnumeratePhysicalDevices(out->instance, &cnt, NULL));
+        CHECK_RETURN(cnt > 0);
+        VkPhysicalDevice *phys_devices = (VkPhysicalDevice *)malloc(sizeof(VkPhysicalDevice) * cnt);
+        CHECK_RETURN_VK(vkEnumeratePhysicalDevices(out->instance, &cnt, phys_devices));
+        out->phys_device = phys_devices[0];
+        vkGetPhysicalDeviceMemoryProperties(out->phys_device, &out->mem_prop);
+        get_indirect_features(out->phys_device, &out->indirect_features);
+        free(phys_devices);
+    }
+
+    // queue family index
+    {
+        uint32_t cnt = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(out->phys_device, &cnt, NULL);
+        VkQueueFamilyProperties *props = (VkQueueFamilyProperties *)malloc(sizeof(VkQueueFamilyProperties) * cnt);
+        vkGetPhysicalDeviceQueueFamilyProperties(out->phys_device, &cnt, props);
+        int32_t index = -1;
+        for (int32_t i = 0; i < cnt; ++i) {
+            if ((props[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) > 0) {
+                index = i;
+                break;
+            }
+        }
+        free(props);
+        CHECK_RETURN(index >= 0);
+        out->queue_family_index = (uint32_t)index;
+    }
+
+    // device
+    {
+        const float queue_priorities[] = { 1.0 };
+        const VkDeviceQueueCreateInfo queue_cis[] = {
+            {
+                VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+                NULL,
+                0,
+                out->queue_family_index,
+                1,
+                queue_priorities,
+            },
+        };
+        VkPhysicalDeviceVulkan12Features features12 = { 0 };
+        features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        features12.timelineSemaphore = VK_TRUE;
+        features12.drawIndirectCount = out->indirect_features.draw_indirect_count;
+        VkPhysicalDeviceFeatures features = { 0 };
+        features.multiDrawIndirect = out->indirect_features.multi_draw_indirect;
+        features.drawIndirectFirstInstance = out->indirect_features.draw_indirect_first_instance;
+        const VkDeviceCreateInfo ci = {
+            VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+            &features12,
+            0,
+            1,
+            queue_cis,
+            0,
+            NULL,
+            0,
+            NULL,
+            &features,
+        };
+        CHECK_RETURN_VK(vkCreateDevice(out->phys_device, &ci, NULL, &out->device));
+    }
+
+    // queue
+    vkGetDeviceQueue(out->device, out->queue_family_index, 0, &out->queue);
+
+    // command pool
+    {
+        const VkCommandPoolCreateInfo ci = {
+            VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            NULL,
+            VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+            out->queue_family_index,
+        };
+        CHECK_RETURN_VK(vkCreateCommandPool(out->device, &ci, NULL, &out->command_pool));
+    }
+
+    // timeline
+    CHECK_RETURN_VK(create_timeline(out->device, &out->timeline));
+    out->deletion_queue = (DeletionQueue){ 0 };
+
+    return VK_SUCCESS;
+}
+
+void destroy_headless(Headless *headless) {
+    wait_timeline(headless->device, &headless->timeline, headless->timeline.value, UINT64_MAX);
+    flush_deletion_queue(headless->device, &headless->deletion_queue);
+    vkDestroySemaphore(headless->device, headless->timeline.semaphore, NULL);
+    vkDestroyCommandPool(headless->device, headless->command_pool, NULL);
+    vkDestroyDevice(headless->device, NULL);
+    vkDestroyInstance(headless->instance, NULL);
+}
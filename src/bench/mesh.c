@@ -0,0 +1,74 @@
+// メッシュファイルを読み込み、GPUへの転送が完了するまでの時間を計るベンチマーク。
+//
+//   $ ./a.out [--format=float32|half|snorm16] <メッシュファイル>...
+//
+// ファイルごとに、100万三角形あたりの読み込み時間を表示する。
+// --formatで頂点の形式を選ぶ。バッファの合計サイズは、create_mesh_from_fileが表示する転送量と等しい。
+// 同じメッシュのglTF/OBJとベイク済みメッシュ(.bmesh)を並べて与えると比較できる。
+// 解析とステージングバッファへの書き込みの速度は、create_mesh_from_fileがファイルごとに表示する。
+
+#include "bench.h"
+
+#include <string.h>
+
+int main(int argc, char **argv) {
+    int first = 1;
+    VertexFormat vertex_format = VERTEX_FORMAT_FLOAT32;
+    if (argc > 1 && strncmp(argv[1], "--format=", 9) == 0) {
+        const char *name = argv[1] + 9;
+        if (strcmp(name, "half") == 0)
+            vertex_format = VERTEX_FORMAT_HALF;
+        else if (strcmp(name, "snorm16") == 0)
+            vertex_format = VERTEX_FORMAT_SNORM16;
+        else
+            CHECK(strcmp(name, "float32") == 0, "unknown vertex format.");
+        first = 2;
+    }
+    CHECK(argc > first, "no mesh file specified.");
+
+    Headless hl;
+    CHECK_VK(create_headless(&hl), "failed to create a headless environment.");
+    UploadContext upload;
+    CHECK_VK(
+        create_upload_context(
+            hl.device,
+            &hl.mem_prop,
+            hl.queue,
+            hl.command_pool,
+            &hl.timeline,
+            &hl.deletion_queue,
+            UPLOAD_THRESHOLD,
+            &upload
+        ),
+        "failed to create an upload context."
+    );
+
+    // NOTE: ファイルごとに、読み込みから転送の完了までを計る。
+    for (int i = first; i < argc; ++i) {
+        Mesh mesh;
+        const double start = now_sec();
+        CHECK_VK(create_mesh_from_file(hl.device, &hl.mem_prop, &upload, argv[i], vertex_format, &mesh), "failed to load a mesh.");
+        uint64_t value;
+        CHECK_VK(flush_upload_context(&upload, &value), "failed to submit uploads.");
+        CHECK_VK(wait_timeline(hl.device, &hl.timeline, value, UINT64_MAX), "failed to wait for uploads.");
+        const double sec = now_sec() - start;
+        collect_deletion_queue(hl.device, &hl.deletion_queue, value);
+
+        uint64_t triangle_cnt = 0;
+        for (uint32_t j = 0; j < mesh.model_cnt; ++j) {
+            triangle_cnt += mesh.models[j].index_cnt / 3;
+        }
+        printf(
+            "%s: %llu triangles, %10.3f ms, %10.3f ms per million triangles\n",
+            argv[i],
+            (unsigned long long)triangle_cnt,
+            sec * 1000.0,
+            triangle_cnt > 0 ? sec * 1000.0 * 1e6 / (double)triangle_cnt : 0.0
+        );
+        destroy_mesh(hl.device, &mesh);
+    }
+
+    CHECK_VK(destroy_upload_context(&upload), "failed to destroy the upload context.");
+    destroy_headless(&hl);
+    return 0;
+}
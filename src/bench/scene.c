@@ -0,0 +1,91 @@
+// シーングラフの更新を、全ノードを計算し直す場合と変わった部分木だけを計算し直す場合とで比較するベンチマーク。
+//
+//   $ ./a.out [ノード数]
+//
+// 各ノードが4つの子を持つ木を作る。
+//   - full: 根を動かし、すべてのノードを計算し直す
+//   - partial: 葉を100個おきに動かし、そのノードだけを計算し直す
+// それぞれジョブシステムなし・ありで、ITER_CNT回の平均を表示する。デバイスは使わない。
+
+#include "bench.h"
+
+#include <string.h>
+
+#define ITER_CNT 32
+#define BRANCH_CNT 4
+
+typedef enum Mode_t {
+    MODE_FULL,
+    MODE_PARTIAL,
+} Mode;
+
+// 一回分の変更を加えて更新し、ITER_CNT回の平均の時間を返す関数。
+static void run(JobSystem *jobs, SceneGraph *graph, Mode mode, double *p_sec, uint32_t *p_updated_cnt) {
+    const float scl[3] = { 1.0f, 1.0f, 1.0f };
+    const float trs[3] = { 1.0f, 0.0f, 0.0f };
+    double sec = 0.0;
+    uint32_t updated = 0;
+    for (uint32_t i = 0; i < ITER_CNT; ++i) {
+        const float rot[3] = { 0.01f * (float)i, 0.0f, 0.0f };
+        // NOTE: 印を付けるのは計測の外で行う。
+        if (mode == MODE_FULL) {
+            set_scene_node(graph, 0, scl, rot, trs);
+        } else {
+            // NOTE: 末尾の1/BRANCH_CNTは葉なので、そこから100個おきに選ぶ。
+            for (uint32_t k = 0; k * 100 < graph->cnt / BRANCH_CNT; ++k) {
+                set_scene_node(graph, graph->cnt - 1 - k * 100, scl, rot, trs);
+            }
+        }
+        const double start = now_sec();
+        updated = update_scene_graph(jobs, graph);
+        sec += now_sec() - start;
+    }
+    *p_sec = sec / (double)ITER_CNT;
+    *p_updated_cnt = updated;
+}
+
+int main(int argc, char **argv) {
+    const uint32_t cnt = argc > 1 ? (uint32_t)atoi(argv[1]) : 100000;
+    CHECK(cnt > 0, "invalid node count.");
+
+    // NOTE: ノードiの親は(i - 1) / BRANCH_CNTとする。親は必ず子より前にある。
+    SceneGraph graph;
+    CHECK_VK(create_scene_graph(cnt, &graph), "failed to create a scene graph.");
+    const float scl[3] = { 1.0f, 1.0f, 1.0f };
+    const float rot[3] = { 0.0f, 0.0f, 0.0f };
+    const float trs[3] = { 1.0f, 0.0f, 0.0f };
+    for (uint32_t i = 0; i < cnt; ++i) {
+        const uint32_t parent = i == 0 ? SCENE_NO_PARENT : (i - 1) / BRANCH_CNT;
+        CHECK_VK(add_scene_node(&graph, parent, scl, rot, trs, NULL), "failed to add a node.");
+    }
+    update_scene_graph(NULL, &graph);
+
+    JobSystem jobs;
+    CHECK_VK(create_job_system(0, &jobs), "failed to create a job system.");
+
+    printf("nodes          : %u (%u levels)\n", cnt, graph.level_cnt);
+    printf("threads        : %u + 1\n", jobs.thread_cnt);
+    printf("                     time    updated\n");
+    double sec;
+    uint32_t updated;
+    run(NULL, &graph, MODE_FULL, &sec, &updated);
+    printf("full           : %7.3f ms %10u\n", sec * 1000.0, updated);
+
+    // NOTE: 並列に計算しても、結果は一つのスレッドで計算したものと同じになる。
+    float (*expected)[16] = (float (*)[16])malloc(sizeof(float) * 16 * cnt);
+    CHECK(expected != NULL, "failed to allocate matrices.");
+    memcpy(expected, graph.worlds, sizeof(float) * 16 * cnt);
+    run(&jobs, &graph, MODE_FULL, &sec, &updated);
+    printf("full + jobs    : %7.3f ms %10u\n", sec * 1000.0, updated);
+    CHECK(memcmp(expected, graph.worlds, sizeof(float) * 16 * cnt) == 0, "job result differs from serial one.");
+    free(expected);
+
+    run(NULL, &graph, MODE_PARTIAL, &sec, &updated);
+    printf("partial        : %7.3f ms %10u\n", sec * 1000.0, updated);
+    run(&jobs, &graph, MODE_PARTIAL, &sec, &updated);
+    printf("partial + jobs : %7.3f ms %10u\n", sec * 1000.0, updated);
+
+    destroy_job_system(&jobs);
+    destroy_scene_graph(&graph);
+    return 0;
+}
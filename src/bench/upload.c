@@ -0,0 +1,134 @@
+// テクスチャのセットアップ時間を、1枚ずつ提出して待つ場合とまとめて提出する場合とで比較するベンチマーク。
+//
+//   $ ./a.out [テクスチャ数] [画像ファイル]
+//
+// 画像ファイルを省略すると、256x256のRGBA画像をメモリ上で生成して使う(デコード時間を含めないため)。
+// 両方を一度ずつ測らずに流した後、順番を入れ替えながらITER_CNT回ずつ測り、平均を表示する。
+
+#include "bench.h"
+
+#include <string.h>
+
+#define SYNTHETIC_SIZE 256
+#define ITER_CNT 8
+
+static VkResult create_synthetic_texture(Headless *hl, UploadContext *upload, const uint8_t *pixels, Texture *out) {
+    const VkDeviceSize size = SYNTHETIC_SIZE * SYNTHETIC_SIZE * 4;
+    void *p;
+    VkDeviceSize offset;
+    CHECK_RETURN_VK(reserve_upload(upload, size, 16, &p, &offset));
+    memcpy(p, pixels, size);
+    CHECK_RETURN_VK(
+        create_texture(
+            hl->device,
+            &hl->mem_prop,
+            VK_FORMAT_R8G8B8A8_UNORM,
+            SYNTHETIC_SIZE,
+            SYNTHETIC_SIZE,
+            1,
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_IMAGE_ASPECT_COLOR_BIT,
+            NULL,
+            out
+        )
+    );
+    const VkBufferImageCopy region = {
+        0,
+        0,
+        0,
+        { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+        { 0, 0, 0 },
+        { SYNTHETIC_SIZE, SYNTHETIC_SIZE, 1 },
+    };
+    return upload_image(upload, offset, out->image, 1, 1, &region, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
+
+// cnt枚のテクスチャを作成し、すべての転送が完了するまでの時間を返す。
+//   - batched: VK_FALSEなら1枚ごとに提出して完了を待つ(以前のcreate_image_texture_from_fileと同じ)
+static VkResult run(Headless *hl, uint32_t cnt, const char *path, const uint8_t *pixels, VkBool32 batched, Texture *textures, double *p_sec) {
+    // NOTE: 1枚ずつのときは閾値を0にして、以前と同じくテクスチャの大きさだけのステージングバッファを作らせる。
+    UploadContext upload;
+    CHECK_RETURN_VK(
+        create_upload_context(
+            hl->device,
+            &hl->mem_prop,
+            hl->queue,
+            hl->command_pool,
+            &hl->timeline,
+            &hl->deletion_queue,
+            batched ? UPLOAD_THRESHOLD : 0,
+            &upload
+        )
+    );
+
+    const double start = now_sec();
+    for (uint32_t i = 0; i < cnt; ++i) {
+        if (path != NULL) {
+            CHECK_RETURN_VK(create_image_texture_from_file(hl->device, &hl->mem_prop, &upload, path, &textures[i]));
+        } else {
+            CHECK_RETURN_VK(create_synthetic_texture(hl, &upload, pixels, &textures[i]));
+        }
+        if (!batched) {
+            uint64_t value;
+            CHECK_RETURN_VK(flush_upload_context(&upload, &value));
+            CHECK_RETURN_VK(wait_timeline(hl->device, &hl->timeline, value, UINT64_MAX));
+            collect_deletion_queue(hl->device, &hl->deletion_queue, value);
+        }
+    }
+    uint64_t value;
+    CHECK_RETURN_VK(flush_upload_context(&upload, &value));
+    CHECK_RETURN_VK(wait_timeline(hl->device, &hl->timeline, value, UINT64_MAX));
+    collect_deletion_queue(hl->device, &hl->deletion_queue, value);
+    *p_sec = now_sec() - start;
+
+    CHECK_RETURN_VK(destroy_upload_context(&upload));
+    for (uint32_t i = 0; i < cnt; ++i) {
+        destroy_texture(hl->device, &textures[i]);
+    }
+    return VK_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+    const uint32_t cnt = argc > 1 ? (uint32_t)atoi(argv[1]) : 1000;
+    const char *path = argc > 2 ? argv[2] : NULL;
+    CHECK(cnt > 0, "invalid texture count.");
+
+    Headless hl;
+    CHECK_VK(create_headless(&hl), "failed to create a headless environment.");
+
+    uint8_t *pixels = (uint8_t *)malloc(SYNTHETIC_SIZE * SYNTHETIC_SIZE * 4);
+    for (uint32_t i = 0; i < SYNTHETIC_SIZE * SYNTHETIC_SIZE * 4; ++i) {
+        pixels[i] = (uint8_t)(i * 31);
+    }
+    Texture *textures = (Texture *)malloc(sizeof(Texture) * cnt);
+
+    // NOTE: 最初の実行はドライバの初期化やページフォルトの分だけ遅くなるので、両方を一度流して結果は捨てる。
+    // NOTE: 後に走る方がキャッシュなどで得をしないよう、測るたびに順番を入れ替える。
+    double sec;
+    CHECK_VK(run(&hl, cnt, path, pixels, VK_FALSE, textures, &sec), "failed to run the per-texture benchmark.");
+    CHECK_VK(run(&hl, cnt, path, pixels, VK_TRUE, textures, &sec), "failed to run the batched benchmark.");
+    double before = 0.0;
+    double after = 0.0;
+    for (uint32_t i = 0; i < ITER_CNT; ++i) {
+        for (uint32_t k = 0; k < 2; ++k) {
+            const VkBool32 batched = (i + k) % 2 == 1;
+            CHECK_VK(run(&hl, cnt, path, pixels, batched, textures, &sec), "failed to run the upload benchmark.");
+            if (batched)
+                after += sec;
+            else
+                before += sec;
+        }
+    }
+    before /= (double)ITER_CNT;
+    after /= (double)ITER_CNT;
+
+    printf("textures            : %u (%s)\n", cnt, path != NULL ? path : "synthetic 256x256 RGBA");
+    printf("submit and wait each: %10.3f ms\n", before * 1000.0);
+    printf("batched             : %10.3f ms\n", after * 1000.0);
+    printf("speedup             : %10.2fx\n", before / after);
+
+    free(textures);
+    free(pixels);
+    destroy_headless(&hl);
+    return 0;
+}
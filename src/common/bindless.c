@@ -0,0 +1,171 @@
+#include "vulkan-tutorial.h"
+
+#define BINDLESS_BINDING_CNT 2
+
+VkBool32 is_bindless_supported(const VkPhysicalDevice phys_device, uint32_t capacity) {
+    VkPhysicalDeviceVulkan12Features features12 = { 0 };
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 features = { 0 };
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &features12;
+    vkGetPhysicalDeviceFeatures2(phys_device, &features);
+    if (
+        !features12.runtimeDescriptorArray
+            || !features12.descriptorBindingPartiallyBound
+            || !features12.descriptorBindingSampledImageUpdateAfterBind
+            || !features12.descriptorBindingUpdateUnusedWhilePending
+            || !features12.shaderSampledImageArrayNonUniformIndexing
+    ) {
+        return VK_FALSE;
+    }
+    // NOTE: update-after-bindのディスクリプタには、通常とは別の上限がある。
+    VkPhysicalDeviceDescriptorIndexingProperties indexing_prop = { 0 };
+    indexing_prop.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+    VkPhysicalDeviceProperties2 prop = { 0 };
+    prop.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    prop.pNext = &indexing_prop;
+    vkGetPhysicalDeviceProperties2(phys_device, &prop);
+    return indexing_prop.maxPerStageDescriptorUpdateAfterBindSampledImages >= capacity
+        && indexing_prop.maxDescriptorSetUpdateAfterBindSampledImages >= capacity;
+}
+
+void enable_bindless_features(VkPhysicalDeviceVulkan12Features *features12) {
+    features12->runtimeDescriptorArray = VK_TRUE;
+    features12->descriptorBindingPartiallyBound = VK_TRUE;
+    features12->descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    features12->descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    features12->shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+}
+
+VkResult create_bindless_table(const VkDevice device, uint32_t capacity, const VkSampler sampler, BindlessTable *out) {
+    CHECK_RETURN(capacity > 0);
+    out->capacity = capacity;
+    out->cnt = 0;
+    out->free_cnt = 0;
+    out->free_slots = (uint32_t *)malloc(sizeof(uint32_t) * capacity);
+    CHECK_RETURN(out->free_slots != NULL);
+
+    // descriptor set layout
+    // NOTE: テクスチャの配列は、使っていない枠があってもよく(partially bound)、バインドした後でも書き換えられる(update after bind)。
+    // NOTE: 提出済みのコマンドが使わない枠なら、実行中でも書き換えられる(update unused while pending)。
+    // NOTE: サンプラはすべてのテクスチャで共有し、レイアウトに埋め込む。
+    {
+        const VkDescriptorSetLayoutBinding binds[BINDLESS_BINDING_CNT] = {
+            {
+                0,
+                VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+                capacity,
+                VK_SHADER_STAGE_ALL,
+                NULL,
+            },
+            {
+                1,
+                VK_DESCRIPTOR_TYPE_SAMPLER,
+                1,
+                VK_SHADER_STAGE_ALL,
+                &sampler,
+            },
+        };
+        const VkDescriptorBindingFlags bind_flags[BINDLESS_BINDING_CNT] = {
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+                | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+                | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT,
+            0,
+        };
+        const VkDescriptorSetLayoutBindingFlagsCreateInfo flags_ci = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+            NULL,
+            BINDLESS_BINDING_CNT,
+            bind_flags,
+        };
+        const VkDescriptorSetLayoutCreateInfo ci = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            &flags_ci,
+            VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+            BINDLESS_BINDING_CNT,
+            binds,
+        };
+        CHECK_RETURN_VK(vkCreateDescriptorSetLayout(device, &ci, NULL, &out->descriptor_set_layout));
+    }
+
+    // descriptor pool and set
+    // NOTE: セットは一つだけで、アプリケーションの終わりまで使い続ける。
+    {
+        const VkDescriptorPoolSize pool_sizes[] = {
+            {
+                VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+                capacity,
+            },
+            {
+                VK_DESCRIPTOR_TYPE_SAMPLER,
+                1,
+            },
+        };
+        const VkDescriptorPoolCreateInfo ci = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            NULL,
+            VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+            1,
+            2,
+            pool_sizes,
+        };
+        CHECK_RETURN_VK(vkCreateDescriptorPool(device, &ci, NULL, &out->descriptor_pool));
+        const VkDescriptorSetAllocateInfo ai = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            NULL,
+            out->descriptor_pool,
+            1,
+            &out->descriptor_set_layout,
+        };
+        CHECK_RETURN_VK(vkAllocateDescriptorSets(device, &ai, &out->descriptor_set));
+    }
+    return VK_SUCCESS;
+}
+
+VkResult register_bindless_texture(const VkDevice device, BindlessTable *table, const VkImageView view, uint32_t *p_slot) {
+    // NOTE: 空いた枠があればそれを使い、なければ末尾から取る。
+    uint32_t slot;
+    if (table->free_cnt > 0) {
+        table->free_cnt -= 1;
+        slot = table->free_slots[table->free_cnt];
+    } else {
+        CHECK_RETURN(table->cnt < table->capacity);
+        slot = table->cnt;
+        table->cnt += 1;
+    }
+    const VkDescriptorImageInfo ii = {
+        VK_NULL_HANDLE,
+        view,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    };
+    const VkWriteDescriptorSet write = {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        NULL,
+        table->descriptor_set,
+        0,
+        slot,
+        1,
+        VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+        &ii,
+        NULL,
+        NULL,
+    };
+    vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+    *p_slot = slot;
+    return VK_SUCCESS;
+}
+
+void unregister_bindless_texture(BindlessTable *table, uint32_t slot) {
+    // NOTE: ディスクリプタは書き換えずに残す。次に登録されるまで、シェーダが読まない限り問題ない。
+    // NOTE: すぐに空きに戻すので、使用中かもしれなければdefer_unregister_bindless_textureを使う。
+    table->free_slots[table->free_cnt] = slot;
+    table->free_cnt += 1;
+}
+
+void destroy_bindless_table(const VkDevice device, BindlessTable *table) {
+    // NOTE: セットはプールとともに解放される。
+    vkDestroyDescriptorPool(device, table->descriptor_pool, NULL);
+    vkDestroyDescriptorSetLayout(device, table->descriptor_set_layout, NULL);
+    free(table->free_slots);
+    table->free_slots = NULL;
+}
@@ -2,13 +2,14 @@
 
 #include <string.h>
 
-static int32_t get_memory_type_index(
+int32_t get_memory_type_index(
     const VkPhysicalDeviceMemoryProperties *mem_prop,
     const VkMemoryRequirements *reqs,
     VkMemoryPropertyFlags flags
 ) {
+    // NOTE: 求めたフラグをすべて持つタイプを選ぶ。一つでも欠けると、永続的なマップが失敗したり書き込みがコヒーレントでなかったりする。
     for (int32_t i = 0; i < mem_prop->memoryTypeCount; ++i) {
-        if ((reqs->memoryTypeBits & (1 << i)) && (mem_prop->memoryTypes[i].propertyFlags & flags)) {
+        if ((reqs->memoryTypeBits & (1 << i)) && (mem_prop->memoryTypes[i].propertyFlags & flags) == flags) {
             return i;
         }
     }
@@ -60,8 +61,10 @@ VkResult create_texture(
     VkFormat format,
     uint32_t width,
     uint32_t height,
+    uint32_t mip_levels,
     VkImageUsageFlags usage,
     VkImageAspectFlags aspect,
+    const VkComponentMapping *components,
     Texture *out
 ) {
     // NOTE: イメージを作る。
@@ -73,7 +76,7 @@ VkResult create_texture(
             VK_IMAGE_TYPE_2D,
             format,
             { width, height, 1 },
-            1,
+            mip_levels,
             1,
             VK_SAMPLE_COUNT_1_BIT,
             VK_IMAGE_TILING_OPTIMAL,
@@ -102,6 +105,12 @@ VkResult create_texture(
 
     // NOTE: イメージビューを作る。
     {
+        const VkComponentMapping identity = {
+            VK_COMPONENT_SWIZZLE_R,
+            VK_COMPONENT_SWIZZLE_G,
+            VK_COMPONENT_SWIZZLE_B,
+            VK_COMPONENT_SWIZZLE_A,
+        };
         const VkImageViewCreateInfo ci = {
             VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
             NULL,
@@ -109,13 +118,8 @@ VkResult create_texture(
             out->image,
             VK_IMAGE_VIEW_TYPE_2D,
             format,
-            {
-                VK_COMPONENT_SWIZZLE_R,
-                VK_COMPONENT_SWIZZLE_G,
-                VK_COMPONENT_SWIZZLE_B,
-                VK_COMPONENT_SWIZZLE_A,
-            },
-            { aspect, 0, 1, 0, 1 },
+            components != NULL ? *components : identity,
+            { aspect, 0, mip_levels, 0, 1 },
         };
         CHECK_RETURN_VK(vkCreateImageView(device, &ci, NULL, &out->view));
     }
@@ -123,6 +127,18 @@ VkResult create_texture(
     return VK_SUCCESS;
 }
 
+VkSampleCountFlagBits get_max_sample_count(const VkPhysicalDevice phys_device, VkSampleCountFlagBits requested) {
+    VkPhysicalDeviceProperties prop;
+    vkGetPhysicalDeviceProperties(phys_device, &prop);
+    const VkSampleCountFlags counts = prop.limits.framebufferColorSampleCounts & prop.limits.framebufferDepthSampleCounts;
+    // NOTE: サンプル数のビットは値そのものなので、requestedから半分ずつ下げて探す。1サンプルはどのデバイスでも使える。
+    for (uint32_t bit = (uint32_t)requested; bit > 1; bit >>= 1) {
+        if (counts & bit)
+            return (VkSampleCountFlagBits)bit;
+    }
+    return VK_SAMPLE_COUNT_1_BIT;
+}
+
 VkResult map_memory(const VkDevice device, const VkDeviceMemory device_memory, const void *data, int32_t size) {
     void *p;
     CHECK_RETURN_VK(vkMapMemory(device, device_memory, 0, VK_WHOLE_SIZE, 0, &p));
@@ -131,6 +147,32 @@ VkResult map_memory(const VkDevice device, const VkDeviceMemory device_memory, c
     return VK_SUCCESS;
 }
 
+VkResult create_mapped_buffer(
+    const VkDevice device,
+    const VkPhysicalDeviceMemoryProperties *mem_prop,
+    VkDeviceSize size,
+    VkBufferUsageFlags usage,
+    Buffer *out,
+    void **p_mapped
+) {
+    CHECK_RETURN_VK(
+        create_buffer(
+            device,
+            mem_prop,
+            size,
+            usage,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            out
+        )
+    );
+    const VkResult res = vkMapMemory(device, out->memory, 0, VK_WHOLE_SIZE, 0, p_mapped);
+    if (res != VK_SUCCESS) {
+        destroy_buffer(device, out);
+        return res;
+    }
+    return VK_SUCCESS;
+}
+
 VkResult create_model(
     const VkDevice device,
     const VkPhysicalDeviceMemoryProperties *mem_prop,
@@ -140,8 +182,22 @@ VkResult create_model(
     const uint32_t *idxs,
     Model *out
 ) {
+    // NOTE: 頂点数は分からないので、インデックスの最大値から型を選ぶ。
+    uint32_t max_index = 0;
+    for (uint32_t i = 0; i < index_cnt; ++i) {
+        max_index = idxs[i] > max_index ? idxs[i] : max_index;
+    }
     out->index_cnt = index_cnt;
-    const size_t idxs_size = sizeof(uint32_t) * index_cnt;
+    out->index_type = max_index < 0xFFFF ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    out->vertex_cnt = 0;
+    out->first_vertex = 0;
+    out->first_index = 0;
+    for (uint32_t i = 0; i < 3; ++i) {
+        out->pos_scale[i] = 1.0f;
+        out->pos_offset[i] = 0.0f;
+    }
+    const size_t index_size = out->index_type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    const size_t idxs_size = index_size * index_cnt;
     CHECK_RETURN_VK(
         create_buffer(
             device,
@@ -163,5 +219,32 @@ VkResult create_model(
         )
     );
     CHECK_RETURN_VK(map_memory(device, out->vertex.memory, (void *)vtxs, vtxs_size));
-    CHECK_RETURN_VK(map_memory(device, out->index.memory, (void *)idxs, idxs_size));
+    if (out->index_type == VK_INDEX_TYPE_UINT32) {
+        CHECK_RETURN_VK(map_memory(device, out->index.memory, (void *)idxs, idxs_size));
+        return VK_SUCCESS;
+    }
+    uint16_t *narrow = (uint16_t *)malloc(idxs_size);
+    CHECK_RETURN(narrow != NULL);
+    for (uint32_t i = 0; i < index_cnt; ++i) {
+        narrow[i] = (uint16_t)idxs[i];
+    }
+    const VkResult res = map_memory(device, out->index.memory, (void *)narrow, idxs_size);
+    free(narrow);
+    return res;
+}
+
+void destroy_buffer(const VkDevice device, const Buffer *buffer) {
+    vkFreeMemory(device, buffer->memory, NULL);
+    vkDestroyBuffer(device, buffer->buffer, NULL);
+}
+
+void destroy_texture(const VkDevice device, const Texture *texture) {
+    vkFreeMemory(device, texture->memory, NULL);
+    vkDestroyImageView(device, texture->view, NULL);
+    vkDestroyImage(device, texture->image, NULL);
+}
+
+void destroy_model(const VkDevice device, const Model *model) {
+    destroy_buffer(device, &model->vertex);
+    destroy_buffer(device, &model->index);
 }
@@ -0,0 +1,310 @@
+#include "vulkan-tutorial.h"
+
+#include <string.h>
+
+#define MAX_MIP_LEVELS 16
+
+// 圧縮フォーマットのブロックの情報。
+typedef struct BlockInfo_t {
+    VkFormat format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t bytes;
+} BlockInfo;
+
+// NOTE: 読み込みに対応するフォーマットの一覧。
+// NOTE: BCnはデスクトップ、ETC2とASTCはモバイルのGPUで広く対応している。
+static const BlockInfo BLOCK_INFOS[] = {
+    { VK_FORMAT_R8G8B8A8_UNORM, 1, 1, 4 },
+    { VK_FORMAT_R8G8B8A8_SRGB, 1, 1, 4 },
+    { VK_FORMAT_BC1_RGB_UNORM_BLOCK, 4, 4, 8 },
+    { VK_FORMAT_BC1_RGB_SRGB_BLOCK, 4, 4, 8 },
+    { VK_FORMAT_BC1_RGBA_UNORM_BLOCK, 4, 4, 8 },
+    { VK_FORMAT_BC1_RGBA_SRGB_BLOCK, 4, 4, 8 },
+    { VK_FORMAT_BC2_UNORM_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_BC2_SRGB_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_BC3_UNORM_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_BC3_SRGB_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_BC4_UNORM_BLOCK, 4, 4, 8 },
+    { VK_FORMAT_BC4_SNORM_BLOCK, 4, 4, 8 },
+    { VK_FORMAT_BC5_UNORM_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_BC5_SNORM_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_BC6H_UFLOAT_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_BC6H_SFLOAT_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_BC7_UNORM_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_BC7_SRGB_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, 4, 4, 8 },
+    { VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK, 4, 4, 8 },
+    { VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK, 4, 4, 8 },
+    { VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK, 4, 4, 8 },
+    { VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_EAC_R11_UNORM_BLOCK, 4, 4, 8 },
+    { VK_FORMAT_EAC_R11_SNORM_BLOCK, 4, 4, 8 },
+    { VK_FORMAT_EAC_R11G11_UNORM_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_EAC_R11G11_SNORM_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_ASTC_4x4_UNORM_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_ASTC_4x4_SRGB_BLOCK, 4, 4, 16 },
+    { VK_FORMAT_ASTC_5x4_UNORM_BLOCK, 5, 4, 16 },
+    { VK_FORMAT_ASTC_5x4_SRGB_BLOCK, 5, 4, 16 },
+    { VK_FORMAT_ASTC_5x5_UNORM_BLOCK, 5, 5, 16 },
+    { VK_FORMAT_ASTC_5x5_SRGB_BLOCK, 5, 5, 16 },
+    { VK_FORMAT_ASTC_6x5_UNORM_BLOCK, 6, 5, 16 },
+    { VK_FORMAT_ASTC_6x5_SRGB_BLOCK, 6, 5, 16 },
+    { VK_FORMAT_ASTC_6x6_UNORM_BLOCK, 6, 6, 16 },
+    { VK_FORMAT_ASTC_6x6_SRGB_BLOCK, 6, 6, 16 },
+    { VK_FORMAT_ASTC_8x5_UNORM_BLOCK, 8, 5, 16 },
+    { VK_FORMAT_ASTC_8x5_SRGB_BLOCK, 8, 5, 16 },
+    { VK_FORMAT_ASTC_8x6_UNORM_BLOCK, 8, 6, 16 },
+    { VK_FORMAT_ASTC_8x6_SRGB_BLOCK, 8, 6, 16 },
+    { VK_FORMAT_ASTC_8x8_UNORM_BLOCK, 8, 8, 16 },
+    { VK_FORMAT_ASTC_8x8_SRGB_BLOCK, 8, 8, 16 },
+    { VK_FORMAT_ASTC_10x5_UNORM_BLOCK, 10, 5, 16 },
+    { VK_FORMAT_ASTC_10x5_SRGB_BLOCK, 10, 5, 16 },
+    { VK_FORMAT_ASTC_10x6_UNORM_BLOCK, 10, 6, 16 },
+    { VK_FORMAT_ASTC_10x6_SRGB_BLOCK, 10, 6, 16 },
+    { VK_FORMAT_ASTC_10x8_UNORM_BLOCK, 10, 8, 16 },
+    { VK_FORMAT_ASTC_10x8_SRGB_BLOCK, 10, 8, 16 },
+    { VK_FORMAT_ASTC_10x10_UNORM_BLOCK, 10, 10, 16 },
+    { VK_FORMAT_ASTC_10x10_SRGB_BLOCK, 10, 10, 16 },
+    { VK_FORMAT_ASTC_12x10_UNORM_BLOCK, 12, 10, 16 },
+    { VK_FORMAT_ASTC_12x10_SRGB_BLOCK, 12, 10, 16 },
+    { VK_FORMAT_ASTC_12x12_UNORM_BLOCK, 12, 12, 16 },
+    { VK_FORMAT_ASTC_12x12_SRGB_BLOCK, 12, 12, 16 },
+};
+
+static const BlockInfo *find_block_info(VkFormat format) {
+    for (uint32_t i = 0; i < sizeof(BLOCK_INFOS) / sizeof(BlockInfo); ++i) {
+        if (BLOCK_INFOS[i].format == format)
+            return &BLOCK_INFOS[i];
+    }
+    return NULL;
+}
+
+static uint64_t get_level_size(const BlockInfo *info, uint32_t width, uint32_t height) {
+    const uint64_t w = (width + info->width - 1) / info->width;
+    const uint64_t h = (height + info->height - 1) / info->height;
+    return w * h * info->bytes;
+}
+
+static uint32_t read_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t read_u64(const uint8_t *p) {
+    return (uint64_t)read_u32(p) | ((uint64_t)read_u32(p + 4) << 32);
+}
+
+// コンテナのヘッダから得た、テクスチャの情報。
+typedef struct ContainerInfo_t {
+    VkFormat format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t level_cnt;
+    uint64_t level_offsets[MAX_MIP_LEVELS]; // NOTE: ファイル先頭からのオフセット。
+    uint64_t level_sizes[MAX_MIP_LEVELS];
+} ContainerInfo;
+
+// KTX2のヘッダを読む関数。
+static VkResult parse_ktx2(FILE *file, ContainerInfo *out) {
+    static const uint8_t IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+    uint8_t header[80];
+    CHECK_RETURN(fseek(file, 0, SEEK_SET) == 0);
+    CHECK_RETURN(fread(header, 1, sizeof(header), file) == sizeof(header));
+    CHECK_RETURN(memcmp(header, IDENTIFIER, sizeof(IDENTIFIER)) == 0);
+
+    out->format = (VkFormat)read_u32(header + 12);
+    out->width = read_u32(header + 20);
+    out->height = read_u32(header + 24);
+    const uint32_t depth = read_u32(header + 28);
+    const uint32_t layer_cnt = read_u32(header + 32);
+    const uint32_t face_cnt = read_u32(header + 36);
+    const uint32_t level_cnt = read_u32(header + 40);
+    const uint32_t supercompression = read_u32(header + 44);
+
+    // NOTE: 2Dテクスチャのみ対応する。
+    // NOTE: VK_FORMAT_UNDEFINED(Basis Universal)や超圧縮(zstd等)はCPUでの展開が必要になるので対応しない。
+    CHECK_RETURN(out->format != VK_FORMAT_UNDEFINED);
+    CHECK_RETURN(depth <= 1 && layer_cnt <= 1 && face_cnt == 1);
+    CHECK_RETURN(supercompression == 0);
+    out->level_cnt = level_cnt > 0 ? level_cnt : 1;
+    CHECK_RETURN(out->level_cnt <= MAX_MIP_LEVELS);
+
+    // NOTE: ヘッダの直後にミップレベルごとの{ byteOffset, byteLength, uncompressedByteLength }が並ぶ。
+    for (uint32_t i = 0; i < out->level_cnt; ++i) {
+        uint8_t level[24];
+        CHECK_RETURN(fread(level, 1, sizeof(level), file) == sizeof(level));
+        out->level_offsets[i] = read_u64(level);
+        out->level_sizes[i] = read_u64(level + 8);
+    }
+    return VK_SUCCESS;
+}
+
+static VkFormat dxgi_to_vk_format(uint32_t dxgi) {
+    switch (dxgi) {
+        case 28: return VK_FORMAT_R8G8B8A8_UNORM;
+        case 29: return VK_FORMAT_R8G8B8A8_SRGB;
+        case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+        case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+        case 74: return VK_FORMAT_BC2_UNORM_BLOCK;
+        case 75: return VK_FORMAT_BC2_SRGB_BLOCK;
+        case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+        case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+        case 80: return VK_FORMAT_BC4_UNORM_BLOCK;
+        case 81: return VK_FORMAT_BC4_SNORM_BLOCK;
+        case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+        case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+        case 95: return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+        case 96: return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+        case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+        case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+        default: return VK_FORMAT_UNDEFINED;
+    }
+}
+
+#define FOURCC(a, b, c, d) ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+// DDSのヘッダを読む関数。
+static VkResult parse_dds(FILE *file, ContainerInfo *out) {
+    // NOTE: マジックナンバー(4bytes) + DDS_HEADER(124bytes) + DDS_HEADER_DXT10(20bytes)。
+    uint8_t header[148];
+    CHECK_RETURN(fseek(file, 0, SEEK_SET) == 0);
+    CHECK_RETURN(fread(header, 1, 128, file) == 128);
+    CHECK_RETURN(read_u32(header) == FOURCC('D', 'D', 'S', ' '));
+
+    out->height = read_u32(header + 12);
+    out->width = read_u32(header + 16);
+    const uint32_t mip_cnt = read_u32(header + 28);
+    const uint32_t four_cc = read_u32(header + 84);
+    const uint32_t caps2 = read_u32(header + 112);
+    CHECK_RETURN(caps2 == 0); // NOTE: キューブマップやボリュームテクスチャには対応しない。
+
+    uint64_t offset = 128;
+    switch (four_cc) {
+        case FOURCC('D', 'X', 'T', '1'): out->format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK; break;
+        case FOURCC('D', 'X', 'T', '3'): out->format = VK_FORMAT_BC2_UNORM_BLOCK; break;
+        case FOURCC('D', 'X', 'T', '5'): out->format = VK_FORMAT_BC3_UNORM_BLOCK; break;
+        case FOURCC('A', 'T', 'I', '1'):
+        case FOURCC('B', 'C', '4', 'U'): out->format = VK_FORMAT_BC4_UNORM_BLOCK; break;
+        case FOURCC('A', 'T', 'I', '2'):
+        case FOURCC('B', 'C', '5', 'U'): out->format = VK_FORMAT_BC5_UNORM_BLOCK; break;
+        case FOURCC('D', 'X', '1', '0'):
+            CHECK_RETURN(fread(header + 128, 1, 20, file) == 20);
+            CHECK_RETURN(read_u32(header + 132) == 3); // NOTE: D3D10_RESOURCE_DIMENSION_TEXTURE2D
+            CHECK_RETURN(read_u32(header + 140) <= 1); // NOTE: arraySize
+            out->format = dxgi_to_vk_format(read_u32(header + 128));
+            offset = 148;
+            break;
+        default:
+            out->format = VK_FORMAT_UNDEFINED;
+            break;
+    }
+    CHECK_RETURN(out->format != VK_FORMAT_UNDEFINED);
+    const BlockInfo *info = find_block_info(out->format);
+    CHECK_RETURN(info != NULL);
+
+    // NOTE: DDSは大きいミップレベルから順に詰めて格納されている。
+    out->level_cnt = mip_cnt > 0 ? mip_cnt : 1;
+    CHECK_RETURN(out->level_cnt <= MAX_MIP_LEVELS);
+    for (uint32_t i = 0; i < out->level_cnt; ++i) {
+        const uint32_t w = out->width >> i > 0 ? out->width >> i : 1;
+        const uint32_t h = out->height >> i > 0 ? out->height >> i : 1;
+        out->level_offsets[i] = offset;
+        out->level_sizes[i] = get_level_size(info, w, h);
+        offset += out->level_sizes[i];
+    }
+    return VK_SUCCESS;
+}
+
+VkResult create_compressed_texture_from_file(
+    const VkDevice device,
+    const VkPhysicalDevice phys_device,
+    const VkPhysicalDeviceMemoryProperties *mem_prop,
+    UploadContext *upload,
+    const char *path,
+    Texture *out
+) {
+    FILE *file = fopen(path, "rb");
+    CHECK_RETURN(file != NULL);
+
+    // NOTE: 拡張子ではなく先頭のマジックナンバーでコンテナを判別する。
+    ContainerInfo info = { 0 };
+    uint8_t magic[4] = { 0 };
+    const size_t magic_size = fread(magic, 1, 4, file);
+    VkResult res = VK_ERROR_FORMAT_NOT_SUPPORTED;
+    if (magic_size == 4 && magic[0] == 0xAB && magic[1] == 'K')
+        res = parse_ktx2(file, &info);
+    else if (magic_size == 4 && read_u32(magic) == FOURCC('D', 'D', 'S', ' '))
+        res = parse_dds(file, &info);
+    if (res != VK_SUCCESS) {
+        fclose(file);
+        return res;
+    }
+
+    // NOTE: デバイスがそのフォーマットをサンプリングできるか調べる。
+    // NOTE: できなければVK_ERROR_FORMAT_NOT_SUPPORTEDを返すので、呼び出し側で非圧縮の画像に切り替えること。
+    const BlockInfo *block = find_block_info(info.format);
+    VkFormatProperties format_prop;
+    vkGetPhysicalDeviceFormatProperties(phys_device, info.format, &format_prop);
+    if (block == NULL || (format_prop.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) == 0) {
+        fclose(file);
+        return VK_ERROR_FORMAT_NOT_SUPPORTED;
+    }
+
+    // NOTE: 各ミップレベルのデータサイズを検証し、ステージングバッファ上の配置を決める。
+    // NOTE: オフセットはブロックサイズ(最大16bytes)の倍数に揃える。
+    VkBufferImageCopy regions[MAX_MIP_LEVELS];
+    VkDeviceSize total_size = 0;
+    for (uint32_t i = 0; i < info.level_cnt; ++i) {
+        const uint32_t w = info.width >> i > 0 ? info.width >> i : 1;
+        const uint32_t h = info.height >> i > 0 ? info.height >> i : 1;
+        if (info.level_sizes[i] != get_level_size(block, w, h)) {
+            fclose(file);
+            return VK_ERROR_UNKNOWN;
+        }
+        const VkBufferImageCopy region = {
+            total_size,
+            0,
+            0,
+            { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1 },
+            { 0, 0, 0 },
+            { w, h, 1 },
+        };
+        regions[i] = region;
+        total_size += (info.level_sizes[i] + 15) / 16 * 16;
+    }
+
+    // NOTE: ファイルからステージングバッファへ直接読み込む。CPUでの展開やコピーは一切しない。
+    void *p;
+    VkDeviceSize offset;
+    res = reserve_upload(upload, total_size, 16, &p, &offset);
+    for (uint32_t i = 0; i < info.level_cnt && res == VK_SUCCESS; ++i) {
+        if (fseek(file, (long)info.level_offsets[i], SEEK_SET) != 0
+            || fread((uint8_t *)p + regions[i].bufferOffset, 1, info.level_sizes[i], file) != info.level_sizes[i])
+        {
+            res = VK_ERROR_UNKNOWN;
+        }
+    }
+    fclose(file);
+    if (res != VK_SUCCESS)
+        return res;
+
+    // NOTE: Textureを初期化し、全ミップレベルのコピーを記録する。
+    CHECK_RETURN_VK(
+        create_texture(
+            device,
+            mem_prop,
+            info.format,
+            info.width,
+            info.height,
+            info.level_cnt,
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_IMAGE_ASPECT_COLOR_BIT,
+            NULL,
+            out
+        )
+    );
+    CHECK_RETURN_VK(upload_image(upload, offset, out->image, info.level_cnt, info.level_cnt, regions, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT));
+
+    return VK_SUCCESS;
+}
@@ -0,0 +1,362 @@
+#include "vulkan-tutorial.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#    include <immintrin.h>
+#    define CPU_CULL_AVX
+#endif
+
+#define CULL_GRAIN 1024 // NOTE: ジョブ一つあたりのオブジェクト数。8の倍数にする。
+#define CLIP_W_EPSILON 1e-5f
+
+// 列優先の4x4行列で点(x, y, z, 1)を変換する関数。
+static void transform_point(const float *m, float x, float y, float z, float *out) {
+    for (uint32_t r = 0; r < 4; ++r) {
+        out[r] = m[r] * x + m[4 + r] * y + m[8 + r] * z + m[12 + r];
+    }
+}
+
+VkResult create_cull_bounds(uint32_t capacity, CullBounds *out) {
+    out->cnt = 0;
+    out->capacity = capacity;
+    out->x = (float *)malloc(sizeof(float) * capacity * 4);
+    CHECK_RETURN(out->x != NULL);
+    // NOTE: 一度の確保で済ませ、成分ごとの配列に切り分ける。
+    out->y = out->x + capacity;
+    out->z = out->y + capacity;
+    out->radius = out->z + capacity;
+    return VK_SUCCESS;
+}
+
+VkResult push_cull_bounds(CullBounds *bounds, const float sphere[4]) {
+    CHECK_RETURN(bounds->cnt < bounds->capacity);
+    const uint32_t i = bounds->cnt;
+    bounds->x[i] = sphere[0];
+    bounds->y[i] = sphere[1];
+    bounds->z[i] = sphere[2];
+    bounds->radius[i] = sphere[3];
+    bounds->cnt = i + 1;
+    return VK_SUCCESS;
+}
+
+void destroy_cull_bounds(CullBounds *bounds) {
+    free(bounds->x);
+    bounds->x = NULL;
+    bounds->y = NULL;
+    bounds->z = NULL;
+    bounds->radius = NULL;
+    bounds->cnt = 0;
+}
+
+void extract_frustum(const CameraData *camera, Frustum *out) {
+    float m[16];
+    mul_mat4(camera->proj, camera->view, m);
+    // NOTE: 行ベクトルの和と差が各平面になる。深度は[0, 1]なので、近平面は3行目そのもの。
+    for (uint32_t j = 0; j < 4; ++j) {
+        const float r0 = m[j * 4 + 0];
+        const float r1 = m[j * 4 + 1];
+        const float r2 = m[j * 4 + 2];
+        const float r3 = m[j * 4 + 3];
+        out->planes[0][j] = r3 + r0;
+        out->planes[1][j] = r3 - r0;
+        out->planes[2][j] = r3 + r1;
+        out->planes[3][j] = r3 - r1;
+        out->planes[4][j] = r2;
+        out->planes[5][j] = r3 - r2;
+    }
+    // NOTE: 正規化しておけば、平面との距離をそのまま半径と比べられる。
+    for (uint32_t i = 0; i < 6; ++i) {
+        const float *p = out->planes[i];
+        const float len = sqrtf(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+        const float inv = len > 0.0f ? 1.0f / len : 0.0f;
+        for (uint32_t j = 0; j < 4; ++j) {
+            out->planes[i][j] *= inv;
+        }
+    }
+}
+
+VkResult create_occlusion_buffer(uint32_t width, uint32_t height, OcclusionBuffer *out) {
+    out->width = width;
+    out->height = height;
+    out->depth = (float *)malloc(sizeof(float) * width * height);
+    CHECK_RETURN(out->depth != NULL);
+    return VK_SUCCESS;
+}
+
+void clear_occlusion_buffer(OcclusionBuffer *buffer, const CameraData *camera) {
+    mul_mat4(camera->proj, camera->view, buffer->view_proj);
+    for (uint32_t i = 0; i < buffer->width * buffer->height; ++i) {
+        buffer->depth[i] = 1.0f;
+    }
+}
+
+// クリップ座標をバッファのピクセル座標と深度に変換する関数。wが小さすぎれば0を返す。
+static int to_screen(const OcclusionBuffer *buffer, const float *clip, float *out) {
+    if (clip[3] < CLIP_W_EPSILON)
+        return 0;
+    const float inv_w = 1.0f / clip[3];
+    out[0] = (clip[0] * inv_w * 0.5f + 0.5f) * (float)buffer->width;
+    out[1] = (clip[1] * inv_w * 0.5f + 0.5f) * (float)buffer->height;
+    out[2] = clip[2] * inv_w;
+    return 1;
+}
+
+static float edge(const float *a, const float *b, float x, float y) {
+    return (b[0] - a[0]) * (y - a[1]) - (b[1] - a[1]) * (x - a[0]);
+}
+
+void rasterize_occluders(OcclusionBuffer *buffer, const float *positions, const uint32_t *idxs, uint32_t index_cnt) {
+    for (uint32_t t = 0; t + 2 < index_cnt; t += 3) {
+        float v[3][3];
+        int ok = 1;
+        for (uint32_t k = 0; k < 3; ++k) {
+            const float *p = positions + (size_t)idxs[t + k] * 3;
+            float clip[4];
+            transform_point(buffer->view_proj, p[0], p[1], p[2], clip);
+            ok = ok && to_screen(buffer, clip, v[k]);
+        }
+        // NOTE: 近平面を跨ぐ三角形は切り取らずに捨てる。描かない分には遮蔽が減るだけで、誤って消すことはない。
+        if (!ok)
+            continue;
+        float area = edge(v[0], v[1], v[2][0], v[2][1]);
+        if (area == 0.0f)
+            continue;
+        // NOTE: 裏向きの遮蔽物も使うので、向きを揃える。
+        if (area < 0.0f) {
+            float tmp[3];
+            memcpy(tmp, v[1], sizeof(tmp));
+            memcpy(v[1], v[2], sizeof(tmp));
+            memcpy(v[2], tmp, sizeof(tmp));
+            area = -area;
+        }
+        const float min_x = fminf(v[0][0], fminf(v[1][0], v[2][0]));
+        const float max_x = fmaxf(v[0][0], fmaxf(v[1][0], v[2][0]));
+        const float min_y = fminf(v[0][1], fminf(v[1][1], v[2][1]));
+        const float max_y = fmaxf(v[0][1], fmaxf(v[1][1], v[2][1]));
+        const int x0 = min_x > 0.0f ? (int)min_x : 0;
+        const int y0 = min_y > 0.0f ? (int)min_y : 0;
+        const int x1 = max_x < (float)buffer->width ? (int)ceilf(max_x) : (int)buffer->width;
+        const int y1 = max_y < (float)buffer->height ? (int)ceilf(max_y) : (int)buffer->height;
+        const float inv_area = 1.0f / area;
+        // NOTE: ピクセルの中心で覆うかを判定する。深度はスクリーン空間で線形に補間できる。
+        for (int y = y0; y < y1; ++y) {
+            for (int x = x0; x < x1; ++x) {
+                const float px = (float)x + 0.5f;
+                const float py = (float)y + 0.5f;
+                const float w0 = edge(v[1], v[2], px, py);
+                const float w1 = edge(v[2], v[0], px, py);
+                const float w2 = edge(v[0], v[1], px, py);
+                if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+                    continue;
+                const float z = (w0 * v[0][2] + w1 * v[1][2] + w2 * v[2][2]) * inv_area;
+                float *d = &buffer->depth[y * buffer->width + x];
+                *d = z < *d ? z : *d;
+            }
+        }
+    }
+}
+
+int is_occluded(const OcclusionBuffer *buffer, const float sphere[4]) {
+    // NOTE: 球を囲む立方体の8頂点を投影し、スクリーン上の矩形と最も手前の深度を求める。
+    float min_x = INFINITY, min_y = INFINITY, min_z = INFINITY;
+    float max_x = -INFINITY, max_y = -INFINITY;
+    for (uint32_t k = 0; k < 8; ++k) {
+        const float r = sphere[3];
+        float clip[4];
+        float s[3];
+        transform_point(
+            buffer->view_proj,
+            sphere[0] + (k & 1 ? r : -r),
+            sphere[1] + (k & 2 ? r : -r),
+            sphere[2] + (k & 4 ? r : -r),
+            clip
+        );
+        // NOTE: カメラの後ろに掛かるなら、遮蔽されているとは言えない。
+        if (!to_screen(buffer, clip, s))
+            return 0;
+        min_x = fminf(min_x, s[0]);
+        max_x = fmaxf(max_x, s[0]);
+        min_y = fminf(min_y, s[1]);
+        max_y = fmaxf(max_y, s[1]);
+        min_z = fminf(min_z, s[2]);
+    }
+    const int x0 = min_x > 0.0f ? (int)min_x : 0;
+    const int y0 = min_y > 0.0f ? (int)min_y : 0;
+    const int x1 = max_x < (float)buffer->width ? (int)ceilf(max_x) : (int)buffer->width;
+    const int y1 = max_y < (float)buffer->height ? (int)ceilf(max_y) : (int)buffer->height;
+    if (x0 >= x1 || y0 >= y1)
+        return 0;
+    // NOTE: 矩形のどこか一つでも遮蔽物より手前なら、見えている。
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            if (min_z <= buffer->depth[y * buffer->width + x])
+                return 0;
+        }
+    }
+    return 1;
+}
+
+// 一つの境界球が視錐台の内側に掛かっているかを調べる関数。
+static int is_in_frustum(const Frustum *frustum, float x, float y, float z, float radius) {
+    for (uint32_t i = 0; i < 6; ++i) {
+        const float *p = frustum->planes[i];
+        if (p[0] * x + p[1] * y + p[2] * z + p[3] < -radius)
+            return 0;
+    }
+    return 1;
+}
+
+// [begin, end)の境界球を視錐台と比べ、見えるもののインデックスをvisible[begin]から詰めて書き込む関数。
+static uint32_t cull_range_scalar(const CullBounds *bounds, const Frustum *frustum, uint32_t begin, uint32_t end, uint32_t *visible) {
+    uint32_t cnt = 0;
+    for (uint32_t i = begin; i < end; ++i) {
+        if (is_in_frustum(frustum, bounds->x[i], bounds->y[i], bounds->z[i], bounds->radius[i])) {
+            visible[begin + cnt] = i;
+            cnt += 1;
+        }
+    }
+    return cnt;
+}
+
+#ifdef CPU_CULL_AVX
+// cull_range_scalarのAVX版。8個の境界球を一度に6平面と比べる。
+__attribute__((target("avx")))
+static uint32_t cull_range_avx(const CullBounds *bounds, const Frustum *frustum, uint32_t begin, uint32_t end, uint32_t *visible) {
+    __m256 planes[6][4];
+    for (uint32_t i = 0; i < 6; ++i) {
+        for (uint32_t j = 0; j < 4; ++j) {
+            planes[i][j] = _mm256_set1_ps(frustum->planes[i][j]);
+        }
+    }
+    uint32_t cnt = 0;
+    uint32_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        const __m256 x = _mm256_loadu_ps(bounds->x + i);
+        const __m256 y = _mm256_loadu_ps(bounds->y + i);
+        const __m256 z = _mm256_loadu_ps(bounds->z + i);
+        const __m256 neg_r = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(bounds->radius + i));
+        __m256 outside = _mm256_setzero_ps();
+        // NOTE: is_in_frustumと同じ順に足し、平面にちょうど接する境界球も同じように判定する。
+        for (uint32_t p = 0; p < 6; ++p) {
+            __m256 d = _mm256_mul_ps(planes[p][0], x);
+            d = _mm256_add_ps(d, _mm256_mul_ps(planes[p][1], y));
+            d = _mm256_add_ps(d, _mm256_mul_ps(planes[p][2], z));
+            d = _mm256_add_ps(d, planes[p][3]);
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, neg_r, _CMP_LT_OQ));
+        }
+        // NOTE: 見えるものだけを、ビットの立っている順に書き出す。
+        uint32_t mask = ~(uint32_t)_mm256_movemask_ps(outside) & 0xFF;
+        while (mask != 0) {
+            visible[begin + cnt] = i + (uint32_t)__builtin_ctz(mask);
+            cnt += 1;
+            mask &= mask - 1;
+        }
+    }
+    // NOTE: 8個に満たない残りは一つずつ調べる。
+    for (; i < end; ++i) {
+        if (is_in_frustum(frustum, bounds->x[i], bounds->y[i], bounds->z[i], bounds->radius[i])) {
+            visible[begin + cnt] = i;
+            cnt += 1;
+        }
+    }
+    return cnt;
+}
+#endif
+
+// ジョブに渡す、カリング全体の状態。
+typedef struct CullJob_t {
+    const CullBounds *bounds;
+    const Frustum *frustum;
+    const OcclusionBuffer *occlusion;
+    VkBool32 simd;
+    uint32_t *visible;
+    uint32_t *chunk_cnts;
+} CullJob;
+
+// 一つのチャンク[begin, end)を選別し、見えるものの数を返す関数。
+static uint32_t cull_chunk(const CullJob *job, uint32_t begin, uint32_t end) {
+    const CullBounds *bounds = job->bounds;
+    uint32_t cnt;
+#ifdef CPU_CULL_AVX
+    if (job->simd)
+        cnt = cull_range_avx(bounds, job->frustum, begin, end, job->visible);
+    else
+        cnt = cull_range_scalar(bounds, job->frustum, begin, end, job->visible);
+#else
+    cnt = cull_range_scalar(bounds, job->frustum, begin, end, job->visible);
+#endif
+    // NOTE: 視錐台を通ったものだけを、遮蔽されているか調べて詰め直す。
+    if (job->occlusion != NULL) {
+        uint32_t kept = 0;
+        for (uint32_t k = 0; k < cnt; ++k) {
+            const uint32_t i = job->visible[begin + k];
+            const float sphere[4] = { bounds->x[i], bounds->y[i], bounds->z[i], bounds->radius[i] };
+            if (!is_occluded(job->occlusion, sphere)) {
+                job->visible[begin + kept] = i;
+                kept += 1;
+            }
+        }
+        cnt = kept;
+    }
+    return cnt;
+}
+
+static void cull_job(void *user, uint32_t begin, uint32_t end) {
+    const CullJob *job = (const CullJob *)user;
+    // NOTE: ワーカーがいなければ全体が一度に渡されるので、ここでもチャンクに分ける。
+    for (uint32_t i = begin; i < end; i += CULL_GRAIN) {
+        const uint32_t chunk_end = end - i > CULL_GRAIN ? i + CULL_GRAIN : end;
+        job->chunk_cnts[i / CULL_GRAIN] = cull_chunk(job, i, chunk_end);
+    }
+}
+
+VkBool32 is_cull_simd_supported() {
+#ifdef CPU_CULL_AVX
+    return __builtin_cpu_supports("avx") ? VK_TRUE : VK_FALSE;
+#else
+    return VK_FALSE;
+#endif
+}
+
+VkResult cull_bounds(
+    JobSystem *jobs,
+    const CullBounds *bounds,
+    const Frustum *frustum,
+    const OcclusionBuffer *occlusion,
+    VkBool32 simd,
+    uint32_t *visible,
+    uint32_t *p_visible_cnt
+) {
+    *p_visible_cnt = 0;
+    if (bounds->cnt == 0)
+        return VK_SUCCESS;
+    const uint32_t chunk_cnt = (bounds->cnt + CULL_GRAIN - 1) / CULL_GRAIN;
+    uint32_t *chunk_cnts = (uint32_t *)malloc(sizeof(uint32_t) * chunk_cnt);
+    CHECK_RETURN(chunk_cnts != NULL);
+    const CullJob job = {
+        bounds,
+        frustum,
+        occlusion,
+        simd && is_cull_simd_supported(),
+        visible,
+        chunk_cnts,
+    };
+    run_jobs(jobs, bounds->cnt, CULL_GRAIN, cull_job, (void *)&job);
+
+    // NOTE: チャンクごとに先頭から詰めてあるので、前へ寄せて一つの配列にする。
+    uint32_t cnt = 0;
+    for (uint32_t c = 0; c < chunk_cnt; ++c) {
+        memmove(visible + cnt, visible + c * CULL_GRAIN, sizeof(uint32_t) * chunk_cnts[c]);
+        cnt += chunk_cnts[c];
+    }
+    free(chunk_cnts);
+    *p_visible_cnt = cnt;
+    return VK_SUCCESS;
+}
+
+void destroy_occlusion_buffer(OcclusionBuffer *buffer) {
+    free(buffer->depth);
+    buffer->depth = NULL;
+}
@@ -0,0 +1,303 @@
+#include "vulkan-tutorial.h"
+
+#include <string.h>
+
+#define CULL_GROUP_SIZE 64 // NOTE: シェーダのlocal_size_xと揃える。
+#define CULL_BINDING_CNT 8
+#define CULL_BUFFER_BINDING_CNT 7 // NOTE: 最後のバインディングだけがHi-Zピラミッド。
+
+// カリングのシェーダに渡すプッシュ定数。
+typedef struct CullConstant_t {
+    uint32_t object_cnt;
+    uint32_t compact;
+    uint32_t occlusion;
+} CullConstant;
+
+// カリングパスのディスクリプタセットとパイプラインを作成する関数。
+// NOTE: 失敗したときに作りかけのものが残るので、呼び出し側で破棄すること。
+static VkResult create_cull_pipeline(
+    const VkDevice device,
+    const VkShaderModule shader,
+    const Buffer *camera,
+    const HiZ *hiz,
+    const DrawList *list,
+    CullPass *out
+) {
+    // descriptor set
+    {
+        VkDescriptorSetLayoutBinding binds[CULL_BINDING_CNT];
+        for (uint32_t i = 0; i < CULL_BINDING_CNT; ++i) {
+            VkDescriptorType type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            if (i == 0)
+                type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            else if (i == CULL_BUFFER_BINDING_CNT)
+                type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            const VkDescriptorSetLayoutBinding bind = {
+                i,
+                type,
+                1,
+                VK_SHADER_STAGE_COMPUTE_BIT,
+                NULL,
+            };
+            binds[i] = bind;
+        }
+        const VkDescriptorSetLayoutCreateInfo layout_ci = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            NULL,
+            0,
+            CULL_BINDING_CNT,
+            binds,
+        };
+        CHECK_RETURN_VK(vkCreateDescriptorSetLayout(device, &layout_ci, NULL, &out->descriptor_set_layout));
+        const VkDescriptorPoolSize pool_sizes[] = {
+            {
+                VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                1,
+            },
+            {
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                CULL_BUFFER_BINDING_CNT - 1,
+            },
+            {
+                VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                1,
+            },
+        };
+        const VkDescriptorPoolCreateInfo pool_ci = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            NULL,
+            0,
+            1,
+            3,
+            pool_sizes,
+        };
+        CHECK_RETURN_VK(vkCreateDescriptorPool(device, &pool_ci, NULL, &out->descriptor_pool));
+        const VkDescriptorSetAllocateInfo ai = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            NULL,
+            out->descriptor_pool,
+            1,
+            &out->descriptor_set_layout,
+        };
+        CHECK_RETURN_VK(vkAllocateDescriptorSets(device, &ai, &out->descriptor_set));
+        const VkDescriptorBufferInfo bis[CULL_BUFFER_BINDING_CNT] = {
+            { camera->buffer, 0, VK_WHOLE_SIZE },
+            { out->objects.buffer, 0, VK_WHOLE_SIZE },
+            { out->instances.buffer, 0, VK_WHOLE_SIZE },
+            { list->commands.buffer, 0, VK_WHOLE_SIZE },
+            { list->count.buffer, 0, VK_WHOLE_SIZE },
+            { list->instances.buffer, 0, VK_WHOLE_SIZE },
+            { out->stats.buffer, 0, VK_WHOLE_SIZE },
+        };
+        const VkDescriptorImageInfo ii = {
+            hiz->sampler,
+            hiz->texture.view,
+            VK_IMAGE_LAYOUT_GENERAL,
+        };
+        VkWriteDescriptorSet writes[CULL_BINDING_CNT];
+        for (uint32_t i = 0; i < CULL_BINDING_CNT; ++i) {
+            const VkWriteDescriptorSet write = {
+                VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                NULL,
+                out->descriptor_set,
+                i,
+                0,
+                1,
+                binds[i].descriptorType,
+                i == CULL_BUFFER_BINDING_CNT ? &ii : NULL,
+                i == CULL_BUFFER_BINDING_CNT ? NULL : &bis[i],
+                NULL,
+            };
+            writes[i] = write;
+        }
+        vkUpdateDescriptorSets(device, CULL_BINDING_CNT, writes, 0, NULL);
+    }
+
+    // pipeline
+    {
+        const VkPushConstantRange push_constant_ranges[] = {
+            {
+                VK_SHADER_STAGE_COMPUTE_BIT,
+                0,
+                sizeof(CullConstant),
+            },
+        };
+        const VkPipelineLayoutCreateInfo layout_ci = {
+            VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            NULL,
+            0,
+            1,
+            &out->descriptor_set_layout,
+            1,
+            push_constant_ranges,
+        };
+        CHECK_RETURN_VK(vkCreatePipelineLayout(device, &layout_ci, NULL, &out->pipeline_layout));
+        const VkComputePipelineCreateInfo ci = {
+            VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            NULL,
+            0,
+            {
+                VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                NULL,
+                0,
+                VK_SHADER_STAGE_COMPUTE_BIT,
+                shader,
+                "main",
+                NULL,
+            },
+            out->pipeline_layout,
+            VK_NULL_HANDLE,
+            0,
+        };
+        CHECK_RETURN_VK(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &ci, NULL, &out->pipeline));
+    }
+    return VK_SUCCESS;
+}
+
+VkResult create_cull_pass(
+    const VkDevice device,
+    const VkPhysicalDeviceMemoryProperties *mem_prop,
+    const VkShaderModule shader,
+    const Buffer *camera,
+    const HiZ *hiz,
+    const DrawList *list,
+    CullPass *out
+) {
+    out->capacity = list->capacity;
+    out->instance_size = list->instance_size;
+    out->object_cnt = 0;
+    out->descriptor_set_layout = VK_NULL_HANDLE;
+    out->descriptor_pool = VK_NULL_HANDLE;
+    out->pipeline_layout = VK_NULL_HANDLE;
+    out->pipeline = VK_NULL_HANDLE;
+
+    // buffers
+    void *objects;
+    CHECK_RETURN_VK(
+        create_mapped_buffer(
+            device,
+            mem_prop,
+            sizeof(CullObject) * (VkDeviceSize)out->capacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            &out->objects,
+            &objects
+        )
+    );
+    void *instances;
+    VkResult res = create_mapped_buffer(
+        device,
+        mem_prop,
+        (VkDeviceSize)out->instance_size * out->capacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        &out->instances,
+        &instances
+    );
+    if (res != VK_SUCCESS) {
+        destroy_buffer(device, &out->objects);
+        return res;
+    }
+    // NOTE: 統計はCPUが読み戻すので、ホストから見えるメモリに置く。
+    void *stats;
+    res = create_mapped_buffer(
+        device,
+        mem_prop,
+        sizeof(CullStats),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        &out->stats,
+        &stats
+    );
+    if (res != VK_SUCCESS) {
+        destroy_buffer(device, &out->objects);
+        destroy_buffer(device, &out->instances);
+        return res;
+    }
+    out->mapped_objects = (CullObject *)objects;
+    out->mapped_instances = (uint8_t *)instances;
+    out->mapped_stats = (CullStats *)stats;
+    memset(stats, 0, sizeof(CullStats));
+
+    // NOTE: ここから先で失敗したら、作ったものをdestroy_cull_passでまとめて破棄する。
+    res = create_cull_pipeline(device, shader, camera, hiz, list, out);
+    if (res != VK_SUCCESS) {
+        destroy_cull_pass(device, out);
+        return res;
+    }
+    return VK_SUCCESS;
+}
+
+void reset_cull_pass(CullPass *pass) {
+    pass->object_cnt = 0;
+}
+
+VkResult push_cull_object(CullPass *pass, const Model *model, const float sphere[4], const void *instance) {
+    CHECK_RETURN(pass->object_cnt < pass->capacity);
+    const uint32_t i = pass->object_cnt;
+    const CullObject object = {
+        { sphere[0], sphere[1], sphere[2], sphere[3] },
+        model->index_cnt,
+        model->first_index,
+        (int32_t)model->first_vertex,
+        0,
+    };
+    pass->mapped_objects[i] = object;
+    memcpy(pass->mapped_instances + (size_t)pass->instance_size * i, instance, pass->instance_size);
+    pass->object_cnt = i + 1;
+    return VK_SUCCESS;
+}
+
+void cmd_cull(const VkCommandBuffer command, const CullPass *pass, const HiZ *hiz, DrawList *list) {
+    // NOTE: 描画の数の上限はオブジェクトの数。実際の数はGPUが数える。
+    list->cnt = pass->object_cnt;
+    if (pass->object_cnt == 0)
+        return;
+
+    // NOTE: 数と統計を0にしてから数え始める。パスの外との同期は呼び出し側が行うので、ここではパスの中の順序だけを守る。
+    vkCmdFillBuffer(command, list->count.buffer, 0, sizeof(uint32_t), 0);
+    vkCmdFillBuffer(command, pass->stats.buffer, 0, sizeof(CullStats), 0);
+    const VkMemoryBarrier before = {
+        VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        NULL,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+    };
+    vkCmdPipelineBarrier(
+        command,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        1,
+        &before,
+        0,
+        NULL,
+        0,
+        NULL
+    );
+
+    // NOTE: drawIndirectCountがなければ数を読めないので、詰めずに見えない描画のinstanceCountを0にする。
+    const CullConstant constant = {
+        pass->object_cnt,
+        list->features.draw_indirect_count ? 1 : 0,
+        hiz->built ? 1 : 0,
+    };
+    vkCmdBindPipeline(command, VK_PIPELINE_BIND_POINT_COMPUTE, pass->pipeline);
+    vkCmdBindDescriptorSets(command, VK_PIPELINE_BIND_POINT_COMPUTE, pass->pipeline_layout, 0, 1, &pass->descriptor_set, 0, NULL);
+    vkCmdPushConstants(command, pass->pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstant), (const void *)&constant);
+    vkCmdDispatch(command, (pass->object_cnt + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+}
+
+void get_cull_stats(const CullPass *pass, CullStats *out) {
+    *out = *pass->mapped_stats;
+}
+
+void destroy_cull_pass(const VkDevice device, CullPass *pass) {
+    vkDestroyPipeline(device, pass->pipeline, NULL);
+    vkDestroyPipelineLayout(device, pass->pipeline_layout, NULL);
+    vkDestroyDescriptorPool(device, pass->descriptor_pool, NULL);
+    vkDestroyDescriptorSetLayout(device, pass->descriptor_set_layout, NULL);
+    destroy_buffer(device, &pass->objects);
+    destroy_buffer(device, &pass->instances);
+    destroy_buffer(device, &pass->stats);
+    pass->mapped_objects = NULL;
+    pass->mapped_instances = NULL;
+    pass->mapped_stats = NULL;
+}
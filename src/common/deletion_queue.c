@@ -0,0 +1,120 @@
+#include "vulkan-tutorial.h"
+
+static void destroy_deletion(const VkDevice device, const Deletion *deletion) {
+    switch (deletion->type) {
+        case DELETION_TYPE_BUFFER:
+            destroy_buffer(device, &deletion->u.buffer);
+            break;
+        case DELETION_TYPE_TEXTURE:
+            destroy_texture(device, &deletion->u.texture);
+            break;
+        case DELETION_TYPE_MODEL:
+            destroy_model(device, &deletion->u.model);
+            break;
+        case DELETION_TYPE_PIPELINE:
+            vkDestroyPipeline(device, deletion->u.pipeline, NULL);
+            break;
+        case DELETION_TYPE_DESCRIPTOR_SET:
+            vkFreeDescriptorSets(device, deletion->u.descriptor_set.pool, 1, &deletion->u.descriptor_set.set);
+            break;
+        case DELETION_TYPE_COMMAND_BUFFER:
+            vkFreeCommandBuffers(device, deletion->u.command_buffer.pool, 1, &deletion->u.command_buffer.buffer);
+            break;
+        case DELETION_TYPE_GEOMETRY:
+            free_geometry(deletion->u.geometry.pool, &deletion->u.geometry.model);
+            break;
+        case DELETION_TYPE_BINDLESS_SLOT:
+            unregister_bindless_texture(deletion->u.bindless_slot.table, deletion->u.bindless_slot.slot);
+            break;
+    }
+}
+
+static VkResult push_deletion(DeletionQueue *queue, const Deletion *deletion) {
+    // NOTE: 足りなければ倍に拡張する。
+    if (queue->cnt == queue->cap) {
+        const uint32_t cap = queue->cap > 0 ? queue->cap * 2 : 64;
+        Deletion *entries = (Deletion *)realloc(queue->entries, sizeof(Deletion) * cap);
+        CHECK_RETURN(entries != NULL);
+        queue->entries = entries;
+        queue->cap = cap;
+    }
+    queue->entries[queue->cnt] = *deletion;
+    queue->cnt += 1;
+    return VK_SUCCESS;
+}
+
+VkResult defer_destroy_buffer(DeletionQueue *queue, uint64_t value, const Buffer *buffer) {
+    Deletion deletion = { value, DELETION_TYPE_BUFFER };
+    deletion.u.buffer = *buffer;
+    return push_deletion(queue, &deletion);
+}
+
+VkResult defer_destroy_texture(DeletionQueue *queue, uint64_t value, const Texture *texture) {
+    Deletion deletion = { value, DELETION_TYPE_TEXTURE };
+    deletion.u.texture = *texture;
+    return push_deletion(queue, &deletion);
+}
+
+VkResult defer_destroy_model(DeletionQueue *queue, uint64_t value, const Model *model) {
+    Deletion deletion = { value, DELETION_TYPE_MODEL };
+    deletion.u.model = *model;
+    return push_deletion(queue, &deletion);
+}
+
+VkResult defer_destroy_pipeline(DeletionQueue *queue, uint64_t value, const VkPipeline pipeline) {
+    Deletion deletion = { value, DELETION_TYPE_PIPELINE };
+    deletion.u.pipeline = pipeline;
+    return push_deletion(queue, &deletion);
+}
+
+VkResult defer_free_descriptor_set(DeletionQueue *queue, uint64_t value, const VkDescriptorPool pool, const VkDescriptorSet set) {
+    Deletion deletion = { value, DELETION_TYPE_DESCRIPTOR_SET };
+    deletion.u.descriptor_set.pool = pool;
+    deletion.u.descriptor_set.set = set;
+    return push_deletion(queue, &deletion);
+}
+
+VkResult defer_free_command_buffer(DeletionQueue *queue, uint64_t value, const VkCommandPool pool, const VkCommandBuffer command_buffer) {
+    Deletion deletion = { value, DELETION_TYPE_COMMAND_BUFFER };
+    deletion.u.command_buffer.pool = pool;
+    deletion.u.command_buffer.buffer = command_buffer;
+    return push_deletion(queue, &deletion);
+}
+
+VkResult defer_free_geometry(DeletionQueue *queue, uint64_t value, GeometryPool *pool, const Model *model) {
+    Deletion deletion = { value, DELETION_TYPE_GEOMETRY };
+    deletion.u.geometry.pool = pool;
+    deletion.u.geometry.model = *model;
+    return push_deletion(queue, &deletion);
+}
+
+VkResult defer_unregister_bindless_texture(DeletionQueue *queue, uint64_t value, BindlessTable *table, uint32_t slot) {
+    Deletion deletion = { value, DELETION_TYPE_BINDLESS_SLOT };
+    deletion.u.bindless_slot.table = table;
+    deletion.u.bindless_slot.slot = slot;
+    return push_deletion(queue, &deletion);
+}
+
+void collect_deletion_queue(const VkDevice device, DeletionQueue *queue, uint64_t completed) {
+    // NOTE: 完了済みの要素を解放しつつ、残りを前に詰める。順序は保つ。
+    uint32_t cnt = 0;
+    for (uint32_t i = 0; i < queue->cnt; ++i) {
+        if (queue->entries[i].value <= completed) {
+            destroy_deletion(device, &queue->entries[i]);
+        } else {
+            queue->entries[cnt] = queue->entries[i];
+            cnt += 1;
+        }
+    }
+    queue->cnt = cnt;
+}
+
+void flush_deletion_queue(const VkDevice device, DeletionQueue *queue) {
+    for (uint32_t i = 0; i < queue->cnt; ++i) {
+        destroy_deletion(device, &queue->entries[i]);
+    }
+    free(queue->entries);
+    queue->cnt = 0;
+    queue->cap = 0;
+    queue->entries = NULL;
+}
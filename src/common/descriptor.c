@@ -0,0 +1,220 @@
+#include "vulkan-tutorial.h"
+
+#include <string.h>
+
+#define DESCRIPTOR_POOL_MAX_SETS 4096 // NOTE: プールを継ぎ足すときの、セット数の上限。
+
+VkResult create_descriptor_allocator(
+    uint32_t sets_per_pool,
+    uint32_t ratio_cnt,
+    const DescriptorPoolRatio *ratios,
+    DescriptorAllocator *out
+) {
+    memset(out, 0, sizeof(DescriptorAllocator));
+    CHECK_RETURN(sets_per_pool > 0);
+    CHECK_RETURN(ratio_cnt > 0 && ratio_cnt <= DESCRIPTOR_RATIO_MAX_CNT);
+    out->sets_per_pool = sets_per_pool;
+    out->ratio_cnt = ratio_cnt;
+    memcpy(out->ratios, ratios, sizeof(DescriptorPoolRatio) * ratio_cnt);
+    return VK_SUCCESS;
+}
+
+// プールの配列に一つ追加する関数。足りなければ配列を倍に広げる。
+static VkResult push_pool(VkDescriptorPool **p_pools, uint32_t *p_cnt, uint32_t *p_capacity, const VkDescriptorPool pool) {
+    if (*p_cnt == *p_capacity) {
+        const uint32_t capacity = *p_capacity == 0 ? 4 : *p_capacity * 2;
+        VkDescriptorPool *pools = (VkDescriptorPool *)realloc(*p_pools, sizeof(VkDescriptorPool) * capacity);
+        CHECK_RETURN(pools != NULL);
+        *p_pools = pools;
+        *p_capacity = capacity;
+    }
+    (*p_pools)[*p_cnt] = pool;
+    *p_cnt += 1;
+    return VK_SUCCESS;
+}
+
+// 次に使うプールを用意し、使用中のプールの末尾に置く関数。
+// NOTE: リセット済みのプールがあればそれを使い回し、なければ一つ前より大きなプールを作る。
+static VkResult next_pool(const VkDevice device, DescriptorAllocator *allocator) {
+    VkDescriptorPool pool;
+    if (allocator->free_cnt > 0) {
+        allocator->free_cnt -= 1;
+        pool = allocator->free_pools[allocator->free_cnt];
+    } else {
+        const uint32_t max_sets = allocator->sets_per_pool;
+        VkDescriptorPoolSize sizes[DESCRIPTOR_RATIO_MAX_CNT];
+        for (uint32_t i = 0; i < allocator->ratio_cnt; ++i) {
+            const float cnt = allocator->ratios[i].ratio * (float)max_sets;
+            sizes[i].type = allocator->ratios[i].type;
+            sizes[i].descriptorCount = cnt < 1.0f ? 1 : (uint32_t)cnt;
+        }
+        // NOTE: セットを個別に解放しないので、VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BITは付けない。
+        const VkDescriptorPoolCreateInfo ci = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            NULL,
+            0,
+            max_sets,
+            allocator->ratio_cnt,
+            sizes,
+        };
+        CHECK_RETURN_VK(vkCreateDescriptorPool(device, &ci, NULL, &pool));
+        // NOTE: 足りなくなるたびに作るので、次のプールは大きくしておく。
+        if (allocator->sets_per_pool < DESCRIPTOR_POOL_MAX_SETS)
+            allocator->sets_per_pool = allocator->sets_per_pool * 3 / 2 + 1;
+    }
+    const VkResult res = push_pool(&allocator->pools, &allocator->pool_cnt, &allocator->pool_capacity, pool);
+    if (res != VK_SUCCESS)
+        vkDestroyDescriptorPool(device, pool, NULL);
+    return res;
+}
+
+VkResult allocate_descriptor_set(
+    const VkDevice device,
+    DescriptorAllocator *allocator,
+    const VkDescriptorSetLayout layout,
+    VkDescriptorSet *out
+) {
+    if (allocator->pool_cnt == 0)
+        CHECK_RETURN_VK(next_pool(device, allocator));
+    VkDescriptorSetAllocateInfo ai = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        NULL,
+        allocator->pools[allocator->pool_cnt - 1],
+        1,
+        &layout,
+    };
+    VkResult res = vkAllocateDescriptorSets(device, &ai, out);
+    // NOTE: 今のプールが尽きたら、次のプールを継ぎ足して一度だけやり直す。
+    if (res == VK_ERROR_OUT_OF_POOL_MEMORY || res == VK_ERROR_FRAGMENTED_POOL) {
+        CHECK_RETURN_VK(next_pool(device, allocator));
+        ai.descriptorPool = allocator->pools[allocator->pool_cnt - 1];
+        res = vkAllocateDescriptorSets(device, &ai, out);
+    }
+    if (res != VK_SUCCESS)
+        return res;
+    allocator->allocated_cnt += 1;
+    return VK_SUCCESS;
+}
+
+VkResult reset_descriptor_allocator(const VkDevice device, DescriptorAllocator *allocator) {
+    // NOTE: セットを一つずつ解放せず、プールごとまとめて空にする。
+    for (uint32_t i = 0; i < allocator->pool_cnt; ++i) {
+        CHECK_RETURN_VK(vkResetDescriptorPool(device, allocator->pools[i], 0));
+        CHECK_RETURN_VK(push_pool(&allocator->free_pools, &allocator->free_cnt, &allocator->free_capacity, allocator->pools[i]));
+    }
+    allocator->pool_cnt = 0;
+    allocator->allocated_cnt = 0;
+    return VK_SUCCESS;
+}
+
+void destroy_descriptor_allocator(const VkDevice device, DescriptorAllocator *allocator) {
+    // NOTE: セットはプールとともに解放される。
+    for (uint32_t i = 0; i < allocator->pool_cnt; ++i) {
+        vkDestroyDescriptorPool(device, allocator->pools[i], NULL);
+    }
+    for (uint32_t i = 0; i < allocator->free_cnt; ++i) {
+        vkDestroyDescriptorPool(device, allocator->free_pools[i], NULL);
+    }
+    free(allocator->pools);
+    free(allocator->free_pools);
+    memset(allocator, 0, sizeof(DescriptorAllocator));
+}
+
+VkResult create_descriptor_layout_cache(DescriptorLayoutCache *out) {
+    memset(out, 0, sizeof(DescriptorLayoutCache));
+    return VK_SUCCESS;
+}
+
+// レイアウトの作成情報を、比べられる一続きの値(キー)にする関数。
+// バインディングはバインディング番号の順に並べ直すので、記述の順が違っても同じキーになる。
+// NOTE: outがNULLなら、キーの長さ(uint64_tの数)だけを返す。
+static uint32_t build_layout_key(const VkDescriptorSetLayoutCreateInfo *ci, uint64_t *out) {
+    uint32_t len = 0;
+    if (out != NULL)
+        out[len] = ((uint64_t)ci->flags << 32) | ci->bindingCount;
+    len += 1;
+    uint32_t prev = 0;
+    for (uint32_t k = 0; k < ci->bindingCount; ++k) {
+        // NOTE: バインディングの数は少ないので、前に出した番号より大きい最小のものを毎回探す。
+        const VkDescriptorSetLayoutBinding *bind = NULL;
+        for (uint32_t i = 0; i < ci->bindingCount; ++i) {
+            const VkDescriptorSetLayoutBinding *b = &ci->pBindings[i];
+            if ((k > 0 && b->binding <= prev) || (bind != NULL && b->binding >= bind->binding))
+                continue;
+            bind = b;
+        }
+        prev = bind->binding;
+        if (out != NULL) {
+            out[len] = ((uint64_t)bind->binding << 32) | (uint32_t)bind->descriptorType;
+            out[len + 1] = ((uint64_t)bind->descriptorCount << 32) | bind->stageFlags;
+        }
+        len += 2;
+        // NOTE: immutable samplerはハンドルそのものをキーに含める。
+        if (bind->pImmutableSamplers != NULL) {
+            for (uint32_t i = 0; i < bind->descriptorCount; ++i) {
+                if (out != NULL)
+                    out[len] = (uint64_t)bind->pImmutableSamplers[i];
+                len += 1;
+            }
+        }
+    }
+    return len;
+}
+
+VkResult get_descriptor_set_layout(
+    const VkDevice device,
+    DescriptorLayoutCache *cache,
+    const VkDescriptorSetLayoutCreateInfo *ci,
+    VkDescriptorSetLayout *out
+) {
+    // NOTE: pNextの中身まではキーにできないので、拡張の構造体は受け付けない。
+    CHECK_RETURN(ci->pNext == NULL);
+    const uint32_t key_len = build_layout_key(ci, NULL);
+    uint64_t *key = (uint64_t *)malloc(sizeof(uint64_t) * key_len);
+    CHECK_RETURN(key != NULL);
+    build_layout_key(ci, key);
+    const uint64_t hash = hash_bytes(key, sizeof(uint64_t) * key_len, 0);
+
+    // NOTE: 一つのアプリケーションが使うレイアウトは多くても数十なので、ハッシュを先頭から比べれば足りる。
+    for (uint32_t i = 0; i < cache->cnt; ++i) {
+        const DescriptorLayoutEntry *entry = &cache->entries[i];
+        if (entry->hash != hash || entry->key_len != key_len)
+            continue;
+        if (memcmp(entry->key, key, sizeof(uint64_t) * key_len) != 0)
+            continue;
+        free(key);
+        *out = entry->layout;
+        return VK_SUCCESS;
+    }
+
+    if (cache->cnt == cache->capacity) {
+        const uint32_t capacity = cache->capacity == 0 ? 8 : cache->capacity * 2;
+        DescriptorLayoutEntry *entries = (DescriptorLayoutEntry *)realloc(cache->entries, sizeof(DescriptorLayoutEntry) * capacity);
+        if (entries == NULL) {
+            free(key);
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+        }
+        cache->entries = entries;
+        cache->capacity = capacity;
+    }
+    VkDescriptorSetLayout layout;
+    const VkResult res = vkCreateDescriptorSetLayout(device, ci, NULL, &layout);
+    if (res != VK_SUCCESS) {
+        free(key);
+        return res;
+    }
+    const DescriptorLayoutEntry entry = { hash, key_len, key, layout };
+    cache->entries[cache->cnt] = entry;
+    cache->cnt += 1;
+    *out = layout;
+    return VK_SUCCESS;
+}
+
+void destroy_descriptor_layout_cache(const VkDevice device, DescriptorLayoutCache *cache) {
+    for (uint32_t i = 0; i < cache->cnt; ++i) {
+        vkDestroyDescriptorSetLayout(device, cache->entries[i].layout, NULL);
+        free(cache->entries[i].key);
+    }
+    free(cache->entries);
+    memset(cache, 0, sizeof(DescriptorLayoutCache));
+}
@@ -0,0 +1,127 @@
+#include "vulkan-tutorial.h"
+
+#include <string.h>
+
+void get_indirect_features(const VkPhysicalDevice phys_device, IndirectFeatures *out) {
+    VkPhysicalDeviceVulkan12Features features12 = { 0 };
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 features = { 0 };
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &features12;
+    vkGetPhysicalDeviceFeatures2(phys_device, &features);
+    out->multi_draw_indirect = features.features.multiDrawIndirect;
+    out->draw_indirect_first_instance = features.features.drawIndirectFirstInstance;
+    out->draw_indirect_count = features12.drawIndirectCount;
+}
+
+VkResult create_draw_list(
+    const VkDevice device,
+    const VkPhysicalDeviceMemoryProperties *mem_prop,
+    const IndirectFeatures *features,
+    uint32_t capacity,
+    uint32_t instance_size,
+    DrawList *out
+) {
+    // NOTE: firstInstanceでインスタンスデータを引くので、これがないと描画を区別できない。
+    CHECK_RETURN(features->draw_indirect_first_instance);
+    CHECK_RETURN(capacity > 0 && instance_size > 0 && instance_size % 16 == 0);
+    out->features = *features;
+    out->capacity = capacity;
+    out->cnt = 0;
+    out->instance_size = instance_size;
+
+    // NOTE: 後でGPUが描画コマンドと数を書き込めるように、ストレージバッファとしても使えるようにしておく。
+    void *commands;
+    CHECK_RETURN_VK(
+        create_mapped_buffer(
+            device,
+            mem_prop,
+            sizeof(VkDrawIndexedIndirectCommand) * (VkDeviceSize)capacity,
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            &out->commands,
+            &commands
+        )
+    );
+    void *count;
+    VkResult res = create_mapped_buffer(
+        device,
+        mem_prop,
+        sizeof(uint32_t),
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        &out->count,
+        &count
+    );
+    if (res != VK_SUCCESS) {
+        destroy_buffer(device, &out->commands);
+        return res;
+    }
+    void *instances;
+    res = create_mapped_buffer(
+        device,
+        mem_prop,
+        (VkDeviceSize)instance_size * capacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        &out->instances,
+        &instances
+    );
+    if (res != VK_SUCCESS) {
+        destroy_buffer(device, &out->commands);
+        destroy_buffer(device, &out->count);
+        return res;
+    }
+    out->mapped_commands = (VkDrawIndexedIndirectCommand *)commands;
+    out->mapped_count = (uint32_t *)count;
+    out->mapped_instances = (uint8_t *)instances;
+    *out->mapped_count = 0;
+    return VK_SUCCESS;
+}
+
+void reset_draw_list(DrawList *list) {
+    list->cnt = 0;
+    *list->mapped_count = 0;
+}
+
+VkResult push_draw(DrawList *list, const Model *model, const void *instance) {
+    CHECK_RETURN(list->cnt < list->capacity);
+    const uint32_t i = list->cnt;
+    const VkDrawIndexedIndirectCommand command = {
+        model->index_cnt,
+        1,
+        model->first_index,
+        (int32_t)model->first_vertex,
+        i,
+    };
+    // NOTE: 書き込み結合のメモリかもしれないので、読み戻さずに書き込むだけにする。
+    list->mapped_commands[i] = command;
+    memcpy(list->mapped_instances + (size_t)list->instance_size * i, instance, list->instance_size);
+    list->cnt = i + 1;
+    *list->mapped_count = list->cnt;
+    return VK_SUCCESS;
+}
+
+void cmd_draw_list(const VkCommandBuffer command, const DrawList *list) {
+    if (list->cnt == 0)
+        return;
+    const VkDeviceSize stride = sizeof(VkDrawIndexedIndirectCommand);
+    if (list->features.draw_indirect_count) {
+        // NOTE: 数をバッファから読むので、GPUが描画コマンドを詰めて書き込む場合もこのままでよい。cntは上限となる。
+        vkCmdDrawIndexedIndirectCount(command, list->commands.buffer, 0, list->count.buffer, 0, list->cnt, stride);
+    } else if (list->features.multi_draw_indirect) {
+        vkCmdDrawIndexedIndirect(command, list->commands.buffer, 0, list->cnt, stride);
+    } else {
+        // NOTE: drawCountは1に限られるので、描画コマンドを一つずつ読ませる。
+        for (uint32_t i = 0; i < list->cnt; ++i) {
+            vkCmdDrawIndexedIndirect(command, list->commands.buffer, stride * i, 1, stride);
+        }
+    }
+}
+
+void destroy_draw_list(const VkDevice device, DrawList *list) {
+    // NOTE: メモリの解放で暗黙にアンマップされる。
+    destroy_buffer(device, &list->commands);
+    destroy_buffer(device, &list->count);
+    destroy_buffer(device, &list->instances);
+    list->mapped_commands = NULL;
+    list->mapped_count = NULL;
+    list->mapped_instances = NULL;
+}
@@ -0,0 +1,78 @@
+#include "vulkan-tutorial.h"
+
+#ifdef _WIN32
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+VkResult map_file(const char *path, MappedFile *out) {
+    out->data = NULL;
+    out->size = 0;
+    out->handle = NULL;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    CHECK_RETURN(file != INVALID_HANDLE_VALUE);
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return VK_ERROR_UNKNOWN;
+    }
+    // NOTE: 空のファイルはマップできないので、サイズ0として扱う。
+    if (size.QuadPart == 0) {
+        CloseHandle(file);
+        return VK_SUCCESS;
+    }
+    // NOTE: マッピングオブジェクトを作れば、ファイルのハンドルは閉じてよい。
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    CHECK_RETURN(mapping != NULL);
+    const void *p = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (p == NULL) {
+        CloseHandle(mapping);
+        return VK_ERROR_UNKNOWN;
+    }
+    out->data = (const uint8_t *)p;
+    out->size = (size_t)size.QuadPart;
+    out->handle = (void *)mapping;
+#else
+    const int fd = open(path, O_RDONLY);
+    CHECK_RETURN(fd >= 0);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return VK_ERROR_UNKNOWN;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return VK_SUCCESS;
+    }
+    // NOTE: マップすれば、ファイルディスクリプタは閉じてよい。
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    CHECK_RETURN(p != MAP_FAILED);
+    // NOTE: 先頭から順に読むことをカーネルに伝え、先読みを促す。
+    madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+    out->data = (const uint8_t *)p;
+    out->size = (size_t)st.st_size;
+#endif
+    return VK_SUCCESS;
+}
+
+void unmap_file(MappedFile *file) {
+    if (file->data != NULL) {
+#ifdef _WIN32
+        UnmapViewOfFile((const void *)file->data);
+        CloseHandle((HANDLE)file->handle);
+#else
+        munmap((void *)file->data, file->size);
+#endif
+    }
+    file->data = NULL;
+    file->size = 0;
+    file->handle = NULL;
+}
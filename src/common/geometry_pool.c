@@ -0,0 +1,228 @@
+#include "vulkan-tutorial.h"
+
+#include <string.h>
+
+static VkResult init_free_list(uint32_t capacity, FreeList *out) {
+    out->cnt = 0;
+    out->cap = 16;
+    out->ranges = (FreeRange *)malloc(sizeof(FreeRange) * out->cap);
+    CHECK_RETURN(out->ranges != NULL);
+    if (capacity > 0) {
+        const FreeRange range = { 0, capacity };
+        out->ranges[0] = range;
+        out->cnt = 1;
+    }
+    return VK_SUCCESS;
+}
+
+// フリーリストから領域を切り出す関数。
+// NOTE: 先頭から探して最初に収まった範囲の前側を使う(first-fit)。範囲はオフセット順に並んでいる。
+static VkResult alloc_range(FreeList *list, uint32_t size, uint32_t *p_offset) {
+    if (size == 0) {
+        *p_offset = 0;
+        return VK_SUCCESS;
+    }
+    for (uint32_t i = 0; i < list->cnt; ++i) {
+        FreeRange *range = &list->ranges[i];
+        if (range->size < size)
+            continue;
+        *p_offset = range->offset;
+        range->offset += size;
+        range->size -= size;
+        if (range->size == 0) {
+            memmove(&list->ranges[i], &list->ranges[i + 1], sizeof(FreeRange) * (list->cnt - i - 1));
+            list->cnt -= 1;
+        }
+        return VK_SUCCESS;
+    }
+    return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+}
+
+// 領域をフリーリストに戻す関数。
+// NOTE: 隣接する範囲とは結合し、断片化を抑える。
+static VkResult free_range(FreeList *list, uint32_t offset, uint32_t size) {
+    if (size == 0)
+        return VK_SUCCESS;
+    // NOTE: offsetより後ろにある最初の範囲を二分探索する。
+    uint32_t lo = 0;
+    uint32_t hi = list->cnt;
+    while (lo < hi) {
+        const uint32_t mid = (lo + hi) / 2;
+        if (list->ranges[mid].offset < offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    const int merge_prev = lo > 0 && list->ranges[lo - 1].offset + list->ranges[lo - 1].size == offset;
+    const int merge_next = lo < list->cnt && offset + size == list->ranges[lo].offset;
+    if (merge_prev && merge_next) {
+        list->ranges[lo - 1].size += size + list->ranges[lo].size;
+        memmove(&list->ranges[lo], &list->ranges[lo + 1], sizeof(FreeRange) * (list->cnt - lo - 1));
+        list->cnt -= 1;
+        return VK_SUCCESS;
+    }
+    if (merge_prev) {
+        list->ranges[lo - 1].size += size;
+        return VK_SUCCESS;
+    }
+    if (merge_next) {
+        list->ranges[lo].offset = offset;
+        list->ranges[lo].size += size;
+        return VK_SUCCESS;
+    }
+    if (list->cnt == list->cap) {
+        const uint32_t cap = list->cap * 2;
+        FreeRange *ranges = (FreeRange *)realloc(list->ranges, sizeof(FreeRange) * cap);
+        CHECK_RETURN(ranges != NULL);
+        list->ranges = ranges;
+        list->cap = cap;
+    }
+    memmove(&list->ranges[lo + 1], &list->ranges[lo], sizeof(FreeRange) * (list->cnt - lo));
+    const FreeRange range = { offset, size };
+    list->ranges[lo] = range;
+    list->cnt += 1;
+    return VK_SUCCESS;
+}
+
+VkResult create_geometry_pool(
+    const VkDevice device,
+    const VkPhysicalDeviceMemoryProperties *mem_prop,
+    VertexFormat vertex_format,
+    VkIndexType index_type,
+    uint32_t vertex_capacity,
+    uint32_t index_capacity,
+    GeometryPool *out
+) {
+    out->vertex_format = vertex_format;
+    out->index_type = index_type;
+    out->vertex_capacity = vertex_capacity;
+    out->index_capacity = index_capacity;
+    out->vertex_free.ranges = NULL;
+    out->index_free.ranges = NULL;
+    CHECK_RETURN_VK(
+        create_buffer(
+            device,
+            mem_prop,
+            (VkDeviceSize)get_vertex_size(vertex_format) * vertex_capacity,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            &out->vertex
+        )
+    );
+    VkResult res = create_buffer(
+        device,
+        mem_prop,
+        (VkDeviceSize)get_index_size(index_type) * index_capacity,
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        &out->index
+    );
+    if (res != VK_SUCCESS) {
+        destroy_buffer(device, &out->vertex);
+        return res;
+    }
+    res = init_free_list(vertex_capacity, &out->vertex_free);
+    if (res == VK_SUCCESS)
+        res = init_free_list(index_capacity, &out->index_free);
+    if (res != VK_SUCCESS) {
+        destroy_geometry_pool(device, out);
+        return res;
+    }
+    return VK_SUCCESS;
+}
+
+VkResult alloc_geometry(GeometryPool *pool, uint32_t vertex_cnt, uint32_t index_cnt, Model *out) {
+    // NOTE: uint16_tのプールには、インデックスが収まるモデルしか置けない。
+    CHECK_RETURN(pool->index_type == VK_INDEX_TYPE_UINT32 || select_index_type(vertex_cnt) == VK_INDEX_TYPE_UINT16);
+    uint32_t first_vertex;
+    uint32_t first_index;
+    CHECK_RETURN_VK(alloc_range(&pool->vertex_free, vertex_cnt, &first_vertex));
+    const VkResult res = alloc_range(&pool->index_free, index_cnt, &first_index);
+    if (res != VK_SUCCESS) {
+        free_range(&pool->vertex_free, first_vertex, vertex_cnt);
+        return res;
+    }
+    out->index_cnt = index_cnt;
+    out->index_type = pool->index_type;
+    out->vertex = pool->vertex;
+    out->index = pool->index;
+    out->vertex_cnt = vertex_cnt;
+    out->first_vertex = first_vertex;
+    out->first_index = first_index;
+    for (uint32_t i = 0; i < 3; ++i) {
+        out->pos_scale[i] = 1.0f;
+        out->pos_offset[i] = 0.0f;
+    }
+    return VK_SUCCESS;
+}
+
+VkResult free_geometry(GeometryPool *pool, const Model *model) {
+    CHECK_RETURN_VK(free_range(&pool->vertex_free, model->first_vertex, model->vertex_cnt));
+    CHECK_RETURN_VK(free_range(&pool->index_free, model->first_index, model->index_cnt));
+    return VK_SUCCESS;
+}
+
+VkResult upload_geometry(
+    UploadContext *upload,
+    GeometryPool *pool,
+    uint32_t vertex_cnt,
+    const void *vtxs,
+    uint32_t index_cnt,
+    const uint32_t *idxs,
+    Model *out
+) {
+    CHECK_RETURN_VK(alloc_geometry(pool, vertex_cnt, index_cnt, out));
+    const VkDeviceSize vtxs_size = (VkDeviceSize)get_vertex_size(pool->vertex_format) * vertex_cnt;
+    const VkDeviceSize idxs_size = (VkDeviceSize)get_index_size(pool->index_type) * index_cnt;
+    const VkDeviceSize idxs_offset = (vtxs_size + 15) / 16 * 16;
+
+    // NOTE: コピーを記録する前に失敗しうる処理を済ませ、失敗したら領域をすぐに返せるようにする。
+    void *p;
+    VkDeviceSize offset;
+    const VkResult res = reserve_upload(upload, idxs_offset + idxs_size, 16, &p, &offset);
+    if (res != VK_SUCCESS) {
+        free_geometry(pool, out);
+        return res;
+    }
+    memcpy(p, vtxs, vtxs_size);
+    if (pool->index_type == VK_INDEX_TYPE_UINT16) {
+        uint16_t *narrow = (uint16_t *)((uint8_t *)p + idxs_offset);
+        for (uint32_t i = 0; i < index_cnt; ++i) {
+            narrow[i] = (uint16_t)idxs[i];
+        }
+    } else {
+        memcpy((uint8_t *)p + idxs_offset, idxs, idxs_size);
+    }
+    CHECK_RETURN_VK(
+        upload_buffer(
+            upload,
+            offset,
+            vtxs_size,
+            pool->vertex.buffer,
+            (VkDeviceSize)get_vertex_size(pool->vertex_format) * out->first_vertex,
+            VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+        )
+    );
+    CHECK_RETURN_VK(
+        upload_buffer(
+            upload,
+            offset + idxs_offset,
+            idxs_size,
+            pool->index.buffer,
+            (VkDeviceSize)get_index_size(pool->index_type) * out->first_index,
+            VK_ACCESS_INDEX_READ_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+        )
+    );
+    return VK_SUCCESS;
+}
+
+void destroy_geometry_pool(const VkDevice device, GeometryPool *pool) {
+    destroy_buffer(device, &pool->vertex);
+    destroy_buffer(device, &pool->index);
+    free(pool->vertex_free.ranges);
+    free(pool->index_free.ranges);
+    pool->vertex_free.ranges = NULL;
+    pool->index_free.ranges = NULL;
+}
@@ -0,0 +1,30 @@
+#include "vulkan-tutorial.h"
+
+#include <string.h>
+
+#define HASH_MUL 0x9E3779B97F4A7C15ULL
+
+static uint64_t mix(uint64_t h) {
+    h ^= h >> 32;
+    h *= 0xD6E8FEB86659FD93ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t hash_bytes(const void *data, size_t size, uint64_t seed) {
+    // NOTE: 8bytesずつ回転・XOR・乗算で混ぜる。1byteずつのFNV-1aよりずっと速い。
+    const uint8_t *p = (const uint8_t *)data;
+    uint64_t h = seed ^ (size * HASH_MUL);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t v;
+        memcpy(&v, p + i, 8);
+        h = (((h << 5) | (h >> 59)) ^ v) * HASH_MUL;
+    }
+    if (i < size) {
+        uint64_t v = 0;
+        memcpy(&v, p + i, size - i);
+        h = (((h << 5) | (h >> 59)) ^ v) * HASH_MUL;
+    }
+    return mix(h);
+}
@@ -0,0 +1,312 @@
+#include "vulkan-tutorial.h"
+
+#define HIZ_GROUP_SIZE 8 // NOTE: シェーダのlocal_size_x・local_size_yと揃える。
+#define HIZ_FORMAT VK_FORMAT_R32_SFLOAT
+
+// 縮小のシェーダに渡すプッシュ定数。
+// NOTE: 読む側の大きさはシェーダでtextureSizeから得る。
+typedef struct HiZConstant_t {
+    int32_t dst_size[2];
+} HiZConstant;
+
+static uint32_t get_mip_size(uint32_t size, uint32_t level) {
+    const uint32_t s = size >> level;
+    return s > 0 ? s : 1;
+}
+
+// Hi-Zピラミッドのビュー・サンプラ・ディスクリプタセット・パイプラインを作成する関数。
+// NOTE: 失敗したときに作りかけのものが残るので、呼び出し側で破棄すること。
+static VkResult create_hiz_pipeline(const VkDevice device, const VkShaderModule shader, const VkImageView *depth_views, HiZ *out) {
+    // NOTE: 縮小では、一つ上のミップを読んで一つのミップに書くので、ミップごとのビューも作る。
+    out->mip_views = (VkImageView *)malloc(sizeof(VkImageView) * out->mip_cnt);
+    CHECK_RETURN(out->mip_views != NULL);
+    for (uint32_t i = 0; i < out->mip_cnt; ++i) {
+        out->mip_views[i] = VK_NULL_HANDLE;
+    }
+    for (uint32_t i = 0; i < out->mip_cnt; ++i) {
+        const VkImageViewCreateInfo ci = {
+            VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            NULL,
+            0,
+            out->texture.image,
+            VK_IMAGE_VIEW_TYPE_2D,
+            HIZ_FORMAT,
+            { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A },
+            { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 },
+        };
+        CHECK_RETURN_VK(vkCreateImageView(device, &ci, NULL, &out->mip_views[i]));
+    }
+
+    // sampler
+    // NOTE: texelFetchでしか読まないので、補間はしない。
+    {
+        const VkSamplerCreateInfo ci = {
+            VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+            NULL,
+            0,
+            VK_FILTER_NEAREST,
+            VK_FILTER_NEAREST,
+            VK_SAMPLER_MIPMAP_MODE_NEAREST,
+            VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            0.0,
+            0,
+            1.0,
+            0,
+            VK_COMPARE_OP_NEVER,
+            0.0,
+            VK_LOD_CLAMP_NONE,
+            VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE,
+            0,
+        };
+        CHECK_RETURN_VK(vkCreateSampler(device, &ci, NULL, &out->sampler));
+    }
+
+    // descriptor sets
+    // NOTE: ミップ0はデプスバッファから作るので、デプスバッファごとに一つずつ、残りはミップごとに一つずつ用意する。
+    const uint32_t set_cnt = out->depth_cnt + out->mip_cnt - 1;
+    {
+        const VkDescriptorSetLayoutBinding binds[] = {
+            {
+                0,
+                VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                1,
+                VK_SHADER_STAGE_COMPUTE_BIT,
+                NULL,
+            },
+            {
+                1,
+                VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                1,
+                VK_SHADER_STAGE_COMPUTE_BIT,
+                NULL,
+            },
+        };
+        const VkDescriptorSetLayoutCreateInfo layout_ci = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            NULL,
+            0,
+            2,
+            binds,
+        };
+        CHECK_RETURN_VK(vkCreateDescriptorSetLayout(device, &layout_ci, NULL, &out->descriptor_set_layout));
+        const VkDescriptorPoolSize pool_sizes[] = {
+            {
+                VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                set_cnt,
+            },
+            {
+                VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                set_cnt,
+            },
+        };
+        const VkDescriptorPoolCreateInfo pool_ci = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            NULL,
+            0,
+            set_cnt,
+            2,
+            pool_sizes,
+        };
+        CHECK_RETURN_VK(vkCreateDescriptorPool(device, &pool_ci, NULL, &out->descriptor_pool));
+        out->descriptor_sets = (VkDescriptorSet *)malloc(sizeof(VkDescriptorSet) * set_cnt);
+        CHECK_RETURN(out->descriptor_sets != NULL);
+        for (uint32_t i = 0; i < set_cnt; ++i) {
+            const VkDescriptorSetAllocateInfo ai = {
+                VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+                NULL,
+                out->descriptor_pool,
+                1,
+                &out->descriptor_set_layout,
+            };
+            CHECK_RETURN_VK(vkAllocateDescriptorSets(device, &ai, &out->descriptor_sets[i]));
+            const uint32_t level = i < out->depth_cnt ? 0 : i - out->depth_cnt + 1;
+            const VkDescriptorImageInfo src_ii = {
+                out->sampler,
+                i < out->depth_cnt ? depth_views[i] : out->mip_views[level - 1],
+                i < out->depth_cnt ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL,
+            };
+            const VkDescriptorImageInfo dst_ii = {
+                VK_NULL_HANDLE,
+                out->mip_views[level],
+                VK_IMAGE_LAYOUT_GENERAL,
+            };
+            const VkWriteDescriptorSet writes[] = {
+                {
+                    VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    NULL,
+                    out->descriptor_sets[i],
+                    0,
+                    0,
+                    1,
+                    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                    &src_ii,
+                    NULL,
+                    NULL,
+                },
+                {
+                    VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    NULL,
+                    out->descriptor_sets[i],
+                    1,
+                    0,
+                    1,
+                    VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                    &dst_ii,
+                    NULL,
+                    NULL,
+                },
+            };
+            vkUpdateDescriptorSets(device, 2, writes, 0, NULL);
+        }
+    }
+
+    // pipeline
+    {
+        const VkPushConstantRange push_constant_ranges[] = {
+            {
+                VK_SHADER_STAGE_COMPUTE_BIT,
+                0,
+                sizeof(HiZConstant),
+            },
+        };
+        const VkPipelineLayoutCreateInfo layout_ci = {
+            VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            NULL,
+            0,
+            1,
+            &out->descriptor_set_layout,
+            1,
+            push_constant_ranges,
+        };
+        CHECK_RETURN_VK(vkCreatePipelineLayout(device, &layout_ci, NULL, &out->pipeline_layout));
+        const VkComputePipelineCreateInfo ci = {
+            VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            NULL,
+            0,
+            {
+                VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                NULL,
+                0,
+                VK_SHADER_STAGE_COMPUTE_BIT,
+                shader,
+                "main",
+                NULL,
+            },
+            out->pipeline_layout,
+            VK_NULL_HANDLE,
+            0,
+        };
+        CHECK_RETURN_VK(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &ci, NULL, &out->pipeline));
+    }
+    return VK_SUCCESS;
+}
+
+VkResult create_hiz(
+    const VkDevice device,
+    const VkPhysicalDeviceMemoryProperties *mem_prop,
+    const VkShaderModule shader,
+    uint32_t width,
+    uint32_t height,
+    uint32_t depth_cnt,
+    const VkImageView *depth_views,
+    HiZ *out
+) {
+    // NOTE: ミップ0はデプスバッファの半分の解像度とし、1x1になるまで半分にしていく。
+    out->width = width > 1 ? width / 2 : 1;
+    out->height = height > 1 ? height / 2 : 1;
+    out->mip_cnt = 1;
+    while (get_mip_size(out->width, out->mip_cnt - 1) > 1 || get_mip_size(out->height, out->mip_cnt - 1) > 1)
+        out->mip_cnt += 1;
+    out->depth_cnt = depth_cnt;
+    out->built = VK_FALSE;
+
+    out->mip_views = NULL;
+    out->sampler = VK_NULL_HANDLE;
+    out->descriptor_set_layout = VK_NULL_HANDLE;
+    out->descriptor_pool = VK_NULL_HANDLE;
+    out->descriptor_sets = NULL;
+    out->pipeline_layout = VK_NULL_HANDLE;
+    out->pipeline = VK_NULL_HANDLE;
+
+    // image
+    CHECK_RETURN_VK(
+        create_texture(
+            device,
+            mem_prop,
+            HIZ_FORMAT,
+            out->width,
+            out->height,
+            out->mip_cnt,
+            VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_IMAGE_ASPECT_COLOR_BIT,
+            NULL,
+            &out->texture
+        )
+    );
+
+    // NOTE: ここから先で失敗したら、作ったものをdestroy_hizでまとめて破棄する。
+    const VkResult res = create_hiz_pipeline(device, shader, depth_views, out);
+    if (res != VK_SUCCESS) {
+        destroy_hiz(device, out);
+        return res;
+    }
+    return VK_SUCCESS;
+}
+
+void cmd_build_hiz(const VkCommandBuffer command, HiZ *hiz, uint32_t depth_index) {
+    vkCmdBindPipeline(command, VK_PIPELINE_BIND_POINT_COMPUTE, hiz->pipeline);
+    for (uint32_t level = 0; level < hiz->mip_cnt; ++level) {
+        const HiZConstant constant = {
+            { (int32_t)get_mip_size(hiz->width, level), (int32_t)get_mip_size(hiz->height, level) },
+        };
+        const VkDescriptorSet set = hiz->descriptor_sets[level == 0 ? depth_index : hiz->depth_cnt + level - 1];
+        vkCmdBindDescriptorSets(command, VK_PIPELINE_BIND_POINT_COMPUTE, hiz->pipeline_layout, 0, 1, &set, 0, NULL);
+        vkCmdPushConstants(command, hiz->pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(HiZConstant), (const void *)&constant);
+        vkCmdDispatch(
+            command,
+            ((uint32_t)constant.dst_size[0] + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE,
+            ((uint32_t)constant.dst_size[1] + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE,
+            1
+        );
+        // NOTE: 書いたミップを次の縮小から読めるようにする。最後のミップの後は、呼び出し側が次のカリングと同期する。
+        if (level + 1 == hiz->mip_cnt)
+            break;
+        const VkMemoryBarrier barrier = {
+            VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            NULL,
+            VK_ACCESS_SHADER_WRITE_BIT,
+            VK_ACCESS_SHADER_READ_BIT,
+        };
+        vkCmdPipelineBarrier(
+            command,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0,
+            1,
+            &barrier,
+            0,
+            NULL,
+            0,
+            NULL
+        );
+    }
+    hiz->built = VK_TRUE;
+}
+
+void destroy_hiz(const VkDevice device, HiZ *hiz) {
+    vkDestroyPipeline(device, hiz->pipeline, NULL);
+    vkDestroyPipelineLayout(device, hiz->pipeline_layout, NULL);
+    vkDestroyDescriptorPool(device, hiz->descriptor_pool, NULL);
+    vkDestroyDescriptorSetLayout(device, hiz->descriptor_set_layout, NULL);
+    vkDestroySampler(device, hiz->sampler, NULL);
+    for (uint32_t i = 0; hiz->mip_views != NULL && i < hiz->mip_cnt; ++i) {
+        vkDestroyImageView(device, hiz->mip_views[i], NULL);
+    }
+    free(hiz->mip_views);
+    free(hiz->descriptor_sets);
+    hiz->mip_views = NULL;
+    hiz->descriptor_sets = NULL;
+    destroy_texture(device, &hiz->texture);
+}
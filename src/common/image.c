@@ -1,41 +1,130 @@
 #include "vulkan-tutorial.h"
 
+#include <string.h>
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define USE_SSSE3
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON)
+#define USE_NEON
+#include <arm_neon.h>
+#endif
+
+// RGBの画素列をアルファ255のRGBAに展開する関数(スカラー版)。
+static void expand_rgb_to_rgba_scalar(const uint8_t *src, uint8_t *dst, size_t pixel_cnt) {
+    for (size_t i = 0; i < pixel_cnt; ++i) {
+        dst[i * 4 + 0] = src[i * 3 + 0];
+        dst[i * 4 + 1] = src[i * 3 + 1];
+        dst[i * 4 + 2] = src[i * 3 + 2];
+        dst[i * 4 + 3] = 0xFF;
+    }
+}
+
+#if defined(USE_SSSE3)
+// NOTE: -mssse3なしでもビルドできるよう関数単位で有効にし、実行時にCPUの対応を調べて呼び分ける。
+__attribute__((target("ssse3")))
+static void expand_rgb_to_rgba_ssse3(const uint8_t *src, uint8_t *dst, size_t pixel_cnt) {
+    // NOTE: 12bytes(4画素)を16bytesに並べ替え、空いたアルファの位置を0xFFで埋める。
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+    // NOTE: 16画素(48bytes)ずつ処理する。
+    size_t i = 0;
+    for (; i + 16 <= pixel_cnt; i += 16) {
+        const __m128i a = _mm_loadu_si128((const __m128i *)(src + i * 3));
+        const __m128i b = _mm_loadu_si128((const __m128i *)(src + i * 3 + 16));
+        const __m128i c = _mm_loadu_si128((const __m128i *)(src + i * 3 + 32));
+        const __m128i p0 = a;
+        const __m128i p1 = _mm_alignr_epi8(b, a, 12);
+        const __m128i p2 = _mm_alignr_epi8(c, b, 8);
+        const __m128i p3 = _mm_srli_si128(c, 4);
+        _mm_storeu_si128((__m128i *)(dst + i * 4), _mm_or_si128(_mm_shuffle_epi8(p0, shuffle), alpha));
+        _mm_storeu_si128((__m128i *)(dst + i * 4 + 16), _mm_or_si128(_mm_shuffle_epi8(p1, shuffle), alpha));
+        _mm_storeu_si128((__m128i *)(dst + i * 4 + 32), _mm_or_si128(_mm_shuffle_epi8(p2, shuffle), alpha));
+        _mm_storeu_si128((__m128i *)(dst + i * 4 + 48), _mm_or_si128(_mm_shuffle_epi8(p3, shuffle), alpha));
+    }
+    expand_rgb_to_rgba_scalar(src + i * 3, dst + i * 4, pixel_cnt - i);
+}
+#elif defined(USE_NEON)
+static void expand_rgb_to_rgba_neon(const uint8_t *src, uint8_t *dst, size_t pixel_cnt) {
+    // NOTE: vld3/vst4でチャンネルごとに分けて読み、アルファを足して書き戻す。
+    const uint8x16_t alpha = vdupq_n_u8(0xFF);
+    size_t i = 0;
+    for (; i + 16 <= pixel_cnt; i += 16) {
+        const uint8x16x3_t rgb = vld3q_u8(src + i * 3);
+        const uint8x16x4_t rgba = { { rgb.val[0], rgb.val[1], rgb.val[2], alpha } };
+        vst4q_u8(dst + i * 4, rgba);
+    }
+    expand_rgb_to_rgba_scalar(src + i * 3, dst + i * 4, pixel_cnt - i);
+}
+#endif
+
+static void expand_rgb_to_rgba(const uint8_t *src, uint8_t *dst, size_t pixel_cnt) {
+#if defined(USE_SSSE3)
+    if (__builtin_cpu_supports("ssse3")) {
+        expand_rgb_to_rgba_ssse3(src, dst, pixel_cnt);
+        return;
+    }
+#elif defined(USE_NEON)
+    expand_rgb_to_rgba_neon(src, dst, pixel_cnt);
+    return;
+#endif
+    expand_rgb_to_rgba_scalar(src, dst, pixel_cnt);
+}
+
 VkResult create_image_texture_from_file(
     const VkDevice device,
     const VkPhysicalDeviceMemoryProperties *mem_prop,
-    const VkCommandPool command_pool,
-    const VkQueue queue,
+    UploadContext *upload,
     const char *path,
     Texture *out
 ) {
-    // NOTE: 画像ファイルをstbで読み込む。
+    // NOTE: 画像ファイルをstbで読み込む。チャンネル数はファイルのまま。
     int width = 0;
     int height = 0;
     int channel_cnt = 0;
     unsigned char *pixels = stbi_load(path, &width, &height, &channel_cnt, 0);
     CHECK_RETURN(pixels != NULL);
-    CHECK_RETURN(channel_cnt == 4);
+    if (channel_cnt < 1 || channel_cnt > 4) {
+        stbi_image_free((void *)pixels);
+        return VK_ERROR_UNKNOWN;
+    }
 
-    // NOTE: 定数定義。
-    const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
-    const int32_t size = width * height * 4;
+    // NOTE: チャンネル数に応じてフォーマットとビューのスウィズルを決める。
+    // NOTE: R8G8B8はサンプリングに対応しないデバイスが多いので、RGBだけはRGBAに展開する。
+    static const VkFormat FORMATS[4] = {
+        VK_FORMAT_R8_UNORM,
+        VK_FORMAT_R8G8_UNORM,
+        VK_FORMAT_R8G8B8A8_UNORM,
+        VK_FORMAT_R8G8B8A8_UNORM,
+    };
+    static const VkComponentMapping COMPONENTS[4] = {
+        { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_ONE },
+        { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G },
+        { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A },
+        { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A },
+    };
+    const VkFormat format = FORMATS[channel_cnt - 1];
+    const size_t pixel_cnt = (size_t)width * (size_t)height;
+    const size_t texel_size = channel_cnt == 3 ? 4 : (size_t)channel_cnt;
 
-    // NOTE: ステージングバッファを作る。
-    Buffer staging;
-    CHECK_RETURN_VK(
-        create_buffer(
-            device,
-            mem_prop,
-            (VkDeviceSize)size,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-            &staging
-        )
-    );
-    CHECK_RETURN_VK(map_memory(device, staging.memory, (void *)pixels, size));
+    // NOTE: ステージングバッファの領域を予約して、画素を書き込む。
+    // NOTE: ステージングバッファはアップロードコンテキストが複数の転送でまとめて使う。
+    // NOTE: RGBの展開もステージングバッファへ直接書き込み、一時バッファは使わない。
+    void *p;
+    VkDeviceSize offset;
+    const VkResult result = reserve_upload(upload, (VkDeviceSize)(pixel_cnt * texel_size), 16, &p, &offset);
+    if (result != VK_SUCCESS) {
+        stbi_image_free((void *)pixels);
+        return result;
+    }
+    if (channel_cnt == 3)
+        expand_rgb_to_rgba((const uint8_t *)pixels, (uint8_t *)p, pixel_cnt);
+    else
+        memcpy(p, pixels, pixel_cnt * texel_size);
+    stbi_image_free((void *)pixels);
 
     // NOTE: Textureを初期化する。
     CHECK_RETURN_VK(
@@ -45,113 +134,25 @@ VkResult create_image_texture_from_file(
             format,
             width,
             height,
+            1,
             VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
             VK_IMAGE_ASPECT_COLOR_BIT,
+            &COMPONENTS[channel_cnt - 1],
             out
         )
     );
 
-    // NOTE: コマンドバッファを作成し、開始する。
-    VkCommandBuffer command;
-    {
-        // NOTE: コマンドバッファをアロケートする。
-        const VkCommandBufferAllocateInfo ai = {
-            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-            NULL,
-            command_pool,
-            VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-            1,
-        };
-        CHECK_RETURN_VK(vkAllocateCommandBuffers(device, &ai, &command));
-        // NOTE: コマンドの記録を開始する。
-        const VkCommandBufferBeginInfo bi = {
-            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-            NULL,
-            0,
-            NULL,
-        };
-        CHECK_RETURN_VK(vkBeginCommandBuffer(command, &bi));
-    }
-
-    // TODO: もっと詳しく説明する。
     // NOTE: コピーのためのコマンドを記録する。
-    {
-        VkImageMemoryBarrier image_memory_barrier = {
-            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-            NULL,
-            0,
-            VK_ACCESS_TRANSFER_WRITE_BIT,
-            VK_IMAGE_LAYOUT_UNDEFINED,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            VK_QUEUE_FAMILY_IGNORED,
-            VK_QUEUE_FAMILY_IGNORED,
-            out->image,
-            { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
-        };
-        vkCmdPipelineBarrier(
-            command,
-            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-            VK_PIPELINE_STAGE_TRANSFER_BIT,
-            0,
-            0,
-            NULL,
-            0,
-            NULL,
-            1,
-            &image_memory_barrier
-        );
-        const VkBufferImageCopy copy_region = {
-            0,
-            0,
-            0,
-            { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
-            { 0, 0, 0 },
-            { width, height, 1 },
-        };
-        vkCmdCopyBufferToImage(command, staging.buffer, out->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy_region);
-        image_memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        image_memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        image_memory_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        image_memory_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        vkCmdPipelineBarrier(
-            command,
-            VK_PIPELINE_STAGE_TRANSFER_BIT,
-            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-            0,
-            0,
-            NULL,
-            0,
-            NULL,
-            1,
-            &image_memory_barrier
-        );
-    }
-
-    // NOTE: コマンドの記録を終了して提出する。
-    {
-        vkEndCommandBuffer(command);
-        const VkSubmitInfo si = {
-            VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            NULL,
-            0,
-            NULL,
-            NULL,
-            1,
-            &command,
-            0,
-            NULL,
-        };
-        CHECK_RETURN_VK(vkQueueSubmit(queue, 1, &si, VK_NULL_HANDLE));
-    }
-
-    // NOTE: コマンドが処理されるのを待つ。
-    vkDeviceWaitIdle(device);
-
-    // NOTE: 不要なリソースを解放する。
-    vkFreeCommandBuffers(device, command_pool, 1, &command);
-    vkFreeMemory(device, staging.memory, NULL);
-    vkDestroyBuffer(device, staging.buffer, NULL);
-    stbi_image_free((void *)pixels);
+    // NOTE: 提出はアップロードコンテキストのフラッシュ時にまとめて行う。
+    const VkBufferImageCopy copy_region = {
+        0,
+        0,
+        0,
+        { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+        { 0, 0, 0 },
+        { width, height, 1 },
+    };
+    CHECK_RETURN_VK(upload_image(upload, offset, out->image, 1, 1, &copy_region, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT));
 
     return VK_SUCCESS;
 }
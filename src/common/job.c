@@ -0,0 +1,140 @@
+#include "vulkan-tutorial.h"
+
+#include <pthread.h>
+#ifdef _WIN32
+#    include <windows.h>
+#else
+#    include <unistd.h>
+#endif
+
+// ワーカースレッドと呼び出し側が共有する状態。
+// NOTE: 仕事の受け渡しはすべてmutexの下で行う。チャンクは粗いので、ロックの競合は問題にならない。
+typedef struct JobState_t {
+    pthread_mutex_t mutex;
+    pthread_cond_t wake; // NOTE: ワーカーが仕事を待つ。
+    pthread_cond_t done; // NOTE: 呼び出し側が完了を待つ。
+    pthread_t *threads;
+    JobFunc func;
+    void *user;
+    uint32_t cnt;
+    uint32_t grain;
+    uint32_t next; // NOTE: まだ誰も取っていない最初の要素。cnt以上なら仕事はない。
+    uint32_t remaining; // NOTE: まだ終わっていない要素の数。
+    int quit;
+} JobState;
+
+static uint32_t get_core_cnt() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (uint32_t)info.dwNumberOfProcessors;
+#else
+    const long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (uint32_t)n : 1;
+#endif
+}
+
+// mutexを持った状態で、チャンクを一つ取って実行する関数。チャンクがなければ0を返す。
+// NOTE: 実行中はmutexを手放す。
+static int run_chunk(JobState *state) {
+    if (state->next >= state->cnt)
+        return 0;
+    const uint32_t begin = state->next;
+    const uint32_t end = state->cnt - begin > state->grain ? begin + state->grain : state->cnt;
+    const JobFunc func = state->func;
+    void *user = state->user;
+    state->next = end;
+    pthread_mutex_unlock(&state->mutex);
+    func(user, begin, end);
+    pthread_mutex_lock(&state->mutex);
+    state->remaining -= end - begin;
+    if (state->remaining == 0)
+        pthread_cond_broadcast(&state->done);
+    return 1;
+}
+
+static void *worker_main(void *arg) {
+    JobState *state = (JobState *)arg;
+    pthread_mutex_lock(&state->mutex);
+    while (!state->quit) {
+        if (!run_chunk(state))
+            pthread_cond_wait(&state->wake, &state->mutex);
+    }
+    pthread_mutex_unlock(&state->mutex);
+    return NULL;
+}
+
+VkResult create_job_system(uint32_t thread_cnt, JobSystem *out) {
+    // NOTE: 呼び出し側のスレッドも仕事をするので、既定ではコア数より一つ少なく作る。
+    out->thread_cnt = thread_cnt > 0 ? thread_cnt : get_core_cnt() - 1;
+    out->state = NULL;
+    JobState *state = (JobState *)malloc(sizeof(JobState));
+    CHECK_RETURN(state != NULL);
+    state->threads = out->thread_cnt > 0 ? (pthread_t *)malloc(sizeof(pthread_t) * out->thread_cnt) : NULL;
+    if (out->thread_cnt > 0 && state->threads == NULL) {
+        free(state);
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+    pthread_mutex_init(&state->mutex, NULL);
+    pthread_cond_init(&state->wake, NULL);
+    pthread_cond_init(&state->done, NULL);
+    state->func = NULL;
+    state->user = NULL;
+    state->cnt = 0;
+    state->grain = 1;
+    state->next = 0;
+    state->remaining = 0;
+    state->quit = 0;
+    out->state = (void *)state;
+    for (uint32_t i = 0; i < out->thread_cnt; ++i) {
+        if (pthread_create(&state->threads[i], NULL, worker_main, (void *)state) != 0) {
+            out->thread_cnt = i;
+            destroy_job_system(out);
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+    }
+    return VK_SUCCESS;
+}
+
+void run_jobs(JobSystem *jobs, uint32_t cnt, uint32_t grain, JobFunc func, void *user) {
+    if (cnt == 0)
+        return;
+    // NOTE: ワーカーがいなければ、その場ですべて実行する。
+    if (jobs == NULL || jobs->thread_cnt == 0) {
+        func(user, 0, cnt);
+        return;
+    }
+    JobState *state = (JobState *)jobs->state;
+    pthread_mutex_lock(&state->mutex);
+    state->func = func;
+    state->user = user;
+    state->cnt = cnt;
+    state->grain = grain > 0 ? grain : 1;
+    state->next = 0;
+    state->remaining = cnt;
+    pthread_cond_broadcast(&state->wake);
+    while (run_chunk(state));
+    while (state->remaining > 0)
+        pthread_cond_wait(&state->done, &state->mutex);
+    pthread_mutex_unlock(&state->mutex);
+}
+
+void destroy_job_system(JobSystem *jobs) {
+    JobState *state = (JobState *)jobs->state;
+    if (state == NULL)
+        return;
+    pthread_mutex_lock(&state->mutex);
+    state->quit = 1;
+    pthread_cond_broadcast(&state->wake);
+    pthread_mutex_unlock(&state->mutex);
+    for (uint32_t i = 0; i < jobs->thread_cnt; ++i) {
+        pthread_join(state->threads[i], NULL);
+    }
+    pthread_cond_destroy(&state->done);
+    pthread_cond_destroy(&state->wake);
+    pthread_mutex_destroy(&state->mutex);
+    free(state->threads);
+    free(state);
+    jobs->state = NULL;
+    jobs->thread_cnt = 0;
+}
@@ -0,0 +1,9 @@
+#include "vulkan-tutorial.h"
+
+void mul_mat4(const float *a, const float *b, float *out) {
+    for (uint32_t c = 0; c < 4; ++c) {
+        for (uint32_t r = 0; r < 4; ++r) {
+            out[c * 4 + r] = a[r] * b[c * 4] + a[4 + r] * b[c * 4 + 1] + a[8 + r] * b[c * 4 + 2] + a[12 + r] * b[c * 4 + 3];
+        }
+    }
+}
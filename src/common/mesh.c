@@ -0,0 +1,398 @@
+#include "vulkan-tutorial.h"
+
+#include <string.h>
+#include <time.h>
+
+static double get_time_sec() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// floatをhalfに丸める関数。最近接偶数丸め。
+static uint16_t float_to_half(float f) {
+    uint32_t x;
+    memcpy(&x, &f, sizeof(uint32_t));
+    const uint16_t sign = (uint16_t)((x >> 16) & 0x8000);
+    x &= 0x7FFFFFFF;
+    // NOTE: 無限大・NaN、およびhalfで表せない大きさ(65520以上)。
+    if (x >= 0x7F800000)
+        return sign | 0x7C00 | (x > 0x7F800000 ? 0x0200 : 0);
+    if (x >= 0x477FF000)
+        return sign | 0x7C00;
+    // NOTE: halfの非正規化数。2^-24を単位として丸める。
+    if (x < 0x38800000) {
+        float a;
+        memcpy(&a, &x, sizeof(float));
+        return sign | (uint16_t)(a * 16777216.0f + 0.5f);
+    }
+    // NOTE: 指数のバイアスを127から15へ付け替え、仮数の下位13bitを丸める。
+    x += 0xC8000FFF + ((x >> 13) & 1);
+    return sign | (uint16_t)(x >> 13);
+}
+
+static uint16_t to_snorm16(float f) {
+    const float c = f < -1.0f ? -1.0f : f > 1.0f ? 1.0f : f;
+    return (uint16_t)(int16_t)(c * 32767.0f + (c < 0.0f ? -0.5f : 0.5f));
+}
+
+static uint16_t to_unorm16(float f) {
+    return (uint16_t)(f * 65535.0f + 0.5f);
+}
+
+// 頂点を量子化してdstへ書き込む関数。UVが[0, 1]を外れる頂点があれば、unorm16では表せないので失敗する。
+// NOTE: dstはステージングバッファなので、書き込むだけで読まない。
+static VkResult pack_vertices(VertexFormat vertex_format, const MeshVertex *src, uint32_t vertex_cnt, PackedVertex *dst, Model *model) {
+    // NOTE: 丸めて詰めると繰り返しのUVが黙って潰れるので、書き込む前に確かめる。NaNもここで弾く。
+    for (uint32_t i = 0; i < vertex_cnt; ++i) {
+        for (uint32_t k = 0; k < 2; ++k) {
+            CHECK_RETURN(src[i].uv[k] >= 0.0f && src[i].uv[k] <= 1.0f);
+        }
+    }
+    if (vertex_format == VERTEX_FORMAT_SNORM16 && vertex_cnt > 0) {
+        // NOTE: AABBの中心をpos_offset、半分の大きさをpos_scaleとし、[-1, 1]に正規化する。
+        float min[3], max[3];
+        for (uint32_t k = 0; k < 3; ++k) {
+            min[k] = src[0].pos[k];
+            max[k] = src[0].pos[k];
+        }
+        for (uint32_t i = 1; i < vertex_cnt; ++i) {
+            for (uint32_t k = 0; k < 3; ++k) {
+                min[k] = src[i].pos[k] < min[k] ? src[i].pos[k] : min[k];
+                max[k] = src[i].pos[k] > max[k] ? src[i].pos[k] : max[k];
+            }
+        }
+        for (uint32_t k = 0; k < 3; ++k) {
+            const float extent = (max[k] - min[k]) * 0.5f;
+            model->pos_offset[k] = (max[k] + min[k]) * 0.5f;
+            model->pos_scale[k] = extent > 0.0f ? extent : 1.0f;
+        }
+    }
+    float inv_scale[3];
+    for (uint32_t k = 0; k < 3; ++k) {
+        inv_scale[k] = 1.0f / model->pos_scale[k];
+    }
+    for (uint32_t i = 0; i < vertex_cnt; ++i) {
+        PackedVertex v;
+        if (vertex_format == VERTEX_FORMAT_SNORM16) {
+            for (uint32_t k = 0; k < 3; ++k) {
+                v.pos[k] = to_snorm16((src[i].pos[k] - model->pos_offset[k]) * inv_scale[k]);
+            }
+            v.pos[3] = 0x7FFF;
+        } else {
+            for (uint32_t k = 0; k < 3; ++k) {
+                v.pos[k] = float_to_half(src[i].pos[k]);
+            }
+            v.pos[3] = 0x3C00;
+        }
+        v.uv[0] = to_unorm16(src[i].uv[0]);
+        v.uv[1] = to_unorm16(src[i].uv[1]);
+        dst[i] = v;
+    }
+    return VK_SUCCESS;
+}
+
+// モデルのバッファを作り(またはジオメトリプールから領域を確保し)、頂点とインデックスを書き込むステージングバッファ上の領域を返す関数。
+// NOTE: reserve_uploadは途中でフラッシュしうるので、頂点とインデックスの領域は一度に予約する。
+// NOTE: 失敗した場合は、作ったバッファ・確保した領域を解放してから返す。
+static VkResult begin_model(
+    const VkDevice device,
+    const VkPhysicalDeviceMemoryProperties *mem_prop,
+    UploadContext *upload,
+    GeometryPool *pool,
+    VertexFormat vertex_format,
+    VkIndexType index_type,
+    uint32_t vertex_cnt,
+    uint32_t index_cnt,
+    Model *out,
+    void **p_vtxs,
+    void **p_idxs,
+    VkDeviceSize *p_offset
+) {
+    const VkDeviceSize vtxs_size = (VkDeviceSize)get_vertex_size(vertex_format) * vertex_cnt;
+    const VkDeviceSize idxs_size = (VkDeviceSize)get_index_size(index_type) * index_cnt;
+    const VkDeviceSize idxs_offset = (vtxs_size + 15) / 16 * 16;
+    if (pool != NULL) {
+        CHECK_RETURN_VK(alloc_geometry(pool, vertex_cnt, index_cnt, out));
+    } else {
+        out->index_cnt = index_cnt;
+        out->index_type = index_type;
+        out->vertex_cnt = vertex_cnt;
+        out->first_vertex = 0;
+        out->first_index = 0;
+        for (uint32_t i = 0; i < 3; ++i) {
+            out->pos_scale[i] = 1.0f;
+            out->pos_offset[i] = 0.0f;
+        }
+        CHECK_RETURN_VK(
+            create_buffer(
+                device,
+                mem_prop,
+                vtxs_size,
+                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                &out->vertex
+            )
+        );
+        const VkResult res = create_buffer(
+            device,
+            mem_prop,
+            idxs_size,
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            &out->index
+        );
+        if (res != VK_SUCCESS) {
+            destroy_buffer(device, &out->vertex);
+            return res;
+        }
+    }
+    void *p;
+    const VkResult res = reserve_upload(upload, idxs_offset + idxs_size, 16, &p, p_offset);
+    if (res != VK_SUCCESS) {
+        if (pool != NULL)
+            free_geometry(pool, out);
+        else
+            destroy_model(device, out);
+        return res;
+    }
+    *p_vtxs = p;
+    *p_idxs = (uint8_t *)p + idxs_offset;
+    return VK_SUCCESS;
+}
+
+// begin_modelで得た領域に書き込み終えたあと、コピーを記録する関数。
+static VkResult end_model(UploadContext *upload, const Model *model, VkDeviceSize vertex_size, VkDeviceSize index_size, VkDeviceSize offset) {
+    const VkDeviceSize vtxs_size = vertex_size * model->vertex_cnt;
+    const VkDeviceSize idxs_offset = (vtxs_size + 15) / 16 * 16;
+    CHECK_RETURN_VK(
+        upload_buffer(
+            upload,
+            offset,
+            vtxs_size,
+            model->vertex.buffer,
+            vertex_size * model->first_vertex,
+            VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+        )
+    );
+    CHECK_RETURN_VK(
+        upload_buffer(
+            upload,
+            offset + idxs_offset,
+            index_size * model->index_cnt,
+            model->index.buffer,
+            index_size * model->first_index,
+            VK_ACCESS_INDEX_READ_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+        )
+    );
+    return VK_SUCCESS;
+}
+
+// create_mesh_from_file・create_mesh_in_poolで使う、アップロードコンテキストへ書き込むMeshWriterの状態。
+// NOTE: 変換の要る頂点・インデックスは作業領域(scratch_*)へ読ませ、end_upload_writerで変換して書き込む。
+// NOTE: インデックスは読み込み側の大きさ(index_size)が書き込み先と同じなら、ステージングバッファへ直接書かせる。
+typedef struct UploadWriter_t {
+    VkDevice device;
+    const VkPhysicalDeviceMemoryProperties *mem_prop;
+    UploadContext *upload;
+    GeometryPool *pool;
+    VertexFormat vertex_format;
+    Mesh *out;
+    uint32_t model_cap;
+    void *vtxs;
+    void *idxs;
+    VkDeviceSize offset;
+    uint32_t index_size;
+    uint32_t scratch_vertex_cap;
+    size_t scratch_index_cap; // NOTE: bytes
+    MeshVertex *scratch_vtxs;
+    void *scratch_idxs;
+    VkDeviceSize written;
+    double start;
+    double sec;
+} UploadWriter;
+
+static VkResult begin_upload_writer(void *user, uint32_t vertex_cnt, uint32_t index_cnt, uint32_t index_size, MeshVertex **p_vtxs, void **p_idxs) {
+    UploadWriter *w = (UploadWriter *)user;
+    w->start = get_time_sec();
+    Mesh *out = w->out;
+    if (out->model_cnt == w->model_cap) {
+        const uint32_t cap = w->model_cap > 0 ? w->model_cap * 2 : 16;
+        Model *models = (Model *)realloc(out->models, sizeof(Model) * cap);
+        CHECK_RETURN(models != NULL);
+        out->models = models;
+        w->model_cap = cap;
+    }
+    const int packed = w->vertex_format != VERTEX_FORMAT_FLOAT32;
+    const VkIndexType index_type = w->pool != NULL ? w->pool->index_type : select_index_type(vertex_cnt);
+    const int convert = index_size != get_index_size(index_type);
+    if (packed && vertex_cnt > w->scratch_vertex_cap) {
+        MeshVertex *vtxs = (MeshVertex *)realloc(w->scratch_vtxs, sizeof(MeshVertex) * vertex_cnt);
+        CHECK_RETURN(vtxs != NULL);
+        w->scratch_vtxs = vtxs;
+        w->scratch_vertex_cap = vertex_cnt;
+    }
+    if (convert && (size_t)index_size * index_cnt > w->scratch_index_cap) {
+        void *idxs = realloc(w->scratch_idxs, (size_t)index_size * index_cnt);
+        CHECK_RETURN(idxs != NULL);
+        w->scratch_idxs = idxs;
+        w->scratch_index_cap = (size_t)index_size * index_cnt;
+    }
+    w->index_size = index_size;
+
+    CHECK_RETURN_VK(
+        begin_model(
+            w->device,
+            w->mem_prop,
+            w->upload,
+            w->pool,
+            w->vertex_format,
+            index_type,
+            vertex_cnt,
+            index_cnt,
+            &out->models[out->model_cnt],
+            &w->vtxs,
+            &w->idxs,
+            &w->offset
+        )
+    );
+    // NOTE: 書き込みの途中で失敗しても破棄できるよう、ここで数に含める。
+    out->model_cnt += 1;
+    *p_vtxs = packed ? w->scratch_vtxs : (MeshVertex *)w->vtxs;
+    *p_idxs = convert ? w->scratch_idxs : w->idxs;
+    return VK_SUCCESS;
+}
+
+static VkResult end_upload_writer(void *user) {
+    UploadWriter *w = (UploadWriter *)user;
+    Model *model = &w->out->models[w->out->model_cnt - 1];
+    if (w->vertex_format != VERTEX_FORMAT_FLOAT32) {
+        CHECK_RETURN_VK(pack_vertices(w->vertex_format, w->scratch_vtxs, model->vertex_cnt, (PackedVertex *)w->vtxs, model));
+    }
+    const VkDeviceSize vertex_size = get_vertex_size(w->vertex_format);
+    const VkDeviceSize index_size = get_index_size(model->index_type);
+    if (w->index_size != index_size) {
+        // NOTE: 読み込み側と書き込み先でインデックスの大きさが違うときだけ、詰めるか広げる。
+        if (model->index_type == VK_INDEX_TYPE_UINT16) {
+            const uint32_t *src = (const uint32_t *)w->scratch_idxs;
+            uint16_t *dst = (uint16_t *)w->idxs;
+            for (uint32_t i = 0; i < model->index_cnt; ++i) {
+                dst[i] = (uint16_t)src[i];
+            }
+        } else {
+            const uint16_t *src = (const uint16_t *)w->scratch_idxs;
+            uint32_t *dst = (uint32_t *)w->idxs;
+            for (uint32_t i = 0; i < model->index_cnt; ++i) {
+                dst[i] = src[i];
+            }
+        }
+    }
+    CHECK_RETURN_VK(end_model(w->upload, model, vertex_size, index_size, w->offset));
+    w->written += vertex_size * model->vertex_cnt + index_size * model->index_cnt;
+    w->sec += get_time_sec() - w->start;
+    return VK_SUCCESS;
+}
+
+static VkResult load_mesh(
+    const VkDevice device,
+    const VkPhysicalDeviceMemoryProperties *mem_prop,
+    UploadContext *upload,
+    GeometryPool *pool,
+    const char *path,
+    VertexFormat vertex_format,
+    Mesh *out
+) {
+    out->pool = pool;
+    out->vertex_format = vertex_format;
+    out->model_cnt = 0;
+    out->models = NULL;
+    UploadWriter w = { device, mem_prop, upload, pool, vertex_format, out, 0, NULL, NULL, 0, 0, 0, 0, NULL, NULL, 0, 0.0, 0.0 };
+    MeshWriter writer = { (void *)&w, begin_upload_writer, end_upload_writer };
+
+    const double start = get_time_sec();
+    size_t read_size = 0;
+    const VkResult res = read_mesh_file(path, &writer, &read_size);
+    free(w.scratch_vtxs);
+    free(w.scratch_idxs);
+    if (res != VK_SUCCESS) {
+        // NOTE: 作成済みのモデルへのコピーが記録されているかもしれないので、提出してから遅延解放する。
+        uint64_t value = 0;
+        flush_upload_context(upload, &value);
+        for (uint32_t i = 0; i < out->model_cnt; ++i) {
+            if (pool != NULL)
+                defer_free_geometry(upload->deletion_queue, value, pool, &out->models[i]);
+            else
+                defer_destroy_model(upload->deletion_queue, value, &out->models[i]);
+        }
+        free(out->models);
+        out->model_cnt = 0;
+        out->models = NULL;
+        return res;
+    }
+
+    // NOTE: 解析(ファイルの読み込みを含む)と、ステージングバッファへの書き込みの速度を報告する。
+    // NOTE: 書き込みの時間はbegin_modelからend_modelまでの合計で、それ以外を解析の時間とみなす。
+    const double parse_sec = get_time_sec() - start - w.sec;
+    printf(
+        "[ Info    ] %s: %u models, parse %.1f MB/s (%.2f MB), upload %.1f MB/s (%.2f MB)\n",
+        path,
+        out->model_cnt,
+        (double)read_size / 1e6 / (parse_sec > 0.0 ? parse_sec : 1e-9),
+        (double)read_size / 1e6,
+        (double)w.written / 1e6 / (w.sec > 0.0 ? w.sec : 1e-9),
+        (double)w.written / 1e6
+    );
+    return VK_SUCCESS;
+}
+
+VkResult create_mesh_from_file(
+    const VkDevice device,
+    const VkPhysicalDeviceMemoryProperties *mem_prop,
+    UploadContext *upload,
+    const char *path,
+    VertexFormat vertex_format,
+    Mesh *out
+) {
+    return load_mesh(device, mem_prop, upload, NULL, path, vertex_format, out);
+}
+
+VkResult create_mesh_in_pool(UploadContext *upload, GeometryPool *pool, const char *path, Mesh *out) {
+    return load_mesh(upload->device, upload->mem_prop, upload, pool, path, pool->vertex_format, out);
+}
+
+void get_vertex_input(VertexFormat vertex_format, VkVertexInputBindingDescription *binding, VkVertexInputAttributeDescription *attrs) {
+    if (vertex_format == VERTEX_FORMAT_FLOAT32) {
+        const VkVertexInputBindingDescription b = { 0, sizeof(MeshVertex), VK_VERTEX_INPUT_RATE_VERTEX };
+        const VkVertexInputAttributeDescription pos = { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 };
+        const VkVertexInputAttributeDescription uv = { 1, 0, VK_FORMAT_R32G32_SFLOAT, sizeof(float) * 3 };
+        *binding = b;
+        attrs[0] = pos;
+        attrs[1] = uv;
+        return;
+    }
+    const VkVertexInputBindingDescription b = { 0, sizeof(PackedVertex), VK_VERTEX_INPUT_RATE_VERTEX };
+    const VkVertexInputAttributeDescription pos = {
+        0,
+        0,
+        vertex_format == VERTEX_FORMAT_HALF ? VK_FORMAT_R16G16B16A16_SFLOAT : VK_FORMAT_R16G16B16A16_SNORM,
+        0,
+    };
+    const VkVertexInputAttributeDescription uv = { 1, 0, VK_FORMAT_R16G16_UNORM, sizeof(uint16_t) * 4 };
+    *binding = b;
+    attrs[0] = pos;
+    attrs[1] = uv;
+}
+
+void destroy_mesh(const VkDevice device, Mesh *mesh) {
+    for (uint32_t i = 0; i < mesh->model_cnt; ++i) {
+        if (mesh->pool != NULL)
+            free_geometry(mesh->pool, &mesh->models[i]);
+        else
+            destroy_model(device, &mesh->models[i]);
+    }
+    free(mesh->models);
+    mesh->model_cnt = 0;
+    mesh->models = NULL;
+}
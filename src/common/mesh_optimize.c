@@ -0,0 +1,338 @@
+#include "vulkan-tutorial.h"
+
+#include <math.h>
+#include <string.h>
+
+// NOTE: Forsythのアルゴリズムが想定するLRUキャッシュのサイズ。
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_MAX_VALENCE 32
+// NOTE: オーバードローの最適化と統計で使うFIFOキャッシュのサイズ。
+#define FIFO_CACHE_SIZE 16
+
+// NOTE: 頂点のスコアの表。キャッシュ内の位置と、未出力の隣接三角形の数から引く。
+static float g_cache_scores[FORSYTH_CACHE_SIZE];
+static float g_valence_scores[FORSYTH_MAX_VALENCE];
+
+static void init_forsyth_scores() {
+    if (g_valence_scores[1] > 0.0f)
+        return;
+    for (uint32_t i = 0; i < FORSYTH_CACHE_SIZE; ++i) {
+        // NOTE: 直前の三角形の頂点は、どの順で出力しても同じなので一定のスコアにする。
+        g_cache_scores[i] = i < 3 ? 0.75f : powf(1.0f - (float)(i - 3) / (float)(FORSYTH_CACHE_SIZE - 3), 1.5f);
+    }
+    for (uint32_t i = 1; i < FORSYTH_MAX_VALENCE; ++i) {
+        // NOTE: 残りの三角形が少ない頂点を優先し、孤立した三角形が後に残らないようにする。
+        g_valence_scores[i] = 2.0f * powf((float)i, -0.5f);
+    }
+}
+
+static float get_vertex_score(int32_t cache_pos, uint32_t live) {
+    if (live == 0)
+        return -1.0f;
+    const float cache_score = cache_pos >= 0 ? g_cache_scores[cache_pos] : 0.0f;
+    return cache_score + g_valence_scores[live < FORSYTH_MAX_VALENCE ? live : FORSYTH_MAX_VALENCE - 1];
+}
+
+VkResult optimize_vertex_cache(uint32_t *idxs, uint32_t index_cnt, uint32_t vertex_cnt) {
+    init_forsyth_scores();
+    const uint32_t tri_cnt = index_cnt / 3;
+    if (tri_cnt == 0)
+        return VK_SUCCESS;
+
+    // NOTE: 作業用の配列はまとめて一度に確保する。
+    uint8_t *mem = (uint8_t *)malloc(sizeof(uint32_t) * (vertex_cnt * 4 + 1 + tri_cnt * 6) + tri_cnt);
+    CHECK_RETURN(mem != NULL);
+    uint32_t *live = (uint32_t *)mem;
+    uint32_t *offsets = live + vertex_cnt;
+    uint32_t *adjacency = offsets + vertex_cnt + 1;
+    uint32_t *out = adjacency + tri_cnt * 3;
+    int32_t *cache_pos = (int32_t *)(out + tri_cnt * 3);
+    float *vertex_scores = (float *)(cache_pos + vertex_cnt);
+    uint8_t *emitted = (uint8_t *)(vertex_scores + vertex_cnt);
+    memset(live, 0, sizeof(uint32_t) * vertex_cnt);
+    memset(emitted, 0, tri_cnt);
+
+    // NOTE: 頂点ごとに、隣接する三角形の一覧を作る。
+    for (uint32_t i = 0; i < tri_cnt * 3; ++i) {
+        live[idxs[i]] += 1;
+    }
+    offsets[0] = 0;
+    for (uint32_t v = 0; v < vertex_cnt; ++v) {
+        offsets[v + 1] = offsets[v] + live[v];
+        live[v] = 0;
+    }
+    for (uint32_t t = 0; t < tri_cnt; ++t) {
+        for (uint32_t k = 0; k < 3; ++k) {
+            const uint32_t v = idxs[t * 3 + k];
+            adjacency[offsets[v] + live[v]] = t;
+            live[v] += 1;
+        }
+    }
+    for (uint32_t v = 0; v < vertex_cnt; ++v) {
+        cache_pos[v] = -1;
+        vertex_scores[v] = get_vertex_score(-1, live[v]);
+    }
+
+    uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+    uint32_t cache_cnt = 0;
+    uint32_t scan = 0;
+    int64_t best = -1;
+    for (uint32_t n = 0; n < tri_cnt; ++n) {
+        // NOTE: キャッシュ内の頂点から候補が見つからなければ、未出力の三角形を入力順に探す。
+        if (best < 0) {
+            while (emitted[scan])
+                scan += 1;
+            best = scan;
+        }
+        const uint32_t *tri = &idxs[best * 3];
+        memcpy(&out[n * 3], tri, sizeof(uint32_t) * 3);
+        emitted[best] = 1;
+
+        // NOTE: 出力した三角形を、各頂点の隣接一覧から取り除く。
+        for (uint32_t k = 0; k < 3; ++k) {
+            const uint32_t v = tri[k];
+            uint32_t *adj = &adjacency[offsets[v]];
+            for (uint32_t j = 0; j < live[v]; ++j) {
+                if (adj[j] == (uint32_t)best) {
+                    adj[j] = adj[live[v] - 1];
+                    break;
+                }
+            }
+            live[v] -= 1;
+        }
+
+        // NOTE: 三角形の頂点をLRUキャッシュの先頭に入れる。あふれた頂点は追い出す。
+        uint32_t new_cache[FORSYTH_CACHE_SIZE + 3];
+        uint32_t new_cnt = 0;
+        for (uint32_t k = 0; k < 3; ++k) {
+            if (k > 0 && tri[k] == tri[0])
+                continue;
+            if (k > 1 && tri[k] == tri[1])
+                continue;
+            new_cache[new_cnt++] = tri[k];
+        }
+        for (uint32_t i = 0; i < cache_cnt; ++i) {
+            const uint32_t v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                new_cache[new_cnt++] = v;
+        }
+        for (uint32_t i = FORSYTH_CACHE_SIZE; i < new_cnt; ++i) {
+            cache_pos[new_cache[i]] = -1;
+            vertex_scores[new_cache[i]] = get_vertex_score(-1, live[new_cache[i]]);
+        }
+        cache_cnt = new_cnt < FORSYTH_CACHE_SIZE ? new_cnt : FORSYTH_CACHE_SIZE;
+        for (uint32_t i = 0; i < cache_cnt; ++i) {
+            cache[i] = new_cache[i];
+            cache_pos[cache[i]] = (int32_t)i;
+            vertex_scores[cache[i]] = get_vertex_score((int32_t)i, live[cache[i]]);
+        }
+
+        // NOTE: キャッシュ内の頂点に隣接する三角形から、スコアが最大のものを次に選ぶ。
+        best = -1;
+        float best_score = -1.0f;
+        for (uint32_t i = 0; i < new_cnt; ++i) {
+            const uint32_t v = new_cache[i];
+            const uint32_t *adj = &adjacency[offsets[v]];
+            for (uint32_t j = 0; j < live[v]; ++j) {
+                const uint32_t t = adj[j];
+                const float score = vertex_scores[idxs[t * 3]] + vertex_scores[idxs[t * 3 + 1]] + vertex_scores[idxs[t * 3 + 2]];
+                if (i < cache_cnt && score > best_score) {
+                    best = t;
+                    best_score = score;
+                }
+            }
+        }
+    }
+    memcpy(idxs, out, sizeof(uint32_t) * tri_cnt * 3);
+    free(mem);
+    return VK_SUCCESS;
+}
+
+// FIFOキャッシュに三角形を一つ通し、ミスの数を返す関数。
+// NOTE: タイムスタンプで表すので、キャッシュを空にするにはtimestampをFIFO_CACHE_SIZEより大きく進めればよい。
+static uint32_t simulate_fifo(const uint32_t *tri, uint32_t *timestamps, uint32_t *p_timestamp) {
+    uint32_t misses = 0;
+    for (uint32_t k = 0; k < 3; ++k) {
+        if (*p_timestamp - timestamps[tri[k]] > FIFO_CACHE_SIZE) {
+            timestamps[tri[k]] = *p_timestamp;
+            *p_timestamp += 1;
+            misses += 1;
+        }
+    }
+    return misses;
+}
+
+typedef struct Cluster_t {
+    uint32_t start;
+    uint32_t end;
+    float key;
+} Cluster;
+
+static int compare_clusters(const void *a, const void *b) {
+    const float ka = ((const Cluster *)a)->key;
+    const float kb = ((const Cluster *)b)->key;
+    return ka > kb ? -1 : ka < kb ? 1 : 0;
+}
+
+VkResult optimize_overdraw(uint32_t *idxs, uint32_t index_cnt, const MeshVertex *vtxs, uint32_t vertex_cnt, float threshold) {
+    const uint32_t tri_cnt = index_cnt / 3;
+    if (tri_cnt == 0)
+        return VK_SUCCESS;
+    Cluster *clusters = (Cluster *)malloc(sizeof(Cluster) * tri_cnt + sizeof(uint32_t) * (vertex_cnt + tri_cnt * 4 + 1));
+    CHECK_RETURN(clusters != NULL);
+    uint32_t *timestamps = (uint32_t *)(clusters + tri_cnt);
+    uint32_t *out = timestamps + vertex_cnt;
+    uint32_t *hard = out + tri_cnt * 3;
+
+    // NOTE: 3頂点ともミスする三角形、つまりキャッシュが総入れ替えされる位置で区切る(ハードな境界)。
+    uint32_t timestamp = FIFO_CACHE_SIZE + 1;
+    memset(timestamps, 0, sizeof(uint32_t) * vertex_cnt);
+    uint32_t hard_cnt = 0;
+    for (uint32_t t = 0; t < tri_cnt; ++t) {
+        if (simulate_fifo(&idxs[t * 3], timestamps, &timestamp) == 3 || t == 0)
+            hard[hard_cnt++] = t;
+    }
+    hard[hard_cnt] = tri_cnt;
+
+    // NOTE: さらに、区切ってもACMRがthreshold倍以内に収まる位置で細かく区切る(ソフトな境界)。
+    // NOTE: 細かいほど並べ替えの自由度が上がり、オーバードローを減らせる。
+    uint32_t cluster_cnt = 0;
+    for (uint32_t h = 0; h < hard_cnt; ++h) {
+        const uint32_t start = hard[h];
+        const uint32_t end = hard[h + 1];
+        timestamp += FIFO_CACHE_SIZE + 1;
+        uint32_t misses = 0;
+        for (uint32_t t = start; t < end; ++t) {
+            misses += simulate_fifo(&idxs[t * 3], timestamps, &timestamp);
+        }
+        const float target = threshold * (float)misses / (float)(end - start);
+
+        timestamp += FIFO_CACHE_SIZE + 1;
+        uint32_t sub_start = start;
+        uint32_t running = 0;
+        for (uint32_t t = start; t < end; ++t) {
+            running += simulate_fifo(&idxs[t * 3], timestamps, &timestamp);
+            if (t + 1 < end && (float)running / (float)(t + 1 - sub_start) <= target) {
+                clusters[cluster_cnt].start = sub_start;
+                clusters[cluster_cnt].end = t + 1;
+                cluster_cnt += 1;
+                sub_start = t + 1;
+                running = 0;
+                timestamp += FIFO_CACHE_SIZE + 1;
+            }
+        }
+        clusters[cluster_cnt].start = sub_start;
+        clusters[cluster_cnt].end = end;
+        cluster_cnt += 1;
+    }
+
+    // NOTE: メッシュの中心から見て外側を向いたクラスタほど手前に来やすいので、先に描く。
+    float mesh_center[3] = { 0.0f, 0.0f, 0.0f };
+    for (uint32_t i = 0; i < tri_cnt * 3; ++i) {
+        for (uint32_t k = 0; k < 3; ++k) {
+            mesh_center[k] += vtxs[idxs[i]].pos[k];
+        }
+    }
+    for (uint32_t k = 0; k < 3; ++k) {
+        mesh_center[k] /= (float)(tri_cnt * 3);
+    }
+    for (uint32_t c = 0; c < cluster_cnt; ++c) {
+        float center[3] = { 0.0f, 0.0f, 0.0f };
+        float normal[3] = { 0.0f, 0.0f, 0.0f };
+        float area = 0.0f;
+        for (uint32_t t = clusters[c].start; t < clusters[c].end; ++t) {
+            const float *p0 = vtxs[idxs[t * 3]].pos;
+            const float *p1 = vtxs[idxs[t * 3 + 1]].pos;
+            const float *p2 = vtxs[idxs[t * 3 + 2]].pos;
+            const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            const float n[3] = {
+                e1[1] * e2[2] - e1[2] * e2[1],
+                e1[2] * e2[0] - e1[0] * e2[2],
+                e1[0] * e2[1] - e1[1] * e2[0],
+            };
+            const float a = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (uint32_t k = 0; k < 3; ++k) {
+                center[k] += (p0[k] + p1[k] + p2[k]) / 3.0f * a;
+                normal[k] += n[k];
+            }
+            area += a;
+        }
+        const float inv_area = area > 0.0f ? 1.0f / area : 0.0f;
+        const float len = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        const float inv_len = len > 0.0f ? 1.0f / len : 0.0f;
+        float key = 0.0f;
+        for (uint32_t k = 0; k < 3; ++k) {
+            key += (center[k] * inv_area - mesh_center[k]) * normal[k] * inv_len;
+        }
+        clusters[c].key = key;
+    }
+    qsort(clusters, cluster_cnt, sizeof(Cluster), compare_clusters);
+
+    uint32_t n = 0;
+    for (uint32_t c = 0; c < cluster_cnt; ++c) {
+        const uint32_t cnt = (clusters[c].end - clusters[c].start) * 3;
+        memcpy(&out[n], &idxs[clusters[c].start * 3], sizeof(uint32_t) * cnt);
+        n += cnt;
+    }
+    memcpy(idxs, out, sizeof(uint32_t) * tri_cnt * 3);
+    free(clusters);
+    return VK_SUCCESS;
+}
+
+VkResult optimize_vertex_fetch(MeshVertex *vtxs, uint32_t *p_vertex_cnt, uint32_t *idxs, uint32_t index_cnt) {
+    const uint32_t vertex_cnt = *p_vertex_cnt;
+    MeshVertex *src = (MeshVertex *)malloc((sizeof(MeshVertex) + sizeof(uint32_t)) * vertex_cnt);
+    CHECK_RETURN(src != NULL);
+    uint32_t *remap = (uint32_t *)(src + vertex_cnt);
+
+    // NOTE: インデックスで初めて参照された順に頂点を並べ直す。参照されない頂点は捨てる。
+    memcpy(src, vtxs, sizeof(MeshVertex) * vertex_cnt);
+    memset(remap, 0xFF, sizeof(uint32_t) * vertex_cnt);
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < index_cnt; ++i) {
+        const uint32_t v = idxs[i];
+        if (remap[v] == UINT32_MAX) {
+            remap[v] = next;
+            vtxs[next] = src[v];
+            next += 1;
+        }
+        idxs[i] = remap[v];
+    }
+    *p_vertex_cnt = next;
+    free(src);
+    return VK_SUCCESS;
+}
+
+VkResult optimize_mesh(MeshVertex *vtxs, uint32_t *p_vertex_cnt, uint32_t *idxs, uint32_t index_cnt) {
+    CHECK_RETURN_VK(optimize_vertex_cache(idxs, index_cnt, *p_vertex_cnt));
+    CHECK_RETURN_VK(optimize_overdraw(idxs, index_cnt, vtxs, *p_vertex_cnt, OVERDRAW_THRESHOLD));
+    CHECK_RETURN_VK(optimize_vertex_fetch(vtxs, p_vertex_cnt, idxs, index_cnt));
+    return VK_SUCCESS;
+}
+
+void analyze_vertex_cache(const uint32_t *idxs, uint32_t index_cnt, uint32_t vertex_cnt, VertexCacheStats *out) {
+    out->acmr = 0.0f;
+    out->atvr = 0.0f;
+    const uint32_t tri_cnt = index_cnt / 3;
+    if (tri_cnt == 0)
+        return;
+    uint32_t *timestamps = (uint32_t *)calloc(vertex_cnt, sizeof(uint32_t) + 1);
+    if (timestamps == NULL)
+        return;
+    uint8_t *used = (uint8_t *)(timestamps + vertex_cnt);
+
+    uint32_t timestamp = FIFO_CACHE_SIZE + 1;
+    uint32_t misses = 0;
+    uint32_t used_cnt = 0;
+    for (uint32_t t = 0; t < tri_cnt; ++t) {
+        misses += simulate_fifo(&idxs[t * 3], timestamps, &timestamp);
+        for (uint32_t k = 0; k < 3; ++k) {
+            used_cnt += used[idxs[t * 3 + k]] == 0;
+            used[idxs[t * 3 + k]] = 1;
+        }
+    }
+    out->acmr = (float)misses / (float)tri_cnt;
+    out->atvr = (float)misses / (float)used_cnt;
+    free(timestamps);
+}
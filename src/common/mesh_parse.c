@@ -0,0 +1,841 @@
+#include "vulkan-tutorial.h"
+
+#include <math.h>
+#include <string.h>
+
+#define JSON_MAX_DEPTH 64
+#define GLB_MAGIC 0x46546C67
+#define GLB_CHUNK_JSON 0x4E4F534A
+#define GLB_CHUNK_BIN 0x004E4942
+#define MAX_GLTF_BUFFERS 16
+
+// NOTE: 配列の末尾に一つ追加する。足りなければ倍に拡張する。
+#define PUSH_ITEM(arr, cnt, cap, type, v) {                                 \
+    if ((cnt) == (cap)) {                                                   \
+        const uint32_t new_cap = (cap) > 0 ? (cap) * 2 : 256;               \
+        type *p = (type *)realloc((arr), sizeof(type) * new_cap);           \
+        CHECK_RETURN(p != NULL);                                            \
+        (arr) = p;                                                          \
+        (cap) = new_cap;                                                    \
+    }                                                                       \
+    (arr)[(cnt)] = (v);                                                     \
+    (cnt) += 1;                                                             \
+}
+
+typedef enum JsonType_t {
+    JSON_TYPE_OBJECT,
+    JSON_TYPE_ARRAY,
+    JSON_TYPE_STRING,
+    JSON_TYPE_PRIMITIVE,
+} JsonType;
+
+// JSONのトークン。値は複製せず、元の文字列の範囲[start, end)で表す。
+// NOTE: sizeは直下の子トークンの数。オブジェクトではキーと値の両方を数える。
+typedef struct JsonToken_t {
+    JsonType type;
+    uint32_t start;
+    uint32_t end;
+    uint32_t size;
+} JsonToken;
+
+typedef struct Json_t {
+    const char *src;
+    uint32_t token_cnt;
+    uint32_t token_cap;
+    JsonToken *tokens;
+} Json;
+
+// JSONをトークンの配列に分解する関数。
+// NOTE: 文字列のエスケープは展開しない。glTFで参照するキーやURIには不要なため。
+// NOTE: 失敗した場合もjson->tokensは呼び出し側で解放すること。
+static VkResult parse_json(const char *src, size_t len, Json *json) {
+    json->src = src;
+    json->token_cnt = 0;
+    json->token_cap = 0;
+    json->tokens = NULL;
+    CHECK_RETURN(len < UINT32_MAX);
+
+    uint32_t stack[JSON_MAX_DEPTH];
+    uint32_t depth = 0;
+    size_t i = 0;
+    while (i < len) {
+        const char c = src[i];
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == ',' || c == ':') {
+            i += 1;
+            continue;
+        }
+        if (c == '}' || c == ']') {
+            CHECK_RETURN(depth > 0);
+            depth -= 1;
+            json->tokens[stack[depth]].end = (uint32_t)(i + 1);
+            i += 1;
+            continue;
+        }
+
+        if (depth > 0)
+            json->tokens[stack[depth - 1]].size += 1;
+        JsonToken token = { JSON_TYPE_PRIMITIVE, (uint32_t)i, 0, 0 };
+        if (c == '{' || c == '[') {
+            CHECK_RETURN(depth < JSON_MAX_DEPTH);
+            token.type = c == '{' ? JSON_TYPE_OBJECT : JSON_TYPE_ARRAY;
+            stack[depth] = json->token_cnt;
+            depth += 1;
+            i += 1;
+        } else if (c == '"') {
+            token.type = JSON_TYPE_STRING;
+            token.start = (uint32_t)(i + 1);
+            i += 1;
+            while (i < len && src[i] != '"')
+                i += src[i] == '\\' ? 2 : 1;
+            CHECK_RETURN(i < len);
+            token.end = (uint32_t)i;
+            i += 1;
+        } else {
+            while (i < len && strchr(" \t\n\r,:]}", src[i]) == NULL)
+                i += 1;
+            token.end = (uint32_t)i;
+        }
+        PUSH_ITEM(json->tokens, json->token_cnt, json->token_cap, JsonToken, token);
+    }
+    CHECK_RETURN(depth == 0 && json->token_cnt > 0);
+    return VK_SUCCESS;
+}
+
+// トークンiとその子孫を飛ばした、次のトークンの位置を返す関数。
+static uint32_t skip_json(const Json *json, uint32_t i) {
+    uint32_t pending = 1;
+    while (pending > 0) {
+        if (json->tokens[i].type == JSON_TYPE_OBJECT || json->tokens[i].type == JSON_TYPE_ARRAY)
+            pending += json->tokens[i].size;
+        pending -= 1;
+        i += 1;
+    }
+    return i;
+}
+
+static int eq_json(const Json *json, int32_t i, const char *s) {
+    const size_t len = strlen(s);
+    const JsonToken *t = &json->tokens[i];
+    return t->end - t->start == len && memcmp(json->src + t->start, s, len) == 0;
+}
+
+// オブジェクトobjからキーkeyの値のトークンを探す関数。なければ-1を返す。
+static int32_t find_json(const Json *json, int32_t obj, const char *key) {
+    if (obj < 0 || json->tokens[obj].type != JSON_TYPE_OBJECT)
+        return -1;
+    uint32_t i = (uint32_t)obj + 1;
+    for (uint32_t n = 0; n < json->tokens[obj].size / 2; ++n) {
+        if (eq_json(json, i, key))
+            return (int32_t)i + 1;
+        i = skip_json(json, i + 1);
+    }
+    return -1;
+}
+
+// 配列arrの要素のトークン位置を、tableに列挙する関数。
+// NOTE: 毎回先頭から辿らずに済むよう、accessorsなどは最初に一度だけ列挙しておく。
+static VkResult list_json(const Json *json, int32_t arr, uint32_t *p_cnt, int32_t **p_table) {
+    *p_cnt = 0;
+    *p_table = NULL;
+    if (arr < 0)
+        return VK_SUCCESS;
+    CHECK_RETURN(json->tokens[arr].type == JSON_TYPE_ARRAY);
+    const uint32_t cnt = json->tokens[arr].size;
+    int32_t *table = (int32_t *)malloc(sizeof(int32_t) * (cnt > 0 ? cnt : 1));
+    CHECK_RETURN(table != NULL);
+    uint32_t i = (uint32_t)arr + 1;
+    for (uint32_t n = 0; n < cnt; ++n) {
+        table[n] = (int32_t)i;
+        i = skip_json(json, i);
+    }
+    *p_cnt = cnt;
+    *p_table = table;
+    return VK_SUCCESS;
+}
+
+// 整数のトークンを読む関数。トークンがなければdefを返す。
+static int64_t int_json(const Json *json, int32_t i, int64_t def) {
+    if (i < 0 || json->tokens[i].type != JSON_TYPE_PRIMITIVE)
+        return def;
+    const char *p = json->src + json->tokens[i].start;
+    const char *end = json->src + json->tokens[i].end;
+    const int negative = p < end && *p == '-';
+    if (negative)
+        p += 1;
+    int64_t v = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p)
+        v = v * 10 + (*p - '0');
+    return negative ? -v : v;
+}
+
+// アクセサが指すデータ。マップしたファイル上を直接指す。
+typedef struct Accessor_t {
+    const uint8_t *data;
+    uint32_t stride;
+    uint32_t count;
+    uint32_t component_type;
+    uint32_t component_cnt;
+    int normalized;
+} Accessor;
+
+typedef struct Gltf_t {
+    Json json;
+    uint32_t buffer_cnt;
+    const uint8_t *buffer_datas[MAX_GLTF_BUFFERS];
+    size_t buffer_sizes[MAX_GLTF_BUFFERS];
+    MappedFile buffer_files[MAX_GLTF_BUFFERS];
+    uint32_t accessor_cnt;
+    int32_t *accessors;
+    uint32_t buffer_view_cnt;
+    int32_t *buffer_views;
+} Gltf;
+
+static uint32_t get_component_size(uint32_t component_type) {
+    switch (component_type) {
+        case 5120: case 5121: return 1; // NOTE: BYTE, UNSIGNED_BYTE
+        case 5122: case 5123: return 2; // NOTE: SHORT, UNSIGNED_SHORT
+        case 5125: case 5126: return 4; // NOTE: UNSIGNED_INT, FLOAT
+        default: return 0;
+    }
+}
+
+// アクセサを解決し、データの位置を境界検査したうえで返す関数。
+static VkResult resolve_accessor(const Gltf *gltf, int64_t index, Accessor *out) {
+    const Json *json = &gltf->json;
+    CHECK_RETURN(index >= 0 && index < gltf->accessor_cnt);
+    const int32_t acc = gltf->accessors[index];
+    // NOTE: スパースアクセサは展開が必要になるので対応しない。
+    CHECK_RETURN(find_json(json, acc, "sparse") < 0);
+
+    const int64_t view_index = int_json(json, find_json(json, acc, "bufferView"), -1);
+    CHECK_RETURN(view_index >= 0 && view_index < gltf->buffer_view_cnt);
+    const int32_t view = gltf->buffer_views[view_index];
+    const int64_t buffer_index = int_json(json, find_json(json, view, "buffer"), -1);
+    CHECK_RETURN(buffer_index >= 0 && buffer_index < gltf->buffer_cnt);
+    const int64_t view_offset = int_json(json, find_json(json, view, "byteOffset"), 0);
+    const int64_t view_length = int_json(json, find_json(json, view, "byteLength"), -1);
+    const int64_t view_stride = int_json(json, find_json(json, view, "byteStride"), 0);
+    CHECK_RETURN(view_offset >= 0 && view_length >= 0);
+    CHECK_RETURN((uint64_t)(view_offset + view_length) <= gltf->buffer_sizes[buffer_index]);
+
+    const int32_t type = find_json(json, acc, "type");
+    CHECK_RETURN(type >= 0);
+    out->component_cnt = eq_json(json, type, "SCALAR") ? 1
+        : eq_json(json, type, "VEC2") ? 2
+        : eq_json(json, type, "VEC3") ? 3
+        : eq_json(json, type, "VEC4") ? 4
+        : 0;
+    out->component_type = (uint32_t)int_json(json, find_json(json, acc, "componentType"), 0);
+    const int32_t normalized = find_json(json, acc, "normalized");
+    out->normalized = normalized >= 0 && eq_json(json, normalized, "true");
+    const uint32_t elem_size = get_component_size(out->component_type) * out->component_cnt;
+    CHECK_RETURN(elem_size > 0);
+
+    const int64_t count = int_json(json, find_json(json, acc, "count"), -1);
+    const int64_t offset = int_json(json, find_json(json, acc, "byteOffset"), 0);
+    CHECK_RETURN(count > 0 && count <= UINT32_MAX && offset >= 0);
+    out->count = (uint32_t)count;
+    out->stride = view_stride > 0 ? (uint32_t)view_stride : elem_size;
+    CHECK_RETURN((uint64_t)offset + (uint64_t)out->stride * (out->count - 1) + elem_size <= (uint64_t)view_length);
+    out->data = gltf->buffer_datas[buffer_index] + view_offset + offset;
+    return VK_SUCCESS;
+}
+
+static float read_component(const uint8_t *p, uint32_t component_type, int normalized) {
+    switch (component_type) {
+        case 5120: { int8_t v; memcpy(&v, p, 1); return normalized ? fmaxf((float)v / 127.0f, -1.0f) : (float)v; }
+        case 5121: return normalized ? (float)p[0] / 255.0f : (float)p[0];
+        case 5122: { int16_t v; memcpy(&v, p, 2); return normalized ? fmaxf((float)v / 32767.0f, -1.0f) : (float)v; }
+        case 5123: { uint16_t v; memcpy(&v, p, 2); return normalized ? (float)v / 65535.0f : (float)v; }
+        case 5125: { uint32_t v; memcpy(&v, p, 4); return (float)v; }
+        default: { float v; memcpy(&v, p, 4); return v; }
+    }
+}
+
+// 一つのプリミティブをモデルにする関数。
+// NOTE: マップしたファイル上のアクセサから、writerが用意した頂点・インデックスの領域へ直接変換して書き込む。
+static VkResult load_gltf_primitive(const Gltf *gltf, int32_t prim, MeshWriter *writer) {
+    const Json *json = &gltf->json;
+    // NOTE: 三角形リスト(mode = 4)のみ対応する。
+    CHECK_RETURN(int_json(json, find_json(json, prim, "mode"), 4) == 4);
+    const int32_t attrs = find_json(json, prim, "attributes");
+
+    Accessor pos;
+    CHECK_RETURN_VK(resolve_accessor(gltf, int_json(json, find_json(json, attrs, "POSITION"), -1), &pos));
+    CHECK_RETURN(pos.component_type == 5126 && pos.component_cnt == 3);
+    Accessor uv = { NULL };
+    const int32_t uv_token = find_json(json, attrs, "TEXCOORD_0");
+    if (uv_token >= 0) {
+        CHECK_RETURN_VK(resolve_accessor(gltf, int_json(json, uv_token, -1), &uv));
+        CHECK_RETURN(uv.component_cnt == 2 && uv.count == pos.count);
+    }
+    Accessor idx = { NULL };
+    const int32_t idx_token = find_json(json, prim, "indices");
+    if (idx_token >= 0) {
+        CHECK_RETURN_VK(resolve_accessor(gltf, int_json(json, idx_token, -1), &idx));
+        CHECK_RETURN(idx.component_cnt == 1);
+        CHECK_RETURN(idx.component_type == 5121 || idx.component_type == 5123 || idx.component_type == 5125);
+    }
+    const uint32_t vertex_cnt = pos.count;
+    // NOTE: TRIANGLESなので、三角形にならない末尾のインデックスは捨てる。
+    const uint32_t index_cnt = (idx.data != NULL ? idx.count : pos.count) / 3 * 3;
+
+    MeshVertex *vtxs;
+    void *p_idxs;
+    CHECK_RETURN_VK(writer->begin_model(writer->user, vertex_cnt, index_cnt, sizeof(uint32_t), &vtxs, &p_idxs));
+    uint32_t *idxs = (uint32_t *)p_idxs;
+
+    for (uint32_t i = 0; i < vertex_cnt; ++i) {
+        memcpy(vtxs[i].pos, pos.data + (size_t)pos.stride * i, sizeof(float) * 3);
+    }
+    if (uv.data == NULL) {
+        for (uint32_t i = 0; i < vertex_cnt; ++i) {
+            vtxs[i].uv[0] = 0.0f;
+            vtxs[i].uv[1] = 0.0f;
+        }
+    } else if (uv.component_type == 5126) {
+        for (uint32_t i = 0; i < vertex_cnt; ++i) {
+            memcpy(vtxs[i].uv, uv.data + (size_t)uv.stride * i, sizeof(float) * 2);
+        }
+    } else {
+        const uint32_t size = get_component_size(uv.component_type);
+        for (uint32_t i = 0; i < vertex_cnt; ++i) {
+            const uint8_t *p = uv.data + (size_t)uv.stride * i;
+            vtxs[i].uv[0] = read_component(p, uv.component_type, uv.normalized);
+            vtxs[i].uv[1] = read_component(p + size, uv.component_type, uv.normalized);
+        }
+    }
+
+    // NOTE: インデックスはuint32_tに広げる。範囲外のインデックスがあれば失敗とする。
+    uint32_t max_index = 0;
+    if (idx.data == NULL) {
+        for (uint32_t i = 0; i < index_cnt; ++i) {
+            idxs[i] = i;
+        }
+    } else if (idx.component_type == 5125 && idx.stride == 4) {
+        // NOTE: 書き込み先はステージングバッファ(write-combined)かもしれないので、最大値は読み込み元から求める。
+        for (uint32_t i = 0; i < index_cnt; ++i) {
+            uint32_t v;
+            memcpy(&v, idx.data + sizeof(uint32_t) * i, sizeof(uint32_t));
+            max_index = v > max_index ? v : max_index;
+        }
+        memcpy(idxs, idx.data, sizeof(uint32_t) * index_cnt);
+    } else {
+        for (uint32_t i = 0; i < index_cnt; ++i) {
+            const uint8_t *p = idx.data + (size_t)idx.stride * i;
+            uint32_t v;
+            if (idx.component_type == 5121) {
+                v = p[0];
+            } else if (idx.component_type == 5123) {
+                uint16_t u;
+                memcpy(&u, p, 2);
+                v = u;
+            } else {
+                memcpy(&v, p, 4);
+            }
+            idxs[i] = v;
+            max_index = v > max_index ? v : max_index;
+        }
+    }
+    CHECK_RETURN(max_index < vertex_cnt);
+
+    return writer->end_model(writer->user);
+}
+
+// glTFのbuffersを解決する関数。
+// NOTE: .glbのBINチャンクはそのまま参照し、.gltfの外部ファイルは個別にメモリマップする。
+// NOTE: data URI(base64)は展開のためのコピーが必要になるので対応しない。
+static VkResult resolve_gltf_buffers(Gltf *gltf, const char *path, const uint8_t *bin, size_t bin_size) {
+    const Json *json = &gltf->json;
+    const int32_t buffers = find_json(json, 0, "buffers");
+    if (buffers < 0)
+        return VK_SUCCESS;
+    CHECK_RETURN(json->tokens[buffers].type == JSON_TYPE_ARRAY && json->tokens[buffers].size <= MAX_GLTF_BUFFERS);
+
+    // NOTE: 相対URIはファイルのディレクトリを基準にする。
+    const char *slash = strrchr(path, '/');
+    const char *backslash = strrchr(path, '\\');
+    const char *sep = backslash > slash ? backslash : slash;
+    const size_t dir_len = sep != NULL ? (size_t)(sep - path) + 1 : 0;
+
+    uint32_t i = (uint32_t)buffers + 1;
+    for (uint32_t n = 0; n < json->tokens[buffers].size; ++n) {
+        const int32_t uri = find_json(json, (int32_t)i, "uri");
+        const int64_t length = int_json(json, find_json(json, (int32_t)i, "byteLength"), -1);
+        CHECK_RETURN(length >= 0);
+        if (uri < 0) {
+            CHECK_RETURN(n == 0 && bin != NULL && (size_t)length <= bin_size);
+            gltf->buffer_datas[n] = bin;
+        } else {
+            const JsonToken *t = &json->tokens[uri];
+            const size_t uri_len = t->end - t->start;
+            CHECK_RETURN(uri_len > 0 && !(uri_len >= 5 && memcmp(json->src + t->start, "data:", 5) == 0));
+            char *buffer_path = (char *)malloc(dir_len + uri_len + 1);
+            CHECK_RETURN(buffer_path != NULL);
+            memcpy(buffer_path, path, dir_len);
+            memcpy(buffer_path + dir_len, json->src + t->start, uri_len);
+            buffer_path[dir_len + uri_len] = '\0';
+            const VkResult res = map_file(buffer_path, &gltf->buffer_files[n]);
+            free(buffer_path);
+            if (res != VK_SUCCESS)
+                return res;
+            CHECK_RETURN((size_t)length <= gltf->buffer_files[n].size);
+            gltf->buffer_datas[n] = gltf->buffer_files[n].data;
+        }
+        gltf->buffer_sizes[n] = (size_t)length;
+        gltf->buffer_cnt = n + 1;
+        i = skip_json(json, i);
+    }
+    return VK_SUCCESS;
+}
+
+static VkResult load_gltf(const char *path, const MappedFile *file, Gltf *gltf, MeshWriter *writer) {
+    // NOTE: .glbなら、JSONチャンクとBINチャンクに分ける。
+    const char *src = (const char *)file->data;
+    size_t src_len = file->size;
+    const uint8_t *bin = NULL;
+    size_t bin_size = 0;
+    uint32_t header[5] = { 0 };
+    if (file->size >= 20)
+        memcpy(header, file->data, 20);
+    if (header[0] == GLB_MAGIC) {
+        CHECK_RETURN(header[1] == 2 && header[2] <= file->size);
+        CHECK_RETURN(header[4] == GLB_CHUNK_JSON && 20 + (size_t)header[3] <= header[2]);
+        src = (const char *)file->data + 20;
+        src_len = header[3];
+        const size_t bin_offset = 20 + (size_t)(header[3] + 3) / 4 * 4;
+        if (bin_offset + 8 <= header[2]) {
+            uint32_t chunk[2];
+            memcpy(chunk, file->data + bin_offset, 8);
+            CHECK_RETURN(chunk[1] == GLB_CHUNK_BIN && bin_offset + 8 + chunk[0] <= header[2]);
+            bin = file->data + bin_offset + 8;
+            bin_size = chunk[0];
+        }
+    }
+
+    CHECK_RETURN_VK(parse_json(src, src_len, &gltf->json));
+    const Json *json = &gltf->json;
+    CHECK_RETURN(json->tokens[0].type == JSON_TYPE_OBJECT);
+    CHECK_RETURN_VK(resolve_gltf_buffers(gltf, path, bin, bin_size));
+    CHECK_RETURN_VK(list_json(json, find_json(json, 0, "accessors"), &gltf->accessor_cnt, &gltf->accessors));
+    CHECK_RETURN_VK(list_json(json, find_json(json, 0, "bufferViews"), &gltf->buffer_view_cnt, &gltf->buffer_views));
+
+    // NOTE: すべてのメッシュのすべてのプリミティブを読む。
+    uint32_t mesh_cnt;
+    int32_t *meshes;
+    CHECK_RETURN_VK(list_json(json, find_json(json, 0, "meshes"), &mesh_cnt, &meshes));
+    VkResult res = VK_SUCCESS;
+    for (uint32_t i = 0; i < mesh_cnt && res == VK_SUCCESS; ++i) {
+        const int32_t prims = find_json(json, meshes[i], "primitives");
+        if (prims < 0 || json->tokens[prims].type != JSON_TYPE_ARRAY)
+            continue;
+        uint32_t j = (uint32_t)prims + 1;
+        for (uint32_t n = 0; n < json->tokens[prims].size && res == VK_SUCCESS; ++n) {
+            res = load_gltf_primitive(gltf, (int32_t)j, writer);
+            j = skip_json(json, j);
+        }
+    }
+    free(meshes);
+    return res;
+}
+
+// OBJのグループ一つ分の範囲。
+typedef struct ObjGroup_t {
+    uint32_t first_vertex;
+    uint32_t vertex_cnt;
+    uint32_t first_index;
+    uint32_t index_cnt;
+} ObjGroup;
+
+// 頂点の重複除去のためのハッシュテーブル。キーは(位置の番号, UVの番号)。
+typedef struct ObjVertexMap_t {
+    uint32_t cap;
+    uint32_t cnt;
+    uint64_t *keys;
+    uint32_t *values;
+} ObjVertexMap;
+
+typedef struct ObjPosition_t {
+    float v[3];
+} ObjPosition;
+
+typedef struct ObjUv_t {
+    float v[2];
+} ObjUv;
+
+typedef struct Obj_t {
+    uint32_t position_cnt;
+    uint32_t position_cap;
+    ObjPosition *positions;
+    uint32_t uv_cnt;
+    uint32_t uv_cap;
+    ObjUv *uvs;
+    uint32_t vertex_cnt;
+    uint32_t vertex_cap;
+    uint64_t *vertices; // NOTE: (位置の番号 << 32) | UVの番号
+    uint32_t index_cnt;
+    uint32_t index_cap;
+    uint32_t *indices;
+    uint32_t group_cnt;
+    uint32_t group_cap;
+    ObjGroup *groups;
+    ObjVertexMap map;
+} Obj;
+
+#define OBJ_NO_UV 0xFFFFFFFF
+
+static uint64_t hash_u64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static VkResult resize_obj_vertex_map(ObjVertexMap *map, uint32_t cap) {
+    uint64_t *keys = (uint64_t *)malloc(sizeof(uint64_t) * cap);
+    uint32_t *values = (uint32_t *)malloc(sizeof(uint32_t) * cap);
+    if (keys == NULL || values == NULL) {
+        free(keys);
+        free(values);
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+    memset(keys, 0xFF, sizeof(uint64_t) * cap);
+    for (uint32_t i = 0; i < map->cap; ++i) {
+        if (map->keys[i] == UINT64_MAX)
+            continue;
+        uint32_t j = (uint32_t)hash_u64(map->keys[i]) & (cap - 1);
+        while (keys[j] != UINT64_MAX)
+            j = (j + 1) & (cap - 1);
+        keys[j] = map->keys[i];
+        values[j] = map->values[i];
+    }
+    free(map->keys);
+    free(map->values);
+    map->keys = keys;
+    map->values = values;
+    map->cap = cap;
+    return VK_SUCCESS;
+}
+
+// 現在のグループを閉じ、新しいグループを始める関数。
+static VkResult begin_obj_group(Obj *obj) {
+    if (obj->group_cnt > 0) {
+        ObjGroup *last = &obj->groups[obj->group_cnt - 1];
+        if (last->index_cnt == 0)
+            return VK_SUCCESS;
+    }
+    const ObjGroup group = { obj->vertex_cnt, 0, obj->index_cnt, 0 };
+    PUSH_ITEM(obj->groups, obj->group_cnt, obj->group_cap, ObjGroup, group);
+    // NOTE: インデックスはグループごとに0から振るので、重複除去の表も空にする。
+    if (obj->map.cap > 0)
+        memset(obj->map.keys, 0xFF, sizeof(uint64_t) * obj->map.cap);
+    obj->map.cnt = 0;
+    return VK_SUCCESS;
+}
+
+// 面の頂点(位置とUVの番号の組)を、現在のグループのインデックスに変換する関数。
+static VkResult add_obj_corner(Obj *obj, uint64_t key, uint32_t *p_index) {
+    ObjVertexMap *map = &obj->map;
+    if ((map->cnt + 1) * 2 > map->cap)
+        CHECK_RETURN_VK(resize_obj_vertex_map(map, map->cap > 0 ? map->cap * 2 : 1024));
+    uint32_t j = (uint32_t)hash_u64(key) & (map->cap - 1);
+    while (map->keys[j] != UINT64_MAX) {
+        if (map->keys[j] == key) {
+            *p_index = map->values[j];
+            return VK_SUCCESS;
+        }
+        j = (j + 1) & (map->cap - 1);
+    }
+    ObjGroup *group = &obj->groups[obj->group_cnt - 1];
+    map->keys[j] = key;
+    map->values[j] = group->vertex_cnt;
+    map->cnt += 1;
+    *p_index = group->vertex_cnt;
+    group->vertex_cnt += 1;
+    PUSH_ITEM(obj->vertices, obj->vertex_cnt, obj->vertex_cap, uint64_t, key);
+    return VK_SUCCESS;
+}
+
+static const char *skip_obj_spaces(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p += 1;
+    return p;
+}
+
+// 浮動小数点数を読む関数。strtofより速く、ロケールにも依存しない。
+static const char *parse_obj_float(const char *p, const char *end, float *out) {
+    static const double POW10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    p = skip_obj_spaces(p, end);
+    const int negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+'))
+        p += 1;
+    uint64_t mantissa = 0;
+    int32_t exponent = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+        if (mantissa < 100000000000000000ULL)
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+        else
+            exponent += 1;
+    }
+    if (p < end && *p == '.') {
+        for (p += 1; p < end && *p >= '0' && *p <= '9'; ++p) {
+            if (mantissa < 100000000000000000ULL) {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                exponent -= 1;
+            }
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p += 1;
+        const int exp_negative = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+'))
+            p += 1;
+        int32_t e = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p)
+            e = e < 10000 ? e * 10 + (*p - '0') : e;
+        exponent += exp_negative ? -e : e;
+    }
+    double v = (double)mantissa;
+    if (exponent >= 0 && exponent <= 22)
+        v *= POW10[exponent];
+    else if (exponent < 0 && exponent >= -22)
+        v /= POW10[-exponent];
+    else
+        v *= pow(10.0, (double)exponent);
+    *out = (float)(negative ? -v : v);
+    return p;
+}
+
+static const char *parse_obj_int(const char *p, const char *end, int64_t *out) {
+    const int negative = p < end && *p == '-';
+    if (negative)
+        p += 1;
+    int64_t v = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p)
+        v = v < INT32_MAX ? v * 10 + (*p - '0') : v;
+    *out = negative ? -v : v;
+    return p;
+}
+
+// OBJの番号(1始まり、負なら末尾からの相対)を0始まりに直す関数。
+static VkResult resolve_obj_index(int64_t index, uint32_t cnt, uint32_t *out) {
+    const int64_t i = index < 0 ? (int64_t)cnt + index : index - 1;
+    CHECK_RETURN(index != 0 && i >= 0 && i < cnt);
+    *out = (uint32_t)i;
+    return VK_SUCCESS;
+}
+
+// 一行の面を読んで、扇形に三角形分割する関数。
+static VkResult parse_obj_face(Obj *obj, const char *p, const char *end) {
+    if (obj->group_cnt == 0)
+        CHECK_RETURN_VK(begin_obj_group(obj));
+    uint32_t first = 0;
+    uint32_t prev = 0;
+    uint32_t corner_cnt = 0;
+    while (1) {
+        p = skip_obj_spaces(p, end);
+        if (p == end || *p == '\n' || *p == '\r' || *p == '#')
+            break;
+        int64_t v;
+        int64_t t = 0;
+        p = parse_obj_int(p, end, &v);
+        if (p < end && *p == '/') {
+            p += 1;
+            if (p < end && *p != '/')
+                p = parse_obj_int(p, end, &t);
+            // NOTE: 法線の番号は読み飛ばす。
+            if (p < end && *p == '/') {
+                int64_t n;
+                p = parse_obj_int(p + 1, end, &n);
+            }
+        }
+        CHECK_RETURN(p == end || *p == ' ' || *p == '\t' || *p == '\n' || *p == '\r');
+        uint32_t vi;
+        uint32_t ti = OBJ_NO_UV;
+        CHECK_RETURN_VK(resolve_obj_index(v, obj->position_cnt, &vi));
+        if (t != 0)
+            CHECK_RETURN_VK(resolve_obj_index(t, obj->uv_cnt, &ti));
+
+        uint32_t index;
+        CHECK_RETURN_VK(add_obj_corner(obj, ((uint64_t)vi << 32) | ti, &index));
+        if (corner_cnt == 0) {
+            first = index;
+        } else if (corner_cnt >= 2) {
+            PUSH_ITEM(obj->indices, obj->index_cnt, obj->index_cap, uint32_t, first);
+            PUSH_ITEM(obj->indices, obj->index_cnt, obj->index_cap, uint32_t, prev);
+            PUSH_ITEM(obj->indices, obj->index_cnt, obj->index_cap, uint32_t, index);
+            obj->groups[obj->group_cnt - 1].index_cnt += 3;
+        }
+        prev = index;
+        corner_cnt += 1;
+    }
+    return VK_SUCCESS;
+}
+
+static VkResult parse_obj(const MappedFile *file, Obj *obj) {
+    const char *p = (const char *)file->data;
+    const char *end = p + file->size;
+    while (p < end) {
+        p = skip_obj_spaces(p, end);
+        if (end - p >= 3 && p[0] == 'v' && p[1] == 't' && (p[2] == ' ' || p[2] == '\t')) {
+            ObjUv uv;
+            p = parse_obj_float(p + 2, end, &uv.v[0]);
+            p = parse_obj_float(p, end, &uv.v[1]);
+            PUSH_ITEM(obj->uvs, obj->uv_cnt, obj->uv_cap, ObjUv, uv);
+        } else if (end - p >= 2 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+            ObjPosition pos;
+            p = parse_obj_float(p + 1, end, &pos.v[0]);
+            p = parse_obj_float(p, end, &pos.v[1]);
+            p = parse_obj_float(p, end, &pos.v[2]);
+            PUSH_ITEM(obj->positions, obj->position_cnt, obj->position_cap, ObjPosition, pos);
+        } else if (end - p >= 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            CHECK_RETURN_VK(parse_obj_face(obj, p + 1, end));
+        } else if (end - p >= 2 && (p[0] == 'o' || p[0] == 'g') && (p[1] == ' ' || p[1] == '\t')) {
+            CHECK_RETURN_VK(begin_obj_group(obj));
+        }
+        // NOTE: 法線やマテリアルなど、その他の行は読み飛ばす。
+        while (p < end && *p != '\n')
+            p += 1;
+        p += 1;
+    }
+    return VK_SUCCESS;
+}
+
+static VkResult load_obj(const MappedFile *file, Obj *obj, MeshWriter *writer) {
+    // NOTE: OBJはテキストなので、位置とUVの数値だけは一旦配列に読み出す必要がある。
+    // NOTE: 頂点の組み立ては、writerが用意した領域上で直接行う。
+    CHECK_RETURN_VK(parse_obj(file, obj));
+    for (uint32_t i = 0; i < obj->group_cnt; ++i) {
+        const ObjGroup *group = &obj->groups[i];
+        if (group->index_cnt == 0)
+            continue;
+        MeshVertex *vtxs;
+        void *idxs;
+        CHECK_RETURN_VK(writer->begin_model(writer->user, group->vertex_cnt, group->index_cnt, sizeof(uint32_t), &vtxs, &idxs));
+        for (uint32_t j = 0; j < group->vertex_cnt; ++j) {
+            const uint64_t key = obj->vertices[group->first_vertex + j];
+            const uint32_t vi = (uint32_t)(key >> 32);
+            const uint32_t ti = (uint32_t)key;
+            memcpy(vtxs[j].pos, obj->positions[vi].v, sizeof(float) * 3);
+            // NOTE: OBJのVは下が0なので、上が0になるよう反転する。
+            vtxs[j].uv[0] = ti != OBJ_NO_UV ? obj->uvs[ti].v[0] : 0.0f;
+            vtxs[j].uv[1] = ti != OBJ_NO_UV ? 1.0f - obj->uvs[ti].v[1] : 0.0f;
+        }
+        memcpy(idxs, &obj->indices[group->first_index], sizeof(uint32_t) * group->index_cnt);
+        CHECK_RETURN_VK(writer->end_model(writer->user));
+    }
+    return VK_SUCCESS;
+}
+
+// ベイク済みメッシュを読む関数。
+// NOTE: ファイル上の配置がGPUの頂点・インデックスの配置と同じなので、モデルごとにmemcpyするだけでよい。
+// NOTE: インデックスもファイル上の大きさのまま渡すので、書き込み先と大きさが同じならそのままステージングバッファへ入る。
+// ベイクされたインデックスの最大値を返す関数。
+// NOTE: ペイロード内の位置が揃っているとは限らないので、一つずつ写して読む。
+static uint32_t max_baked_index(const uint8_t *idxs, uint32_t index_size, uint32_t index_cnt) {
+    uint32_t max_index = 0;
+    for (uint32_t i = 0; i < index_cnt; ++i) {
+        uint32_t v;
+        if (index_size == sizeof(uint16_t)) {
+            uint16_t v16;
+            memcpy(&v16, idxs + sizeof(uint16_t) * i, sizeof(uint16_t));
+            v = v16;
+        } else {
+            memcpy(&v, idxs + sizeof(uint32_t) * i, sizeof(uint32_t));
+        }
+        max_index = v > max_index ? v : max_index;
+    }
+    return max_index;
+}
+
+static VkResult load_baked(const MappedFile *file, MeshWriter *writer) {
+    BakedMeshHeader header;
+    CHECK_RETURN(file->size >= sizeof(BakedMeshHeader));
+    memcpy(&header, file->data, sizeof(BakedMeshHeader));
+    CHECK_RETURN(header.magic == BAKED_MESH_MAGIC && header.version == BAKED_MESH_VERSION);
+    CHECK_RETURN(header.vertex_size == sizeof(MeshVertex) && header.model_size == sizeof(BakedModel));
+    CHECK_RETURN(sizeof(BakedMeshHeader) + (uint64_t)sizeof(BakedModel) * header.model_cnt <= header.payload_offset);
+    CHECK_RETURN(header.payload_offset <= file->size && header.payload_size <= file->size - header.payload_offset);
+    const uint8_t *payload = file->data + header.payload_offset;
+#ifndef RELEASE
+    // NOTE: 読み込みが遅くなるので、ハッシュの検証はデバッグビルドでのみ行う。
+    CHECK_RETURN(hash_bytes(payload, header.payload_size, 0) == header.hash);
+#endif
+
+    for (uint32_t i = 0; i < header.model_cnt; ++i) {
+        BakedModel model;
+        memcpy(&model, file->data + sizeof(BakedMeshHeader) + sizeof(BakedModel) * i, sizeof(BakedModel));
+        const uint64_t vtxs_size = (uint64_t)sizeof(MeshVertex) * model.vertex_cnt;
+        CHECK_RETURN(model.index_size == sizeof(uint16_t) || model.index_size == sizeof(uint32_t));
+        const uint64_t idxs_size = (uint64_t)model.index_size * model.index_cnt;
+        CHECK_RETURN(model.vertex_offset <= header.payload_size && vtxs_size <= header.payload_size - model.vertex_offset);
+        CHECK_RETURN(model.index_offset <= header.payload_size && idxs_size <= header.payload_size - model.index_offset);
+        // NOTE: ハッシュはリリースビルドでは検証しないので、範囲外の頂点を引くインデックスはここで必ず弾く。
+        CHECK_RETURN(model.index_cnt == 0 || max_baked_index(payload + model.index_offset, model.index_size, model.index_cnt) < model.vertex_cnt);
+
+        MeshVertex *vtxs;
+        void *idxs;
+        CHECK_RETURN_VK(writer->begin_model(writer->user, model.vertex_cnt, model.index_cnt, model.index_size, &vtxs, &idxs));
+        memcpy(vtxs, payload + model.vertex_offset, vtxs_size);
+        memcpy(idxs, payload + model.index_offset, idxs_size);
+        CHECK_RETURN_VK(writer->end_model(writer->user));
+    }
+    return VK_SUCCESS;
+}
+
+static int has_extension(const char *path, const char *ext) {
+    const size_t len = strlen(path);
+    const size_t ext_len = strlen(ext);
+    if (len < ext_len)
+        return 0;
+    for (size_t i = 0; i < ext_len; ++i) {
+        const char c = path[len - ext_len + i];
+        if ((c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c) != ext[i])
+            return 0;
+    }
+    return 1;
+}
+
+VkResult read_mesh_file(const char *path, MeshWriter *writer, size_t *p_read_size) {
+    const int is_gltf = has_extension(path, ".gltf") || has_extension(path, ".glb");
+    const int is_obj = has_extension(path, ".obj");
+    const int is_baked = has_extension(path, ".bmesh");
+    CHECK_RETURN(is_gltf || is_obj || is_baked);
+
+    MappedFile file;
+    CHECK_RETURN_VK(map_file(path, &file));
+    size_t read_size = file.size;
+    VkResult res;
+    if (is_gltf) {
+        Gltf gltf;
+        memset(&gltf, 0, sizeof(Gltf));
+        res = load_gltf(path, &file, &gltf, writer);
+        for (uint32_t i = 0; i < gltf.buffer_cnt; ++i) {
+            read_size += gltf.buffer_files[i].size;
+            unmap_file(&gltf.buffer_files[i]);
+        }
+        free(gltf.json.tokens);
+        free(gltf.accessors);
+        free(gltf.buffer_views);
+    } else if (is_obj) {
+        Obj obj;
+        memset(&obj, 0, sizeof(Obj));
+        res = load_obj(&file, &obj, writer);
+        free(obj.positions);
+        free(obj.uvs);
+        free(obj.vertices);
+        free(obj.indices);
+        free(obj.groups);
+        free(obj.map.keys);
+        free(obj.map.values);
+    } else {
+        res = load_baked(&file, writer);
+    }
+    unmap_file(&file);
+    if (p_read_size != NULL)
+        *p_read_size = read_size;
+    return res;
+}
@@ -0,0 +1,511 @@
+#include "vulkan-tutorial.h"
+
+#include <pthread.h>
+#include <string.h>
+
+// キャッシュの一項目。
+typedef struct PipelineEntry_t {
+    uint64_t hash;
+    PipelineDesc desc;
+    VkPipeline pipeline;
+    VkResult result; // NOTE: 作成中ならVK_NOT_READY。
+    VkBool32 released; // NOTE: 外した項目は探索から除く。作成中の番号を変えないよう、配列には残しておく。
+} PipelineEntry;
+
+// コンパイルスレッドと呼び出し側が共有する状態。
+// NOTE: 項目は作成を頼まれた順に並び、[next, cnt)がまだ誰も取っていない項目となる。
+typedef struct PipelineState_t {
+    DynamicStateFeatures features;
+    PFN_vkCmdSetCullModeEXT cmd_set_cull_mode;
+    PFN_vkCmdSetFrontFaceEXT cmd_set_front_face;
+    PFN_vkCmdSetDepthTestEnableEXT cmd_set_depth_test_enable;
+    PFN_vkCmdSetDepthWriteEnableEXT cmd_set_depth_write_enable;
+    PFN_vkCmdSetDepthCompareOpEXT cmd_set_depth_compare_op;
+    pthread_mutex_t mutex;
+    pthread_cond_t wake; // NOTE: コンパイルスレッドが仕事を待つ。
+    pthread_cond_t done; // NOTE: 呼び出し側が作成の完了を待つ。
+    pthread_t *threads;
+    VkDevice device;
+    uint32_t cnt;
+    uint32_t capacity;
+    uint32_t next;
+    PipelineEntry *entries;
+    int quit;
+} PipelineState;
+
+// 拡張の名前が一覧にあるか調べる関数。
+static VkBool32 has_extension(const VkExtensionProperties *props, uint32_t cnt, const char *name) {
+    for (uint32_t i = 0; i < cnt; ++i) {
+        if (strcmp(props[i].extensionName, name) == 0)
+            return VK_TRUE;
+    }
+    return VK_FALSE;
+}
+
+void get_dynamic_state_features(const VkPhysicalDevice phys_device, DynamicStateFeatures *out) {
+    out->extended_dynamic_state = VK_FALSE;
+    out->dynamic_rendering = VK_FALSE;
+    // NOTE: 機能の構造体は、その拡張に対応しているデバイスにしか渡せない。先に拡張の一覧を見る。
+    uint32_t cnt = 0;
+    if (vkEnumerateDeviceExtensionProperties(phys_device, NULL, &cnt, NULL) != VK_SUCCESS || cnt == 0)
+        return;
+    VkExtensionProperties *props = (VkExtensionProperties *)malloc(sizeof(VkExtensionProperties) * cnt);
+    if (props == NULL)
+        return;
+    VkBool32 has_eds = VK_FALSE;
+    VkBool32 has_dr = VK_FALSE;
+    if (vkEnumerateDeviceExtensionProperties(phys_device, NULL, &cnt, props) == VK_SUCCESS) {
+        has_eds = has_extension(props, cnt, EXTENDED_DYNAMIC_STATE_EXT_NAME);
+        has_dr = has_extension(props, cnt, DYNAMIC_RENDERING_EXT_NAME);
+    }
+    free(props);
+
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT eds = { 0 };
+    eds.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dr = { 0 };
+    dr.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    VkPhysicalDeviceFeatures2 features = { 0 };
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    void **p_next = &features.pNext;
+    if (has_eds) {
+        *p_next = (void *)&eds;
+        p_next = &eds.pNext;
+    }
+    if (has_dr) {
+        *p_next = (void *)&dr;
+        p_next = &dr.pNext;
+    }
+    vkGetPhysicalDeviceFeatures2(phys_device, &features);
+    out->extended_dynamic_state = eds.extendedDynamicState;
+    out->dynamic_rendering = dr.dynamicRendering;
+}
+
+void init_pipeline_desc(PipelineDesc *out) {
+    // NOTE: 詰め物も含めて0にしておく。記述をそのままハッシュに使うため。
+    memset(out, 0, sizeof(PipelineDesc));
+    out->topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    out->polygon_mode = VK_POLYGON_MODE_FILL;
+    out->cull_mode = VK_CULL_MODE_BACK_BIT;
+    out->front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    out->depth_test = VK_TRUE;
+    out->depth_write = VK_TRUE;
+    out->depth_compare_op = VK_COMPARE_OP_LESS_OR_EQUAL;
+    out->blend = VK_FALSE;
+    out->samples = VK_SAMPLE_COUNT_1_BIT;
+}
+
+// 記述からグラフィックスパイプラインを作る関数。どのスレッドから呼んでもよい。
+// NOTE: ビューポートとシザーは常に動的とする。大きさが変わっても作り直さなくてよい。
+static VkResult build_pipeline(
+    const VkDevice device,
+    const VkPipelineCache cache,
+    const DynamicStateFeatures *features,
+    const PipelineDesc *desc,
+    VkPipeline *out
+) {
+    // shaders
+    const VkPipelineShaderStageCreateInfo shader_cis[2] = {
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            NULL,
+            0,
+            VK_SHADER_STAGE_VERTEX_BIT,
+            desc->vert_shader,
+            "main",
+            NULL,
+        },
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            NULL,
+            0,
+            VK_SHADER_STAGE_FRAGMENT_BIT,
+            desc->frag_shader,
+            "main",
+            NULL,
+        },
+    };
+
+    // vertex input
+    const VkVertexInputBindingDescription vert_inp_binding_dcs[] = {
+        { 0, desc->vertex_stride, VK_VERTEX_INPUT_RATE_VERTEX },
+    };
+    const VkPipelineVertexInputStateCreateInfo vert_inp_ci = {
+        VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        NULL,
+        0,
+        desc->attr_cnt > 0 ? 1 : 0,
+        vert_inp_binding_dcs,
+        desc->attr_cnt,
+        desc->attrs,
+    };
+
+    // input assembly
+    const VkPipelineInputAssemblyStateCreateInfo inp_as_ci = {
+        VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        NULL,
+        0,
+        desc->topology,
+        VK_FALSE,
+    };
+
+    // viewport
+    // NOTE: 値は描画時にcmd_set_pipeline_stateで与えるので、数だけを決める。
+    const VkPipelineViewportStateCreateInfo viewport_ci = {
+        VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        NULL,
+        0,
+        1,
+        NULL,
+        1,
+        NULL,
+    };
+
+    // rasterization
+    const VkPipelineRasterizationStateCreateInfo raster_ci = {
+        VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        NULL,
+        0,
+        VK_FALSE,
+        VK_FALSE,
+        desc->polygon_mode,
+        desc->cull_mode,
+        desc->front_face,
+        VK_FALSE,
+        0.0f,
+        0.0f,
+        0.0f,
+        1.0f,
+    };
+
+    // multisample
+    const VkPipelineMultisampleStateCreateInfo multisample_ci = {
+        VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        NULL,
+        0,
+        desc->samples,
+        VK_FALSE,
+        0.0f,
+        NULL,
+        VK_FALSE,
+        VK_FALSE,
+    };
+
+    // depth stencil
+    const VkPipelineDepthStencilStateCreateInfo depth_stencil_ci = {
+        VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        NULL,
+        0,
+        desc->depth_test,
+        desc->depth_write,
+        desc->depth_compare_op,
+        VK_FALSE,
+        VK_FALSE,
+        { 0 },
+        { 0 },
+        0.0f,
+        0.0f,
+    };
+
+    // color blend
+    // NOTE: ブレンドを有効にするなら、アルファによる半透明の合成とする。
+    const VkPipelineColorBlendAttachmentState color_blend_states[] = {
+        {
+            desc->blend,
+            VK_BLEND_FACTOR_SRC_ALPHA,
+            VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+            VK_BLEND_OP_ADD,
+            VK_BLEND_FACTOR_SRC_ALPHA,
+            VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+            VK_BLEND_OP_ADD,
+            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+        }
+    };
+    const VkPipelineColorBlendStateCreateInfo color_blend_ci = {
+        VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        NULL,
+        0,
+        VK_FALSE,
+        (VkLogicOp)0,
+        1,
+        color_blend_states,
+        {0.0f, 0.0f, 0.0f, 0.0f},
+    };
+
+    // dynamic state
+    // NOTE: extended dynamic stateがあれば、カリングとデプスの設定も描画時に与える。
+    const VkDynamicState dynamic_states[] = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR,
+        VK_DYNAMIC_STATE_CULL_MODE_EXT,
+        VK_DYNAMIC_STATE_FRONT_FACE_EXT,
+        VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT,
+        VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT,
+        VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT,
+    };
+    const VkPipelineDynamicStateCreateInfo dynamic_ci = {
+        VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        NULL,
+        0,
+        features->extended_dynamic_state ? 7 : 2,
+        dynamic_states,
+    };
+
+    // rendering
+    // NOTE: レンダーパスがなければdynamic renderingで描くので、アタッチメントのフォーマットを渡す。
+    const VkPipelineRenderingCreateInfoKHR rendering_ci = {
+        VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR,
+        NULL,
+        0,
+        1,
+        &desc->color_format,
+        desc->depth_format,
+        VK_FORMAT_UNDEFINED,
+    };
+
+    // pipeline
+    const VkGraphicsPipelineCreateInfo ci = {
+        VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        desc->render_pass == VK_NULL_HANDLE ? (const void *)&rendering_ci : NULL,
+        0,
+        2,
+        shader_cis,
+        &vert_inp_ci,
+        &inp_as_ci,
+        NULL,
+        &viewport_ci,
+        &raster_ci,
+        &multisample_ci,
+        &depth_stencil_ci,
+        &color_blend_ci,
+        &dynamic_ci,
+        desc->layout,
+        desc->render_pass,
+        desc->subpass,
+        NULL,
+        0,
+    };
+    return vkCreateGraphicsPipelines(device, cache, 1, &ci, NULL, out);
+}
+
+// コンパイルスレッドの本体。まだ取られていない項目を一つずつ取って作る。
+// NOTE: 作成中はmutexを手放す。VkPipelineCacheは内部で同期されるので、複数のスレッドから同時に使ってよい。
+static void *compile_main(void *arg) {
+    PipelineCache *cache = (PipelineCache *)arg;
+    PipelineState *state = (PipelineState *)cache->state;
+    pthread_mutex_lock(&state->mutex);
+    while (!state->quit) {
+        if (state->next >= state->cnt) {
+            pthread_cond_wait(&state->wake, &state->mutex);
+            continue;
+        }
+        // NOTE: 項目の配列は広げるときに動くので、記述を写してから手放す。
+        const uint32_t index = state->next;
+        const PipelineDesc desc = state->entries[index].desc;
+        state->next += 1;
+        pthread_mutex_unlock(&state->mutex);
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        const VkResult result = build_pipeline(state->device, cache->cache, &state->features, &desc, &pipeline);
+        pthread_mutex_lock(&state->mutex);
+        state->entries[index].pipeline = pipeline;
+        state->entries[index].result = result;
+        pthread_cond_broadcast(&state->done);
+    }
+    pthread_mutex_unlock(&state->mutex);
+    return NULL;
+}
+
+VkResult create_pipeline_cache(const VkDevice device, const DynamicStateFeatures *features, uint32_t thread_cnt, PipelineCache *out) {
+    out->thread_cnt = thread_cnt > 0 ? thread_cnt : 1;
+    out->state = NULL;
+    const VkPipelineCacheCreateInfo ci = {
+        VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        NULL,
+        0,
+        0,
+        NULL,
+    };
+    CHECK_RETURN_VK(vkCreatePipelineCache(device, &ci, NULL, &out->cache));
+    PipelineState *state = (PipelineState *)malloc(sizeof(PipelineState));
+    if (state != NULL)
+        state->threads = (pthread_t *)malloc(sizeof(pthread_t) * out->thread_cnt);
+    if (state == NULL || state->threads == NULL) {
+        free(state);
+        vkDestroyPipelineCache(device, out->cache, NULL);
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+    // NOTE: extended dynamic stateのコマンドは拡張なので、デバイスから関数を得る。
+    state->features = *features;
+    state->cmd_set_cull_mode = NULL;
+    state->cmd_set_front_face = NULL;
+    state->cmd_set_depth_test_enable = NULL;
+    state->cmd_set_depth_write_enable = NULL;
+    state->cmd_set_depth_compare_op = NULL;
+    if (features->extended_dynamic_state) {
+        state->cmd_set_cull_mode = (PFN_vkCmdSetCullModeEXT)vkGetDeviceProcAddr(device, "vkCmdSetCullModeEXT");
+        state->cmd_set_front_face = (PFN_vkCmdSetFrontFaceEXT)vkGetDeviceProcAddr(device, "vkCmdSetFrontFaceEXT");
+        state->cmd_set_depth_test_enable = (PFN_vkCmdSetDepthTestEnableEXT)vkGetDeviceProcAddr(device, "vkCmdSetDepthTestEnableEXT");
+        state->cmd_set_depth_write_enable = (PFN_vkCmdSetDepthWriteEnableEXT)vkGetDeviceProcAddr(device, "vkCmdSetDepthWriteEnableEXT");
+        state->cmd_set_depth_compare_op = (PFN_vkCmdSetDepthCompareOpEXT)vkGetDeviceProcAddr(device, "vkCmdSetDepthCompareOpEXT");
+        if (
+            state->cmd_set_cull_mode == NULL || state->cmd_set_front_face == NULL || state->cmd_set_depth_test_enable == NULL
+                || state->cmd_set_depth_write_enable == NULL || state->cmd_set_depth_compare_op == NULL
+        ) {
+            state->features.extended_dynamic_state = VK_FALSE;
+        }
+    }
+    pthread_mutex_init(&state->mutex, NULL);
+    pthread_cond_init(&state->wake, NULL);
+    pthread_cond_init(&state->done, NULL);
+    state->device = device;
+    state->cnt = 0;
+    state->capacity = 0;
+    state->next = 0;
+    state->entries = NULL;
+    state->quit = 0;
+    out->state = (void *)state;
+    for (uint32_t i = 0; i < out->thread_cnt; ++i) {
+        if (pthread_create(&state->threads[i], NULL, compile_main, (void *)out) != 0) {
+            out->thread_cnt = i;
+            destroy_pipeline_cache(out);
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+    }
+    return VK_SUCCESS;
+}
+
+// mutexを持った状態で、記述に合う項目を探す関数。なければ作成を頼んで加える。
+// NOTE: 動的にした設定はパイプラインに含まれないので、キーから外す。その設定だけが違う記述は同じパイプラインを共有する。
+static VkResult find_or_request(PipelineState *state, const PipelineDesc *src, uint32_t *p_index) {
+    PipelineDesc key = *src;
+    if (state->features.extended_dynamic_state) {
+        key.cull_mode = 0;
+        key.front_face = (VkFrontFace)0;
+        key.depth_test = VK_FALSE;
+        key.depth_write = VK_FALSE;
+        key.depth_compare_op = (VkCompareOp)0;
+    }
+    const PipelineDesc *desc = &key;
+    const uint64_t hash = hash_bytes(desc, sizeof(PipelineDesc), 0);
+    // NOTE: パイプラインの種類は多くても数百なので、ハッシュを先頭から比べれば足りる。
+    for (uint32_t i = 0; i < state->cnt; ++i) {
+        const PipelineEntry *entry = &state->entries[i];
+        if (!entry->released && entry->hash == hash && memcmp(&entry->desc, desc, sizeof(PipelineDesc)) == 0) {
+            *p_index = i;
+            return VK_SUCCESS;
+        }
+    }
+    if (state->cnt == state->capacity) {
+        const uint32_t capacity = state->capacity == 0 ? 16 : state->capacity * 2;
+        PipelineEntry *entries = (PipelineEntry *)realloc(state->entries, sizeof(PipelineEntry) * capacity);
+        CHECK_RETURN(entries != NULL);
+        state->entries = entries;
+        state->capacity = capacity;
+    }
+    PipelineEntry *entry = &state->entries[state->cnt];
+    entry->hash = hash;
+    entry->desc = *desc;
+    entry->pipeline = VK_NULL_HANDLE;
+    entry->result = VK_NOT_READY;
+    entry->released = VK_FALSE;
+    *p_index = state->cnt;
+    state->cnt += 1;
+    pthread_cond_signal(&state->wake);
+    return VK_SUCCESS;
+}
+
+VkResult get_pipeline(PipelineCache *cache, const PipelineDesc *desc, VkBool32 wait, VkPipeline *out) {
+    PipelineState *state = (PipelineState *)cache->state;
+    *out = VK_NULL_HANDLE;
+    pthread_mutex_lock(&state->mutex);
+    uint32_t index;
+    VkResult result = find_or_request(state, desc, &index);
+    if (result == VK_SUCCESS) {
+        while (wait && state->entries[index].result == VK_NOT_READY)
+            pthread_cond_wait(&state->done, &state->mutex);
+        result = state->entries[index].result;
+        *out = state->entries[index].pipeline;
+    }
+    pthread_mutex_unlock(&state->mutex);
+    return result;
+}
+
+void cmd_set_pipeline_state(const VkCommandBuffer command, const PipelineCache *cache, const PipelineDesc *desc, VkExtent2D extent) {
+    const PipelineState *state = (const PipelineState *)cache->state;
+    const VkViewport viewport = {
+        0.0f,
+        0.0f,
+        (float)extent.width,
+        (float)extent.height,
+        0.0f,
+        1.0f,
+    };
+    const VkRect2D scissor = { {0, 0}, extent };
+    vkCmdSetViewport(command, 0, 1, &viewport);
+    vkCmdSetScissor(command, 0, 1, &scissor);
+    if (!state->features.extended_dynamic_state)
+        return;
+    state->cmd_set_cull_mode(command, desc->cull_mode);
+    state->cmd_set_front_face(command, desc->front_face);
+    state->cmd_set_depth_test_enable(command, desc->depth_test);
+    state->cmd_set_depth_write_enable(command, desc->depth_write);
+    state->cmd_set_depth_compare_op(command, desc->depth_compare_op);
+}
+
+VkResult release_pipelines_with_shader(
+    PipelineCache *cache,
+    const VkShaderModule shader,
+    DeletionQueue *deletion_queue,
+    uint64_t value
+) {
+    PipelineState *state = (PipelineState *)cache->state;
+    VkResult result = VK_SUCCESS;
+    pthread_mutex_lock(&state->mutex);
+    for (uint32_t i = 0; i < state->cnt; ++i) {
+        PipelineEntry *entry = &state->entries[i];
+        if (entry->released || (entry->desc.vert_shader != shader && entry->desc.frag_shader != shader))
+            continue;
+        // NOTE: 外した後にモジュールが破棄されるので、コンパイルスレッドが使い終わるまで待つ。
+        while (entry->result == VK_NOT_READY) {
+            pthread_cond_wait(&state->done, &state->mutex);
+        }
+        // NOTE: 同じハンドルの新しいモジュールが古い項目に当たらないよう、失敗した項目も外す。
+        entry->released = VK_TRUE;
+        if (entry->pipeline != VK_NULL_HANDLE) {
+            // NOTE: 積めなければキャッシュに残し、キャッシュの破棄とともに破棄する。
+            const VkResult res = defer_destroy_pipeline(deletion_queue, value, entry->pipeline);
+            if (res == VK_SUCCESS)
+                entry->pipeline = VK_NULL_HANDLE;
+            else
+                result = res;
+        }
+    }
+    pthread_mutex_unlock(&state->mutex);
+    return result;
+}
+
+void destroy_pipeline_cache(PipelineCache *cache) {
+    PipelineState *state = (PipelineState *)cache->state;
+    if (state == NULL)
+        return;
+    // NOTE: 作成中のものは終わるまで待ち、まだ取られていないものは作らずに捨てる。
+    pthread_mutex_lock(&state->mutex);
+    state->quit = 1;
+    pthread_cond_broadcast(&state->wake);
+    pthread_mutex_unlock(&state->mutex);
+    for (uint32_t i = 0; i < cache->thread_cnt; ++i) {
+        pthread_join(state->threads[i], NULL);
+    }
+    for (uint32_t i = 0; i < state->cnt; ++i) {
+        if (state->entries[i].pipeline != VK_NULL_HANDLE)
+            vkDestroyPipeline(state->device, state->entries[i].pipeline, NULL);
+    }
+    vkDestroyPipelineCache(state->device, cache->cache, NULL);
+    pthread_cond_destroy(&state->done);
+    pthread_cond_destroy(&state->wake);
+    pthread_mutex_destroy(&state->mutex);
+    free(state->entries);
+    free(state->threads);
+    free(state);
+    cache->state = NULL;
+    cache->thread_cnt = 0;
+}
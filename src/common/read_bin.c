@@ -7,16 +7,41 @@ char *read_bin(const char *path, int *p_size) {
     FILE *file = fopen(path, "rb");
     if (file == NULL)
         return NULL;
-    char *buf = (char *)malloc(sizeof(char) * MAX_SHADER_BIN_SIZE);
-    int cnt = 0;
-    while (!feof(file)) {
-        char c;
-        if (fread(&c, sizeof(char), 1, file) > 0) {
-            buf[cnt] = c;
-            cnt += 1;
-        }
+    // NOTE: 先にサイズを調べ、ファイル全体が収まるだけ確保する。
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *buf = size > 0 ? (char *)malloc(sizeof(char) * size) : NULL;
+    if (buf == NULL || fread(buf, sizeof(char), size, file) != (size_t)size) {
+        fclose(file);
+        free(buf);
+        return NULL;
     }
     fclose(file);
-    *p_size = cnt;
+    *p_size = (int)size;
     return buf;
 }
+
+VkBool32 load_spirv(const uint32_t *embedded, size_t embedded_size, const char *path, SpirvCode *out) {
+    if (embedded != NULL) {
+        out->code = embedded;
+        out->size = embedded_size;
+        out->owned = NULL;
+        return VK_TRUE;
+    }
+    // NOTE: mallocの返すメモリはuint32_tの境界に揃っているので、そのままコードとして渡せる。
+    int size;
+    out->owned = read_bin(path, &size);
+    if (out->owned == NULL)
+        return VK_FALSE;
+    out->code = (const uint32_t *)out->owned;
+    out->size = (size_t)size;
+    return VK_TRUE;
+}
+
+void free_spirv(SpirvCode *code) {
+    free(code->owned);
+    code->owned = NULL;
+    code->code = NULL;
+    code->size = 0;
+}
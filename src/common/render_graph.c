@@ -0,0 +1,444 @@
+#include "vulkan-tutorial.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// NOTE: これらのビットがあるアクセスは書き込みとみなす。
+#define WRITE_ACCESS_MASK ( \
+    VK_ACCESS_SHADER_WRITE_BIT | \
+    VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | \
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | \
+    VK_ACCESS_TRANSFER_WRITE_BIT | \
+    VK_ACCESS_HOST_WRITE_BIT | \
+    VK_ACCESS_MEMORY_WRITE_BIT \
+)
+
+// 一回のvkCmdPipelineBarrierにまとめるバリア。
+typedef struct BarrierBatch_t {
+    VkPipelineStageFlags src_stages;
+    VkPipelineStageFlags dst_stages;
+    uint32_t image_cnt;
+    VkImageMemoryBarrier images[RENDER_GRAPH_RESOURCE_MAX_CNT];
+    uint32_t buffer_cnt;
+    VkBufferMemoryBarrier buffers[RENDER_GRAPH_RESOURCE_MAX_CNT];
+} BarrierBatch;
+
+void init_render_graph(RenderGraph *out) {
+    memset(out, 0, sizeof(RenderGraph));
+}
+
+static VkResult add_resource(RenderGraph *graph, VkBool32 is_image, uint32_t *out) {
+    CHECK_RETURN(!graph->compiled);
+    CHECK_RETURN(graph->resource_cnt < RENDER_GRAPH_RESOURCE_MAX_CNT);
+    RenderGraphResource *res = &graph->resources[graph->resource_cnt];
+    memset(res, 0, sizeof(RenderGraphResource));
+    res->is_image = is_image;
+    res->mip_cnt = 1;
+    res->first_pass = RENDER_GRAPH_NONE;
+    res->last_pass = RENDER_GRAPH_NONE;
+    res->alias = RENDER_GRAPH_NONE;
+    res->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    *out = graph->resource_cnt;
+    graph->resource_cnt += 1;
+    return VK_SUCCESS;
+}
+
+VkResult add_render_graph_image(RenderGraph *graph, VkImageAspectFlags aspect, uint32_t mip_cnt, uint32_t *out) {
+    CHECK_RETURN_VK(add_resource(graph, VK_TRUE, out));
+    graph->resources[*out].aspect = aspect;
+    graph->resources[*out].mip_cnt = mip_cnt;
+    return VK_SUCCESS;
+}
+
+VkResult add_render_graph_buffer(RenderGraph *graph, uint32_t *out) {
+    return add_resource(graph, VK_FALSE, out);
+}
+
+VkResult add_render_graph_transient(
+    RenderGraph *graph,
+    VkFormat format,
+    uint32_t width,
+    uint32_t height,
+    VkSampleCountFlagBits samples,
+    VkImageUsageFlags usage,
+    VkImageAspectFlags aspect,
+    uint32_t *out
+) {
+    CHECK_RETURN_VK(add_resource(graph, VK_TRUE, out));
+    RenderGraphResource *res = &graph->resources[*out];
+    res->transient = VK_TRUE;
+    res->aspect = aspect;
+    res->format = format;
+    res->width = width;
+    res->height = height;
+    res->samples = samples;
+    res->usage = usage;
+    return VK_SUCCESS;
+}
+
+VkResult set_render_graph_output(RenderGraph *graph, uint32_t resource, const RenderGraphAccess *final) {
+    CHECK_RETURN(!graph->compiled);
+    CHECK_RETURN(resource < graph->resource_cnt);
+    RenderGraphResource *res = &graph->resources[resource];
+    res->output = VK_TRUE;
+    if (final != NULL) {
+        res->final = *final;
+        res->final.resource = resource;
+    }
+    return VK_SUCCESS;
+}
+
+VkResult add_render_graph_pass(RenderGraph *graph, uint32_t access_cnt, const RenderGraphAccess *accesses, uint32_t *out) {
+    CHECK_RETURN(!graph->compiled);
+    CHECK_RETURN(graph->pass_cnt < RENDER_GRAPH_PASS_MAX_CNT);
+    RenderGraphPass *pass = &graph->passes[graph->pass_cnt];
+    memset(pass, 0, sizeof(RenderGraphPass));
+    // NOTE: 同じ資源への使い方は一つにまとめ、一つのバリアで済ませる。
+    for (uint32_t i = 0; i < access_cnt; ++i) {
+        const RenderGraphAccess *access = &accesses[i];
+        CHECK_RETURN(access->resource < graph->resource_cnt);
+        uint32_t k = 0;
+        while (k < pass->access_cnt && pass->accesses[k].resource != access->resource)
+            k += 1;
+        if (k < pass->access_cnt) {
+            CHECK_RETURN(pass->accesses[k].layout == access->layout);
+            pass->accesses[k].stages |= access->stages;
+            pass->accesses[k].access |= access->access;
+        } else {
+            CHECK_RETURN(pass->access_cnt < RENDER_GRAPH_ACCESS_MAX_CNT);
+            pass->accesses[pass->access_cnt] = *access;
+            pass->access_cnt += 1;
+        }
+    }
+    *out = graph->pass_cnt;
+    graph->pass_cnt += 1;
+    return VK_SUCCESS;
+}
+
+// 結果につながらないパスに印を付ける関数。
+// NOTE: 後ろのパスから見ていき、要る資源に書き込むパスを残す。残したパスが読む資源は、それより前のパスに要る。
+// NOTE: 読まずに書き込むだけなら前の内容は要らないので、それより前にその資源へ書き込んだパスは要らない。
+static void cull_passes(RenderGraph *graph) {
+    VkBool32 needed[RENDER_GRAPH_RESOURCE_MAX_CNT];
+    for (uint32_t i = 0; i < graph->resource_cnt; ++i) {
+        needed[i] = graph->resources[i].output;
+    }
+    for (uint32_t p = graph->pass_cnt; p-- > 0; ) {
+        RenderGraphPass *pass = &graph->passes[p];
+        pass->culled = VK_TRUE;
+        for (uint32_t i = 0; i < pass->access_cnt; ++i) {
+            const RenderGraphAccess *access = &pass->accesses[i];
+            if ((access->access & WRITE_ACCESS_MASK) && needed[access->resource])
+                pass->culled = VK_FALSE;
+        }
+        if (pass->culled)
+            continue;
+        for (uint32_t i = 0; i < pass->access_cnt; ++i) {
+            const RenderGraphAccess *access = &pass->accesses[i];
+            needed[access->resource] = (access->access & ~WRITE_ACCESS_MASK) != 0;
+        }
+    }
+}
+
+// 一時的なイメージを作り、使うパスの範囲が重ならないものに同じメモリを割り当てる関数。
+// NOTE: 使い始めの早いものから順に、同じメモリタイプで前の使い手がすでに使い終えたメモリを探す。なければ新しく確保する。
+static VkResult alias_transients(const VkDevice device, const VkPhysicalDeviceMemoryProperties *mem_prop, RenderGraph *graph) {
+    uint32_t type_indices[RENDER_GRAPH_RESOURCE_MAX_CNT];
+    VkDeviceSize sizes[RENDER_GRAPH_RESOURCE_MAX_CNT];
+    uint32_t occupants[RENDER_GRAPH_RESOURCE_MAX_CNT]; // NOTE: メモリごとの、最後に割り当てたイメージ。
+    uint32_t memory_indices[RENDER_GRAPH_RESOURCE_MAX_CNT];
+    uint32_t memory_cnt = 0;
+    for (uint32_t p = 0; p < graph->pass_cnt; ++p) {
+        for (uint32_t r = 0; r < graph->resource_cnt; ++r) {
+            RenderGraphResource *target = &graph->resources[r];
+            if (!target->transient || target->first_pass != p)
+                continue;
+            const VkImageCreateInfo ci = {
+                VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                NULL,
+                0,
+                VK_IMAGE_TYPE_2D,
+                target->format,
+                { target->width, target->height, 1 },
+                1,
+                1,
+                target->samples,
+                VK_IMAGE_TILING_OPTIMAL,
+                target->usage,
+                VK_SHARING_MODE_EXCLUSIVE,
+                0,
+                NULL,
+                VK_IMAGE_LAYOUT_UNDEFINED,
+            };
+            CHECK_RETURN_VK(vkCreateImage(device, &ci, NULL, &target->image));
+            VkMemoryRequirements reqs;
+            vkGetImageMemoryRequirements(device, target->image, &reqs);
+            int32_t type_index = -1;
+            if (target->usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)
+                type_index = get_memory_type_index(mem_prop, &reqs, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+            if (type_index < 0)
+                type_index = get_memory_type_index(mem_prop, &reqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            CHECK_RETURN(type_index >= 0);
+            uint32_t m = 0;
+            while (m < memory_cnt && !(type_indices[m] == (uint32_t)type_index && graph->resources[occupants[m]].last_pass < p))
+                m += 1;
+            if (m == memory_cnt) {
+                type_indices[m] = (uint32_t)type_index;
+                sizes[m] = 0;
+                memory_cnt += 1;
+            } else {
+                target->alias = occupants[m];
+            }
+            // NOTE: どのイメージもメモリの先頭に置くので、アラインメントは満たされる。
+            if (reqs.size > sizes[m])
+                sizes[m] = reqs.size;
+            occupants[m] = r;
+            memory_indices[r] = m;
+        }
+    }
+    for (uint32_t m = 0; m < memory_cnt; ++m) {
+        const VkMemoryAllocateInfo ai = {
+            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            NULL,
+            sizes[m],
+            type_indices[m],
+        };
+        CHECK_RETURN_VK(vkAllocateMemory(device, &ai, NULL, &graph->memories[m]));
+        graph->memory_cnt = m + 1;
+    }
+    for (uint32_t r = 0; r < graph->resource_cnt; ++r) {
+        RenderGraphResource *target = &graph->resources[r];
+        if (target->image == VK_NULL_HANDLE || !target->transient)
+            continue;
+        CHECK_RETURN_VK(vkBindImageMemory(device, target->image, graph->memories[memory_indices[r]], 0));
+        const VkImageViewCreateInfo ci = {
+            VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            NULL,
+            0,
+            target->image,
+            VK_IMAGE_VIEW_TYPE_2D,
+            target->format,
+            {
+                VK_COMPONENT_SWIZZLE_R,
+                VK_COMPONENT_SWIZZLE_G,
+                VK_COMPONENT_SWIZZLE_B,
+                VK_COMPONENT_SWIZZLE_A,
+            },
+            { target->aspect, 0, 1, 0, 1 },
+        };
+        CHECK_RETURN_VK(vkCreateImageView(device, &ci, NULL, &target->view));
+    }
+    return VK_SUCCESS;
+}
+
+VkResult compile_render_graph(const VkDevice device, const VkPhysicalDeviceMemoryProperties *mem_prop, RenderGraph *graph) {
+    CHECK_RETURN(!graph->compiled);
+    cull_passes(graph);
+
+    // NOTE: 残ったパスだけで、資源を使う範囲を求める。
+    uint32_t culled_cnt = 0;
+    for (uint32_t p = 0; p < graph->pass_cnt; ++p) {
+        const RenderGraphPass *pass = &graph->passes[p];
+        if (pass->culled) {
+            culled_cnt += 1;
+            continue;
+        }
+        for (uint32_t i = 0; i < pass->access_cnt; ++i) {
+            RenderGraphResource *res = &graph->resources[pass->accesses[i].resource];
+            if (res->first_pass == RENDER_GRAPH_NONE)
+                res->first_pass = p;
+            res->last_pass = p;
+        }
+    }
+    CHECK_RETURN_VK(alias_transients(device, mem_prop, graph));
+    graph->compiled = VK_TRUE;
+
+    uint32_t transient_cnt = 0;
+    for (uint32_t r = 0; r < graph->resource_cnt; ++r) {
+        if (graph->resources[r].transient && graph->resources[r].image != VK_NULL_HANDLE)
+            transient_cnt += 1;
+    }
+    printf(
+        "[ Info    ] render graph: %u passes (%u culled), %u transient images in %u allocations\n",
+        graph->pass_cnt - culled_cnt,
+        culled_cnt,
+        transient_cnt,
+        graph->memory_cnt
+    );
+    return VK_SUCCESS;
+}
+
+void set_render_graph_image(RenderGraph *graph, uint32_t resource, const VkImage image, VkPipelineStageFlags stages, VkImageLayout layout) {
+    RenderGraphResource *res = &graph->resources[resource];
+    res->image = image;
+    res->layout = layout;
+    res->write_stages = stages;
+    res->write_access = 0;
+    res->read_stages = 0;
+    res->read_access = 0;
+}
+
+void set_render_graph_buffer(RenderGraph *graph, uint32_t resource, const VkBuffer buffer) {
+    graph->resources[resource].buffer = buffer;
+}
+
+void begin_render_graph(RenderGraph *graph) {
+    graph->next_pass = 0;
+    for (uint32_t r = 0; r < graph->resource_cnt; ++r) {
+        RenderGraphResource *res = &graph->resources[r];
+        if (!res->transient)
+            continue;
+        res->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        res->write_stages = 0;
+        res->write_access = 0;
+        res->read_stages = 0;
+        res->read_access = 0;
+    }
+}
+
+// 資源をaccessのとおりに使う前に要る同期をバッチに足し、資源の状態を使った後のものに進める関数。
+// NOTE: 書き込みの後の読み込みは書き込みを、読み込みの後の書き込みは読み込みの実行を待つ。同期を済ませた読み込みどうしはバリアを挟まない。
+// NOTE: レイアウトの遷移は書き込みとして扱う。遷移を待った読み込みは、その後の同じステージの読み込みで再び待たない。
+static void add_barrier(RenderGraph *graph, RenderGraphResource *res, const RenderGraphAccess *access, VkBool32 first_use, BarrierBatch *batch) {
+    const VkBool32 write = (access->access & WRITE_ACCESS_MASK) != 0;
+    const VkBool32 transition = res->is_image && res->layout != access->layout;
+    VkPipelineStageFlags src_stages = 0;
+    VkAccessFlags src_access = 0;
+    VkBool32 needed = transition;
+    if (transition || write) {
+        // NOTE: 同期を済ませた読み込みがあれば、書き込みはそれより前に見えるようになっているので、読み込みの実行だけを待つ。
+        if (res->read_stages != 0) {
+            src_stages = res->read_stages;
+        } else {
+            src_stages = res->write_stages;
+            src_access = res->write_access;
+        }
+        needed = needed || src_stages != 0;
+    } else if (res->write_stages != 0 && ((access->stages & ~res->read_stages) || (access->access & ~res->read_access))) {
+        src_stages = res->write_stages;
+        src_access = res->write_access;
+        needed = VK_TRUE;
+    }
+    // NOTE: メモリを共有する一時的なイメージは、使い始める前に前の使い手を待つ。
+    if (first_use && res->alias != RENDER_GRAPH_NONE) {
+        const RenderGraphResource *prev = &graph->resources[res->alias];
+        src_stages |= prev->write_stages | prev->read_stages;
+        src_access |= prev->write_access;
+    }
+
+    if (needed) {
+        batch->src_stages |= src_stages;
+        batch->dst_stages |= access->stages;
+        if (res->is_image) {
+            const VkImageMemoryBarrier barrier = {
+                VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                NULL,
+                src_access,
+                access->access,
+                res->layout,
+                access->layout,
+                VK_QUEUE_FAMILY_IGNORED,
+                VK_QUEUE_FAMILY_IGNORED,
+                res->image,
+                { res->aspect, 0, res->mip_cnt, 0, 1 },
+            };
+            batch->images[batch->image_cnt] = barrier;
+            batch->image_cnt += 1;
+        } else {
+            const VkBufferMemoryBarrier barrier = {
+                VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                NULL,
+                src_access,
+                access->access,
+                VK_QUEUE_FAMILY_IGNORED,
+                VK_QUEUE_FAMILY_IGNORED,
+                res->buffer,
+                0,
+                VK_WHOLE_SIZE,
+            };
+            batch->buffers[batch->buffer_cnt] = barrier;
+            batch->buffer_cnt += 1;
+        }
+    }
+
+    if (transition || write) {
+        res->write_stages = access->stages;
+        res->write_access = access->access & WRITE_ACCESS_MASK;
+        res->read_stages = write ? 0 : access->stages;
+        res->read_access = write ? 0 : access->access;
+    } else {
+        res->read_stages |= access->stages;
+        res->read_access |= access->access;
+    }
+    if (res->is_image)
+        res->layout = access->layout;
+}
+
+static void cmd_flush_barriers(const VkCommandBuffer command, const BarrierBatch *batch) {
+    if (batch->image_cnt == 0 && batch->buffer_cnt == 0)
+        return;
+    // NOTE: 待つものがなければ(中身を捨てる初めての遷移など)、パイプラインの先頭から始めてよい。
+    vkCmdPipelineBarrier(
+        command,
+        batch->src_stages != 0 ? batch->src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        batch->dst_stages,
+        0,
+        0,
+        NULL,
+        batch->buffer_cnt,
+        batch->buffers,
+        batch->image_cnt,
+        batch->images
+    );
+}
+
+VkBool32 cmd_begin_render_graph_pass(const VkCommandBuffer command, RenderGraph *graph, uint32_t pass) {
+    if (!graph->compiled || pass < graph->next_pass || pass >= graph->pass_cnt)
+        return VK_FALSE;
+    graph->next_pass = pass + 1;
+    const RenderGraphPass *p = &graph->passes[pass];
+    if (p->culled)
+        return VK_FALSE;
+    BarrierBatch batch;
+    batch.src_stages = 0;
+    batch.dst_stages = 0;
+    batch.image_cnt = 0;
+    batch.buffer_cnt = 0;
+    for (uint32_t i = 0; i < p->access_cnt; ++i) {
+        RenderGraphResource *res = &graph->resources[p->accesses[i].resource];
+        add_barrier(graph, res, &p->accesses[i], res->first_pass == pass, &batch);
+    }
+    cmd_flush_barriers(command, &batch);
+    return VK_TRUE;
+}
+
+void cmd_end_render_graph(const VkCommandBuffer command, RenderGraph *graph) {
+    BarrierBatch batch;
+    batch.src_stages = 0;
+    batch.dst_stages = 0;
+    batch.image_cnt = 0;
+    batch.buffer_cnt = 0;
+    for (uint32_t r = 0; r < graph->resource_cnt; ++r) {
+        RenderGraphResource *res = &graph->resources[r];
+        if (res->output && res->final.stages != 0)
+            add_barrier(graph, res, &res->final, VK_FALSE, &batch);
+    }
+    cmd_flush_barriers(command, &batch);
+    graph->next_pass = graph->pass_cnt;
+}
+
+void destroy_render_graph(const VkDevice device, RenderGraph *graph) {
+    for (uint32_t r = 0; r < graph->resource_cnt; ++r) {
+        RenderGraphResource *res = &graph->resources[r];
+        if (!res->transient)
+            continue;
+        if (res->view != VK_NULL_HANDLE)
+            vkDestroyImageView(device, res->view, NULL);
+        if (res->image != VK_NULL_HANDLE)
+            vkDestroyImage(device, res->image, NULL);
+    }
+    for (uint32_t m = 0; m < graph->memory_cnt; ++m) {
+        vkFreeMemory(device, graph->memories[m], NULL);
+    }
+    init_render_graph(graph);
+}
@@ -0,0 +1,103 @@
+#include "vulkan-tutorial.h"
+
+#include <string.h>
+
+VkResult create_sampler_cache(const VkPhysicalDevice phys_device, VkBool32 anisotropy_enabled, SamplerCache *out) {
+    memset(out, 0, sizeof(SamplerCache));
+    VkPhysicalDeviceProperties prop;
+    vkGetPhysicalDeviceProperties(phys_device, &prop);
+    // NOTE: 論理デバイスで有効にしていなければ、対応していても使えない。
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(phys_device, &features);
+    out->anisotropy = anisotropy_enabled && features.samplerAnisotropy;
+    out->max_anisotropy = out->anisotropy ? prop.limits.maxSamplerAnisotropy : 1.0f;
+    out->max_cnt = prop.limits.maxSamplerAllocationCount;
+    return VK_SUCCESS;
+}
+
+// 作成情報をデバイスで使える値に直し、比べられる形(キー)にする関数。
+// NOTE: 異方性フィルタリングを使えなければ無効にし、最大値は上限に収める。同じ結果になる作成情報は同じキーになる。
+static void build_sampler_key(const SamplerCache *cache, const VkSamplerCreateInfo *ci, SamplerKey *out) {
+    memset(out, 0, sizeof(SamplerKey));
+    out->flags = ci->flags;
+    out->mag_filter = ci->magFilter;
+    out->min_filter = ci->minFilter;
+    out->mipmap_mode = ci->mipmapMode;
+    out->address_mode_u = ci->addressModeU;
+    out->address_mode_v = ci->addressModeV;
+    out->address_mode_w = ci->addressModeW;
+    out->mip_lod_bias = ci->mipLodBias;
+    out->anisotropy_enable = cache->anisotropy && ci->anisotropyEnable;
+    if (out->anisotropy_enable)
+        out->max_anisotropy = ci->maxAnisotropy < cache->max_anisotropy ? ci->maxAnisotropy : cache->max_anisotropy;
+    out->compare_enable = ci->compareEnable;
+    out->compare_op = ci->compareEnable ? ci->compareOp : VK_COMPARE_OP_NEVER;
+    out->min_lod = ci->minLod;
+    out->max_lod = ci->maxLod;
+    out->border_color = ci->borderColor;
+    out->unnormalized_coordinates = ci->unnormalizedCoordinates;
+}
+
+VkResult get_sampler(const VkDevice device, SamplerCache *cache, const VkSamplerCreateInfo *ci, VkSampler *out) {
+    // NOTE: pNextの中身(YCbCr変換など)まではキーにできないので、拡張の構造体は受け付けない。
+    CHECK_RETURN(ci->pNext == NULL);
+    SamplerKey key;
+    build_sampler_key(cache, ci, &key);
+    const uint64_t hash = hash_bytes(&key, sizeof(SamplerKey), 0);
+
+    // NOTE: サンプラの種類は多くないので、ハッシュを先頭から比べれば足りる。
+    for (uint32_t i = 0; i < cache->cnt; ++i) {
+        const SamplerEntry *entry = &cache->entries[i];
+        if (entry->hash == hash && memcmp(&entry->key, &key, sizeof(SamplerKey)) == 0) {
+            *out = entry->sampler;
+            return VK_SUCCESS;
+        }
+    }
+
+    // NOTE: デバイス全体で作れるサンプラの数には上限がある(maxSamplerAllocationCount)。
+    CHECK_RETURN(cache->cnt < cache->max_cnt);
+    if (cache->cnt == cache->capacity) {
+        const uint32_t capacity = cache->capacity == 0 ? 8 : cache->capacity * 2;
+        SamplerEntry *entries = (SamplerEntry *)realloc(cache->entries, sizeof(SamplerEntry) * capacity);
+        CHECK_RETURN(entries != NULL);
+        cache->entries = entries;
+        cache->capacity = capacity;
+    }
+    const VkSamplerCreateInfo fixed_ci = {
+        VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        NULL,
+        key.flags,
+        key.mag_filter,
+        key.min_filter,
+        key.mipmap_mode,
+        key.address_mode_u,
+        key.address_mode_v,
+        key.address_mode_w,
+        key.mip_lod_bias,
+        key.anisotropy_enable,
+        key.anisotropy_enable ? key.max_anisotropy : 1.0f,
+        key.compare_enable,
+        key.compare_op,
+        key.min_lod,
+        key.max_lod,
+        key.border_color,
+        key.unnormalized_coordinates,
+    };
+    VkSampler sampler;
+    CHECK_RETURN_VK(vkCreateSampler(device, &fixed_ci, NULL, &sampler));
+    SamplerEntry *entry = &cache->entries[cache->cnt];
+    entry->hash = hash;
+    entry->key = key;
+    entry->sampler = sampler;
+    cache->cnt += 1;
+    *out = sampler;
+    return VK_SUCCESS;
+}
+
+void destroy_sampler_cache(const VkDevice device, SamplerCache *cache) {
+    for (uint32_t i = 0; i < cache->cnt; ++i) {
+        vkDestroySampler(device, cache->entries[i].sampler, NULL);
+    }
+    free(cache->entries);
+    memset(cache, 0, sizeof(SamplerCache));
+}
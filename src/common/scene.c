@@ -0,0 +1,194 @@
+#include "vulkan-tutorial.h"
+
+#include <math.h>
+#include <string.h>
+
+#define SCENE_GRAIN 256 // NOTE: ジョブ一つあたりのノード数。行列の計算は軽いので、ある程度まとめて渡す。
+
+// 拡大・回転・平行移動から、ノードのローカル行列を求める関数。
+// NOTE: 09-cubeの頂点シェーダと同じく、拡大、x・y・z軸の回転、平行移動の順に掛ける。
+static void compose_local(const float *scl, const float *rot, const float *trs, float *out) {
+    const float cx = cosf(rot[0]), sx = sinf(rot[0]);
+    const float cy = cosf(rot[1]), sy = sinf(rot[1]);
+    const float cz = cosf(rot[2]), sz = sinf(rot[2]);
+    // NOTE: シェーダのmat4コンストラクタと同じ並び(列優先)で書く。
+    const float rx[16] = {
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f,   cx,  -sx, 0.0f,
+        0.0f,   sx,   cx, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f,
+    };
+    const float ry[16] = {
+          cy, 0.0f,   sy, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+         -sy, 0.0f,   cy, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f,
+    };
+    const float rz[16] = {
+          cz,  -sz, 0.0f, 0.0f,
+          sz,   cz, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f,
+    };
+    float ryx[16];
+    float r[16];
+    mul_mat4(ry, rx, ryx);
+    mul_mat4(rz, ryx, r);
+    // NOTE: 拡大は列に掛け、平行移動は4列目に置く。
+    for (uint32_t c = 0; c < 3; ++c) {
+        for (uint32_t k = 0; k < 4; ++k) {
+            out[c * 4 + k] = r[c * 4 + k] * scl[c];
+        }
+    }
+    out[12] = trs[0];
+    out[13] = trs[1];
+    out[14] = trs[2];
+    out[15] = 1.0f;
+}
+
+VkResult create_scene_graph(uint32_t capacity, SceneGraph *out) {
+    memset(out, 0, sizeof(SceneGraph));
+    CHECK_RETURN(capacity > 0);
+    out->capacity = capacity;
+    out->parents = (uint32_t *)malloc(sizeof(uint32_t) * capacity);
+    out->depths = (uint32_t *)malloc(sizeof(uint32_t) * capacity);
+    out->order = (uint32_t *)malloc(sizeof(uint32_t) * capacity);
+    out->level_starts = (uint32_t *)malloc(sizeof(uint32_t) * (capacity + 1));
+    out->scales = (float (*)[3])malloc(sizeof(float) * 3 * capacity);
+    out->rotations = (float (*)[3])malloc(sizeof(float) * 3 * capacity);
+    out->translations = (float (*)[3])malloc(sizeof(float) * 3 * capacity);
+    out->worlds = (float (*)[16])malloc(sizeof(float) * 16 * capacity);
+    out->dirty = (uint8_t *)malloc(sizeof(uint8_t) * capacity);
+    if (
+        out->parents == NULL || out->depths == NULL || out->order == NULL || out->level_starts == NULL
+            || out->scales == NULL || out->rotations == NULL || out->translations == NULL
+            || out->worlds == NULL || out->dirty == NULL
+    ) {
+        destroy_scene_graph(out);
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+    return VK_SUCCESS;
+}
+
+VkResult add_scene_node(
+    SceneGraph *graph,
+    uint32_t parent,
+    const float scl[3],
+    const float rot[3],
+    const float trs[3],
+    uint32_t *p_index
+) {
+    CHECK_RETURN(graph->cnt < graph->capacity);
+    // NOTE: 親は子より前にあるので、配列の順に辿れば必ず親が先に決まる。
+    CHECK_RETURN(parent == SCENE_NO_PARENT || parent < graph->cnt);
+    const uint32_t i = graph->cnt;
+    graph->parents[i] = parent;
+    graph->depths[i] = parent == SCENE_NO_PARENT ? 0 : graph->depths[parent] + 1;
+    graph->cnt = i + 1;
+    graph->sorted = VK_FALSE;
+    set_scene_node(graph, i, scl, rot, trs);
+    if (p_index != NULL)
+        *p_index = i;
+    return VK_SUCCESS;
+}
+
+void set_scene_node(SceneGraph *graph, uint32_t index, const float scl[3], const float rot[3], const float trs[3]) {
+    memcpy(graph->scales[index], scl, sizeof(float) * 3);
+    memcpy(graph->rotations[index], rot, sizeof(float) * 3);
+    memcpy(graph->translations[index], trs, sizeof(float) * 3);
+    graph->dirty[index] = 1;
+}
+
+// ノードを深さごとに並べ直す関数。同じ深さのノードは互いに依存しないので、並列に計算できる。
+// NOTE: 深さで数え上げソートするので、同じ深さの中では元の順(メモリ順)が保たれる。
+static void sort_scene_graph(SceneGraph *graph) {
+    graph->level_cnt = 0;
+    for (uint32_t i = 0; i < graph->cnt; ++i) {
+        if (graph->depths[i] + 1 > graph->level_cnt)
+            graph->level_cnt = graph->depths[i] + 1;
+    }
+    memset(graph->level_starts, 0, sizeof(uint32_t) * (graph->level_cnt + 1));
+    for (uint32_t i = 0; i < graph->cnt; ++i) {
+        graph->level_starts[graph->depths[i] + 1] += 1;
+    }
+    for (uint32_t l = 0; l < graph->level_cnt; ++l) {
+        graph->level_starts[l + 1] += graph->level_starts[l];
+    }
+    // NOTE: level_startsを書き込み位置として進め、埋め終わったら一つずらして先頭に戻す。
+    for (uint32_t i = 0; i < graph->cnt; ++i) {
+        graph->order[graph->level_starts[graph->depths[i]]++] = i;
+    }
+    for (uint32_t l = graph->level_cnt; l > 0; --l) {
+        graph->level_starts[l] = graph->level_starts[l - 1];
+    }
+    graph->level_starts[0] = 0;
+    graph->sorted = VK_TRUE;
+}
+
+// 一つの深さのジョブに渡す状態。
+typedef struct LevelJob_t {
+    SceneGraph *graph;
+    uint32_t offset; // NOTE: この深さの、orderの中での先頭。
+} LevelJob;
+
+// 一つの深さのノードの範囲[begin, end)を更新する関数。beginとendはorderの中の位置。
+static void update_range(SceneGraph *graph, uint32_t begin, uint32_t end) {
+    for (uint32_t k = begin; k < end; ++k) {
+        const uint32_t i = graph->order[k];
+        const uint32_t parent = graph->parents[i];
+        // NOTE: 親は一つ前の深さで更新済み。親が変わったなら、子も変わる。
+        if (parent != SCENE_NO_PARENT && graph->dirty[parent])
+            graph->dirty[i] = 1;
+        if (!graph->dirty[i])
+            continue;
+        if (parent == SCENE_NO_PARENT) {
+            compose_local(graph->scales[i], graph->rotations[i], graph->translations[i], graph->worlds[i]);
+        } else {
+            float local[16];
+            compose_local(graph->scales[i], graph->rotations[i], graph->translations[i], local);
+            mul_mat4(graph->worlds[parent], local, graph->worlds[i]);
+        }
+    }
+}
+
+static void level_job(void *user, uint32_t begin, uint32_t end) {
+    const LevelJob *level = (const LevelJob *)user;
+    update_range(level->graph, level->offset + begin, level->offset + end);
+}
+
+uint32_t update_scene_graph(JobSystem *jobs, SceneGraph *graph) {
+    if (!graph->sorted)
+        sort_scene_graph(graph);
+    for (uint32_t l = 0; l < graph->level_cnt; ++l) {
+        const uint32_t begin = graph->level_starts[l];
+        const uint32_t cnt = graph->level_starts[l + 1] - begin;
+        // NOTE: 少ないならワーカーを起こさずにその場で済ませる。
+        if (cnt <= SCENE_GRAIN) {
+            update_range(graph, begin, begin + cnt);
+            continue;
+        }
+        // NOTE: run_jobsは[0, cnt)を渡すので、この深さの先頭だけずらす。
+        const LevelJob level = { graph, begin };
+        run_jobs(jobs, cnt, SCENE_GRAIN, level_job, (void *)&level);
+    }
+    // NOTE: 子が親の印を見終わってから消す。
+    uint32_t updated = 0;
+    for (uint32_t i = 0; i < graph->cnt; ++i) {
+        updated += graph->dirty[i];
+        graph->dirty[i] = 0;
+    }
+    return updated;
+}
+
+void destroy_scene_graph(SceneGraph *graph) {
+    free(graph->parents);
+    free(graph->depths);
+    free(graph->order);
+    free(graph->level_starts);
+    free(graph->scales);
+    free(graph->rotations);
+    free(graph->translations);
+    free(graph->worlds);
+    free(graph->dirty);
+    memset(graph, 0, sizeof(SceneGraph));
+}
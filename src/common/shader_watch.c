@@ -0,0 +1,225 @@
+#include "vulkan-tutorial.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#    include <poll.h>
+#    include <pthread.h>
+#    include <sys/inotify.h>
+#    include <time.h>
+#    include <unistd.h>
+
+#define SHADER_WATCH_POLL_MS 100 // NOTE: 終了の指示に気付くまでの最長の時間。
+#define SHADER_WATCH_SETTLE_MS 30 // NOTE: エディタは保存時に何度も書き込むので、この間イベントが途絶えてからコンパイルする。
+#define SHADER_WATCH_CMD_MAX_LEN 1024
+
+// 監視するシェーダ一つ分。
+typedef struct ShaderWatchEntry_t {
+    char *src;
+    char *out;
+    const char *name; // NOTE: srcのうち、ディレクトリを除いた部分。
+    int wd;
+    int dirty; // NOTE: 書き換えられたが、まだコンパイルしていない。
+    int reloaded; // NOTE: コンパイルできたが、まだ呼び出し側が取っていない。
+} ShaderWatchEntry;
+
+// 監視スレッドと呼び出し側が共有する状態。
+// NOTE: 呼び出し側と共有するのはreloadedとquitだけで、それらはmutexの下で読み書きする。
+typedef struct ShaderWatchState_t {
+    pthread_mutex_t mutex;
+    pthread_t thread;
+    int fd;
+    uint32_t cnt;
+    ShaderWatchEntry *entries;
+    int quit;
+} ShaderWatchState;
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+// 溜まったイベントを読み、書き換えられたシェーダに印を付ける関数。印を付けたら1を返す。
+static int read_events(ShaderWatchState *state, uint32_t cnt) {
+    // NOTE: inotify_eventは可変長なので、バッファを構造体の境界に揃えておく。
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int marked = 0;
+    for (;;) {
+        const ssize_t len = read(state->fd, buf, sizeof(buf));
+        if (len <= 0)
+            break;
+        for (char *p = buf; p < buf + len; ) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + ev->len;
+            if (ev->len == 0)
+                continue;
+            for (uint32_t i = 0; i < cnt; ++i) {
+                if (state->entries[i].wd == ev->wd && strcmp(state->entries[i].name, ev->name) == 0) {
+                    state->entries[i].dirty = 1;
+                    marked = 1;
+                }
+            }
+        }
+    }
+    return marked;
+}
+
+// 印の付いたシェーダをglslcでコンパイルする関数。
+// NOTE: glslcは失敗すると出力を書き換えないので、前のSPIR-Vが残る。エラーはglslcが標準エラー出力に出す。
+static void compile_dirty(ShaderWatchState *state, uint32_t cnt) {
+    for (uint32_t i = 0; i < cnt; ++i) {
+        ShaderWatchEntry *entry = &state->entries[i];
+        if (!entry->dirty)
+            continue;
+        entry->dirty = 0;
+        char cmd[SHADER_WATCH_CMD_MAX_LEN];
+        snprintf(cmd, sizeof(cmd), "glslc -o \"%s\" \"%s\"", entry->out, entry->src);
+        const double start = now_ms();
+        if (system(cmd) != 0) {
+            printf("[ Warning ] failed to compile %s.\n", entry->src);
+            continue;
+        }
+        printf("[ Info    ] shader: compiled %s in %.0f ms\n", entry->src, now_ms() - start);
+        pthread_mutex_lock(&state->mutex);
+        entry->reloaded = 1;
+        pthread_mutex_unlock(&state->mutex);
+    }
+}
+
+static void *watch_main(void *arg) {
+    ShaderWatchState *state = (ShaderWatchState *)arg;
+    const uint32_t cnt = state->cnt;
+    struct pollfd pfd = { state->fd, POLLIN, 0 };
+    for (;;) {
+        pthread_mutex_lock(&state->mutex);
+        const int quit = state->quit;
+        pthread_mutex_unlock(&state->mutex);
+        if (quit)
+            break;
+        if (poll(&pfd, 1, SHADER_WATCH_POLL_MS) <= 0)
+            continue;
+        if (!read_events(state, cnt))
+            continue;
+        // NOTE: 保存が落ち着くまで待ってから、まとめてコンパイルする。
+        while (poll(&pfd, 1, SHADER_WATCH_SETTLE_MS) > 0) {
+            read_events(state, cnt);
+        }
+        compile_dirty(state, cnt);
+    }
+    return NULL;
+}
+
+static char *dup_str(const char *s) {
+    const size_t len = strlen(s);
+    char *p = (char *)malloc(len + 1);
+    if (p != NULL)
+        memcpy(p, s, len + 1);
+    return p;
+}
+
+// 状態を、スレッド以外すべて解放する関数。
+static void free_state(ShaderWatchState *state, uint32_t cnt) {
+    for (uint32_t i = 0; i < cnt; ++i) {
+        free(state->entries[i].src);
+        free(state->entries[i].out);
+    }
+    free(state->entries);
+    if (state->fd >= 0)
+        close(state->fd);
+    free(state);
+}
+
+VkResult create_shader_watcher(uint32_t cnt, const char *const *srcs, const char *const *outs, ShaderWatcher *out) {
+    out->cnt = 0;
+    out->state = NULL;
+    CHECK_RETURN(cnt > 0);
+    ShaderWatchState *state = (ShaderWatchState *)malloc(sizeof(ShaderWatchState));
+    CHECK_RETURN(state != NULL);
+    state->cnt = cnt;
+    state->entries = (ShaderWatchEntry *)calloc(cnt, sizeof(ShaderWatchEntry));
+    state->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    state->quit = 0;
+    if (state->entries == NULL || state->fd < 0) {
+        free_state(state, 0);
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    for (uint32_t i = 0; i < cnt; ++i) {
+        ShaderWatchEntry *entry = &state->entries[i];
+        entry->src = dup_str(srcs[i]);
+        entry->out = dup_str(outs[i]);
+        if (entry->src == NULL || entry->out == NULL) {
+            free_state(state, i + 1);
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+        }
+        // NOTE: 多くのエディタは別のファイルに書いてから置き換えるので、ファイルではなくディレクトリを監視する。
+        char *sep = strrchr(entry->src, '/');
+        if (sep == NULL) {
+            entry->name = entry->src;
+            entry->wd = inotify_add_watch(state->fd, ".", IN_CLOSE_WRITE | IN_MOVED_TO);
+        } else {
+            *sep = '\0';
+            entry->wd = inotify_add_watch(state->fd, sep == entry->src ? "/" : entry->src, IN_CLOSE_WRITE | IN_MOVED_TO);
+            *sep = '/';
+            entry->name = sep + 1;
+        }
+        if (entry->wd < 0) {
+            printf("[ Warning ] failed to watch %s.\n", entry->src);
+            free_state(state, i + 1);
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+    }
+    pthread_mutex_init(&state->mutex, NULL);
+    if (pthread_create(&state->thread, NULL, watch_main, (void *)state) != 0) {
+        pthread_mutex_destroy(&state->mutex);
+        free_state(state, cnt);
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    out->cnt = cnt;
+    out->state = (void *)state;
+    return VK_SUCCESS;
+}
+
+VkBool32 take_shader_reload(ShaderWatcher *watcher, uint32_t index) {
+    ShaderWatchState *state = (ShaderWatchState *)watcher->state;
+    if (state == NULL || index >= watcher->cnt)
+        return VK_FALSE;
+    pthread_mutex_lock(&state->mutex);
+    const int reloaded = state->entries[index].reloaded;
+    state->entries[index].reloaded = 0;
+    pthread_mutex_unlock(&state->mutex);
+    return reloaded ? VK_TRUE : VK_FALSE;
+}
+
+void destroy_shader_watcher(ShaderWatcher *watcher) {
+    ShaderWatchState *state = (ShaderWatchState *)watcher->state;
+    if (state == NULL)
+        return;
+    pthread_mutex_lock(&state->mutex);
+    state->quit = 1;
+    pthread_mutex_unlock(&state->mutex);
+    pthread_join(state->thread, NULL);
+    pthread_mutex_destroy(&state->mutex);
+    free_state(state, watcher->cnt);
+    watcher->state = NULL;
+    watcher->cnt = 0;
+}
+
+#else
+
+// NOTE: inotifyのないプラットフォームでは監視できない。呼び出し側はホットリロードなしで動き続ければよい。
+VkResult create_shader_watcher(uint32_t cnt, const char *const *srcs, const char *const *outs, ShaderWatcher *out) {
+    out->cnt = 0;
+    out->state = NULL;
+    return VK_ERROR_FEATURE_NOT_PRESENT;
+}
+
+VkBool32 take_shader_reload(ShaderWatcher *watcher, uint32_t index) {
+    return VK_FALSE;
+}
+
+void destroy_shader_watcher(ShaderWatcher *watcher) {
+}
+
+#endif
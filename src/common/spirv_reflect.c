@@ -0,0 +1,522 @@
+#include "vulkan-tutorial.h"
+
+#include <string.h>
+
+// SPIR-Vの命令やデコレーションの番号。仕様書の値をそのまま使う。
+#define SPV_MAGIC 0x07230203
+#define SPV_HEADER_LEN 5
+#define SPV_OP_ENTRY_POINT 15
+#define SPV_OP_TYPE_INT 21
+#define SPV_OP_TYPE_FLOAT 22
+#define SPV_OP_TYPE_VECTOR 23
+#define SPV_OP_TYPE_MATRIX 24
+#define SPV_OP_TYPE_IMAGE 25
+#define SPV_OP_TYPE_SAMPLER 26
+#define SPV_OP_TYPE_SAMPLED_IMAGE 27
+#define SPV_OP_TYPE_ARRAY 28
+#define SPV_OP_TYPE_RUNTIME_ARRAY 29
+#define SPV_OP_TYPE_STRUCT 30
+#define SPV_OP_TYPE_POINTER 32
+#define SPV_OP_CONSTANT 43
+#define SPV_OP_VARIABLE 59
+#define SPV_OP_DECORATE 71
+#define SPV_OP_MEMBER_DECORATE 72
+#define SPV_DECORATION_BLOCK 2
+#define SPV_DECORATION_BUFFER_BLOCK 3
+#define SPV_DECORATION_ARRAY_STRIDE 6
+#define SPV_DECORATION_MATRIX_STRIDE 7
+#define SPV_DECORATION_BUILT_IN 11
+#define SPV_DECORATION_LOCATION 30
+#define SPV_DECORATION_BINDING 33
+#define SPV_DECORATION_DESCRIPTOR_SET 34
+#define SPV_DECORATION_OFFSET 35
+#define SPV_STORAGE_UNIFORM_CONSTANT 0
+#define SPV_STORAGE_INPUT 1
+#define SPV_STORAGE_UNIFORM 2
+#define SPV_STORAGE_PUSH_CONSTANT 9
+#define SPV_STORAGE_STORAGE_BUFFER 12
+#define SPV_DIM_BUFFER 5
+#define SPV_DIM_SUBPASS_DATA 6
+
+#define SPV_NONE 0xFFFFFFFF
+
+// 結果を持つ命令一つ分の情報。番号(id)で引く。
+typedef struct SpirvId_t {
+    uint32_t offset; // NOTE: 定義する命令の位置。定義されていなければ0。
+    uint32_t set;
+    uint32_t binding;
+    uint32_t location;
+    uint32_t array_stride;
+    uint8_t built_in;
+    uint8_t block;
+    uint8_t buffer_block;
+} SpirvId;
+
+typedef struct Spirv_t {
+    const uint32_t *code;
+    uint32_t len;
+    SpirvId *ids;
+    uint32_t bound;
+} Spirv;
+
+static uint32_t spv_op(const Spirv *spv, uint32_t offset) {
+    return spv->code[offset] & 0xFFFF;
+}
+
+// 番号の定義を引く関数。定義されていなければNULLを返す。
+static const uint32_t *spv_def(const Spirv *spv, uint32_t id) {
+    if (id >= spv->bound || spv->ids[id].offset == 0)
+        return NULL;
+    return &spv->code[spv->ids[id].offset];
+}
+
+// 構造体のメンバのデコレーションを探す関数。なければdefを返す。
+// NOTE: メンバのデコレーションはプッシュ定数の大きさを求めるときしか使わないので、その都度先頭から探す。
+static uint32_t spv_member_decoration(const Spirv *spv, uint32_t id, uint32_t member, uint32_t decoration, uint32_t def) {
+    for (uint32_t i = SPV_HEADER_LEN; i < spv->len; i += spv->code[i] >> 16) {
+        const uint32_t *w = &spv->code[i];
+        if ((w[0] & 0xFFFF) == SPV_OP_MEMBER_DECORATE && (w[0] >> 16) >= 5 && w[1] == id && w[2] == member && w[3] == decoration)
+            return w[4];
+    }
+    return def;
+}
+
+// 型の大きさを求める関数。求められなければ0を返す。
+//   - matrix_stride: 行列のメンバに付いたMatrixStride。なければ0
+static uint32_t spv_type_size(const Spirv *spv, uint32_t id, uint32_t matrix_stride) {
+    const uint32_t *def = spv_def(spv, id);
+    if (def == NULL)
+        return 0;
+    switch (def[0] & 0xFFFF) {
+        case SPV_OP_TYPE_INT:
+        case SPV_OP_TYPE_FLOAT:
+            return def[2] / 8;
+        case SPV_OP_TYPE_VECTOR:
+            return def[3] * spv_type_size(spv, def[2], 0);
+        case SPV_OP_TYPE_MATRIX:
+            return def[3] * (matrix_stride > 0 ? matrix_stride : spv_type_size(spv, def[2], 0));
+        case SPV_OP_TYPE_ARRAY: {
+            const uint32_t *len = spv_def(spv, def[3]);
+            if (len == NULL || (len[0] & 0xFFFF) != SPV_OP_CONSTANT)
+                return 0;
+            const uint32_t stride = spv->ids[id].array_stride;
+            return len[3] * (stride > 0 ? stride : spv_type_size(spv, def[2], 0));
+        }
+        case SPV_OP_TYPE_STRUCT: {
+            // NOTE: 詰め物があるので、メンバの大きさの和ではなく、最も後ろのメンバの終わりとする。
+            uint32_t size = 0;
+            const uint32_t member_cnt = (def[0] >> 16) - 2;
+            for (uint32_t m = 0; m < member_cnt; ++m) {
+                const uint32_t offset = spv_member_decoration(spv, id, m, SPV_DECORATION_OFFSET, 0);
+                const uint32_t stride = spv_member_decoration(spv, id, m, SPV_DECORATION_MATRIX_STRIDE, 0);
+                const uint32_t end = offset + spv_type_size(spv, def[2 + m], stride);
+                if (end > size)
+                    size = end;
+            }
+            return size;
+        }
+        default:
+            return 0;
+    }
+}
+
+// 変数の型からディスクリプタの種類と数を求める関数。ディスクリプタでなければVK_FALSEを返す。
+// NOTE: 実行時に大きさの決まる配列(bindlessなど)の数は0とする。
+static VkBool32 spv_descriptor(const Spirv *spv, uint32_t storage, uint32_t type, VkDescriptorType *p_type, uint32_t *p_cnt) {
+    uint32_t cnt = 1;
+    for (;;) {
+        const uint32_t *def = spv_def(spv, type);
+        if (def == NULL)
+            return VK_FALSE;
+        const uint32_t op = def[0] & 0xFFFF;
+        if (op == SPV_OP_TYPE_RUNTIME_ARRAY) {
+            cnt = 0;
+            type = def[2];
+        } else if (op == SPV_OP_TYPE_ARRAY) {
+            const uint32_t *len = spv_def(spv, def[3]);
+            if (len == NULL || (len[0] & 0xFFFF) != SPV_OP_CONSTANT)
+                return VK_FALSE;
+            cnt *= len[3];
+            type = def[2];
+        } else {
+            break;
+        }
+    }
+    const uint32_t *def = spv_def(spv, type);
+    const uint32_t op = def[0] & 0xFFFF;
+    *p_cnt = cnt;
+    if (storage == SPV_STORAGE_STORAGE_BUFFER) {
+        *p_type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        return VK_TRUE;
+    }
+    if (storage == SPV_STORAGE_UNIFORM) {
+        // NOTE: 古い書き方では、ストレージバッファもUniformにBufferBlockを付けて表す。
+        if (op != SPV_OP_TYPE_STRUCT)
+            return VK_FALSE;
+        *p_type = spv->ids[type].buffer_block ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        return VK_TRUE;
+    }
+    if (storage != SPV_STORAGE_UNIFORM_CONSTANT)
+        return VK_FALSE;
+    if (op == SPV_OP_TYPE_SAMPLER) {
+        *p_type = VK_DESCRIPTOR_TYPE_SAMPLER;
+        return VK_TRUE;
+    }
+    if (op == SPV_OP_TYPE_SAMPLED_IMAGE) {
+        const uint32_t *image = spv_def(spv, def[2]);
+        if (image == NULL)
+            return VK_FALSE;
+        *p_type = image[3] == SPV_DIM_BUFFER ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        return VK_TRUE;
+    }
+    if (op == SPV_OP_TYPE_IMAGE) {
+        // NOTE: Sampledが2なら、サンプラを通さずに読み書きするイメージ。
+        const VkBool32 storage_image = def[7] == 2;
+        if (def[3] == SPV_DIM_SUBPASS_DATA)
+            *p_type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        else if (def[3] == SPV_DIM_BUFFER)
+            *p_type = storage_image ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+        else
+            *p_type = storage_image ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        return VK_TRUE;
+    }
+    return VK_FALSE;
+}
+
+// 頂点入力の型からフォーマットと大きさを求める関数。32bitのスカラーとベクトルだけを扱い、それ以外はVK_FORMAT_UNDEFINEDとする。
+static VkFormat spv_input_format(const Spirv *spv, uint32_t type, uint32_t *p_size) {
+    static const VkFormat formats[3][4] = {
+        { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT },
+        { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT },
+        { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT },
+    };
+    *p_size = 0;
+    const uint32_t *def = spv_def(spv, type);
+    if (def == NULL)
+        return VK_FORMAT_UNDEFINED;
+    uint32_t comp_cnt = 1;
+    if ((def[0] & 0xFFFF) == SPV_OP_TYPE_VECTOR) {
+        comp_cnt = def[3];
+        def = spv_def(spv, def[2]);
+    }
+    if (def == NULL || comp_cnt < 1 || comp_cnt > 4 || def[2] != 32)
+        return VK_FORMAT_UNDEFINED;
+    *p_size = comp_cnt * 4;
+    if ((def[0] & 0xFFFF) == SPV_OP_TYPE_FLOAT)
+        return formats[0][comp_cnt - 1];
+    if ((def[0] & 0xFFFF) == SPV_OP_TYPE_INT)
+        return formats[def[3] ? 1 : 2][comp_cnt - 1];
+    return VK_FORMAT_UNDEFINED;
+}
+
+static VkShaderStageFlags spv_stage(uint32_t model) {
+    switch (model) {
+        case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+        case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+        case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+        case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+        case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+        case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+        default: return 0;
+    }
+}
+
+// 一つ目のパスで、番号ごとに定義の位置とデコレーションを集める関数。
+static VkResult spv_collect(Spirv *spv, VkShaderStageFlags *p_stage) {
+    *p_stage = 0;
+    for (uint32_t i = SPV_HEADER_LEN; i < spv->len; ) {
+        const uint32_t *w = &spv->code[i];
+        const uint32_t cnt = w[0] >> 16;
+        CHECK_RETURN(cnt > 0 && i + cnt <= spv->len);
+        const uint32_t op = w[0] & 0xFFFF;
+        uint32_t result = SPV_NONE;
+        if (op >= SPV_OP_TYPE_INT && op <= SPV_OP_TYPE_POINTER && cnt >= 2)
+            result = w[1];
+        else if ((op == SPV_OP_CONSTANT || op == SPV_OP_VARIABLE) && cnt >= 3)
+            result = w[2];
+        else if (op == SPV_OP_ENTRY_POINT && cnt >= 2 && *p_stage == 0)
+            *p_stage = spv_stage(w[1]); // NOTE: glslcの出力はエントリポイントが一つなので、最初のものだけを見る。
+        else if (op == SPV_OP_DECORATE && cnt >= 3 && w[1] < spv->bound) {
+            SpirvId *id = &spv->ids[w[1]];
+            const uint32_t value = cnt >= 4 ? w[3] : 0;
+            switch (w[2]) {
+                case SPV_DECORATION_BLOCK: id->block = 1; break;
+                case SPV_DECORATION_BUFFER_BLOCK: id->buffer_block = 1; break;
+                case SPV_DECORATION_ARRAY_STRIDE: id->array_stride = value; break;
+                case SPV_DECORATION_BUILT_IN: id->built_in = 1; break;
+                case SPV_DECORATION_LOCATION: id->location = value; break;
+                case SPV_DECORATION_BINDING: id->binding = value; break;
+                case SPV_DECORATION_DESCRIPTOR_SET: id->set = value; break;
+                default: break;
+            }
+        }
+        if (result != SPV_NONE) {
+            CHECK_RETURN(result < spv->bound);
+            spv->ids[result].offset = i;
+        }
+        i += cnt;
+    }
+    CHECK_RETURN(*p_stage != 0);
+    return VK_SUCCESS;
+}
+
+// 二つ目のパスで、変数からディスクリプタ・プッシュ定数・頂点入力を取り出す関数。
+static VkResult spv_reflect_variables(const Spirv *spv, ShaderReflection *out) {
+    uint32_t push_begin = UINT32_MAX;
+    uint32_t push_end = 0;
+    for (uint32_t i = SPV_HEADER_LEN; i < spv->len; i += spv->code[i] >> 16) {
+        if (spv_op(spv, i) != SPV_OP_VARIABLE)
+            continue;
+        const uint32_t *w = &spv->code[i];
+        const uint32_t id = w[2];
+        const uint32_t storage = w[3];
+        const uint32_t *ptr = spv_def(spv, w[1]);
+        CHECK_RETURN(ptr != NULL && (ptr[0] & 0xFFFF) == SPV_OP_TYPE_POINTER);
+        const uint32_t type = ptr[3];
+
+        if (storage == SPV_STORAGE_PUSH_CONSTANT) {
+            // NOTE: 範囲は、最も前のメンバの始まりから構造体の終わりまでとする。
+            const uint32_t *def = spv_def(spv, type);
+            CHECK_RETURN(def != NULL && (def[0] & 0xFFFF) == SPV_OP_TYPE_STRUCT);
+            const uint32_t member_cnt = (def[0] >> 16) - 2;
+            for (uint32_t m = 0; m < member_cnt; ++m) {
+                const uint32_t offset = spv_member_decoration(spv, type, m, SPV_DECORATION_OFFSET, 0);
+                if (offset < push_begin)
+                    push_begin = offset;
+            }
+            const uint32_t end = spv_type_size(spv, type, 0);
+            if (end > push_end)
+                push_end = end;
+            continue;
+        }
+
+        if (storage == SPV_STORAGE_INPUT) {
+            // NOTE: 頂点シェーダの入力だけが頂点属性になる。gl_VertexIndexなどの組み込み変数は除く。
+            if (out->stage != VK_SHADER_STAGE_VERTEX_BIT || spv->ids[id].built_in || spv->ids[id].location == SPV_NONE)
+                continue;
+            CHECK_RETURN(out->input_cnt < SHADER_INPUT_MAX_CNT);
+            ShaderInput *input = &out->inputs[out->input_cnt];
+            input->location = spv->ids[id].location;
+            input->format = spv_input_format(spv, type, &input->size);
+            out->input_cnt += 1;
+            continue;
+        }
+
+        VkDescriptorType desc_type;
+        uint32_t desc_cnt;
+        if (!spv_descriptor(spv, storage, type, &desc_type, &desc_cnt))
+            continue;
+        CHECK_RETURN(out->binding_cnt < SHADER_BINDING_MAX_CNT);
+        ShaderBinding *binding = &out->bindings[out->binding_cnt];
+        binding->set = spv->ids[id].set == SPV_NONE ? 0 : spv->ids[id].set;
+        binding->binding = spv->ids[id].binding == SPV_NONE ? 0 : spv->ids[id].binding;
+        binding->type = desc_type;
+        binding->cnt = desc_cnt;
+        binding->stages = out->stage;
+        out->binding_cnt += 1;
+    }
+    if (push_end > 0) {
+        out->push_constant.stageFlags = out->stage;
+        out->push_constant.offset = push_begin;
+        out->push_constant.size = push_end - push_begin;
+    }
+    return VK_SUCCESS;
+}
+
+// バインディングを(セット, バインディング)の順に、頂点入力をロケーションの順に並べる関数。
+// NOTE: 数は高々十数なので、挿入ソートで足りる。
+static void sort_reflection(ShaderReflection *refl) {
+    for (uint32_t i = 1; i < refl->binding_cnt; ++i) {
+        const ShaderBinding b = refl->bindings[i];
+        uint32_t k = i;
+        while (k > 0 && (refl->bindings[k - 1].set > b.set || (refl->bindings[k - 1].set == b.set && refl->bindings[k - 1].binding > b.binding))) {
+            refl->bindings[k] = refl->bindings[k - 1];
+            k -= 1;
+        }
+        refl->bindings[k] = b;
+    }
+    for (uint32_t i = 1; i < refl->input_cnt; ++i) {
+        const ShaderInput input = refl->inputs[i];
+        uint32_t k = i;
+        while (k > 0 && refl->inputs[k - 1].location > input.location) {
+            refl->inputs[k] = refl->inputs[k - 1];
+            k -= 1;
+        }
+        refl->inputs[k] = input;
+    }
+}
+
+VkResult reflect_shader(const uint32_t *code, size_t size, ShaderReflection *out) {
+    memset(out, 0, sizeof(ShaderReflection));
+    CHECK_RETURN(code != NULL && size % 4 == 0 && size / 4 > SPV_HEADER_LEN);
+    CHECK_RETURN(code[0] == SPV_MAGIC);
+    Spirv spv = { code, (uint32_t)(size / 4), NULL, code[3] };
+    spv.ids = (SpirvId *)malloc(sizeof(SpirvId) * spv.bound);
+    CHECK_RETURN(spv.ids != NULL);
+    for (uint32_t i = 0; i < spv.bound; ++i) {
+        const SpirvId id = { 0, SPV_NONE, SPV_NONE, SPV_NONE, 0, 0, 0, 0 };
+        spv.ids[i] = id;
+    }
+    VkResult res = spv_collect(&spv, &out->stage);
+    if (res == VK_SUCCESS)
+        res = spv_reflect_variables(&spv, out);
+    free(spv.ids);
+    if (res != VK_SUCCESS)
+        return res;
+    sort_reflection(out);
+    out->hash = hash_bytes(code, size, 0);
+    return VK_SUCCESS;
+}
+
+static const ShaderBinding *find_binding(const ShaderReflection *refl, uint32_t set, uint32_t binding) {
+    for (uint32_t i = 0; i < refl->binding_cnt; ++i) {
+        if (refl->bindings[i].set == set && refl->bindings[i].binding == binding)
+            return &refl->bindings[i];
+    }
+    return NULL;
+}
+
+VkResult merge_shader_reflections(uint32_t cnt, const ShaderReflection *refls, ShaderReflection *out) {
+    memset(out, 0, sizeof(ShaderReflection));
+    uint32_t push_end = 0;
+    for (uint32_t i = 0; i < cnt; ++i) {
+        const ShaderReflection *refl = &refls[i];
+        out->stage |= refl->stage;
+        // NOTE: 同じバインディングはステージをまとめて一つにする。種類か数が食い違えば、一つのレイアウトにできない。
+        for (uint32_t k = 0; k < refl->binding_cnt; ++k) {
+            const ShaderBinding *src = &refl->bindings[k];
+            ShaderBinding *dst = (ShaderBinding *)find_binding(out, src->set, src->binding);
+            if (dst != NULL) {
+                CHECK_RETURN(dst->type == src->type && dst->cnt == src->cnt);
+                dst->stages |= src->stages;
+                continue;
+            }
+            CHECK_RETURN(out->binding_cnt < SHADER_BINDING_MAX_CNT);
+            out->bindings[out->binding_cnt] = *src;
+            out->binding_cnt += 1;
+        }
+        // NOTE: プッシュ定数は、すべてのステージを覆う一つの範囲にまとめる。
+        if (refl->push_constant.size > 0) {
+            const uint32_t end = refl->push_constant.offset + refl->push_constant.size;
+            if (out->push_constant.size == 0 || refl->push_constant.offset < out->push_constant.offset)
+                out->push_constant.offset = refl->push_constant.offset;
+            if (end > push_end)
+                push_end = end;
+            out->push_constant.stageFlags |= refl->push_constant.stageFlags;
+            out->push_constant.size = push_end - out->push_constant.offset;
+        }
+        if (refl->stage == VK_SHADER_STAGE_VERTEX_BIT) {
+            out->input_cnt = refl->input_cnt;
+            memcpy(out->inputs, refl->inputs, sizeof(ShaderInput) * refl->input_cnt);
+        }
+    }
+    sort_reflection(out);
+    out->hash = hash_bytes(out->bindings, sizeof(ShaderBinding) * out->binding_cnt, out->stage);
+    return VK_SUCCESS;
+}
+
+VkBool32 check_shader_reflection(const ShaderReflection *shader, const ShaderReflection *layout) {
+    if ((layout->stage & shader->stage) != shader->stage)
+        return VK_FALSE;
+    for (uint32_t i = 0; i < shader->binding_cnt; ++i) {
+        const ShaderBinding *src = &shader->bindings[i];
+        const ShaderBinding *dst = find_binding(layout, src->set, src->binding);
+        if (dst == NULL || dst->type != src->type || dst->cnt != src->cnt || (dst->stages & src->stages) != src->stages)
+            return VK_FALSE;
+    }
+    if (shader->push_constant.size > 0) {
+        const VkPushConstantRange *range = &layout->push_constant;
+        if ((range->stageFlags & shader->stage) == 0
+            || shader->push_constant.offset < range->offset
+            || shader->push_constant.offset + shader->push_constant.size > range->offset + range->size) {
+            return VK_FALSE;
+        }
+    }
+    if (shader->stage == VK_SHADER_STAGE_VERTEX_BIT) {
+        if (shader->input_cnt != layout->input_cnt)
+            return VK_FALSE;
+        if (memcmp(shader->inputs, layout->inputs, sizeof(ShaderInput) * shader->input_cnt) != 0)
+            return VK_FALSE;
+    }
+    return VK_TRUE;
+}
+
+VkResult get_reflected_set_layout(
+    const VkDevice device,
+    DescriptorLayoutCache *cache,
+    const ShaderReflection *refl,
+    uint32_t set,
+    VkDescriptorSetLayout *out
+) {
+    VkDescriptorSetLayoutBinding binds[SHADER_BINDING_MAX_CNT];
+    uint32_t cnt = 0;
+    for (uint32_t i = 0; i < refl->binding_cnt; ++i) {
+        const ShaderBinding *b = &refl->bindings[i];
+        if (b->set != set)
+            continue;
+        // NOTE: 実行時に大きさの決まる配列は、バインディングのフラグ(pNext)が要るので、キャッシュでは作れない。
+        CHECK_RETURN(b->cnt > 0);
+        const VkDescriptorSetLayoutBinding bind = { b->binding, b->type, b->cnt, b->stages, NULL };
+        binds[cnt] = bind;
+        cnt += 1;
+    }
+    const VkDescriptorSetLayoutCreateInfo ci = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        NULL,
+        0,
+        cnt,
+        binds,
+    };
+    return get_descriptor_set_layout(device, cache, &ci, out);
+}
+
+VkResult fill_reflected_vertex_input(const ShaderReflection *refl, PipelineDesc *desc) {
+    CHECK_RETURN(refl->input_cnt <= PIPELINE_ATTR_MAX_CNT);
+    // NOTE: 属性はロケーションの順に、詰め物なしで一つのバッファに並んでいるものとする。
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < refl->input_cnt; ++i) {
+        const ShaderInput *input = &refl->inputs[i];
+        CHECK_RETURN(input->format != VK_FORMAT_UNDEFINED);
+        desc->attrs[i] = (VkVertexInputAttributeDescription){ input->location, 0, input->format, offset };
+        offset += input->size;
+    }
+    desc->attr_cnt = refl->input_cnt;
+    desc->vertex_stride = offset;
+    return VK_SUCCESS;
+}
+
+VkResult create_shader_reflection_cache(ShaderReflectionCache *out) {
+    memset(out, 0, sizeof(ShaderReflectionCache));
+    return VK_SUCCESS;
+}
+
+VkResult get_shader_reflection(ShaderReflectionCache *cache, const uint32_t *code, size_t size, ShaderReflection *out) {
+    CHECK_RETURN(code != NULL);
+    const uint64_t hash = hash_bytes(code, size, 0);
+    // NOTE: シェーダの数は多くないので、ハッシュを先頭から比べれば足りる。ハッシュが衝突しても大きさまで同じことはまずない。
+    for (uint32_t i = 0; i < cache->cnt; ++i) {
+        const ShaderReflectionEntry *entry = &cache->entries[i];
+        if (entry->reflection.hash == hash && entry->size == size) {
+            *out = entry->reflection;
+            return VK_SUCCESS;
+        }
+    }
+    if (cache->cnt == cache->capacity) {
+        const uint32_t capacity = cache->capacity == 0 ? 8 : cache->capacity * 2;
+        ShaderReflectionEntry *entries = (ShaderReflectionEntry *)realloc(cache->entries, sizeof(ShaderReflectionEntry) * capacity);
+        CHECK_RETURN(entries != NULL);
+        cache->entries = entries;
+        cache->capacity = capacity;
+    }
+    ShaderReflectionEntry *entry = &cache->entries[cache->cnt];
+    CHECK_RETURN_VK(reflect_shader(code, size, &entry->reflection));
+    entry->size = size;
+    cache->cnt += 1;
+    *out = entry->reflection;
+    return VK_SUCCESS;
+}
+
+void destroy_shader_reflection_cache(ShaderReflectionCache *cache) {
+    free(cache->entries);
+    memset(cache, 0, sizeof(ShaderReflectionCache));
+}
@@ -0,0 +1,82 @@
+#include "vulkan-tutorial.h"
+
+VkResult create_timeline(const VkDevice device, Timeline *out) {
+    // NOTE: セマフォの種類をタイムラインに指定する。初期値は0。
+    const VkSemaphoreTypeCreateInfo type_ci = {
+        VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        NULL,
+        VK_SEMAPHORE_TYPE_TIMELINE,
+        0,
+    };
+    const VkSemaphoreCreateInfo ci = {
+        VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        &type_ci,
+        0,
+    };
+    CHECK_RETURN_VK(vkCreateSemaphore(device, &ci, NULL, &out->semaphore));
+    out->value = 0;
+    return VK_SUCCESS;
+}
+
+VkResult submit_timeline(
+    const VkQueue queue,
+    Timeline *timeline,
+    uint32_t command_buffer_cnt,
+    const VkCommandBuffer *command_buffers,
+    const VkSemaphore wait_semaphore,
+    VkPipelineStageFlags wait_stage,
+    const VkSemaphore signal_semaphore,
+    uint64_t *p_value
+) {
+    // NOTE: 提出のたびに値を一つ進める。
+    const uint64_t value = timeline->value + 1;
+
+    // NOTE: バイナリセマフォの値は無視されるが、個数は揃えなければならない。
+    const VkSemaphore signal_semaphores[] = { timeline->semaphore, signal_semaphore };
+    const uint64_t signal_values[] = { value, 0 };
+    const uint32_t signal_cnt = signal_semaphore != VK_NULL_HANDLE ? 2 : 1;
+    const uint64_t wait_values[] = { 0 };
+    const uint32_t wait_cnt = wait_semaphore != VK_NULL_HANDLE ? 1 : 0;
+
+    const VkTimelineSemaphoreSubmitInfo timeline_si = {
+        VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        NULL,
+        wait_cnt,
+        wait_values,
+        signal_cnt,
+        signal_values,
+    };
+    const VkSubmitInfo si = {
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        &timeline_si,
+        wait_cnt,
+        &wait_semaphore,
+        &wait_stage,
+        command_buffer_cnt,
+        command_buffers,
+        signal_cnt,
+        signal_semaphores,
+    };
+    CHECK_RETURN_VK(vkQueueSubmit(queue, 1, &si, VK_NULL_HANDLE));
+
+    timeline->value = value;
+    if (p_value != NULL)
+        *p_value = value;
+    return VK_SUCCESS;
+}
+
+VkResult wait_timeline(const VkDevice device, const Timeline *timeline, uint64_t value, uint64_t timeout) {
+    const VkSemaphoreWaitInfo wi = {
+        VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        NULL,
+        0,
+        1,
+        &timeline->semaphore,
+        &value,
+    };
+    return vkWaitSemaphores(device, &wi, timeout);
+}
+
+VkResult get_timeline_value(const VkDevice device, const Timeline *timeline, uint64_t *out) {
+    return vkGetSemaphoreCounterValue(device, timeline->semaphore, out);
+}
@@ -0,0 +1,244 @@
+#include "vulkan-tutorial.h"
+
+#include <string.h>
+
+// NOTE: 配列の末尾に一つ追加する。足りなければ倍に拡張する。
+#define PUSH_BARRIER(arr, cnt, cap, type, v) {                              \
+    if ((cnt) == (cap)) {                                                   \
+        const uint32_t new_cap = (cap) > 0 ? (cap) * 2 : 64;                \
+        type *p = (type *)realloc((arr), sizeof(type) * new_cap);           \
+        CHECK_RETURN(p != NULL);                                            \
+        (arr) = p;                                                          \
+        (cap) = new_cap;                                                    \
+    }                                                                       \
+    (arr)[(cnt)] = (v);                                                     \
+    (cnt) += 1;                                                             \
+}
+
+// 新しいバッチを開始する関数。
+// コマンドバッファを確保して記録を開始し、size以上のステージングバッファを用意する。
+static VkResult begin_batch(UploadContext *ctx, VkDeviceSize size) {
+    const VkDeviceSize staging_size = size > ctx->threshold ? size : ctx->threshold;
+    CHECK_RETURN_VK(
+        create_buffer(
+            ctx->device,
+            ctx->mem_prop,
+            staging_size,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            &ctx->staging
+        )
+    );
+    // NOTE: バッチの間はマップしたままにしておく。
+    void *p;
+    CHECK_RETURN_VK(vkMapMemory(ctx->device, ctx->staging.memory, 0, VK_WHOLE_SIZE, 0, &p));
+    ctx->staging_ptr = (uint8_t *)p;
+    ctx->staging_size = staging_size;
+    ctx->staging_used = 0;
+
+    const VkCommandBufferAllocateInfo ai = {
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        NULL,
+        ctx->command_pool,
+        VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        1,
+    };
+    CHECK_RETURN_VK(vkAllocateCommandBuffers(ctx->device, &ai, &ctx->command));
+    const VkCommandBufferBeginInfo bi = {
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        NULL,
+        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        NULL,
+    };
+    CHECK_RETURN_VK(vkBeginCommandBuffer(ctx->command, &bi));
+    return VK_SUCCESS;
+}
+
+VkResult create_upload_context(
+    const VkDevice device,
+    const VkPhysicalDeviceMemoryProperties *mem_prop,
+    const VkQueue queue,
+    const VkCommandPool command_pool,
+    Timeline *timeline,
+    DeletionQueue *deletion_queue,
+    VkDeviceSize threshold,
+    UploadContext *out
+) {
+    memset(out, 0, sizeof(UploadContext));
+    out->device = device;
+    out->mem_prop = mem_prop;
+    out->queue = queue;
+    out->command_pool = command_pool;
+    out->timeline = timeline;
+    out->deletion_queue = deletion_queue;
+    out->threshold = threshold;
+    return VK_SUCCESS;
+}
+
+VkResult reserve_upload(UploadContext *ctx, VkDeviceSize size, VkDeviceSize alignment, void **p_data, VkDeviceSize *p_offset) {
+    // NOTE: 収まらなければ、いま溜まっている分を提出して新しいバッチを始める。
+    if (ctx->command != NULL) {
+        const VkDeviceSize offset = (ctx->staging_used + alignment - 1) / alignment * alignment;
+        if (offset + size > ctx->staging_size)
+            CHECK_RETURN_VK(flush_upload_context(ctx, NULL));
+    }
+    if (ctx->command == NULL)
+        CHECK_RETURN_VK(begin_batch(ctx, size));
+
+    const VkDeviceSize offset = (ctx->staging_used + alignment - 1) / alignment * alignment;
+    ctx->staging_used = offset + size;
+    *p_data = (void *)(ctx->staging_ptr + offset);
+    *p_offset = offset;
+    return VK_SUCCESS;
+}
+
+VkResult upload_buffer(
+    UploadContext *ctx,
+    VkDeviceSize offset,
+    VkDeviceSize size,
+    const VkBuffer dst,
+    VkDeviceSize dst_offset,
+    VkAccessFlags dst_access,
+    VkPipelineStageFlags dst_stage
+) {
+    const VkBufferCopy region = { offset, dst_offset, size };
+    vkCmdCopyBuffer(ctx->command, ctx->staging.buffer, dst, 1, &region);
+    // NOTE: 転送後のバリアはフラッシュ時にまとめて発行する。
+    const VkBufferMemoryBarrier barrier = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        NULL,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        dst_access,
+        VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED,
+        dst,
+        dst_offset,
+        size,
+    };
+    PUSH_BARRIER(ctx->buffer_barriers, ctx->buffer_barrier_cnt, ctx->buffer_barrier_cap, VkBufferMemoryBarrier, barrier);
+    ctx->dst_stages |= dst_stage;
+    return VK_SUCCESS;
+}
+
+VkResult upload_image(
+    UploadContext *ctx,
+    VkDeviceSize offset,
+    const VkImage dst,
+    uint32_t mip_levels,
+    uint32_t region_cnt,
+    const VkBufferImageCopy *regions,
+    VkPipelineStageFlags dst_stage
+) {
+    // NOTE: 作ったばかりのイメージなので、以前の内容を待つ必要はない。
+    VkImageMemoryBarrier barrier = {
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        NULL,
+        0,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED,
+        dst,
+        { VK_IMAGE_ASPECT_COLOR_BIT, 0, mip_levels, 0, 1 },
+    };
+    vkCmdPipelineBarrier(
+        ctx->command,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0,
+        NULL,
+        0,
+        NULL,
+        1,
+        &barrier
+    );
+
+    // NOTE: regionsのbufferOffsetは予約した領域の先頭からの相対値なので、ずらしてから記録する。
+    VkBufferImageCopy local_regions[16];
+    for (uint32_t i = 0; i < region_cnt; i += 16) {
+        const uint32_t cnt = region_cnt - i < 16 ? region_cnt - i : 16;
+        for (uint32_t j = 0; j < cnt; ++j) {
+            local_regions[j] = regions[i + j];
+            local_regions[j].bufferOffset += offset;
+        }
+        vkCmdCopyBufferToImage(ctx->command, ctx->staging.buffer, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, cnt, local_regions);
+    }
+
+    // NOTE: シェーダから読めるレイアウトへの遷移は、フラッシュ時にまとめて発行する。
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    PUSH_BARRIER(ctx->image_barriers, ctx->image_barrier_cnt, ctx->image_barrier_cap, VkImageMemoryBarrier, barrier);
+    ctx->dst_stages |= dst_stage;
+    return VK_SUCCESS;
+}
+
+VkResult upload_to_buffer(
+    UploadContext *ctx,
+    const void *data,
+    VkDeviceSize size,
+    const VkBuffer dst,
+    VkDeviceSize dst_offset,
+    VkAccessFlags dst_access,
+    VkPipelineStageFlags dst_stage
+) {
+    void *p;
+    VkDeviceSize offset;
+    CHECK_RETURN_VK(reserve_upload(ctx, size, 4, &p, &offset));
+    memcpy(p, data, size);
+    return upload_buffer(ctx, offset, size, dst, dst_offset, dst_access, dst_stage);
+}
+
+VkResult flush_upload_context(UploadContext *ctx, uint64_t *p_value) {
+    if (ctx->command == NULL) {
+        if (p_value != NULL)
+            *p_value = ctx->timeline->value;
+        return VK_SUCCESS;
+    }
+
+    // NOTE: 溜めておいた転送後のバリアを一度に発行する。
+    if (ctx->buffer_barrier_cnt > 0 || ctx->image_barrier_cnt > 0) {
+        vkCmdPipelineBarrier(
+            ctx->command,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            ctx->dst_stages,
+            0,
+            0,
+            NULL,
+            ctx->buffer_barrier_cnt,
+            ctx->buffer_barriers,
+            ctx->image_barrier_cnt,
+            ctx->image_barriers
+        );
+    }
+    CHECK_RETURN_VK(vkEndCommandBuffer(ctx->command));
+    vkUnmapMemory(ctx->device, ctx->staging.memory);
+
+    // NOTE: 完了は待たない。コマンドバッファとステージングバッファは遅延解放する。
+    CHECK_RETURN_VK(submit_timeline(ctx->queue, ctx->timeline, 1, &ctx->command, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, p_value));
+    CHECK_RETURN_VK(defer_free_command_buffer(ctx->deletion_queue, ctx->timeline->value, ctx->command_pool, ctx->command));
+    CHECK_RETURN_VK(defer_destroy_buffer(ctx->deletion_queue, ctx->timeline->value, &ctx->staging));
+
+    ctx->command = NULL;
+    ctx->staging_ptr = NULL;
+    ctx->staging_size = 0;
+    ctx->staging_used = 0;
+    ctx->buffer_barrier_cnt = 0;
+    ctx->image_barrier_cnt = 0;
+    ctx->dst_stages = 0;
+    return VK_SUCCESS;
+}
+
+VkResult destroy_upload_context(UploadContext *ctx) {
+    CHECK_RETURN_VK(flush_upload_context(ctx, NULL));
+    free(ctx->buffer_barriers);
+    free(ctx->image_barriers);
+    ctx->buffer_barriers = NULL;
+    ctx->image_barriers = NULL;
+    ctx->buffer_barrier_cap = 0;
+    ctx->image_barrier_cap = 0;
+    return VK_SUCCESS;
+}
@@ -0,0 +1,41 @@
+#include "vulkan-tutorial.h"
+
+#include <math.h>
+
+VkIndexType select_index_type(uint32_t vertex_cnt) {
+    return vertex_cnt <= 0xFFFF ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+uint32_t get_vertex_size(VertexFormat vertex_format) {
+    return vertex_format == VERTEX_FORMAT_FLOAT32 ? sizeof(MeshVertex) : sizeof(PackedVertex);
+}
+
+uint32_t get_index_size(VkIndexType index_type) {
+    return index_type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+void compute_bounding_sphere(const MeshVertex *vtxs, uint32_t vertex_cnt, float out[4]) {
+    float min[3] = { 0.0f, 0.0f, 0.0f };
+    float max[3] = { 0.0f, 0.0f, 0.0f };
+    for (uint32_t i = 0; i < vertex_cnt; ++i) {
+        for (uint32_t j = 0; j < 3; ++j) {
+            const float v = vtxs[i].pos[j];
+            min[j] = i == 0 || v < min[j] ? v : min[j];
+            max[j] = i == 0 || v > max[j] ? v : max[j];
+        }
+    }
+    // NOTE: 中心から最も遠い頂点までの距離を半径とする。AABBの対角線の半分より小さく済む。
+    for (uint32_t j = 0; j < 3; ++j) {
+        out[j] = (min[j] + max[j]) * 0.5f;
+    }
+    float radius2 = 0.0f;
+    for (uint32_t i = 0; i < vertex_cnt; ++i) {
+        float d2 = 0.0f;
+        for (uint32_t j = 0; j < 3; ++j) {
+            const float d = vtxs[i].pos[j] - out[j];
+            d2 += d * d;
+        }
+        radius2 = d2 > radius2 ? d2 : radius2;
+    }
+    out[3] = sqrtf(radius2);
+}
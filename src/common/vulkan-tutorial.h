@@ -23,7 +23,12 @@
 #define SCREEN_CLEAR_RGBA { 0.25f, 0.25f, 0.25f, 1.0f }
 #define DEVICE_EXT_NAMES_CNT 1
 #define DEVICE_EXT_NAMES { "VK_KHR_swapchain" }
-#define MAX_SHADER_BIN_SIZE 8192
+#define EXTENDED_DYNAMIC_STATE_EXT_NAME "VK_EXT_extended_dynamic_state"
+#define DYNAMIC_RENDERING_EXT_NAME "VK_KHR_dynamic_rendering"
+#define UPLOAD_THRESHOLD (64 * 1024 * 1024)
+#define BAKED_MESH_MAGIC 0x48534D42 // NOTE: "BMSH"
+#define BAKED_MESH_VERSION 2
+#define OVERDRAW_THRESHOLD 1.05f
 
 // OS依存の定数マクロ。
 #ifdef _WIN32
@@ -52,6 +57,24 @@
 #    define INST_LAYER_NAMES { }
 #endif
 
+// SPIR-Vを実行ファイルに埋め込むためのマクロ。
+// Tengu712/Vulkan-Tutorial/Makefileを用いる場合は、`make 05 EMBED=1`のようにすると、EMBED_SPIRVが定義された状態でビルドされる。
+// そのときglslcは、SPIR-Vをuint32_tの配列の初期化子として./build/*.incにも書き出す。
+// 埋め込むときはLOAD_SPIRVのarrに渡した配列を、そうでなければpathのファイルを使う。
+#ifdef EMBED_SPIRV
+#    define LOAD_SPIRV(arr, path, p) load_spirv((arr), sizeof(arr), NULL, (p))
+#else
+#    define LOAD_SPIRV(arr, path, p) load_spirv(NULL, 0, (path), (p))
+#endif
+
+// シェーダモジュールを作るためのSPIR-V。
+// NOTE: 埋め込んだものは読み取り専用のメモリを指し、ファイルから読んだものはownedが確保したメモリを持つ。
+typedef struct SpirvCode_t {
+    const uint32_t *code;
+    size_t size; // NOTE: bytes。
+    char *owned;
+} SpirvCode;
+
 // 1バッファに必要なオブジェクトをまとめた構造体。
 // 特に、頂点バッファ、インデックスバッファ、ユニフォームバッファのために。
 typedef struct Buffer_t {
@@ -68,12 +91,495 @@ typedef struct Texture_t {
 } Texture;
 
 // 1モデルに必要なオブジェクトをまとめた構造体。
+// index_typeは、vkCmdBindIndexBufferに渡すインデックスの型。
+// ジオメトリプール上のモデルでは、vertex・indexはプールのバッファを指し、first_vertex・first_indexがプール内の位置となる。
+// 描画はvkCmdDrawIndexedのfirstIndexにfirst_index、vertexOffsetにfirst_vertexを渡す。
+// 自身のバッファを持つモデルでは、first_vertex・first_indexは0となる。
+// 位置をVERTEX_FORMAT_SNORM16で量子化したモデルは、頂点シェーダで pos * pos_scale + pos_offset として元に戻す。
+// それ以外のモデルでは、pos_scaleは1、pos_offsetは0となる。
+// NOTE: create_modelは頂点数を知らないので、vertex_cntを0とする。
 typedef struct Model_t {
     uint32_t index_cnt;
+    VkIndexType index_type;
     Buffer vertex;
     Buffer index;
+    uint32_t vertex_cnt;
+    uint32_t first_vertex;
+    uint32_t first_index;
+    float pos_scale[3];
+    float pos_offset[3];
 } Model;
 
+// メッシュファイルから読み込んだ頂点の構造体。
+// 09-cubeのVertexと同じレイアウト。
+typedef struct MeshVertex_t {
+    float pos[3];
+    float uv[2];
+} MeshVertex;
+
+// GPUのバッファに置く頂点の形式。
+//   - VERTEX_FORMAT_FLOAT32: MeshVertexそのまま(20bytes)
+//   - VERTEX_FORMAT_HALF: 位置をhalf、UVをunorm16としたPackedVertex(12bytes)
+//   - VERTEX_FORMAT_SNORM16: 位置をモデルのAABBで正規化してsnorm16、UVをunorm16としたPackedVertex(12bytes)
+// NOTE: unorm16のUVは[0, 1]しか表せないので、外れるUVを持つモデルは読み込みに失敗する。繰り返しのUVを使うモデルにはVERTEX_FORMAT_FLOAT32を使うこと。
+typedef enum VertexFormat_t {
+    VERTEX_FORMAT_FLOAT32,
+    VERTEX_FORMAT_HALF,
+    VERTEX_FORMAT_SNORM16,
+} VertexFormat;
+
+// 量子化した頂点の構造体。
+// NOTE: 3要素の16bitフォーマットは頂点バッファに対応していないデバイスが多いので、位置は4要素とする。
+typedef struct PackedVertex_t {
+    uint16_t pos[4];
+    uint16_t uv[2];
+} PackedVertex;
+
+// フリーリストの空き範囲。単位は要素(頂点・インデックス)。
+typedef struct FreeRange_t {
+    uint32_t offset;
+    uint32_t size;
+} FreeRange;
+
+// 空き範囲をオフセット順に並べたフリーリスト。
+typedef struct FreeList_t {
+    uint32_t cnt;
+    uint32_t cap;
+    FreeRange *ranges;
+} FreeList;
+
+// 全モデルのジオメトリを置く、一つの頂点バッファと一つのインデックスバッファ。
+// モデルごとの領域はフリーリストから切り出すので、描画ごとにバッファをバインドし直さずに済む。
+// 頂点の形式とインデックスの型は、プール全体で一つ。
+typedef struct GeometryPool_t {
+    VertexFormat vertex_format;
+    VkIndexType index_type;
+    uint32_t vertex_capacity;
+    uint32_t index_capacity;
+    Buffer vertex;
+    Buffer index;
+    FreeList vertex_free;
+    FreeList index_free;
+} GeometryPool;
+
+// 間接描画に関わるデバイスの機能の対応状況。
+typedef struct IndirectFeatures_t {
+    VkBool32 multi_draw_indirect; // NOTE: 一回の間接描画で複数の描画コマンドを読めるか。
+    VkBool32 draw_indirect_first_instance; // NOTE: 描画コマンドのfirstInstanceに0以外を使えるか。
+    VkBool32 draw_indirect_count; // NOTE: 描画コマンドの数をバッファから読めるか。
+} IndirectFeatures;
+
+// 1フレーム分の描画コマンド(VkDrawIndexedIndirectCommand)と、描画ごとのインスタンスデータを溜めるリスト。
+// i番目の描画のfirstInstanceをiとするので、シェーダはgl_InstanceIndexでインスタンスデータを引ける。
+// すべての描画が同じ頂点バッファ・インデックスバッファ(ジオメトリプール)を使うことを前提とする。
+// バッファはホストから見えるメモリに置き、作成時からマップしたままにする。
+// NOTE: GPUが前回の内容を読み終わってから書き込むこと。フレームを重ねて描くなら、フレームごとに作る。
+typedef struct DrawList_t {
+    IndirectFeatures features;
+    uint32_t capacity;
+    uint32_t cnt;
+    uint32_t instance_size;
+    Buffer commands; // NOTE: VkDrawIndexedIndirectCommand * capacity
+    Buffer count; // NOTE: uint32_t 一つ
+    Buffer instances; // NOTE: instance_size * capacity
+    VkDrawIndexedIndirectCommand *mapped_commands;
+    uint32_t *mapped_count;
+    uint8_t *mapped_instances;
+} DrawList;
+
+// GPUカリングの対象となるオブジェクト一つ。レイアウトはカリングのシェーダと揃える。
+typedef struct CullObject_t {
+    float sphere[4]; // NOTE: モデル空間の境界球。xyzが中心、wが半径。
+    uint32_t index_cnt;
+    uint32_t first_index;
+    int32_t vertex_offset;
+    uint32_t reserved;
+} CullObject;
+
+// 前のフレームの深度から作る、深度の階層(Hi-Z)ピラミッド。
+// 各ミップの各テクセルは、一つ上のミップの対応する範囲で最も奥の深度を持つ。ミップ0はデプスバッファの半分の解像度。
+// NOTE: イメージはVK_IMAGE_LAYOUT_GENERALのまま使う。
+typedef struct HiZ_t {
+    Texture texture; // NOTE: VK_FORMAT_R32_SFLOAT。viewは全ミップを含む。
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_cnt;
+    uint32_t depth_cnt;
+    VkImageView *mip_views; // NOTE: 縮小で書き込むための、ミップごとのビュー。
+    VkSampler sampler;
+    VkDescriptorSetLayout descriptor_set_layout;
+    VkDescriptorPool descriptor_pool;
+    VkDescriptorSet *descriptor_sets; // NOTE: デプスバッファごとにdepth_cnt個、続いてミップ1以降にmip_cnt - 1個。
+    VkPipelineLayout pipeline_layout;
+    VkPipeline pipeline;
+    VkBool32 built; // NOTE: 一度でも作ったか。作るまではオクルージョンカリングを行わない。
+} HiZ;
+
+// カリングの結果の統計。レイアウトはカリングのシェーダと揃える。
+typedef struct CullStats_t {
+    uint32_t drawn;
+    uint32_t frustum_culled;
+    uint32_t occlusion_culled;
+    uint32_t reserved;
+} CullStats;
+
+// コンピュートシェーダで視錐台カリングを行い、見えるオブジェクトだけを描画リストに書き込むパス。
+// CPUはオブジェクトとインスタンスデータを書き込むだけで、描画コマンドはGPUが作る。
+// シェーダはインスタンスデータのレイアウトを知っている必要があるので、アプリケーションが用意する。
+// シェーダのバインディング:
+//   - 0: カメラ(CameraData、ユニフォームバッファ)
+//   - 1: オブジェクト(CullObject[])
+//   - 2: インスタンスデータ(入力)
+//   - 3: 描画コマンド(VkDrawIndexedIndirectCommand[]、描画リスト)
+//   - 4: 描画コマンドの数(uint32_t、描画リスト)
+//   - 5: インスタンスデータ(出力、描画リスト)
+//   - 6: 統計(CullStats)
+//   - 7: Hi-Zピラミッド(combined image sampler)
+// プッシュ定数は uint32_t object_cnt, uint32_t compact, uint32_t occlusion 。
+// NOTE: 視錐台を通ったオブジェクトは、occlusionが0でなければ前のフレームのHi-Zピラミッドとも比べる。
+// NOTE: compactが0なら詰めずに、i番目のオブジェクトをi番目の描画とし、見えなければinstanceCountを0とする。
+typedef struct CullPass_t {
+    uint32_t capacity;
+    uint32_t instance_size;
+    uint32_t object_cnt;
+    Buffer objects;
+    Buffer instances;
+    Buffer stats;
+    CullObject *mapped_objects;
+    uint8_t *mapped_instances;
+    CullStats *mapped_stats;
+    VkDescriptorSetLayout descriptor_set_layout;
+    VkDescriptorPool descriptor_pool;
+    VkDescriptorSet descriptor_set;
+    VkPipelineLayout pipeline_layout;
+    VkPipeline pipeline;
+} CullPass;
+
+// テクスチャをディスクリプタの配列に登録し、シェーダから番号で参照できるようにするテーブル(bindless)。
+// セットは一つだけで、一度バインドすれば描画ごとにセットを切り替える必要がない。
+// シェーダのバインディング:
+//   - 0: テクスチャ(sampled image、capacity個の配列)
+//   - 1: サンプラ(immutable sampler、すべてのテクスチャで共有)
+// NOTE: 使っていない枠はシェーダから読んではならない。
+typedef struct BindlessTable_t {
+    uint32_t capacity;
+    uint32_t cnt; // NOTE: 一度でも使った枠の数。
+    uint32_t free_cnt;
+    uint32_t *free_slots; // NOTE: 登録を解除された枠。次の登録で再び使う。
+    VkDescriptorSetLayout descriptor_set_layout;
+    VkDescriptorPool descriptor_pool;
+    VkDescriptorSet descriptor_set;
+} BindlessTable;
+
+#define DESCRIPTOR_RATIO_MAX_CNT 8
+
+// ディスクリプタプールを作るときの、セット一つあたりのディスクリプタ数の見積もり。
+typedef struct DescriptorPoolRatio_t {
+    VkDescriptorType type;
+    float ratio;
+} DescriptorPoolRatio;
+
+// プールを継ぎ足しながらディスクリプタセットを割り当てるアロケータ。
+// セットは個別に解放せず、reset_descriptor_allocatorでプールごとまとめて空にする。
+// フレームごとに一つ作り、そのフレームの完了をタイムラインで待ってからリセットすれば、描画ごとに変わるセットを毎フレーム作り直せる。
+// NOTE: リセットしたプールは捨てずに取っておき、次に足りなくなったときに使い回す。
+typedef struct DescriptorAllocator_t {
+    uint32_t sets_per_pool; // NOTE: 次に作るプールのセット数。プールを作るたびに大きくなる。
+    uint32_t ratio_cnt;
+    DescriptorPoolRatio ratios[DESCRIPTOR_RATIO_MAX_CNT];
+    uint32_t pool_cnt;
+    uint32_t pool_capacity;
+    VkDescriptorPool *pools; // NOTE: 使用中のプール。末尾から割り当てる。
+    uint32_t free_cnt;
+    uint32_t free_capacity;
+    VkDescriptorPool *free_pools; // NOTE: リセット済みで、使っていないプール。
+    uint32_t allocated_cnt; // NOTE: 前のリセットから割り当てたセットの数。
+} DescriptorAllocator;
+
+// ディスクリプタセットレイアウトのキャッシュの一項目。
+typedef struct DescriptorLayoutEntry_t {
+    uint64_t hash;
+    uint32_t key_len;
+    uint64_t *key; // NOTE: バインディング番号の順に並べた、作成情報を詰めた値。
+    VkDescriptorSetLayout layout;
+} DescriptorLayoutEntry;
+
+// 作成情報のハッシュで引く、ディスクリプタセットレイアウトのキャッシュ。
+// 同じ内容のレイアウトは一度だけ作り、同じハンドルを返す。
+typedef struct DescriptorLayoutCache_t {
+    uint32_t cnt;
+    uint32_t capacity;
+    DescriptorLayoutEntry *entries;
+} DescriptorLayoutCache;
+
+// サンプラのキャッシュのキー。VkSamplerCreateInfoからsTypeとpNextを除き、デバイスで使える値に直したもの。
+// NOTE: すべて4bytesのメンバなので詰め物がなく、そのままハッシュを取って比べられる。
+typedef struct SamplerKey_t {
+    VkSamplerCreateFlags flags;
+    VkFilter mag_filter;
+    VkFilter min_filter;
+    VkSamplerMipmapMode mipmap_mode;
+    VkSamplerAddressMode address_mode_u;
+    VkSamplerAddressMode address_mode_v;
+    VkSamplerAddressMode address_mode_w;
+    float mip_lod_bias;
+    VkBool32 anisotropy_enable;
+    float max_anisotropy; // NOTE: anisotropy_enableが無効なら0。
+    VkBool32 compare_enable;
+    VkCompareOp compare_op;
+    float min_lod;
+    float max_lod;
+    VkBorderColor border_color;
+    VkBool32 unnormalized_coordinates;
+} SamplerKey;
+
+// サンプラのキャッシュの一項目。
+typedef struct SamplerEntry_t {
+    uint64_t hash;
+    SamplerKey key;
+    VkSampler sampler;
+} SamplerEntry;
+
+// 作成情報のハッシュで引く、サンプラのキャッシュ。
+// 同じ設定のサンプラは一度だけ作り、同じハンドルを返す。マテリアルが増えてもサンプラの数は設定の種類の数で済む。
+typedef struct SamplerCache_t {
+    VkBool32 anisotropy; // NOTE: 異方性フィルタリングを使えるか。
+    float max_anisotropy; // NOTE: デバイスの上限(maxSamplerAnisotropy)。
+    uint32_t max_cnt; // NOTE: デバイスの上限(maxSamplerAllocationCount)。
+    uint32_t cnt;
+    uint32_t capacity;
+    SamplerEntry *entries;
+} SamplerCache;
+
+#define PIPELINE_ATTR_MAX_CNT 4
+
+// パイプラインの組み合わせを減らす、動的な状態に関わるデバイスの機能の対応状況。
+typedef struct DynamicStateFeatures_t {
+    VkBool32 extended_dynamic_state; // NOTE: VK_EXT_extended_dynamic_state。カリングとデプスの設定を描画時に与えられるか。
+    VkBool32 dynamic_rendering; // NOTE: VK_KHR_dynamic_rendering。レンダーパスとフレームバッファなしで描けるか。
+} DynamicStateFeatures;
+
+// グラフィックスパイプラインの簡潔な記述。パイプラインのキャッシュのキーとなる。
+// 頂点バッファは一つ(バインディング0)、カラーアタッチメントは一つとする。
+// ビューポートとシザーは常に動的なので、記述に含まない。
+// render_passがVK_NULL_HANDLEなら、dynamic renderingで描くパイプラインとし、color_formatとdepth_formatを使う。
+// NOTE: 記述をそのままハッシュに使うので、init_pipeline_descで詰め物まで初期化してから書き換える。
+typedef struct PipelineDesc_t {
+    VkShaderModule vert_shader;
+    VkShaderModule frag_shader;
+    VkPipelineLayout layout;
+    VkRenderPass render_pass;
+    uint32_t subpass;
+    uint32_t vertex_stride;
+    uint32_t attr_cnt;
+    VkVertexInputAttributeDescription attrs[PIPELINE_ATTR_MAX_CNT];
+    VkPrimitiveTopology topology;
+    VkPolygonMode polygon_mode;
+    VkCullModeFlags cull_mode;
+    VkFrontFace front_face;
+    VkBool32 depth_test;
+    VkBool32 depth_write;
+    VkCompareOp depth_compare_op;
+    VkBool32 blend; // NOTE: 有効ならアルファによる半透明の合成。
+    VkSampleCountFlagBits samples;
+    VkFormat color_format; // NOTE: dynamic renderingのときだけ使う。
+    VkFormat depth_format; // NOTE: dynamic renderingのときだけ使う。
+} PipelineDesc;
+
+// 記述のハッシュで引く、グラフィックスパイプラインのキャッシュ。
+// ないパイプラインはコンパイルスレッドで作るので、新しいマテリアルが現れてもフレームを止めずに済む。
+// すべてのパイプラインは一つのVkPipelineCacheを共有する。
+// extended dynamic stateが有効なら、カリングとデプスの設定だけが違う記述は一つのパイプラインを共有する。
+// NOTE: pthread.hをこのヘッダに持ち込まないよう、中身は隠しておく。
+typedef struct PipelineCache_t {
+    uint32_t thread_cnt; // NOTE: コンパイルスレッドの数。
+    VkPipelineCache cache;
+    void *state;
+} PipelineCache;
+
+// シェーダのソースを監視し、書き換えられたら裏でコンパイルし直す構造体。開発中のホットリロードのために。
+// 監視スレッドがinotifyでソースのあるディレクトリを見張り、保存されたらglslcでSPIR-Vを書き出す。
+// 呼び出し側はフレームの区切りでtake_shader_reloadを呼び、コンパイルできたものだけを読み直す。
+// NOTE: Linuxでしか使えない。pthread.hをこのヘッダに持ち込まないよう、中身は隠しておく。
+typedef struct ShaderWatcher_t {
+    uint32_t cnt;
+    void *state;
+} ShaderWatcher;
+
+#define SHADER_BINDING_MAX_CNT 16
+#define SHADER_INPUT_MAX_CNT 16
+
+// シェーダが使うディスクリプタ一つ分。
+// NOTE: cntが0なら、実行時に大きさの決まる配列(bindlessのテーブルなど)。
+typedef struct ShaderBinding_t {
+    uint32_t set;
+    uint32_t binding;
+    VkDescriptorType type;
+    uint32_t cnt;
+    VkShaderStageFlags stages;
+} ShaderBinding;
+
+// 頂点シェーダの入力一つ分。
+// NOTE: 32bitのスカラーとベクトルだけを扱う。それ以外の型はformatがVK_FORMAT_UNDEFINEDになる。
+typedef struct ShaderInput_t {
+    uint32_t location;
+    VkFormat format;
+    uint32_t size;
+} ShaderInput;
+
+// SPIR-Vから読み取った、シェーダの外とのつながり。
+// バインディングは(セット, バインディング)の順に、入力はロケーションの順に並ぶ。
+// 複数のステージをまとめたものは、パイプラインレイアウト全体を表す。
+// NOTE: push_constant.sizeが0なら、プッシュ定数を使わない。
+typedef struct ShaderReflection_t {
+    uint64_t hash; // NOTE: 元のSPIR-Vのハッシュ。まとめたものでは、バインディングのハッシュ。
+    VkShaderStageFlags stage;
+    uint32_t binding_cnt;
+    ShaderBinding bindings[SHADER_BINDING_MAX_CNT];
+    VkPushConstantRange push_constant;
+    uint32_t input_cnt;
+    ShaderInput inputs[SHADER_INPUT_MAX_CNT];
+} ShaderReflection;
+
+typedef struct ShaderReflectionEntry_t {
+    size_t size;
+    ShaderReflection reflection;
+} ShaderReflectionEntry;
+
+// シェーダモジュールのハッシュで引く、読み取り結果のキャッシュ。
+// 同じSPIR-Vを何度読み込んでも、解析するのは一度だけ。
+typedef struct ShaderReflectionCache_t {
+    uint32_t cnt;
+    uint32_t capacity;
+    ShaderReflectionEntry *entries;
+} ShaderReflectionCache;
+
+#define RENDER_GRAPH_RESOURCE_MAX_CNT 16
+#define RENDER_GRAPH_PASS_MAX_CNT 8
+#define RENDER_GRAPH_ACCESS_MAX_CNT 8
+#define RENDER_GRAPH_NONE 0xFFFFFFFF
+
+// パスが資源一つをどう使うか。
+// NOTE: accessに書き込みのビットがあれば書き込みとみなす。バッファではlayoutをVK_IMAGE_LAYOUT_UNDEFINEDとする。
+typedef struct RenderGraphAccess_t {
+    uint32_t resource;
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    VkImageLayout layout;
+} RenderGraphAccess;
+
+// レンダーグラフが扱う、イメージかバッファ一つ。
+// 外から渡すもの(スワップチェインのイメージなど)と、グラフが作る一時的なイメージとがある。
+// 一時的なイメージは使うパスの範囲が重ならなければ、同じメモリを共有する。
+// NOTE: write_*は最後の書き込み(またはレイアウトの遷移)、read_*はその後に同期を済ませた読み込み。
+typedef struct RenderGraphResource_t {
+    VkBool32 is_image;
+    VkBool32 transient;
+    VkImage image;
+    VkImageView view; // NOTE: 一時的なイメージだけ。
+    VkBuffer buffer;
+    VkImageAspectFlags aspect;
+    uint32_t mip_cnt;
+    VkFormat format;
+    uint32_t width;
+    uint32_t height;
+    VkSampleCountFlagBits samples;
+    VkImageUsageFlags usage;
+    uint32_t first_pass; // NOTE: 使う最初のパス。どのパスも使わなければRENDER_GRAPH_NONE。
+    uint32_t last_pass;
+    uint32_t alias; // NOTE: 同じメモリを直前に使っていた一時的なイメージ。なければRENDER_GRAPH_NONE。
+    VkBool32 output; // NOTE: グラフの外で使う結果か。これに書き込まないパスは省く。
+    RenderGraphAccess final; // NOTE: 実行の終わりに移す状態。stagesが0なら移さない。
+    VkImageLayout layout;
+    VkPipelineStageFlags write_stages;
+    VkAccessFlags write_access;
+    VkPipelineStageFlags read_stages;
+    VkAccessFlags read_access;
+} RenderGraphResource;
+
+// レンダーグラフのパス一つ。記録はグラフではなく呼び出し側が行う。
+typedef struct RenderGraphPass_t {
+    uint32_t access_cnt;
+    RenderGraphAccess accesses[RENDER_GRAPH_ACCESS_MAX_CNT];
+    VkBool32 culled;
+} RenderGraphPass;
+
+// パスが使う資源を宣言すると、パスの間のバリアとレイアウトの遷移を求め、結果に届かないパスを省き、一時的なイメージのメモリを共有させる構造体。
+// パスと資源は一度だけ宣言してcompile_render_graphで固め、フレームごとに宣言した順にパスを記録する。
+// NOTE: 資源の状態は実行をまたいで持ち越すので、毎フレーム使い続けるもの(Hi-Zピラミッドなど)は前のフレームの書き込みも待つ。
+typedef struct RenderGraph_t {
+    uint32_t resource_cnt;
+    RenderGraphResource resources[RENDER_GRAPH_RESOURCE_MAX_CNT];
+    uint32_t pass_cnt;
+    RenderGraphPass passes[RENDER_GRAPH_PASS_MAX_CNT];
+    uint32_t memory_cnt;
+    VkDeviceMemory memories[RENDER_GRAPH_RESOURCE_MAX_CNT];
+    uint32_t next_pass; // NOTE: 実行中に、次に記録してよいパス。
+    VkBool32 compiled;
+} RenderGraph;
+
+// 一つのメッシュファイルから読み込んだモデルをまとめた構造体。
+// glTFのプリミティブやOBJのオブジェクト・グループ一つにつき、モデル一つとなる。
+// poolがNULLでなければ、モデルはそのジオメトリプール上にある。
+typedef struct Mesh_t {
+    GeometryPool *pool;
+    VertexFormat vertex_format;
+    uint32_t model_cnt;
+    Model *models;
+} Mesh;
+
+// メッシュファイルの読み込み先を抽象化した構造体。
+// 読み込み側はモデルごとにbegin_modelで書き込み先を受け取り、頂点とインデックスを書き込んでからend_modelを呼ぶ。
+// create_mesh_from_fileではステージングバッファ、ベイカーではCPUのメモリが書き込み先になる。
+// インデックスは読み込み側が持つ大きさ(index_size: 2または4bytes)のまま書き込み、変換は書き込み先に任せる。
+typedef struct MeshWriter_t {
+    void *user;
+    VkResult (*begin_model)(void *user, uint32_t vertex_cnt, uint32_t index_cnt, uint32_t index_size, MeshVertex **p_vtxs, void **p_idxs);
+    VkResult (*end_model)(void *user);
+} MeshWriter;
+
+// ベイク済みメッシュ(.bmesh)のヘッダ。
+// ファイルは ヘッダ | BakedModel * model_cnt | (16bytes境界) | ペイロード の順に並ぶ。
+// ペイロードにはモデルごとの頂点(MeshVertex)とインデックスが、GPUのバッファと同じ配置で16bytes境界に並ぶ。
+// インデックスは、頂点数が許せばuint16_t、そうでなければuint32_tとなる。
+// NOTE: リトルエンディアンを前提とする。
+typedef struct BakedMeshHeader_t {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertex_size;
+    uint32_t model_size; // NOTE: sizeof(BakedModel)
+    uint32_t model_cnt;
+    uint32_t reserved;
+    uint64_t payload_offset; // NOTE: ファイル先頭から
+    uint64_t payload_size;
+    uint64_t hash; // NOTE: ペイロードのhash_bytes(seed = 0)
+} BakedMeshHeader;
+
+// ベイク済みメッシュの、モデル一つ分の情報。オフセットはペイロード先頭から。
+typedef struct BakedModel_t {
+    uint32_t vertex_cnt;
+    uint32_t index_cnt;
+    uint32_t index_size; // NOTE: 2または4
+    uint32_t reserved;
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+} BakedModel;
+
+// 頂点キャッシュの効率の統計。
+//   - acmr: 三角形あたりの頂点シェーダ実行回数(0.5に近いほど良い)
+//   - atvr: 頂点あたりの頂点シェーダ実行回数(1.0に近いほど良い)
+typedef struct VertexCacheStats_t {
+    float acmr;
+    float atvr;
+} VertexCacheStats;
+
+// メモリマップしたファイルの構造体。
+typedef struct MappedFile_t {
+    const uint8_t *data;
+    size_t size;
+    void *handle; // NOTE: Windowsではファイルマッピングオブジェクトのハンドル。
+} MappedFile;
+
 // ユニフォームバッファデータのための構造体。
 // 名前がCameraDataであるのは、当プロジェクトではカメラとしての役割しか持たないため。
 typedef struct CameraData_t {
@@ -81,6 +587,149 @@ typedef struct CameraData_t {
     float proj[16];
 } CameraData;
 
+// ジョブシステムで実行する関数。[begin, end)の要素を処理する。
+// NOTE: 複数のスレッドから同時に呼ばれるので、範囲の外を書き換えないこと。
+typedef void (*JobFunc)(void *user, uint32_t begin, uint32_t end);
+
+// 仕事を範囲に分けてワーカースレッドで並列に実行するための構造体。
+// NOTE: pthread.hをこのヘッダに持ち込まないよう、中身は隠しておく。
+typedef struct JobSystem_t {
+    uint32_t thread_cnt; // NOTE: 呼び出し側を除いたワーカースレッドの数。
+    void *state;
+} JobSystem;
+
+// シーングラフで親を持たないノードの親の番号。
+#define SCENE_NO_PARENT 0xFFFFFFFF
+
+// 平坦なシーングラフ。ノードは番号で表し、各属性を属性ごとの配列(SoA)で持つ。
+// 親は必ず子より前に追加するので、配列の順がそのままトポロジカル順になる。
+// ローカルの変換を変えたノードとその子孫だけ、次のupdate_scene_graphでワールド行列を計算し直す。
+// NOTE: worlds[i]は列優先の4x4行列で、そのままインスタンスデータとしてGPUへ渡せる。
+typedef struct SceneGraph_t {
+    uint32_t cnt;
+    uint32_t capacity;
+    uint32_t *parents; // NOTE: 親がなければSCENE_NO_PARENT。
+    uint32_t *depths; // NOTE: 根を0とする深さ。
+    float (*scales)[3];
+    float (*rotations)[3]; // NOTE: x・y・z軸の回転角(rad)。この順に回す。
+    float (*translations)[3];
+    float (*worlds)[16];
+    uint8_t *dirty; // NOTE: ローカルの変換が変わったか。
+    // NOTE: 以下は並列に更新するための、深さごとに並べたノードの番号。ノードを追加したら作り直す。
+    uint32_t *order;
+    uint32_t *level_starts; // NOTE: 深さlのノードはorder[level_starts[l]]からorder[level_starts[l + 1] - 1]まで。
+    uint32_t level_cnt;
+    VkBool32 sorted;
+} SceneGraph;
+
+// CPUカリングのための、ワールド空間の境界球の配列。
+// NOTE: SIMDで8個ずつ読めるよう、成分ごとの配列(SoA)で持つ。
+typedef struct CullBounds_t {
+    float *x;
+    float *y;
+    float *z;
+    float *radius;
+    uint32_t cnt;
+    uint32_t capacity;
+} CullBounds;
+
+// 正規化した視錐台の6平面。(a, b, c, d)で ax + by + cz + d >= 0 が内側。
+typedef struct Frustum_t {
+    float planes[6][4];
+} Frustum;
+
+// CPUで遮蔽物を描き込む、低解像度の深度バッファ。
+// 深度はVulkanと同じく[0, 1]で、小さいほど手前。
+typedef struct OcclusionBuffer_t {
+    uint32_t width;
+    uint32_t height;
+    float view_proj[16]; // NOTE: clear_occlusion_bufferで渡したカメラのproj * view。
+    float *depth;
+} OcclusionBuffer;
+
+// タイムラインセマフォによる同期のための構造体。
+// キュー一つにつき一つ作り、提出のたびにvalueを一つずつ進める。
+// CPUはvalueを待機・ポーリングすることで、フェンスやvkDeviceWaitIdleを使わずにGPUの進み具合を知る。
+typedef struct Timeline_t {
+    VkSemaphore semaphore;
+    uint64_t value; // NOTE: 最後に提出した処理が完了したときにセマフォが到達する値。
+} Timeline;
+
+// 遅延解放するリソースの種類。
+typedef enum DeletionType_t {
+    DELETION_TYPE_BUFFER,
+    DELETION_TYPE_TEXTURE,
+    DELETION_TYPE_MODEL,
+    DELETION_TYPE_PIPELINE,
+    DELETION_TYPE_DESCRIPTOR_SET,
+    DELETION_TYPE_COMMAND_BUFFER,
+    DELETION_TYPE_GEOMETRY,
+    DELETION_TYPE_BINDLESS_SLOT,
+} DeletionType;
+
+// 遅延解放する一つのリソース。
+// タイムラインがvalueに到達したら解放される。
+typedef struct Deletion_t {
+    uint64_t value;
+    DeletionType type;
+    union {
+        Buffer buffer;
+        Texture texture;
+        Model model;
+        VkPipeline pipeline;
+        struct {
+            VkDescriptorPool pool;
+            VkDescriptorSet set;
+        } descriptor_set;
+        struct {
+            VkCommandPool pool;
+            VkCommandBuffer buffer;
+        } command_buffer;
+        struct {
+            GeometryPool *pool;
+            Model model;
+        } geometry;
+        struct {
+            BindlessTable *table;
+            uint32_t slot;
+        } bindless_slot;
+    } u;
+} Deletion;
+
+// GPUが使用中かもしれないリソースを、使用が終わるまで解放せずに溜めておくキュー。
+// ゼロ初期化して使う。
+typedef struct DeletionQueue_t {
+    uint32_t cnt;
+    uint32_t cap;
+    Deletion *entries;
+} DeletionQueue;
+
+// セットアップ時の転送をまとめるための構造体。
+// 複数のテクスチャやバッファへのコピーとバリアを一つのコマンドバッファに溜め、一度に提出する。
+// ステージングバッファが閾値を超えるか、明示的にフラッシュしたときに提出される。
+typedef struct UploadContext_t {
+    VkDevice device;
+    const VkPhysicalDeviceMemoryProperties *mem_prop;
+    VkQueue queue;
+    VkCommandPool command_pool;
+    Timeline *timeline;
+    DeletionQueue *deletion_queue;
+    VkDeviceSize threshold;
+    // NOTE: 以下は記録中のバッチの状態。記録中でなければcommandはNULL。
+    VkCommandBuffer command;
+    Buffer staging;
+    uint8_t *staging_ptr;
+    VkDeviceSize staging_size;
+    VkDeviceSize staging_used;
+    VkPipelineStageFlags dst_stages;
+    uint32_t buffer_barrier_cnt;
+    uint32_t buffer_barrier_cap;
+    VkBufferMemoryBarrier *buffer_barriers;
+    uint32_t image_barrier_cnt;
+    uint32_t image_barrier_cap;
+    VkImageMemoryBarrier *image_barriers;
+} UploadContext;
+
 // デバッグ関連の関数。
 // リリースビルド時には宣言されない。
 #ifndef RELEASE
@@ -94,6 +743,24 @@ typedef struct CameraData_t {
 //   - p_size: 結果の配列の要素の個数を格納するポインタ
 char *read_bin(const char *path, int *p_size);
 
+// SPIR-Vを得る関数。LOAD_SPIRVを通して呼ぶ。得られなければVK_FALSEを返す。
+// embeddedがNULLでなければ、ファイルは読まずにそれを指す。
+//   - embedded: 実行ファイルに埋め込んだSPIR-V
+//   - embedded_size: embeddedの大きさ(bytes)
+//   - path: embeddedがNULLのときに読むファイルへのパス
+//   - out: 結果を格納するポインタ
+VkBool32 load_spirv(const uint32_t *embedded, size_t embedded_size, const char *path, SpirvCode *out);
+
+// load_spirvで得たSPIR-Vを解放する関数。埋め込んだものなら何もしない。
+//   - code: 解放するSPIR-V
+void free_spirv(SpirvCode *code);
+
+// メモリの要件に合い、flagsをすべて持つメモリタイプの番号を返す関数。なければ-1を返す。
+//   - mem_prop: デバイスメモリのプロパティ
+//   - reqs: バッファかイメージのメモリの要件
+//   - flags: 求めるメモリ特性
+int32_t get_memory_type_index(const VkPhysicalDeviceMemoryProperties *mem_prop, const VkMemoryRequirements *reqs, VkMemoryPropertyFlags flags);
+
 // バッファを作成するための関数。
 //   - device: 論理デバイス
 //   - mem_prop: デバイスメモリのプロパティ
@@ -115,18 +782,24 @@ VkResult create_buffer(
 //   - format: 1テクセルのデータ構造
 //   - width: テクスチャ幅
 //   - height: テクスチャ高
+//   - mip_levels: ミップレベル数
 //   - usage: テクスチャの使用目的
 //   - aspect: イメージのアスペクト
+//   - components: イメージビューのスウィズル(NULLなら恒等)
 VkResult create_texture(
     const VkDevice device,
     const VkPhysicalDeviceMemoryProperties *mem_prop,
     VkFormat format,
     uint32_t width,
     uint32_t height,
+    uint32_t mip_levels,
     VkImageUsageFlags usage,
     VkImageAspectFlags aspect,
+    const VkComponentMapping *components,
     Texture *out
 );
+// カラーとデプスの両方で使えるサンプル数のうち、requested以下で最大のものを返す関数。
+VkSampleCountFlagBits get_max_sample_count(const VkPhysicalDevice phys_device, VkSampleCountFlagBits requested);
 // デバイスメモリにデータをマップする関数。
 //   - device: 論理デバイス
 //   - device_memory: デバイスメモリ
@@ -134,7 +807,25 @@ VkResult create_texture(
 //   - size: データのサイズ(bytes)
 VkResult map_memory(const VkDevice device, const VkDeviceMemory device_memory, const void *data, int32_t size);
 
+// ホストから見えるバッファを作成し、マップしたままにする関数。
+// メモリはHOST_COHERENTなので、書き込みのフラッシュは要らない。破棄はdestroy_bufferで行う。
+//   - device: 論理デバイス
+//   - mem_prop: デバイスメモリのプロパティ
+//   - size: バッファのサイズ(bytes)
+//   - usage: バッファの用途
+//   - out: 結果を格納するポインタ
+//   - p_mapped: マップしたアドレスを格納するポインタ
+VkResult create_mapped_buffer(
+    const VkDevice device,
+    const VkPhysicalDeviceMemoryProperties *mem_prop,
+    VkDeviceSize size,
+    VkBufferUsageFlags usage,
+    Buffer *out,
+    void **p_mapped
+);
+
 // モデルを作成する関数。
+// インデックスの最大値が0xFFFF未満なら、uint16_tに詰めてインデックスバッファに置く。
 //   - device: 論理デバイス
 //   - mem_prop: デバイスメモリのプロパティ
 //   - index_cnt: インデックスの数
@@ -152,18 +843,985 @@ VkResult create_model(
     Model *out
 );
 
+// バッファを破棄する関数。
+//   - device: 論理デバイス
+//   - buffer: 破棄するバッファ
+void destroy_buffer(const VkDevice device, const Buffer *buffer);
+
+// テクスチャを破棄する関数。
+//   - device: 論理デバイス
+//   - texture: 破棄するテクスチャ
+void destroy_texture(const VkDevice device, const Texture *texture);
+
+// モデルを破棄する関数。
+//   - device: 論理デバイス
+//   - model: 破棄するモデル
+void destroy_model(const VkDevice device, const Model *model);
+
 // ファイルから画像テクスチャを作成する関数。
+// 1チャンネルはR8、2チャンネルはR8G8のまま転送し、ビューのスウィズルでグレースケール(+アルファ)として読めるようにする。
+// 3チャンネルはR8G8B8A8に展開する。
+// 転送はuploadに記録されるだけなので、使う前にflush_upload_contextで提出すること。
 //   - device: 論理デバイス
 //   - mem_prop: デバイスメモリのプロパティ
-//   - command_pool: コマンドプール
-//   - queue: キュー
+//   - upload: アップロードコンテキスト
 //   - path: ファイルへのパス
 //   - out: 結果を格納するポインタ
 VkResult create_image_texture_from_file(
     const VkDevice device,
     const VkPhysicalDeviceMemoryProperties *mem_prop,
-    const VkCommandPool command_pool,
-    const VkQueue queue,
+    UploadContext *upload,
+    const char *path,
+    Texture *out
+);
+
+// KTX2またはDDSファイルから、圧縮済みのテクスチャを作成する関数。
+// BCn/ETC2/ASTCのブロックを展開せずにそのままアップロードするため、RGBA8と比べてVRAMと帯域が1/4〜1/8で済む。
+// 全ミップレベルを読み込む。超圧縮されたKTX2(Basis Universal, zstd)やキューブマップには対応しない。
+// デバイスがフォーマットをサンプリングできない場合はVK_ERROR_FORMAT_NOT_SUPPORTEDを返す。
+// 転送はuploadに記録されるだけなので、使う前にflush_upload_contextで提出すること。
+//   - device: 論理デバイス
+//   - phys_device: 物理デバイス(フォーマットの対応を調べるため)
+//   - mem_prop: デバイスメモリのプロパティ
+//   - upload: アップロードコンテキスト
+//   - path: ファイルへのパス
+//   - out: 結果を格納するポインタ
+VkResult create_compressed_texture_from_file(
+    const VkDevice device,
+    const VkPhysicalDevice phys_device,
+    const VkPhysicalDeviceMemoryProperties *mem_prop,
+    UploadContext *upload,
     const char *path,
     Texture *out
 );
+
+// タイムラインを作成する関数。
+// デバイス作成時にVkPhysicalDeviceVulkan12Features::timelineSemaphoreを有効にしておくこと。
+//   - device: 論理デバイス
+//   - out: 結果を格納するポインタ
+VkResult create_timeline(const VkDevice device, Timeline *out);
+
+// コマンドバッファを提出し、完了時にタイムラインを次の値へ進める関数。
+//   - queue: キュー
+//   - timeline: queueのタイムライン
+//   - command_buffer_cnt: コマンドバッファの数
+//   - command_buffers: コマンドバッファ
+//   - wait_semaphore: 待機するバイナリセマフォ(不要ならVK_NULL_HANDLE)
+//   - wait_stage: wait_semaphoreを待機するステージ
+//   - signal_semaphore: 完了時にシグナルするバイナリセマフォ(不要ならVK_NULL_HANDLE)
+//   - p_value: 完了時に到達する値を格納するポインタ(不要ならNULL)
+VkResult submit_timeline(
+    const VkQueue queue,
+    Timeline *timeline,
+    uint32_t command_buffer_cnt,
+    const VkCommandBuffer *command_buffers,
+    const VkSemaphore wait_semaphore,
+    VkPipelineStageFlags wait_stage,
+    const VkSemaphore signal_semaphore,
+    uint64_t *p_value
+);
+
+// タイムラインがvalueに到達するまで待機する関数。
+//   - device: 論理デバイス
+//   - timeline: タイムライン
+//   - value: 待機する値
+//   - timeout: タイムアウト(ns)
+VkResult wait_timeline(const VkDevice device, const Timeline *timeline, uint64_t value, uint64_t timeout);
+
+// タイムラインの現在の値を取得する関数。待機せずにGPUの進み具合を調べるために。
+//   - device: 論理デバイス
+//   - timeline: タイムライン
+//   - out: 結果を格納するポインタ
+VkResult get_timeline_value(const VkDevice device, const Timeline *timeline, uint64_t *out);
+
+// リソースの遅延解放を予約する関数群。
+// valueには、そのリソースを最後に使う提出が完了したときのタイムラインの値を渡す。
+// 通常はTimeline::value(最後に提出した値)を渡せばよい。
+//   - queue: 遅延解放キュー
+//   - value: 解放してよくなるタイムラインの値
+VkResult defer_destroy_buffer(DeletionQueue *queue, uint64_t value, const Buffer *buffer);
+VkResult defer_destroy_texture(DeletionQueue *queue, uint64_t value, const Texture *texture);
+VkResult defer_destroy_model(DeletionQueue *queue, uint64_t value, const Model *model);
+VkResult defer_destroy_pipeline(DeletionQueue *queue, uint64_t value, const VkPipeline pipeline);
+// poolはVK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BITで作成されていること。
+VkResult defer_free_descriptor_set(DeletionQueue *queue, uint64_t value, const VkDescriptorPool pool, const VkDescriptorSet set);
+VkResult defer_free_command_buffer(DeletionQueue *queue, uint64_t value, const VkCommandPool pool, const VkCommandBuffer command_buffer);
+VkResult defer_free_geometry(DeletionQueue *queue, uint64_t value, GeometryPool *pool, const Model *model);
+// 枠を空きに戻すのはvalueに到達してからなので、提出済みのコマンドが読んでいる間は次の登録に上書きされない。
+VkResult defer_unregister_bindless_texture(DeletionQueue *queue, uint64_t value, BindlessTable *table, uint32_t slot);
+
+// タイムラインがcompletedに到達済みのリソースを解放する関数。毎フレーム呼ぶ。
+//   - device: 論理デバイス
+//   - queue: 遅延解放キュー
+//   - completed: タイムラインの現在の値
+void collect_deletion_queue(const VkDevice device, DeletionQueue *queue, uint64_t completed);
+
+// 残っているリソースをすべて解放する関数。GPUの処理がすべて完了してから呼ぶこと。
+//   - device: 論理デバイス
+//   - queue: 遅延解放キュー
+void flush_deletion_queue(const VkDevice device, DeletionQueue *queue);
+
+// アップロードコンテキストを作成する関数。
+//   - device: 論理デバイス
+//   - mem_prop: デバイスメモリのプロパティ
+//   - queue: 転送に使うキュー
+//   - command_pool: queueのキューファミリのコマンドプール
+//   - timeline: queueのタイムライン
+//   - deletion_queue: 提出済みのステージングバッファ等を遅延解放するキュー
+//   - threshold: 一つのバッチのステージングバッファのサイズ(bytes)。超えると自動でフラッシュされる
+//   - out: 結果を格納するポインタ
+VkResult create_upload_context(
+    const VkDevice device,
+    const VkPhysicalDeviceMemoryProperties *mem_prop,
+    const VkQueue queue,
+    const VkCommandPool command_pool,
+    Timeline *timeline,
+    DeletionQueue *deletion_queue,
+    VkDeviceSize threshold,
+    UploadContext *out
+);
+
+// ステージングバッファの領域を予約する関数。
+// 予約した領域に直接データを書き込み、upload_bufferまたはupload_imageで転送先を指定する。
+// 現在のバッチに収まらなければ、先にそれまでの分をフラッシュする。
+//   - ctx: アップロードコンテキスト
+//   - size: 予約するサイズ(bytes)
+//   - alignment: 領域の先頭のアラインメント(1以上)
+//   - p_data: 書き込み先のポインタを格納するポインタ
+//   - p_offset: ステージングバッファ内のオフセットを格納するポインタ
+VkResult reserve_upload(UploadContext *ctx, VkDeviceSize size, VkDeviceSize alignment, void **p_data, VkDeviceSize *p_offset);
+
+// 予約した領域からバッファへのコピーを記録する関数。
+//   - ctx: アップロードコンテキスト
+//   - offset: reserve_uploadで得たオフセット
+//   - size: コピーするサイズ(bytes)
+//   - dst: 転送先のバッファ
+//   - dst_offset: 転送先のオフセット
+//   - dst_access: 転送後にdstを使うアクセス
+//   - dst_stage: 転送後にdstを使うパイプラインステージ
+VkResult upload_buffer(
+    UploadContext *ctx,
+    VkDeviceSize offset,
+    VkDeviceSize size,
+    const VkBuffer dst,
+    VkDeviceSize dst_offset,
+    VkAccessFlags dst_access,
+    VkPipelineStageFlags dst_stage
+);
+
+// 予約した領域から作成直後のイメージへのコピーを記録する関数。
+// 転送後、イメージはVK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMALに遷移する。
+//   - ctx: アップロードコンテキスト
+//   - offset: reserve_uploadで得たオフセット
+//   - dst: 転送先のイメージ
+//   - mip_levels: イメージのミップレベル数
+//   - region_cnt: コピー領域の数
+//   - regions: コピー領域(bufferOffsetは予約した領域の先頭からの相対値)
+//   - dst_stage: 転送後にdstを使うパイプラインステージ
+VkResult upload_image(
+    UploadContext *ctx,
+    VkDeviceSize offset,
+    const VkImage dst,
+    uint32_t mip_levels,
+    uint32_t region_cnt,
+    const VkBufferImageCopy *regions,
+    VkPipelineStageFlags dst_stage
+);
+
+// データをステージングバッファに書き込み、バッファへのコピーを記録する関数。
+//   - ctx: アップロードコンテキスト
+//   - data: データ
+//   - size: データのサイズ(bytes)
+//   - dst, dst_offset, dst_access, dst_stage: upload_bufferと同じ
+VkResult upload_to_buffer(
+    UploadContext *ctx,
+    const void *data,
+    VkDeviceSize size,
+    const VkBuffer dst,
+    VkDeviceSize dst_offset,
+    VkAccessFlags dst_access,
+    VkPipelineStageFlags dst_stage
+);
+
+// 溜まっている転送を提出する関数。完了は待たない。
+//   - ctx: アップロードコンテキスト
+//   - p_value: 転送が完了したときにタイムラインが到達する値を格納するポインタ(不要ならNULL)
+VkResult flush_upload_context(UploadContext *ctx, uint64_t *p_value);
+
+// 溜まっている転送を提出し、アップロードコンテキストを破棄する関数。
+//   - ctx: アップロードコンテキスト
+VkResult destroy_upload_context(UploadContext *ctx);
+
+// ジオメトリプールを作成する関数。
+//   - device: 論理デバイス
+//   - mem_prop: デバイスメモリのプロパティ
+//   - vertex_format: プールに置く頂点の形式
+//   - index_type: プールに置くインデックスの型
+//   - vertex_capacity: 頂点の最大数
+//   - index_capacity: インデックスの最大数
+//   - out: 結果を格納するポインタ
+VkResult create_geometry_pool(
+    const VkDevice device,
+    const VkPhysicalDeviceMemoryProperties *mem_prop,
+    VertexFormat vertex_format,
+    VkIndexType index_type,
+    uint32_t vertex_capacity,
+    uint32_t index_capacity,
+    GeometryPool *out
+);
+
+// ジオメトリプールからモデル一つ分の領域を確保する関数。データは書き込まない。
+// 空きがなければVK_ERROR_OUT_OF_DEVICE_MEMORYを返す。
+//   - pool: ジオメトリプール
+//   - vertex_cnt: 頂点数
+//   - index_cnt: インデックスの数
+//   - out: 結果を格納するポインタ
+VkResult alloc_geometry(GeometryPool *pool, uint32_t vertex_cnt, uint32_t index_cnt, Model *out);
+
+// ジオメトリプールにモデルの領域を返す関数。GPUが使い終わってから呼ぶこと。
+// 使用中かもしれなければ、defer_free_geometryを使う。
+//   - pool: ジオメトリプール
+//   - model: alloc_geometryで確保したモデル
+VkResult free_geometry(GeometryPool *pool, const Model *model);
+
+// ジオメトリプールに領域を確保し、頂点とインデックスの転送を記録する関数。
+//   - upload: アップロードコンテキスト
+//   - pool: ジオメトリプール
+//   - vertex_cnt: 頂点数
+//   - vtxs: プールの形式の頂点データ
+//   - index_cnt: インデックスの数
+//   - idxs: インデックスデータ(uint16_tのプールでは詰めて書き込む)
+//   - out: 結果を格納するポインタ
+VkResult upload_geometry(
+    UploadContext *upload,
+    GeometryPool *pool,
+    uint32_t vertex_cnt,
+    const void *vtxs,
+    uint32_t index_cnt,
+    const uint32_t *idxs,
+    Model *out
+);
+
+// ジオメトリプールを破棄する関数。
+//   - device: 論理デバイス
+//   - pool: 破棄するジオメトリプール
+void destroy_geometry_pool(const VkDevice device, GeometryPool *pool);
+
+// 物理デバイスの間接描画の機能の対応状況を取得する関数。
+// 結果はそのままVkPhysicalDeviceFeatures/VkPhysicalDeviceVulkan12Featuresに設定して有効にできる。
+//   - phys_device: 物理デバイス
+//   - out: 結果を格納するポインタ
+void get_indirect_features(const VkPhysicalDevice phys_device, IndirectFeatures *out);
+
+// 描画リストを作成する関数。
+// featuresのdraw_indirect_first_instanceが無効なら失敗する。
+//   - device: 論理デバイス
+//   - mem_prop: デバイスメモリのプロパティ
+//   - features: デバイス作成時に有効にした間接描画の機能
+//   - capacity: 描画の最大数
+//   - instance_size: 描画一つあたりのインスタンスデータのサイズ(16の倍数)
+//   - out: 結果を格納するポインタ
+VkResult create_draw_list(
+    const VkDevice device,
+    const VkPhysicalDeviceMemoryProperties *mem_prop,
+    const IndirectFeatures *features,
+    uint32_t capacity,
+    uint32_t instance_size,
+    DrawList *out
+);
+
+// 描画リストを空にする関数。フレームの記録の初めに呼ぶ。
+//   - list: 描画リスト
+void reset_draw_list(DrawList *list);
+
+// 描画リストにモデル一つの描画を追加する関数。
+// 容量を超えたら失敗する。
+//   - list: 描画リスト
+//   - model: 描画するモデル
+//   - instance: インスタンスデータ(instance_sizeバイト)
+VkResult push_draw(DrawList *list, const Model *model, const void *instance);
+
+// 描画リストの描画をすべて記録する関数。
+// drawIndirectCountがあれば一回、multiDrawIndirectがあれば一回、なければ描画ごとに一回の間接描画となる。
+// パイプライン、頂点バッファ、インデックスバッファ、インスタンスデータのディスクリプタセットは呼び出し側でバインドしておく。
+//   - command: 記録先のコマンドバッファ
+//   - list: 描画リスト
+void cmd_draw_list(const VkCommandBuffer command, const DrawList *list);
+
+// 描画リストを破棄する関数。
+//   - device: 論理デバイス
+//   - list: 破棄する描画リスト
+void destroy_draw_list(const VkDevice device, DrawList *list);
+
+// Hi-Zピラミッドを作成する関数。
+// デプスバッファはVK_IMAGE_USAGE_SAMPLED_BITを付けて作っておく。
+//   - device: 論理デバイス
+//   - mem_prop: デバイスメモリのプロパティ
+//   - shader: 縮小のコンピュートシェーダ
+//   - width: デプスバッファの幅
+//   - height: デプスバッファの高さ
+//   - depth_cnt: デプスバッファの数
+//   - depth_views: デプスバッファのビュー(depth_cnt個)
+//   - out: 結果を格納するポインタ
+VkResult create_hiz(
+    const VkDevice device,
+    const VkPhysicalDeviceMemoryProperties *mem_prop,
+    const VkShaderModule shader,
+    uint32_t width,
+    uint32_t height,
+    uint32_t depth_cnt,
+    const VkImageView *depth_views,
+    HiZ *out
+);
+
+// デプスバッファからHi-Zピラミッドを作るコマンドを記録する関数。レンダーパスの後に記録する。
+// パスの外との同期は呼び出し側(レンダーグラフ)が行う。デプスバッファはVK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL、
+// ピラミッドはVK_IMAGE_LAYOUT_GENERALで、どちらもコンピュートシェーダから読み書きできるようにしておくこと。
+//   - command: 記録先のコマンドバッファ
+//   - hiz: Hi-Zピラミッド
+//   - depth_index: 描き終えたデプスバッファの番号(create_hizに渡した順)
+void cmd_build_hiz(const VkCommandBuffer command, HiZ *hiz, uint32_t depth_index);
+
+// Hi-Zピラミッドを破棄する関数。シェーダモジュールは破棄しない。
+//   - device: 論理デバイス
+//   - hiz: 破棄するHi-Zピラミッド
+void destroy_hiz(const VkDevice device, HiZ *hiz);
+
+// カリングパスを作成する関数。
+// 容量とインスタンスデータのサイズは描画リストに合わせる。
+//   - device: 論理デバイス
+//   - mem_prop: デバイスメモリのプロパティ
+//   - shader: カリングのコンピュートシェーダ
+//   - camera: カメラのユニフォームバッファ
+//   - hiz: オクルージョンカリングに使うHi-Zピラミッド
+//   - list: 結果を書き込む描画リスト
+//   - out: 結果を格納するポインタ
+VkResult create_cull_pass(
+    const VkDevice device,
+    const VkPhysicalDeviceMemoryProperties *mem_prop,
+    const VkShaderModule shader,
+    const Buffer *camera,
+    const HiZ *hiz,
+    const DrawList *list,
+    CullPass *out
+);
+
+// カリングパスのオブジェクトを空にする関数。フレームの記録の初めに呼ぶ。
+//   - pass: カリングパス
+void reset_cull_pass(CullPass *pass);
+
+// カリングパスにオブジェクトを一つ追加する関数。
+// 容量を超えたら失敗する。
+//   - pass: カリングパス
+//   - model: 描画するモデル
+//   - sphere: モデル空間の境界球(compute_bounding_sphereの結果)
+//   - instance: インスタンスデータ(instance_sizeバイト)
+VkResult push_cull_object(CullPass *pass, const Model *model, const float sphere[4], const void *instance);
+
+// カリングを記録する関数。レンダーパスの外で、cmd_draw_listより前に記録する。
+// 描画リストの中身はGPUが書き込むので、この後でpush_drawを呼ばないこと。
+// パスの外との同期は呼び出し側(レンダーグラフ)が行う。描画リストの三つのバッファと統計は転送とコンピュートシェーダで書き込み、
+// Hi-ZピラミッドはVK_IMAGE_LAYOUT_GENERALでコンピュートシェーダから読む。
+// NOTE: Hi-Zピラミッドは前のフレームのカメラで描いた深度なので、カメラが大きく動くと一フレームだけ誤って消えることがある。
+//   - command: 記録先のコマンドバッファ
+//   - pass: カリングパス
+//   - hiz: Hi-Zピラミッド(create_cull_passに渡したもの)
+//   - list: 結果を書き込む描画リスト(create_cull_passに渡したもの)
+void cmd_cull(const VkCommandBuffer command, const CullPass *pass, const HiZ *hiz, DrawList *list);
+
+// 最後に記録したカリングの統計を得る関数。そのコマンドバッファの完了を待ってから呼ぶ。
+//   - pass: カリングパス
+//   - out: 結果を格納するポインタ
+void get_cull_stats(const CullPass *pass, CullStats *out);
+
+// カリングパスを破棄する関数。シェーダモジュールは破棄しない。
+//   - device: 論理デバイス
+//   - pass: 破棄するカリングパス
+void destroy_cull_pass(const VkDevice device, CullPass *pass);
+
+// 物理デバイスがbindlessのテーブルに対応しているか調べる関数。
+// Vulkan 1.2のディスクリプタインデックスの機能と、update-after-bindのテクスチャ数の上限を見る。
+//   - phys_device: 物理デバイス
+//   - capacity: テーブルに登録するテクスチャの最大数
+VkBool32 is_bindless_supported(const VkPhysicalDevice phys_device, uint32_t capacity);
+
+// bindlessのテーブルに必要な機能を有効にする関数。論理デバイスを作る前に呼ぶ。
+//   - features12: 論理デバイスの作成に渡すVulkan 1.2の機能
+void enable_bindless_features(VkPhysicalDeviceVulkan12Features *features12);
+
+// bindlessのテーブルを作成する関数。
+//   - device: 論理デバイス
+//   - capacity: 登録できるテクスチャの最大数
+//   - sampler: すべてのテクスチャで共有するサンプラ。テーブルより長く生きていなければならない
+//   - out: 結果を格納するポインタ
+VkResult create_bindless_table(const VkDevice device, uint32_t capacity, const VkSampler sampler, BindlessTable *out);
+
+// テクスチャをテーブルに登録し、シェーダから参照する番号を得る関数。
+// 容量を超えたら失敗する。描画中のセットを書き換えてもよい(提出済みのコマンドが使わない枠に限る)。
+//   - device: 論理デバイス
+//   - table: テーブル
+//   - view: テクスチャのビュー(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+//   - p_slot: 番号を格納するポインタ
+VkResult register_bindless_texture(const VkDevice device, BindlessTable *table, const VkImageView view, uint32_t *p_slot);
+
+// テクスチャの登録を解除する関数。その番号は次の登録で再び使われる。
+// GPUがその番号を使い終わってから呼ぶ。使用中かもしれなければ、defer_unregister_bindless_textureで遅らせる。
+//   - table: テーブル
+//   - slot: register_bindless_textureで得た番号
+void unregister_bindless_texture(BindlessTable *table, uint32_t slot);
+
+// bindlessのテーブルを破棄する関数。サンプラとテクスチャは破棄しない。
+//   - device: 論理デバイス
+//   - table: 破棄するテーブル
+void destroy_bindless_table(const VkDevice device, BindlessTable *table);
+
+// ディスクリプタセットのアロケータを作成する関数。プールは初めて割り当てるときに作る。
+//   - sets_per_pool: 初めのプールのセット数
+//   - ratio_cnt: 見積もりの数(DESCRIPTOR_RATIO_MAX_CNT以下)
+//   - ratios: ディスクリプタの種類ごとの、セット一つあたりの数の見積もり
+//   - out: 結果を格納するポインタ
+VkResult create_descriptor_allocator(
+    uint32_t sets_per_pool,
+    uint32_t ratio_cnt,
+    const DescriptorPoolRatio *ratios,
+    DescriptorAllocator *out
+);
+
+// ディスクリプタセットを一つ割り当てる関数。今のプールが尽きていれば、次のプールを継ぎ足す。
+//   - device: 論理デバイス
+//   - allocator: アロケータ
+//   - layout: セットのレイアウト
+//   - out: 結果を格納するポインタ
+VkResult allocate_descriptor_set(
+    const VkDevice device,
+    DescriptorAllocator *allocator,
+    const VkDescriptorSetLayout layout,
+    VkDescriptorSet *out
+);
+
+// 割り当てたセットをすべてまとめて解放する関数。
+// GPUがそれらのセットを使い終わってから呼ぶ(タイムラインで待つ)。
+//   - device: 論理デバイス
+//   - allocator: アロケータ
+VkResult reset_descriptor_allocator(const VkDevice device, DescriptorAllocator *allocator);
+
+// アロケータを破棄する関数。割り当てたセットもすべて解放される。
+//   - device: 論理デバイス
+//   - allocator: 破棄するアロケータ
+void destroy_descriptor_allocator(const VkDevice device, DescriptorAllocator *allocator);
+
+// ディスクリプタセットレイアウトのキャッシュを作成する関数。
+//   - out: 結果を格納するポインタ
+VkResult create_descriptor_layout_cache(DescriptorLayoutCache *out);
+
+// 作成情報に合うレイアウトを得る関数。キャッシュになければ作って加える。
+// 得たレイアウトはキャッシュが持つので、破棄しないこと。
+// NOTE: pNextを持つ作成情報(バインディングのフラグなど)は扱えない。
+//   - device: 論理デバイス
+//   - cache: キャッシュ
+//   - ci: レイアウトの作成情報
+//   - out: 結果を格納するポインタ
+VkResult get_descriptor_set_layout(
+    const VkDevice device,
+    DescriptorLayoutCache *cache,
+    const VkDescriptorSetLayoutCreateInfo *ci,
+    VkDescriptorSetLayout *out
+);
+
+// キャッシュを、作ったレイアウトとともに破棄する関数。
+//   - device: 論理デバイス
+//   - cache: 破棄するキャッシュ
+void destroy_descriptor_layout_cache(const VkDevice device, DescriptorLayoutCache *cache);
+
+// サンプラのキャッシュを作成する関数。
+//   - phys_device: 物理デバイス
+//   - anisotropy_enabled: 論理デバイスの作成時にsamplerAnisotropyを有効にしたか
+//   - out: 結果を格納するポインタ
+VkResult create_sampler_cache(const VkPhysicalDevice phys_device, VkBool32 anisotropy_enabled, SamplerCache *out);
+
+// 作成情報に合うサンプラを得る関数。キャッシュになければ作って加える。
+// 異方性フィルタリングを使えなければ無効にし、maxAnisotropyはデバイスの上限に収める。
+// 得たサンプラはキャッシュが持つので、破棄しないこと。
+// NOTE: pNextを持つ作成情報(YCbCr変換など)は扱えない。
+//   - device: 論理デバイス
+//   - cache: キャッシュ
+//   - ci: サンプラの作成情報
+//   - out: 結果を格納するポインタ
+VkResult get_sampler(const VkDevice device, SamplerCache *cache, const VkSamplerCreateInfo *ci, VkSampler *out);
+
+// キャッシュを、作ったサンプラとともに破棄する関数。
+//   - device: 論理デバイス
+//   - cache: 破棄するキャッシュ
+void destroy_sampler_cache(const VkDevice device, SamplerCache *cache);
+
+// 動的な状態に関わる機能の対応状況を得る関数。
+// 有効にするには、論理デバイスの作成時に拡張の名前と機能の構造体を渡す。
+//   - phys_device: 物理デバイス
+//   - out: 結果を格納するポインタ
+void get_dynamic_state_features(const VkPhysicalDevice phys_device, DynamicStateFeatures *out);
+
+// パイプラインの記述を既定値で初期化する関数。
+// 三角形リスト、塗りつぶし、裏面カリング(反時計回りが表)、デプステストと書き込み(LESS_OR_EQUAL)、ブレンドなし、1サンプルとなる。
+//   - out: 初期化する記述
+void init_pipeline_desc(PipelineDesc *out);
+
+// パイプラインのキャッシュを作成する関数。
+//   - device: 論理デバイス
+//   - features: デバイス作成時に有効にした、動的な状態に関わる機能
+//   - thread_cnt: コンパイルスレッドの数。0なら一つ
+//   - out: 結果を格納するポインタ
+VkResult create_pipeline_cache(const VkDevice device, const DynamicStateFeatures *features, uint32_t thread_cnt, PipelineCache *out);
+
+// 記述に合うパイプラインを得る関数。キャッシュになければコンパイルスレッドに作成を頼む。
+// waitが無効で、まだできていなければVK_NOT_READYを返す。そのときは描画を飛ばし、次のフレームで再び呼ぶ。
+// 作成に失敗したパイプラインは、その結果を返し続ける。
+// 得たパイプラインはキャッシュが持つので、破棄しないこと。
+//   - cache: キャッシュ
+//   - desc: パイプラインの記述(init_pipeline_descで初期化したもの)
+//   - wait: 有効なら、できるまで待つ
+//   - out: 結果を格納するポインタ。できていなければVK_NULL_HANDLE
+VkResult get_pipeline(PipelineCache *cache, const PipelineDesc *desc, VkBool32 wait, VkPipeline *out);
+
+// パイプラインの動的な状態を記録する関数。パイプラインをバインドした後に記録する。
+// ビューポートとシザーは常に、カリングとデプスの設定はextended dynamic stateが有効なときだけ記録する。
+//   - command: 記録先のコマンドバッファ
+//   - cache: キャッシュ
+//   - desc: バインドしたパイプラインの記述
+//   - extent: 描画先の大きさ
+void cmd_set_pipeline_state(const VkCommandBuffer command, const PipelineCache *cache, const PipelineDesc *desc, VkExtent2D extent);
+
+// キャッシュを、作ったパイプラインとともに破棄する関数。
+// 作成中のものは終わるまで待ち、まだ作り始めていないものは作らない。シェーダモジュールとレイアウトは破棄しない。
+//   - cache: 破棄するキャッシュ
+void destroy_pipeline_cache(PipelineCache *cache);
+
+// シェーダモジュールを使うパイプラインをキャッシュから外す関数。シェーダを差し替えた後に、古いものを捨てるために。
+// 作成中のものは終わるまで待つ。外したパイプラインは遅延解放キューに積むので、シェーダモジュールはこの後すぐに破棄してよい。
+//   - cache: キャッシュ
+//   - shader: 頂点シェーダかフラグメントシェーダとして使われたモジュール
+//   - deletion_queue: 遅延解放キュー
+//   - value: 外したパイプラインを最後に使う提出のタイムラインの値
+VkResult release_pipelines_with_shader(
+    PipelineCache *cache,
+    const VkShaderModule shader,
+    DeletionQueue *deletion_queue,
+    uint64_t value
+);
+
+// シェーダの監視を始める関数。
+// NOTE: glslcにパスが通っていること。
+//   - cnt: 監視するシェーダの数
+//   - srcs: シェーダのソースのパスの配列
+//   - outs: SPIR-Vの出力先のパスの配列
+//   - out: 結果を格納するポインタ
+VkResult create_shader_watcher(uint32_t cnt, const char *const *srcs, const char *const *outs, ShaderWatcher *out);
+
+// 前に呼んでから、シェーダがコンパイルし直されたかを調べる関数。一度VK_TRUEを返すと、次に書き換えられるまでVK_FALSEを返す。
+//   - watcher: 監視
+//   - index: create_shader_watcherに渡した配列での番号
+VkBool32 take_shader_reload(ShaderWatcher *watcher, uint32_t index);
+
+// 監視を止めて破棄する関数。コンパイル中なら終わるまで待つ。
+//   - watcher: 破棄する監視
+void destroy_shader_watcher(ShaderWatcher *watcher);
+
+// SPIR-Vを解析し、ディスクリプタ・プッシュ定数・頂点入力を読み取る関数。
+// エントリポイントは一つ目だけを見る。
+//   - code: SPIR-V
+//   - size: codeの大きさ(bytes)
+//   - out: 結果を格納するポインタ
+VkResult reflect_shader(const uint32_t *code, size_t size, ShaderReflection *out);
+
+// 複数のステージの読み取り結果を、一つのパイプラインレイアウトにまとめる関数。
+// 同じバインディングはステージを合わせて一つにし、プッシュ定数はすべてのステージを覆う一つの範囲にする。
+// 同じバインディングで種類か数が食い違えば失敗する。頂点入力は頂点シェーダのものを引き継ぐ。
+//   - cnt: 読み取り結果の数
+//   - refls: 読み取り結果の配列
+//   - out: 結果を格納するポインタ
+VkResult merge_shader_reflections(uint32_t cnt, const ShaderReflection *refls, ShaderReflection *out);
+
+// シェーダが、まとめたレイアウトのまま使えるかを調べる関数。シェーダを差し替えるときに。
+// シェーダの使うバインディングとプッシュ定数がすべてレイアウトにあり、頂点シェーダなら入力が同じであればVK_TRUEを返す。
+//   - shader: 一つのシェーダの読み取り結果
+//   - layout: merge_shader_reflectionsでまとめたもの
+VkBool32 check_shader_reflection(const ShaderReflection *shader, const ShaderReflection *layout);
+
+// 読み取り結果のうち、一つのセットのレイアウトをキャッシュから得る関数。
+// NOTE: 実行時に大きさの決まる配列を含むセットは、バインディングのフラグが要るので扱えない。
+//   - device: 論理デバイス
+//   - cache: レイアウトのキャッシュ
+//   - refl: 読み取り結果
+//   - set: セットの番号
+//   - out: 結果を格納するポインタ
+VkResult get_reflected_set_layout(
+    const VkDevice device,
+    DescriptorLayoutCache *cache,
+    const ShaderReflection *refl,
+    uint32_t set,
+    VkDescriptorSetLayout *out
+);
+
+// 頂点シェーダの入力から、パイプラインの記述の頂点属性とストライドを埋める関数。
+// 属性はロケーションの順に、詰め物なしで一つのバッファ(バインディング0)に並んでいるものとする。
+//   - refl: 頂点シェーダの読み取り結果
+//   - desc: 埋めるパイプラインの記述
+VkResult fill_reflected_vertex_input(const ShaderReflection *refl, PipelineDesc *desc);
+
+// 読み取り結果のキャッシュを作成する関数。
+//   - out: 結果を格納するポインタ
+VkResult create_shader_reflection_cache(ShaderReflectionCache *out);
+
+// SPIR-Vの読み取り結果を得る関数。キャッシュになければ解析して加える。
+//   - cache: キャッシュ
+//   - code: SPIR-V
+//   - size: codeの大きさ(bytes)
+//   - out: 結果を格納するポインタ
+VkResult get_shader_reflection(ShaderReflectionCache *cache, const uint32_t *code, size_t size, ShaderReflection *out);
+
+// キャッシュを破棄する関数。
+//   - cache: 破棄するキャッシュ
+void destroy_shader_reflection_cache(ShaderReflectionCache *cache);
+
+// レンダーグラフを空にする関数。
+//   - out: 初期化するグラフ
+void init_render_graph(RenderGraph *out);
+
+// 外から渡すイメージを宣言する関数。イメージはset_render_graph_imageで渡す。
+//   - graph: レンダーグラフ
+//   - aspect: バリアで使うアスペクト
+//   - mip_cnt: バリアで使うミップレベル数
+//   - out: 資源の番号を格納するポインタ
+VkResult add_render_graph_image(RenderGraph *graph, VkImageAspectFlags aspect, uint32_t mip_cnt, uint32_t *out);
+
+// 外から渡すバッファを宣言する関数。バッファはset_render_graph_bufferで渡す。
+//   - graph: レンダーグラフ
+//   - out: 資源の番号を格納するポインタ
+VkResult add_render_graph_buffer(RenderGraph *graph, uint32_t *out);
+
+// グラフが作る一時的なイメージを宣言する関数。イメージとビューはcompile_render_graphで作られる。
+// usageにVK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BITを含めれば、遅延割り当てのメモリがあればそこに置く。
+//   - graph: レンダーグラフ
+//   - format: 1テクセルのデータ構造
+//   - width: イメージ幅
+//   - height: イメージ高
+//   - samples: 1ピクセルあたりのサンプル数
+//   - usage: イメージの使用目的
+//   - aspect: イメージのアスペクト
+//   - out: 資源の番号を格納するポインタ
+VkResult add_render_graph_transient(
+    RenderGraph *graph,
+    VkFormat format,
+    uint32_t width,
+    uint32_t height,
+    VkSampleCountFlagBits samples,
+    VkImageUsageFlags usage,
+    VkImageAspectFlags aspect,
+    uint32_t *out
+);
+
+// 資源をグラフの結果とする関数。結果に書き込まず、結果に書き込むパスにもつながらないパスは省かれる。
+//   - graph: レンダーグラフ
+//   - resource: 資源の番号
+//   - final: 実行の終わりに移す状態(resourceは見ない)。NULLかstagesが0なら移さない
+VkResult set_render_graph_output(RenderGraph *graph, uint32_t resource, const RenderGraphAccess *final);
+
+// パスを宣言する関数。パスは宣言した順に記録する。
+// NOTE: 同じ資源を二度使う場合は一つにまとめる。そのときのレイアウトは同じであること。
+//   - graph: レンダーグラフ
+//   - access_cnt: パスが使う資源の数
+//   - accesses: パスが使う資源
+//   - out: パスの番号を格納するポインタ
+VkResult add_render_graph_pass(RenderGraph *graph, uint32_t access_cnt, const RenderGraphAccess *accesses, uint32_t *out);
+
+// パスを省き、一時的なイメージにメモリを割り当てる関数。以後、パスと資源は宣言できない。
+//   - device: 論理デバイス
+//   - mem_prop: デバイスメモリのプロパティ
+//   - graph: レンダーグラフ
+VkResult compile_render_graph(const VkDevice device, const VkPhysicalDeviceMemoryProperties *mem_prop, RenderGraph *graph);
+
+// 外から渡すイメージを設定する関数。前の内容の状態は捨て、stagesを待ってからlayoutで使い始めるものとする。
+//   - graph: レンダーグラフ
+//   - resource: 資源の番号
+//   - image: イメージ
+//   - stages: 使い始める前に待つステージ(スワップチェインのイメージなら、取得を待つステージ)
+//   - layout: 今のレイアウト。中身が要らなければVK_IMAGE_LAYOUT_UNDEFINED
+void set_render_graph_image(RenderGraph *graph, uint32_t resource, const VkImage image, VkPipelineStageFlags stages, VkImageLayout layout);
+
+// 外から渡すバッファを設定する関数。状態は持ち越す。
+//   - graph: レンダーグラフ
+//   - resource: 資源の番号
+//   - buffer: バッファ
+void set_render_graph_buffer(RenderGraph *graph, uint32_t resource, const VkBuffer buffer);
+
+// フレームの実行を始める関数。一時的なイメージの中身は捨てる。
+// NOTE: 前の実行がGPUで終わっていること。
+//   - graph: レンダーグラフ
+void begin_render_graph(RenderGraph *graph);
+
+// パスの前に要るバリアを記録する関数。パスを記録してよければVK_TRUEを、省かれたパスならVK_FALSEを返す。
+// 省かれたパスでも、宣言した順に呼ぶこと。
+//   - command: 記録先のコマンドバッファ
+//   - graph: レンダーグラフ
+//   - pass: パスの番号
+VkBool32 cmd_begin_render_graph_pass(const VkCommandBuffer command, RenderGraph *graph, uint32_t pass);
+
+// 結果を終わりの状態に移すバリアを記録する関数。
+//   - command: 記録先のコマンドバッファ
+//   - graph: レンダーグラフ
+void cmd_end_render_graph(const VkCommandBuffer command, RenderGraph *graph);
+
+// 一時的なイメージとメモリを破棄する関数。
+//   - device: 論理デバイス
+//   - graph: 破棄するレンダーグラフ
+void destroy_render_graph(const VkDevice device, RenderGraph *graph);
+
+// ジョブシステムを作成する関数。
+//   - thread_cnt: ワーカースレッドの数。0ならコア数より一つ少なくする
+//   - out: 結果を格納するポインタ
+VkResult create_job_system(uint32_t thread_cnt, JobSystem *out);
+
+// [0, cnt)をgrain個ずつに分けてfuncを並列に実行し、すべて終わるまで待つ関数。
+// 呼び出し側のスレッドも仕事をする。同時に呼べるのは一つのスレッドからだけ。
+//   - jobs: ジョブシステム。NULLならその場で一度に実行する
+//   - cnt: 要素数
+//   - grain: 一度に渡す要素数
+//   - func: 実行する関数
+//   - user: funcに渡すポインタ
+void run_jobs(JobSystem *jobs, uint32_t cnt, uint32_t grain, JobFunc func, void *user);
+
+// ジョブシステムを破棄する関数。ワーカースレッドの終了を待つ。
+//   - jobs: 破棄するジョブシステム
+void destroy_job_system(JobSystem *jobs);
+
+// 列優先の4x4行列の積 a * b を求める関数。
+//   - a: 左から掛ける行列
+//   - b: 右から掛ける行列
+//   - out: 結果を格納するポインタ。a・bと重なってはいけない
+void mul_mat4(const float *a, const float *b, float *out);
+
+// シーングラフを作成する関数。
+//   - capacity: ノードの最大数
+//   - out: 結果を格納するポインタ
+VkResult create_scene_graph(uint32_t capacity, SceneGraph *out);
+
+// シーングラフにノードを一つ追加する関数。容量を超えたら失敗する。
+//   - graph: シーングラフ
+//   - parent: 親の番号。既に追加したノードかSCENE_NO_PARENT
+//   - scl: 拡大率
+//   - rot: x・y・z軸の回転角(rad)
+//   - trs: 平行移動
+//   - p_index: 追加したノードの番号を格納するポインタ。NULLでもよい
+VkResult add_scene_node(
+    SceneGraph *graph,
+    uint32_t parent,
+    const float scl[3],
+    const float rot[3],
+    const float trs[3],
+    uint32_t *p_index
+);
+
+// ノードのローカルの変換を設定し、更新が必要な印を付ける関数。
+//   - graph: シーングラフ
+//   - index: ノードの番号
+//   - scl: 拡大率
+//   - rot: x・y・z軸の回転角(rad)
+//   - trs: 平行移動
+void set_scene_node(SceneGraph *graph, uint32_t index, const float scl[3], const float rot[3], const float trs[3]);
+
+// 印の付いたノードとその子孫のワールド行列を計算し直し、印を消す関数。計算し直したノードの数を返す。
+// 同じ深さのノードをジョブシステムで並列に計算する。
+//   - jobs: ジョブシステム。NULLなら呼び出し側のスレッドだけで実行する
+//   - graph: シーングラフ
+uint32_t update_scene_graph(JobSystem *jobs, SceneGraph *graph);
+
+// シーングラフを破棄する関数。
+//   - graph: 破棄するシーングラフ
+void destroy_scene_graph(SceneGraph *graph);
+
+// 境界球の配列を作成する関数。
+//   - capacity: 境界球の最大数
+//   - out: 結果を格納するポインタ
+VkResult create_cull_bounds(uint32_t capacity, CullBounds *out);
+
+// 境界球を一つ追加する関数。容量を超えたら失敗する。
+//   - bounds: 境界球の配列
+//   - sphere: ワールド空間の境界球。xyzが中心、wが半径
+VkResult push_cull_bounds(CullBounds *bounds, const float sphere[4]);
+
+// 境界球の配列を破棄する関数。
+//   - bounds: 破棄する境界球の配列
+void destroy_cull_bounds(CullBounds *bounds);
+
+// カメラから視錐台の平面を取り出す関数。
+//   - camera: カメラ
+//   - out: 結果を格納するポインタ
+void extract_frustum(const CameraData *camera, Frustum *out);
+
+// 遮蔽バッファを作成する関数。
+//   - width: 幅(pixels)
+//   - height: 高さ(pixels)
+//   - out: 結果を格納するポインタ
+VkResult create_occlusion_buffer(uint32_t width, uint32_t height, OcclusionBuffer *out);
+
+// 遮蔽バッファを最も奥の深度で埋め、このフレームのカメラを設定する関数。
+//   - buffer: 遮蔽バッファ
+//   - camera: カメラ
+void clear_occlusion_buffer(OcclusionBuffer *buffer, const CameraData *camera);
+
+// 遮蔽物の三角形リストを遮蔽バッファに描き込む関数。
+// NOTE: 近平面を跨ぐ三角形は描かない。遮蔽物は壁や地形のような大きく単純なものに限ること。
+//   - buffer: 遮蔽バッファ
+//   - positions: ワールド空間の頂点座標(xyzの並び)
+//   - idxs: インデックス
+//   - index_cnt: インデックス数(3の倍数)
+void rasterize_occluders(OcclusionBuffer *buffer, const float *positions, const uint32_t *idxs, uint32_t index_cnt);
+
+// 境界球が遮蔽物に完全に隠れているかを調べる関数。隠れていれば1を返す。
+//   - buffer: 遮蔽物を描き込んだ遮蔽バッファ
+//   - sphere: ワールド空間の境界球
+int is_occluded(const OcclusionBuffer *buffer, const float sphere[4]);
+
+// このCPUでSIMDによるカリングが使えるかを調べる関数。
+VkBool32 is_cull_simd_supported();
+
+// 境界球を視錐台と遮蔽バッファで選別し、見えるもののインデックスを昇順で書き込む関数。
+// 結果はそのままpush_drawに渡すオブジェクトの選択に使う。
+//   - jobs: ジョブシステム。NULLなら呼び出し側のスレッドだけで実行する
+//   - bounds: 境界球の配列
+//   - frustum: 視錐台
+//   - occlusion: 遮蔽バッファ。NULLなら遮蔽による選別を行わない
+//   - simd: 使えるならSIMDを使うか
+//   - visible: 見えるインデックスの書き込み先(bounds->cnt個以上)
+//   - p_visible_cnt: 見えるインデックスの数を格納するポインタ
+VkResult cull_bounds(
+    JobSystem *jobs,
+    const CullBounds *bounds,
+    const Frustum *frustum,
+    const OcclusionBuffer *occlusion,
+    VkBool32 simd,
+    uint32_t *visible,
+    uint32_t *p_visible_cnt
+);
+
+// 遮蔽バッファを破棄する関数。
+//   - buffer: 破棄する遮蔽バッファ
+void destroy_occlusion_buffer(OcclusionBuffer *buffer);
+
+// ファイルを読み込み専用でメモリマップする関数。
+//   - path: ファイルへのパス
+//   - out: 結果を格納するポインタ
+VkResult map_file(const char *path, MappedFile *out);
+
+// メモリマップしたファイルを解放する関数。
+//   - file: map_fileで得たファイル
+void unmap_file(MappedFile *file);
+
+// バイト列の64bitハッシュを計算する関数。暗号学的な強度はない。
+//   - data: データ
+//   - size: データのサイズ(bytes)
+//   - seed: 初期値
+uint64_t hash_bytes(const void *data, size_t size, uint64_t seed);
+
+// 頂点数からインデックスの型を選ぶ関数。
+// 頂点数が65535以下ならVK_INDEX_TYPE_UINT16、そうでなければVK_INDEX_TYPE_UINT32を返す。
+// NOTE: プリミティブリスタートと衝突しないよう、0xFFFFはインデックスとして使わない。
+//   - vertex_cnt: 頂点数
+VkIndexType select_index_type(uint32_t vertex_cnt);
+
+// 頂点一つのサイズ(bytes)を返す関数。
+//   - vertex_format: 頂点の形式
+uint32_t get_vertex_size(VertexFormat vertex_format);
+
+// インデックス一つのサイズ(bytes)を返す関数。
+//   - index_type: インデックスの型
+uint32_t get_index_size(VkIndexType index_type);
+
+// 頂点を囲む境界球を求める関数。中心はAABBの中心とする。
+//   - vtxs: 頂点
+//   - vertex_cnt: 頂点数
+//   - out: 結果(xyzが中心、wが半径)を格納する配列
+void compute_bounding_sphere(const MeshVertex *vtxs, uint32_t vertex_cnt, float out[4]);
+
+// glTF 2.0(.gltf/.glb)、OBJ、ベイク済みメッシュ(.bmesh)のファイルを読み、writerへ書き込む関数。
+// ファイルはメモリマップして読む。Vulkanのオブジェクトは作らない。
+//   - path: ファイルへのパス(拡張子で形式を判別する)
+//   - writer: 書き込み先
+//   - p_read_size: 読んだファイルの合計サイズ(bytes)を格納するポインタ(不要ならNULL)
+VkResult read_mesh_file(const char *path, MeshWriter *writer, size_t *p_read_size);
+
+// glTF 2.0(.gltf/.glb)、OBJ、ベイク済みメッシュ(.bmesh)のファイルからメッシュを作成する関数。
+// ファイルをメモリマップし、頂点とインデックスをステージングバッファへ直接書き込む。
+// インデックスはモデルごとにselect_index_typeで型を選ぶ。
+// uint16_tのインデックスや量子化した頂点は、CPUの作業領域に読んでから詰めて書き込む。
+// 位置とTEXCOORD_0のみを読む。ノードの変換は適用しない。
+// 転送はuploadに記録されるだけなので、使う前にflush_upload_contextで提出すること。
+//   - device: 論理デバイス
+//   - mem_prop: デバイスメモリのプロパティ
+//   - upload: アップロードコンテキスト
+//   - path: ファイルへのパス(拡張子で形式を判別する)
+//   - vertex_format: 頂点バッファに置く頂点の形式
+//   - out: 結果を格納するポインタ
+VkResult create_mesh_from_file(
+    const VkDevice device,
+    const VkPhysicalDeviceMemoryProperties *mem_prop,
+    UploadContext *upload,
+    const char *path,
+    VertexFormat vertex_format,
+    Mesh *out
+);
+
+// create_mesh_from_fileと同じくメッシュファイルを読み、モデルをジオメトリプール上に作る関数。
+// 頂点の形式とインデックスの型はプールに従う。
+// 破棄はdestroy_meshで行う。
+//   - upload: アップロードコンテキスト
+//   - pool: ジオメトリプール
+//   - path: ファイルへのパス(拡張子で形式を判別する)
+//   - out: 結果を格納するポインタ
+VkResult create_mesh_in_pool(UploadContext *upload, GeometryPool *pool, const char *path, Mesh *out);
+
+// 頂点の形式に合う頂点入力の記述を得る関数。
+// 位置をlocation 0、UVをlocation 1とし、バインディング0から読む。
+//   - vertex_format: 頂点の形式
+//   - binding: バインディングの記述を格納するポインタ
+//   - attrs: 属性の記述2つを格納する配列
+void get_vertex_input(VertexFormat vertex_format, VkVertexInputBindingDescription *binding, VkVertexInputAttributeDescription *attrs);
+
+// 頂点キャッシュ(post-transform cache)に当たりやすいよう、三角形の順序を並べ替える関数。
+// Tom Forsythの"Linear-Speed Vertex Cache Optimisation"による。
+//   - idxs: インデックス(その場で並べ替える)
+//   - index_cnt: インデックス数
+//   - vertex_cnt: 頂点数
+VkResult optimize_vertex_cache(uint32_t *idxs, uint32_t index_cnt, uint32_t vertex_cnt);
+
+// オーバードローが減るよう、頂点キャッシュの効率を保ったまま三角形のクラスタを並べ替える関数。
+// Sanderらの"Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"による。
+// optimize_vertex_cacheの後に呼ぶこと。
+//   - idxs: インデックス(その場で並べ替える)
+//   - index_cnt: インデックス数
+//   - vtxs: 頂点
+//   - vertex_cnt: 頂点数
+//   - threshold: 許容するACMRの悪化の割合(1.05なら5%まで)
+VkResult optimize_overdraw(uint32_t *idxs, uint32_t index_cnt, const MeshVertex *vtxs, uint32_t vertex_cnt, float threshold);
+
+// 頂点の読み込みが連続するよう、インデックスで参照される順に頂点を並べ替える関数。
+// 参照されない頂点は取り除かれる。
+//   - vtxs: 頂点(その場で並べ替える)
+//   - p_vertex_cnt: 頂点数(並べ替え後の頂点数が格納される)
+//   - idxs: インデックス(その場で書き換える)
+//   - index_cnt: インデックス数
+VkResult optimize_vertex_fetch(MeshVertex *vtxs, uint32_t *p_vertex_cnt, uint32_t *idxs, uint32_t index_cnt);
+
+// optimize_vertex_cache、optimize_overdraw、optimize_vertex_fetchの順にすべて適用する関数。
+VkResult optimize_mesh(MeshVertex *vtxs, uint32_t *p_vertex_cnt, uint32_t *idxs, uint32_t index_cnt);
+
+// 大きさ16のFIFOキャッシュを仮定して、頂点キャッシュの効率を調べる関数。
+//   - idxs: インデックス
+//   - index_cnt: インデックス数
+//   - vertex_cnt: 頂点数
+//   - out: 結果を格納するポインタ
+void analyze_vertex_cache(const uint32_t *idxs, uint32_t index_cnt, uint32_t vertex_cnt, VertexCacheStats *out);
+
+// メッシュを破棄する関数。ジオメトリプール上のメッシュなら、領域をプールに返す。
+//   - device: 論理デバイス
+//   - mesh: 破棄するメッシュ
+void destroy_mesh(const VkDevice device, Mesh *mesh);
@@ -0,0 +1,161 @@
+// glTF/OBJのメッシュを、実行時にそのまま転送できるベイク済みメッシュ(.bmesh)に変換するツール。
+//
+//   $ ./a.out <入力ファイル> <出力ファイル>
+//
+// 形式はvulkan-tutorial.hのBakedMeshHeaderを参照。
+
+#include "../common/vulkan-tutorial.h"
+
+#include <string.h>
+
+// 読み込んだモデルをCPUのメモリに溜めておくMeshWriterの状態。
+typedef struct Baker_t {
+    uint32_t model_cnt;
+    uint32_t model_cap;
+    BakedModel *models;
+    uint64_t payload_size;
+    uint64_t payload_cap;
+    uint8_t *payload;
+    double misses_before;
+    double misses_after;
+} Baker;
+
+static uint64_t align16(uint64_t n) {
+    return (n + 15) / 16 * 16;
+}
+
+static VkResult begin_baker(void *user, uint32_t vertex_cnt, uint32_t index_cnt, uint32_t index_size, MeshVertex **p_vtxs, void **p_idxs) {
+    Baker *baker = (Baker *)user;
+    if (baker->model_cnt == baker->model_cap) {
+        const uint32_t cap = baker->model_cap > 0 ? baker->model_cap * 2 : 16;
+        BakedModel *models = (BakedModel *)realloc(baker->models, sizeof(BakedModel) * cap);
+        CHECK_RETURN(models != NULL);
+        baker->models = models;
+        baker->model_cap = cap;
+    }
+
+    // NOTE: 頂点とインデックスを、それぞれ16bytes境界に揃えてペイロードの末尾に追加する。
+    const uint64_t vertex_offset = baker->payload_size;
+    const uint64_t index_offset = align16(vertex_offset + sizeof(MeshVertex) * (uint64_t)vertex_cnt);
+    const uint64_t end = align16(index_offset + sizeof(uint32_t) * (uint64_t)index_cnt);
+    if (end > baker->payload_cap) {
+        uint64_t cap = baker->payload_cap > 0 ? baker->payload_cap : 1024 * 1024;
+        while (cap < end)
+            cap *= 2;
+        uint8_t *payload = (uint8_t *)realloc(baker->payload, cap);
+        CHECK_RETURN(payload != NULL);
+        baker->payload = payload;
+        baker->payload_cap = cap;
+    }
+    // NOTE: パディングも含めて0で埋めておき、ハッシュを決定的にする。
+    memset(baker->payload + vertex_offset, 0, end - vertex_offset);
+    baker->payload_size = end;
+
+    // NOTE: 領域はuint32_tの分だけ取るので、uint16_tで受け取ってもend_bakerでその場で広げられる。
+    const BakedModel model = { vertex_cnt, index_cnt, index_size, 0, vertex_offset, index_offset };
+    baker->models[baker->model_cnt] = model;
+    baker->model_cnt += 1;
+    *p_vtxs = (MeshVertex *)(baker->payload + vertex_offset);
+    *p_idxs = (void *)(baker->payload + index_offset);
+    return VK_SUCCESS;
+}
+
+// 書き込み終えたモデルを最適化する関数。
+// NOTE: 実行時はステージングバッファへ直接書き込むため、読み戻しの要る最適化はベイク時にだけ行う。
+static VkResult end_baker(void *user) {
+    Baker *baker = (Baker *)user;
+    BakedModel *model = &baker->models[baker->model_cnt - 1];
+    MeshVertex *vtxs = (MeshVertex *)(baker->payload + model->vertex_offset);
+    uint32_t *idxs = (uint32_t *)(baker->payload + model->index_offset);
+    const uint32_t tri_cnt = model->index_cnt / 3;
+    // NOTE: uint16_tで受け取ったインデックスは、後ろから広げれば未読の要素を上書きしない。
+    if (model->index_size == sizeof(uint16_t)) {
+        const uint16_t *narrow = (const uint16_t *)idxs;
+        for (uint32_t i = model->index_cnt; i-- > 0; ) {
+            idxs[i] = narrow[i];
+        }
+        model->index_size = sizeof(uint32_t);
+    }
+
+    VertexCacheStats before, after;
+    analyze_vertex_cache(idxs, model->index_cnt, model->vertex_cnt, &before);
+    CHECK_RETURN_VK(optimize_mesh(vtxs, &model->vertex_cnt, idxs, model->index_cnt));
+    analyze_vertex_cache(idxs, model->index_cnt, model->vertex_cnt, &after);
+    baker->misses_before += (double)before.acmr * (double)tri_cnt;
+    baker->misses_after += (double)after.acmr * (double)tri_cnt;
+
+    // NOTE: 頂点数が許せば、インデックスをその場でuint16_tに詰める。前から詰めれば未読の要素を上書きしない。
+    if (select_index_type(model->vertex_cnt) == VK_INDEX_TYPE_UINT16) {
+        uint16_t *narrow = (uint16_t *)idxs;
+        for (uint32_t i = 0; i < model->index_cnt; ++i) {
+            narrow[i] = (uint16_t)idxs[i];
+        }
+        model->index_size = sizeof(uint16_t);
+    }
+
+    // NOTE: 頂点やインデックスが縮んだら、インデックスを前に詰めてペイロードを縮める。
+    const uint64_t vtxs_end = model->vertex_offset + sizeof(MeshVertex) * (uint64_t)model->vertex_cnt;
+    const uint64_t index_offset = align16(vtxs_end);
+    const uint64_t idxs_size = (uint64_t)model->index_size * model->index_cnt;
+    const uint64_t end = align16(index_offset + idxs_size);
+    memmove(baker->payload + index_offset, idxs, idxs_size);
+    memset(baker->payload + vtxs_end, 0, index_offset - vtxs_end);
+    memset(baker->payload + index_offset + idxs_size, 0, end - index_offset - idxs_size);
+    model->index_offset = index_offset;
+    baker->payload_size = end;
+    return VK_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+    CHECK(argc == 3, "usage: a.out <input> <output>");
+
+    Baker baker;
+    memset(&baker, 0, sizeof(Baker));
+    MeshWriter writer = { (void *)&baker, begin_baker, end_baker };
+    size_t read_size = 0;
+    CHECK_VK(read_mesh_file(argv[1], &writer, &read_size), "failed to read a mesh file.");
+
+    const uint64_t payload_offset = align16(sizeof(BakedMeshHeader) + sizeof(BakedModel) * (uint64_t)baker.model_cnt);
+    const BakedMeshHeader header = {
+        BAKED_MESH_MAGIC,
+        BAKED_MESH_VERSION,
+        sizeof(MeshVertex),
+        sizeof(BakedModel),
+        baker.model_cnt,
+        0,
+        payload_offset,
+        baker.payload_size,
+        hash_bytes(baker.payload, baker.payload_size, 0),
+    };
+    static const uint8_t PADDING[16] = { 0 };
+    const size_t padding = payload_offset - sizeof(BakedMeshHeader) - sizeof(BakedModel) * baker.model_cnt;
+
+    FILE *file = fopen(argv[2], "wb");
+    CHECK(file != NULL, "failed to open the output file.");
+    const int ok = fwrite(&header, sizeof(BakedMeshHeader), 1, file) == 1
+        && fwrite(baker.models, sizeof(BakedModel), baker.model_cnt, file) == baker.model_cnt
+        && fwrite(PADDING, 1, padding, file) == padding
+        && fwrite(baker.payload, 1, baker.payload_size, file) == baker.payload_size;
+    fclose(file);
+    CHECK(ok, "failed to write the output file.");
+
+    uint64_t triangle_cnt = 0;
+    for (uint32_t i = 0; i < baker.model_cnt; ++i) {
+        triangle_cnt += baker.models[i].index_cnt / 3;
+    }
+    printf(
+        "%s -> %s: %u models, %llu triangles, %.2f MB -> %.2f MB, ACMR %.3f -> %.3f\n",
+        argv[1],
+        argv[2],
+        baker.model_cnt,
+        (unsigned long long)triangle_cnt,
+        (double)read_size / 1e6,
+        (double)(payload_offset + baker.payload_size) / 1e6,
+        triangle_cnt > 0 ? baker.misses_before / (double)triangle_cnt : 0.0,
+        triangle_cnt > 0 ? baker.misses_after / (double)triangle_cnt : 0.0
+    );
+
+    free(baker.models);
+    free(baker.payload);
+    return 0;
+}
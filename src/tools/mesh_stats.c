@@ -0,0 +1,126 @@
+// メッシュの最適化の効果を、頂点キャッシュの統計(ACMR/ATVR)で報告するツール。
+//
+//   $ ./a.out <メッシュファイル>...
+//
+// ファイルごとに、元の順序、optimize_vertex_cache後、optimize_overdraw後のACMR/ATVRを表示する。
+// 最後に、与えたすべてのファイルの三角形数で重み付けした平均を表示する。
+
+#include "../common/vulkan-tutorial.h"
+
+#include <string.h>
+#include <time.h>
+
+#define STAGE_CNT 3
+
+// 読み込んだモデルを一つずつ最適化して統計を取る、MeshWriterの状態。
+typedef struct Stats_t {
+    uint32_t vertex_cnt;
+    uint32_t index_cnt;
+    uint32_t index_size; // NOTE: 読み込み側が書き込んだインデックスの大きさ
+    uint32_t vertex_cap;
+    uint32_t index_cap;
+    MeshVertex *vtxs;
+    uint32_t *idxs;
+    uint64_t triangle_cnt;
+    uint64_t vertex_total;
+    double misses[STAGE_CNT];
+    double sec;
+} Stats;
+
+static double get_time_sec() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static VkResult begin_stats(void *user, uint32_t vertex_cnt, uint32_t index_cnt, uint32_t index_size, MeshVertex **p_vtxs, void **p_idxs) {
+    Stats *stats = (Stats *)user;
+    // NOTE: モデルごとに作業領域を使い回す。
+    if (vertex_cnt > stats->vertex_cap) {
+        MeshVertex *vtxs = (MeshVertex *)realloc(stats->vtxs, sizeof(MeshVertex) * vertex_cnt);
+        CHECK_RETURN(vtxs != NULL);
+        stats->vtxs = vtxs;
+        stats->vertex_cap = vertex_cnt;
+    }
+    if (index_cnt > stats->index_cap) {
+        uint32_t *idxs = (uint32_t *)realloc(stats->idxs, sizeof(uint32_t) * index_cnt);
+        CHECK_RETURN(idxs != NULL);
+        stats->idxs = idxs;
+        stats->index_cap = index_cnt;
+    }
+    stats->vertex_cnt = vertex_cnt;
+    stats->index_cnt = index_cnt;
+    stats->index_size = index_size;
+    *p_vtxs = stats->vtxs;
+    *p_idxs = stats->idxs;
+    return VK_SUCCESS;
+}
+
+static VkResult end_stats(void *user) {
+    Stats *stats = (Stats *)user;
+    const uint32_t tri_cnt = stats->index_cnt / 3;
+    VertexCacheStats vcs[STAGE_CNT];
+    // NOTE: uint16_tで受け取ったインデックスは、後ろから広げれば未読の要素を上書きしない。
+    if (stats->index_size == sizeof(uint16_t)) {
+        const uint16_t *narrow = (const uint16_t *)stats->idxs;
+        for (uint32_t i = stats->index_cnt; i-- > 0; ) {
+            stats->idxs[i] = narrow[i];
+        }
+    }
+
+    analyze_vertex_cache(stats->idxs, stats->index_cnt, stats->vertex_cnt, &vcs[0]);
+    const double start = get_time_sec();
+    CHECK_RETURN_VK(optimize_vertex_cache(stats->idxs, stats->index_cnt, stats->vertex_cnt));
+    analyze_vertex_cache(stats->idxs, stats->index_cnt, stats->vertex_cnt, &vcs[1]);
+    CHECK_RETURN_VK(optimize_overdraw(stats->idxs, stats->index_cnt, stats->vtxs, stats->vertex_cnt, OVERDRAW_THRESHOLD));
+    analyze_vertex_cache(stats->idxs, stats->index_cnt, stats->vertex_cnt, &vcs[2]);
+    CHECK_RETURN_VK(optimize_vertex_fetch(stats->vtxs, &stats->vertex_cnt, stats->idxs, stats->index_cnt));
+    stats->sec += get_time_sec() - start;
+
+    // NOTE: ミスの数に戻して足し合わせ、あとで三角形数・頂点数で割る。
+    for (uint32_t i = 0; i < STAGE_CNT; ++i) {
+        stats->misses[i] += (double)vcs[i].acmr * (double)tri_cnt;
+    }
+    stats->triangle_cnt += tri_cnt;
+    stats->vertex_total += stats->vertex_cnt;
+    return VK_SUCCESS;
+}
+
+static void print_stats(const char *name, const Stats *stats) {
+    static const char *STAGE_NAMES[STAGE_CNT] = { "original", "vertex cache", "overdraw" };
+    printf("%s: %llu triangles, optimized in %.3f ms\n", name, (unsigned long long)stats->triangle_cnt, stats->sec * 1000.0);
+    for (uint32_t i = 0; i < STAGE_CNT; ++i) {
+        printf(
+            "    %-14s ACMR %6.3f  ATVR %6.3f\n",
+            STAGE_NAMES[i],
+            stats->triangle_cnt > 0 ? stats->misses[i] / (double)stats->triangle_cnt : 0.0,
+            stats->vertex_total > 0 ? stats->misses[i] / (double)stats->vertex_total : 0.0
+        );
+    }
+}
+
+int main(int argc, char **argv) {
+    CHECK(argc > 1, "usage: a.out <mesh file>...");
+
+    Stats total;
+    memset(&total, 0, sizeof(Stats));
+    for (int i = 1; i < argc; ++i) {
+        Stats stats;
+        memset(&stats, 0, sizeof(Stats));
+        MeshWriter writer = { (void *)&stats, begin_stats, end_stats };
+        CHECK_VK(read_mesh_file(argv[i], &writer, NULL), "failed to read a mesh file.");
+        print_stats(argv[i], &stats);
+
+        total.triangle_cnt += stats.triangle_cnt;
+        total.vertex_total += stats.vertex_total;
+        total.sec += stats.sec;
+        for (uint32_t j = 0; j < STAGE_CNT; ++j) {
+            total.misses[j] += stats.misses[j];
+        }
+        free(stats.vtxs);
+        free(stats.idxs);
+    }
+    if (argc > 2)
+        print_stats("total", &total);
+    return 0;
+}